@@ -1,15 +1,514 @@
+#pragma once
 #include <stdlib.h>
 #include <stdio.h>
 #include <limits.h>
 #include <inttypes.h>
+#include <stdatomic.h>
+#include <pthread.h>
 #include <time.h>
+/* a lock-free skip list used as a concurrent ordered map from key_value to
+value. Every level is a sorted linked list whose next pointers only change
+by compare-and-swap. A node is deleted by setting the lowest bit of its next
+pointers (marking) from the top level down; whoever marks level 0 owns the
+deletion, and marked nodes are unlinked by any thread which walks past them.
+Unlinked nodes are retired and freed once every thread which was inside an
+operation at that time has left it (epoch based reclamation). */
+#define SKIP_LIST_MAX_LEVEL 24
+/* the number of nodes a thread retires between two reclamations */
+#define SKIP_LIST_RECLAIM_BATCH 64
+#define SKIP_NODE_LINKING 0
+#define SKIP_NODE_LINKED 1
+#define SKIP_NODE_DELETED 2
+
 struct skip_node {
     int32_t key_value;
-    int *fd;
-    struct skip_node *next;
-    struct skip_node *skip_to;};
+    int8_t top_level;
+    /* the inserter and the deleter meet here to tell who retires the node */
+    _Atomic int8_t state;
+    /* put_a_key_in_skip_list() may overwrite it under readers */
+    _Atomic int64_t value;
+    /* set once the node is unlinked */
+    uint64_t retired_epoch;
+    struct skip_node *next_retired;
+    _Atomic uintptr_t next[];};
+
+/* the epoch a thread entered an operation in, its retired nodes and its random state */
+struct skip_list_thread {
+    _Atomic uint64_t epoch;
+    /* an iterator stays inside an operation, and the operations it makes nest in it */
+    uint32_t nesting;
+    struct skip_list *list;
+    struct skip_node *retired;
+    uint32_t retired_number;
+    uint64_t random_state;
+    struct skip_list_thread *prev, *next;};
+
+struct skip_list {
+    struct skip_node *head;
+    _Atomic uint64_t global_epoch;
+    pthread_key_t thread_key;
+    /* guards thread_list and orphan */
+    pthread_mutex_t mutex;
+    struct skip_list_thread *thread_list;
+    /* retired nodes left by exited threads */
+    struct skip_node *orphan;};
+
+static inline _Bool is_a_marked_skip_pointer(uintptr_t pointer)
+{
+    return pointer & 1;
+}
+
+static inline struct skip_node *skip_node_of_a_pointer(uintptr_t pointer)
+{
+    return (struct skip_node *)(pointer & ~(uintptr_t)1);
+}
+
+static struct skip_node *alloc_a_new_skip_node(int32_t key_value, int64_t value, int8_t top_level)
+{
+    struct skip_node *node = (struct skip_node *)malloc(sizeof(struct skip_node)
+    + (top_level + 1) * sizeof(_Atomic uintptr_t));
+    if (node == NULL)
+        perror("fail to allocate a skip node"), exit(EXIT_FAILURE);
+    node->key_value = key_value;
+    node->top_level = top_level;
+    atomic_init(&node->state, SKIP_NODE_LINKING);
+    atomic_init(&node->value, value);
+    node->retired_epoch = 0;
+    node->next_retired = NULL;
+    for (int8_t i = 0; i <= top_level; i++)
+        atomic_init(&node->next[i], 0);
+    return node;
+}
+
+static void free_a_list_of_retired_skip_nodes(struct skip_node *node)
+{
+    while (node)
+    {
+        struct skip_node *next = node->next_retired;
+        free(node);
+        node = next;
+    }
+    return;
+}
+
+/* hand the retired nodes of an exiting thread over to the list */
+static void release_a_skip_list_thread(void *arg)
+{
+    struct skip_list_thread *thread = (struct skip_list_thread *)arg;
+    struct skip_list *list = thread->list;
+    pthread_mutex_lock(&list->mutex);
+    while (thread->retired)
+    {
+        struct skip_node *node = thread->retired;
+        thread->retired = node->next_retired;
+        node->next_retired = list->orphan, list->orphan = node;
+    }
+    if (thread->prev) thread->prev->next = thread->next;
+    else list->thread_list = thread->next;
+    if (thread->next) thread->next->prev = thread->prev;
+    pthread_mutex_unlock(&list->mutex);
+    free(thread);
+    return;
+}
+
+struct skip_list *init_skip_list(void)
+{
+    struct skip_list *list = (struct skip_list *)calloc(1, sizeof(struct skip_list));
+    if (list == NULL)
+        perror("fail to allocate a skip list"), exit(EXIT_FAILURE);
+    /* the key of head is never compared */
+    list->head = alloc_a_new_skip_node(INT32_MIN, 0, SKIP_LIST_MAX_LEVEL - 1);
+    atomic_init(&list->global_epoch, 1);
+    pthread_mutex_init(&list->mutex, NULL);
+    if (pthread_key_create(&list->thread_key, release_a_skip_list_thread))
+        perror("fail to create the skip list thread key"), exit(EXIT_FAILURE);
+    return list;
+}
+
+/* free the list and every node in it. No thread may use the list during or after the call. */
+void destroy_skip_list(struct skip_list *list)
+{
+    pthread_key_delete(list->thread_key);
+    while (list->thread_list)
+    {
+        struct skip_list_thread *thread = list->thread_list;
+        list->thread_list = thread->next;
+        free_a_list_of_retired_skip_nodes(thread->retired);
+        free(thread);
+    }
+    free_a_list_of_retired_skip_nodes(list->orphan);
+    struct skip_node *node = list->head;
+    while (node)
+    {
+        struct skip_node *next = skip_node_of_a_pointer(atomic_load(&node->next[0]));
+        free(node);
+        node = next;
+    }
+    pthread_mutex_destroy(&list->mutex);
+    free(list);
+    return;
+}
+
+/* free every node of the list, which stays usable and keeps its threads.
+No operation may run during the call. */
+void empty_a_skip_list(struct skip_list *list)
+{
+    pthread_mutex_lock(&list->mutex);
+    for (struct skip_list_thread *thread = list->thread_list; thread; thread = thread->next)
+    {
+        free_a_list_of_retired_skip_nodes(thread->retired);
+        thread->retired = NULL, thread->retired_number = 0;
+    }
+    free_a_list_of_retired_skip_nodes(list->orphan);
+    list->orphan = NULL;
+    pthread_mutex_unlock(&list->mutex);
+    struct skip_node *node = skip_node_of_a_pointer(atomic_load(&list->head->next[0]));
+    while (node)
+    {
+        struct skip_node *next = skip_node_of_a_pointer(atomic_load(&node->next[0]));
+        free(node);
+        node = next;
+    }
+    for (int8_t i = 0; i <= list->head->top_level; i++)
+        atomic_store(&list->head->next[i], 0);
+    return;
+}
+
+static struct skip_list_thread *get_the_skip_list_thread(struct skip_list *list)
+{
+    struct skip_list_thread *thread = (struct skip_list_thread *)pthread_getspecific(list->thread_key);
+    if (__builtin_expect(thread != NULL, 1)) return thread;
+    thread = (struct skip_list_thread *)calloc(1, sizeof(struct skip_list_thread));
+    if (thread == NULL)
+        perror("fail to allocate a skip list thread"), exit(EXIT_FAILURE);
+    thread->list = list;
+    thread->random_state = (uint64_t)(uintptr_t)thread ^ (uint64_t)time(NULL) ^ 0x9E3779B97F4A7C15;
+    pthread_mutex_lock(&list->mutex);
+    thread->next = list->thread_list;
+    if (list->thread_list) list->thread_list->prev = thread;
+    list->thread_list = thread;
+    pthread_mutex_unlock(&list->mutex);
+    pthread_setspecific(list->thread_key, thread);
+    return thread;
+}
+
+/* announce the current epoch until it is still current after the announcement,
+so a reclaimer either sees it or has moved on before this thread reads any node. */
+static struct skip_list_thread *enter_a_skip_list_operation(struct skip_list *list)
+{
+    struct skip_list_thread *thread = get_the_skip_list_thread(list);
+    if (thread->nesting++) return thread;
+    uint64_t epoch = atomic_load(&list->global_epoch), current;
+    atomic_store(&thread->epoch, epoch);
+    while ((current = atomic_load(&list->global_epoch)) != epoch)
+        atomic_store(&thread->epoch, epoch = current);
+    return thread;
+}
+
+static void leave_a_skip_list_operation(struct skip_list_thread *thread)
+{
+    if (--thread->nesting == 0)
+        atomic_store(&thread->epoch, 0);
+    return;
+}
 
-void init_skip_list(struct skip_node *head_to_skip_list, size_t n)
+/* free the nodes of a retired list which were retired before oldest_epoch,
+and return the others as a list */
+static struct skip_node *free_retired_skip_nodes_before(struct skip_node *node, uint64_t oldest_epoch,
+uint32_t *kept_number)
 {
+    struct skip_node *kept = NULL;
+    while (node)
+    {
+        struct skip_node *next = node->next_retired;
+        if (node->retired_epoch < oldest_epoch) free(node);
+        else node->next_retired = kept, kept = node, (*kept_number)++;
+        node = next;
+    }
+    return kept;
+}
 
-}
\ No newline at end of file
+/* free the retired nodes of thread, and of exited threads, which were
+retired before the oldest epoch still announced. */
+static void reclaim_retired_skip_nodes(struct skip_list *list, struct skip_list_thread *thread)
+{
+    atomic_fetch_add(&list->global_epoch, 1);
+    uint64_t oldest_epoch = UINT64_MAX;
+    pthread_mutex_lock(&list->mutex);
+    for (struct skip_list_thread *other = list->thread_list; other; other = other->next)
+    {
+        uint64_t epoch = atomic_load(&other->epoch);
+        if (epoch && epoch < oldest_epoch) oldest_epoch = epoch;
+    }
+    struct skip_node *orphan = list->orphan;
+    list->orphan = NULL;
+    pthread_mutex_unlock(&list->mutex);
+    uint32_t kept_number = 0;
+    thread->retired = free_retired_skip_nodes_before(thread->retired, oldest_epoch, &kept_number);
+    /* the orphans which have to wait join the retired nodes of this thread */
+    orphan = free_retired_skip_nodes_before(orphan, oldest_epoch, &kept_number);
+    while (orphan)
+    {
+        struct skip_node *next = orphan->next_retired;
+        orphan->next_retired = thread->retired, thread->retired = orphan;
+        orphan = next;
+    }
+    thread->retired_number = kept_number;
+    return;
+}
+
+/* node is unlinked from every level, and only threads inside an operation may still hold it */
+static void retire_a_skip_node(struct skip_list *list, struct skip_list_thread *thread, struct skip_node *node)
+{
+    node->retired_epoch = atomic_load(&list->global_epoch);
+    node->next_retired = thread->retired;
+    thread->retired = node;
+    if (++thread->retired_number >= SKIP_LIST_RECLAIM_BATCH)
+        reclaim_retired_skip_nodes(list, thread);
+    return;
+}
+
+/* a level is kept with probability 1/4 for each level above 0 */
+static int8_t random_level_of_a_skip_node(struct skip_list_thread *thread)
+{
+    thread->random_state ^= thread->random_state << 13;
+    thread->random_state ^= thread->random_state >> 7;
+    thread->random_state ^= thread->random_state << 17;
+    uint64_t random = thread->random_state;
+    int8_t level = 0;
+    while ((random & 3) == 0 && level < SKIP_LIST_MAX_LEVEL - 1)
+        random >>= 2, level++;
+    return level;
+}
+
+/* fill preds and succs with the nodes around key_value on every level and
+unlink the marked nodes met on the way. Return 1 if an unmarked node holds key_value. */
+static _Bool look_up_the_neighbours_in_skip_list(struct skip_list *list, int32_t key_value,
+struct skip_node **preds, struct skip_node **succs)
+{
+retry:
+    ;
+    struct skip_node *pred = list->head, *cur = NULL;
+    for (int8_t level = SKIP_LIST_MAX_LEVEL - 1; level >= 0; level--)
+    {
+        cur = skip_node_of_a_pointer(atomic_load(&pred->next[level]));
+        while (cur)
+        {
+            uintptr_t succ = atomic_load(&cur->next[level]);
+            while (is_a_marked_skip_pointer(succ))
+            {
+                /* cur is being deleted, so skip it over */
+                uintptr_t expected = (uintptr_t)cur;
+                if (!atomic_compare_exchange_strong(&pred->next[level], &expected,
+                (uintptr_t)skip_node_of_a_pointer(succ)))
+                    goto retry;
+                cur = skip_node_of_a_pointer(succ);
+                if (cur == NULL) break;
+                succ = atomic_load(&cur->next[level]);
+            }
+            if (cur == NULL || cur->key_value >= key_value) break;
+            pred = cur;
+            cur = skip_node_of_a_pointer(succ);
+        }
+        preds[level] = pred;
+        succs[level] = cur;
+    }
+    return cur && cur->key_value == key_value;
+}
+
+/* return 0 and the value of key_value through value, or -1 if absent.
+A search never writes, so it only walks past marked nodes. */
+int look_up_a_key_in_skip_list(struct skip_list *list, int32_t key_value, int64_t *value)
+{
+    struct skip_list_thread *thread = enter_a_skip_list_operation(list);
+    struct skip_node *pred = list->head, *cur = NULL;
+    for (int8_t level = SKIP_LIST_MAX_LEVEL - 1; level >= 0; level--)
+    {
+        cur = skip_node_of_a_pointer(atomic_load(&pred->next[level]));
+        while (cur && cur->key_value < key_value)
+        {
+            pred = cur;
+            cur = skip_node_of_a_pointer(atomic_load(&cur->next[level]));
+        }
+    }
+    int state = -1;
+    if (cur && cur->key_value == key_value && !is_a_marked_skip_pointer(atomic_load(&cur->next[0])))
+    {
+        if (value) *value = atomic_load_explicit(&cur->value, memory_order_relaxed);
+        state = 0;
+    }
+    leave_a_skip_list_operation(thread);
+    return state;
+}
+
+/* link a new node for key_value. If key_value is there already, overwrite
+its value if overwriting is set. Return 0 if linked, 1 if overwritten, -1 if left as it was. */
+static int link_a_key_in_skip_list(struct skip_list *list, int32_t key_value, int64_t value, _Bool overwriting)
+{
+    struct skip_node *preds[SKIP_LIST_MAX_LEVEL], *succs[SKIP_LIST_MAX_LEVEL];
+    struct skip_list_thread *thread = enter_a_skip_list_operation(list);
+    int8_t top_level = random_level_of_a_skip_node(thread);
+    struct skip_node *new_node = NULL;
+    while (1)
+    {
+        if (look_up_the_neighbours_in_skip_list(list, key_value, preds, succs))
+        {
+            if (overwriting) atomic_store_explicit(&succs[0]->value, value, memory_order_relaxed);
+            leave_a_skip_list_operation(thread);
+            /* new_node was never reachable by other threads */
+            free(new_node);
+            return overwriting ? 1 : -1;
+        }
+        if (new_node == NULL) new_node = alloc_a_new_skip_node(key_value, value, top_level);
+        for (int8_t level = 0; level <= top_level; level++)
+            atomic_store_explicit(&new_node->next[level], (uintptr_t)succs[level], memory_order_relaxed);
+        /* the node is in the map once it is linked on level 0 */
+        uintptr_t expected = (uintptr_t)succs[0];
+        if (atomic_compare_exchange_strong(&preds[0]->next[0], &expected, (uintptr_t)new_node))
+            break;
+    }
+    for (int8_t level = 1; level <= top_level; level++)
+    {
+        while (1)
+        {
+            uintptr_t next = atomic_load(&new_node->next[level]);
+            /* a deleter marked it meanwhile, so stop linking it */
+            if (is_a_marked_skip_pointer(next)) goto linked;
+            if (next != (uintptr_t)succs[level]
+            && !atomic_compare_exchange_strong(&new_node->next[level], &next, (uintptr_t)succs[level]))
+                goto linked;
+            uintptr_t expected = (uintptr_t)succs[level];
+            if (atomic_compare_exchange_strong(&preds[level]->next[level], &expected, (uintptr_t)new_node))
+                break;
+            look_up_the_neighbours_in_skip_list(list, key_value, preds, succs);
+            if (succs[0] != new_node) goto linked;
+        }
+    }
+linked:
+    /* if it was deleted while being linked, the deleter left unlinking and
+    retiring to this thread, since only this thread knows when linking stops. */
+    if (atomic_exchange(&new_node->state, SKIP_NODE_LINKED) == SKIP_NODE_DELETED)
+    {
+        look_up_the_neighbours_in_skip_list(list, key_value, preds, succs);
+        retire_a_skip_node(list, thread, new_node);
+    }
+    leave_a_skip_list_operation(thread);
+    return 0;
+}
+
+/* return 0, or -1 if key_value is there already. */
+int insert_a_key_in_skip_list(struct skip_list *list, int32_t key_value, int64_t value)
+{
+    if (link_a_key_in_skip_list(list, key_value, value, 0) == 0)
+        return 0;
+    fprintf(stderr, "insert failed. This skip list has already a key value %" PRId32".\n", key_value);
+    return -1;
+}
+
+/* insert key_value, or overwrite its value. Return 0 if inserted, 1 if overwritten. */
+int put_a_key_in_skip_list(struct skip_list *list, int32_t key_value, int64_t value)
+{
+    return link_a_key_in_skip_list(list, key_value, value, 1);
+}
+
+/* return 0, or -1 if key_value is absent. */
+int delete_a_key_in_skip_list(struct skip_list *list, int32_t key_value)
+{
+    struct skip_node *preds[SKIP_LIST_MAX_LEVEL], *succs[SKIP_LIST_MAX_LEVEL];
+    struct skip_list_thread *thread = enter_a_skip_list_operation(list);
+    if (!look_up_the_neighbours_in_skip_list(list, key_value, preds, succs))
+    {
+        leave_a_skip_list_operation(thread);
+        fprintf(stderr, "no key value %" PRId32" in skip list!\n", key_value);
+        return -1;
+    }
+    struct skip_node *node = succs[0];
+    for (int8_t level = node->top_level; level > 0; level--)
+    {
+        uintptr_t next = atomic_load(&node->next[level]);
+        while (!is_a_marked_skip_pointer(next)
+        && !atomic_compare_exchange_weak(&node->next[level], &next, next | 1));
+    }
+    uintptr_t next = atomic_load(&node->next[0]);
+    while (1)
+    {
+        if (is_a_marked_skip_pointer(next))
+        {
+            /* another thread deleted it first */
+            leave_a_skip_list_operation(thread);
+            fprintf(stderr, "no key value %" PRId32" in skip list!\n", key_value);
+            return -1;
+        }
+        if (atomic_compare_exchange_weak(&node->next[0], &next, next | 1))
+            break;
+    }
+    /* unlink it on every level, unless the inserter is still linking it */
+    if (atomic_exchange(&node->state, SKIP_NODE_DELETED) == SKIP_NODE_LINKED)
+    {
+        look_up_the_neighbours_in_skip_list(list, key_value, preds, succs);
+        retire_a_skip_node(list, thread, node);
+    }
+    leave_a_skip_list_operation(thread);
+    return 0;
+}
+
+/* a position in level 0. The iterating thread stays inside an operation, so
+the nodes it walks are not freed, until close_a_skip_list_iterator(). */
+struct skip_list_iterator {
+    struct skip_list_thread *thread;
+    struct skip_node *node;};
+
+/* position iter at the first key which is not less than lower_key. Keys
+inserted or deleted during the iteration may be seen or not, but every key
+present for the whole iteration is seen once, in order.
+Return 0, or -1 if every key in the list is less than lower_key. */
+int lower_bound_in_skip_list(struct skip_list *list, int32_t lower_key, struct skip_list_iterator *iter)
+{
+    iter->thread = enter_a_skip_list_operation(list);
+    struct skip_node *pred = list->head, *cur = NULL;
+    for (int8_t level = SKIP_LIST_MAX_LEVEL - 1; level >= 0; level--)
+    {
+        cur = skip_node_of_a_pointer(atomic_load(&pred->next[level]));
+        while (cur && cur->key_value < lower_key)
+        {
+            pred = cur;
+            cur = skip_node_of_a_pointer(atomic_load(&cur->next[level]));
+        }
+    }
+    iter->node = cur;
+    return cur ? 0 : -1;
+}
+
+/* copy at most batch_size keys not greater than upper_key, and their values
+if value_buf is not NULL, then advance iter past them. Deleted keys are
+skipped. Return the number of copied keys, which is 0 at the end of the range. */
+int32_t next_batch_in_skip_list(struct skip_list_iterator *iter, int32_t upper_key,
+int32_t *key_buf, int64_t *value_buf, int32_t batch_size)
+{
+    int32_t copied = 0;
+    while (iter->node && copied < batch_size)
+    {
+        struct skip_node *node = iter->node;
+        if (node->key_value > upper_key)
+        {
+            iter->node = NULL;
+            break;
+        }
+        uintptr_t next = atomic_load(&node->next[0]);
+        if (!is_a_marked_skip_pointer(next))
+        {
+            key_buf[copied] = node->key_value;
+            if (value_buf) value_buf[copied] = atomic_load_explicit(&node->value, memory_order_relaxed);
+            copied++;
+        }
+        iter->node = skip_node_of_a_pointer(next);
+    }
+    return copied;
+}
+
+void close_a_skip_list_iterator(struct skip_list_iterator *iter)
+{
+    leave_a_skip_list_operation(iter->thread);
+    iter->node = NULL;
+    return;
+}
@@ -247,27 +247,22 @@ static size_t insert_leaf_in_tree_node(struct tree_node *node, struct tree_node
         perror("fail to allocate array");
         exit(EXIT_FAILURE);
     }
-    size_t pos = 0;
-    if (node->child_num != 0)
+    /* children stay sorted by dist; new_leaf goes after those of equal dist */
+    size_t left = 0, right = node->child_num;
+    while (left < right)
     {
-        size_t left = 0, right = node->child_num - 1, middle;
-        while (left <= right)
-        {
-            middle = left + ((right - left) >> 1);
-            if (node->next[middle]->dist == new_leaf->dist)
-                break;
-            else if (node->next[middle]->dist > new_leaf->dist)
-                right = middle - 1;
-            else left = middle + 1;
-        }
-        pos = left > middle ? left : middle;
-        for (size_t i = pos; i < node->child_num; i++)
-            node->next[i + 1] = node->next[i];
+        size_t middle = left + ((right - left) >> 1);
+        if (node->next[middle]->dist > new_leaf->dist)
+            right = middle;
+        else left = middle + 1;
     }
-    node->child_num++;
+    size_t pos = left;
+    for (size_t i = node->child_num; i > pos; i--)
+        node->next[i] = node->next[i - 1];
     node->next[pos] = new_leaf;
     new_leaf->parent = node;
     new_leaf->parent_id = node->node_id;
+    node->child_num++;
     return pos;
 }
 
@@ -279,6 +274,7 @@ static void delete_all_nodes_in_undirc_tree(struct tree_node *node)
     }
     for (size_t i = 0; i < node->child_num; i++)
         delete_all_nodes_in_undirc_tree(node->next[i]);
+    free(node->next);
     free(node);
     return;
 }
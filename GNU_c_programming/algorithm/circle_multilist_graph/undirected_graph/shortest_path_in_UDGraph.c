@@ -2,233 +2,99 @@
 #include <inttypes.h>
 #include "UDGraph.c"
 
-struct binomial_node
-{   struct tree_node *node;
-    size_t degree;
-    struct binomial_node *left_child;
-    struct binomial_node *parent;
-    struct binomial_node *sibling;};
+/* the unvisited nodes ordered by dist, with the node ids as handles */
+#define D_ARY_HEAP_NAME dist_heap
+#define D_ARY_HEAP_KEY_TYPE int64_t
+#include "../../tree/d_ary_heap_template.c"
 
-struct binomial_heap
-{   struct binomial_node *head;
-    /* priority queue for positioning to decrease key */
-    struct binomial_node *prior_queue[NODE_NUM];};
-
-static struct binomial_node *link_binomial_trees(struct binomial_node *front
-, struct binomial_node *rear, struct binomial_node *first)
+static struct tree_node *alloc_a_tree_node(int node_id, int64_t dist, int parent_id)
 {
-    if (front->node->dist <= rear->node->dist)
-    {
-        front->sibling = rear->sibling;
-        rear->parent = front;
-        rear->sibling = front->left_child;
-        front->left_child = rear;
-        front->degree++;
-    }
-    else
-    {
-        if (front == first) rear = first;
-        front->parent = rear;
-        front->sibling = rear->left_child;
-        rear->left_child = front;
-        rear->degree++;
-        front = rear;
-    }
-    return front;
+    struct tree_node *node = (struct tree_node *)malloc(sizeof(struct tree_node));
+    if (node == NULL)
+        perror("fail to allocate a tree node"), exit(EXIT_FAILURE);
+    *node = (struct tree_node){node_id, dist, NULL, parent_id, NULL, 0};
+    return node;
 }
 
-static struct tree_node *extract_min_binomial_node(struct binomial_heap *heap)
+/* push the unvisited neighbours of node into the heap, or decrease their
+dist if node brings them closer. candidate[v] is the tree node of v from
+its first push on. */
+static void relax_adj_nodes_in_dist_heap(const struct tree_node *node, const struct UDGraph_info *UDGraph,
+struct dist_heap *heap, struct tree_node **candidate, const _Bool *visited, _Bool flag)
 {
-    struct binomial_node *min = heap->head, *prev_of_min = NULL;
-    struct binomial_node *i;
-    *i = (struct binomial_node){0};
-    for (i->sibling = heap->head; i->sibling != NULL; i = i->sibling)
-        if (i->sibling->node->dist < min->node->dist)
-        {
-            min = i->sibling;
-            prev_of_min = i;
-        }
-    /* delete minimum-key node */
-    if (prev_of_min == NULL)
-        heap->head = min->sibling;
-    else prev_of_min->sibling = min->sibling;
-    /* sort binomial trees in the degree of root */
-    struct binomial_node *cur1 = heap->head;
-    struct binomial_node *cur2 = min->left_child;
-    for (i = min->left_child; i != NULL; i = i->sibling)
-        i->parent = NULL;
-    /* sort binomial trees in the degree of root */
-    heap->head = (cur1->degree < cur2->degree) ? cur1 : cur2;
-    *i = (struct binomial_node){0};
-    while (cur1 != NULL && cur2 != NULL)
+    for (struct adj_line *adj_line = UDGraph->adj[node->node_id]; adj_line != NULL;
+    adj_line = (adj_line->i_node == node->node_id) ? adj_line->i_next : adj_line->j_next)
     {
-        if (cur1->degree < cur2->degree)
-        {
-            i->sibling = cur1;
-            cur1 = cur1->sibling;
-        }
-        else
+        int v = (adj_line->i_node != node->node_id) ? adj_line->i_node : adj_line->j_node;
+        int64_t dist = adj_line->weight + node->dist * flag;
+        if (visited[v]) continue;
+        if (candidate[v] == NULL)
         {
-            i->sibling = cur2;
-            cur2 = cur2->sibling;
+            candidate[v] = alloc_a_tree_node(v, dist, node->node_id);
+            push_a_key_in_dist_heap(heap, v, dist);
         }
-        i = i->sibling;
-    }
-    while (cur1 != NULL)
-    {
-        i->sibling = cur1;
-        cur1 = cur1->sibling;
-        i = i->sibling;
-    }
-    while (cur2 != NULL)
-    {
-        i->sibling = cur2;
-        cur2 = cur2->sibling;
-        i = i->sibling;
-    }
-    /* merge binomial trees from head of binomial_heap */
-    for (i = heap->head; i->sibling != NULL;)
-    {
-        struct binomial_node *next_of_i = i->sibling;
-        if ((i->degree != next_of_i->degree) ||
-        ((next_of_i->sibling != NULL) && (next_of_i->degree == next_of_i->sibling->degree)))
-            i = i->sibling;
-        else i = link_binomial_trees(i, next_of_i, heap->head);
-    }
-    heap->prior_queue[min->node->node_id] = NULL;
-    return min->node;
-}
-
-/* worst complexity of inserting a node in binomial heap is O(log n) */
-static void insert_a_node_in_binomial_heap(struct binomial_heap *heap, struct tree_node *const cand)
-{
-    struct binomial_node *new_node = (struct binomial_node *)malloc(sizeof(struct binomial_node));
-    memset(new_node, 0, sizeof(struct binomial_node));
-    new_node->node = cand;
-    /* set new_node as the first binomial tree in binomial_heap */
-    new_node->sibling = heap->head;
-    heap->head = new_node;
-    /* add new node in first of heap and unite binomial trees one by one */
-    struct binomial_node *cur, *next_of_cur;
-    for (cur = new_node; cur->sibling != NULL;)
-    /* worst complexity of inserting a node in binomial heap is O(log n) */
-    {
-        next_of_cur = cur->sibling;
-        if (next_of_cur->sibling != NULL &&
-        next_of_cur->degree == next_of_cur->sibling->degree) cur = cur->sibling;
-        else if (cur->degree != next_of_cur->degree) break;
-        else cur = link_binomial_trees(cur, next_of_cur, heap->head);
-    }
-    heap->prior_queue[cand->node_id] = new_node;
-    return;
-}
-
-#define NO_NODEID -1
-#define WRONG_DIST -2
-#define DECR_SUCCESS 0
-static int decrease_binomial_key(struct binomial_heap *heap, int id, int64_t new_dist)
-{
-    struct tree_node *decr_node = heap->prior_queue[id]->node;
-    if (decr_node == NULL)
-    {
-        fprintf(stderr, "No decreased_id %d in binomial_heap.\n", id);
-        return NO_NODEID;
-    }
-    if (decr_node->dist <= new_dist)
-    {
-        fprintf(stderr, "decreased_dist %" PRId64" <=  new_dist %" PRId64".\n", decr_node->dist, new_dist);
-        return WRONG_DIST;
-    }
-    decr_node->dist = new_dist;
-    for (struct binomial_node *cur = heap->prior_queue[id];
-    cur->parent != NULL && cur->node->dist < cur->parent->node->dist;
-    cur = cur->parent)
-    {
-        int64_t tmp_dist = cur->node->dist;
-        cur->node->dist = cur->parent->node->dist;
-        cur->parent->node->dist = tmp_dist;
-        int tmp_id = cur->node->node_id;
-        cur->node->node_id = cur->parent->node->node_id;
-        cur->parent->node->node_id = tmp_id;
-        tmp_id = cur->node->parent_id;
-        cur->node->parent_id = cur->parent->node->parent_id;
-        cur->parent->node->parent_id = tmp_id;
-        heap->prior_queue[cur->node->node_id] = cur;
-        heap->prior_queue[cur->parent->node->node_id] = cur->parent;
-    }
-    return DECR_SUCCESS;
-}
-
-static void insert_adj_nodes_in_binomial_heap(const struct tree_node *node, const struct UDGraph_info *UDGraph, struct binomial_heap *heap, _Bool flag)
-{
-    /* next adjacent node */
-    struct adj_line *adj_line = UDGraph->adj[node->node_id];
-    while (adj_line != NULL)
-    {
-        /* candidate inserted into unvisited set */
-        struct tree_node *cand;
-        *cand = (struct tree_node){-1,
-        adj_line->weight + node->dist * flag
-        , 0, node->node_id, 0, 0};
-        cand->node_id = (adj_line->i_node != node->node_id) ? adj_line->i_node : adj_line->j_node;
-        if (decrease_binomial_key(heap, cand->node_id, cand->dist) == NO_NODEID)
-            insert_a_node_in_binomial_heap(heap, cand);
-        else free(cand);
-        adj_line = (adj_line->i_node == node->node_id) ? adj_line->i_next : adj_line->j_next;
+        else if (decrease_a_key_in_dist_heap(heap, v, dist) == 0)
+            candidate[v]->dist = dist, candidate[v]->parent_id = node->node_id;
     }
     return;
 }
 
-static void delete_all_nodes_in_binomial_heap(struct binomial_node *node)
+/* grow a tree from src, taking the unvisited node of the least dist out of
+the heap each time, until dest is taken or, if dest is -1, every node that
+src reaches is. Return the root and the last node taken in *last. */
+static struct tree_node *grow_a_tree_by_dist_heap_in_UDGraph(const struct UDGraph_info *UDGraph, int src, int dest,
+_Bool flag, struct tree_node **last)
 {
-    if (node == NULL) return;
-    delete_all_nodes_in_binomial_heap(node->left_child);
-    delete_all_nodes_in_binomial_heap(node->sibling);
-    free(node);
-    return;
+    struct tree_node **candidate = (struct tree_node **)calloc(NODE_NUM, sizeof(struct tree_node *));
+    _Bool *visited = (_Bool *)calloc(NODE_NUM, sizeof(_Bool));
+    if (candidate == NULL || visited == NULL)
+        perror("fail to allocate the search arrays"), exit(EXIT_FAILURE);
+    struct dist_heap *unvisited = init_dist_heap(NODE_NUM);
+    struct tree_node *root = candidate[src] = alloc_a_tree_node(src, 0, -1), *cur = root;
+    push_a_key_in_dist_heap(unvisited, src, 0);
+    int32_t id;
+    while (pop_the_min_key_in_dist_heap(unvisited, &id, NULL) == 0)
+    {
+        cur = candidate[id];
+        visited[id] = 1;
+        if (cur->parent_id != -1)
+            insert_leaf_in_tree_node(candidate[cur->parent_id], cur);
+        if (id == dest) break;
+        relax_adj_nodes_in_dist_heap(cur, UDGraph, unvisited, candidate, visited, flag);
+    }
+    /* the candidates left in the heap never joined the tree */
+    while (pop_the_min_key_in_dist_heap(unvisited, &id, NULL) == 0)
+        free(candidate[id]);
+    destroy_dist_heap(unvisited);
+    free(candidate); free(visited);
+    *last = cur;
+    return root;
 }
 
 #define DIJKSTRA 1
 struct tree_node *Dijkstra_algorithm_in_UDGraph(const struct UDGraph_info *UDGraph, int src, int dest)
 {
     /* the root of shortest path tree */
-    struct tree_node *SPT_root;
-    /* put src node into SPT as root */
-    *SPT_root = (struct tree_node){src, 0, 0, -1, 0};
-    /* loop current node id */
-    struct tree_node *cur = SPT_root;
-    /* find the minimum-dist node from binomial heap */
-    struct binomial_heap unvisited = (struct binomial_heap){0};
-    unvisited.head->node = cur;
-    struct tree_node *visited[NODE_NUM];
-    memset(visited, 0, NODE_NUM * sizeof(struct tree_node *));
-    while (cur->node_id != dest || unvisited.head != NULL)
-    {
-        /* find the minimum-dist node from binomial heap */
-        cur = extract_min_binomial_node(&unvisited);
-        insert_adj_nodes_in_binomial_heap(cur, UDGraph, &unvisited, DIJKSTRA);
-        visited[cur->node_id] = cur;
-        if (cur->parent_id != -1)
-            insert_leaf_in_tree_node(visited[cur->parent_id], cur);
-    }
-    delete_all_nodes_in_binomial_heap(unvisited.head);
-    memset(unvisited.prior_queue, 0, NODE_NUM * sizeof(struct tree_node *));
-    free(&unvisited); free(visited);
+    struct tree_node *cur;
+    struct tree_node *SPT_root = grow_a_tree_by_dist_heap_in_UDGraph(UDGraph, src, dest, DIJKSTRA, &cur);
     if (cur->node_id != dest)
     {
         delete_all_nodes_in_undirc_tree(SPT_root);
-        return SPT_root = NULL;
+        return NULL;
     }
-    /* copy tree_node to shortest_path */
-    struct tree_node *path_node, *last;
+    /* copy tree_node to shortest_path, linked from src through next[0] */
+    struct tree_node *path_node = NULL, *last = NULL;
     for (struct tree_node *i = cur; i != NULL; i = i->parent)
     {
-        *path_node = (struct tree_node){i->node_id, i->dist, 0, i->parent_id, i->parent, 0};
+        path_node = alloc_a_tree_node(i->node_id, i->dist, i->parent_id);
         if (last != NULL)
         {
             path_node->child_num = 1;
-            path_node->next = (struct tree_node **)malloc(8UL);
+            path_node->next = (struct tree_node **)malloc(sizeof(struct tree_node *));
+            if (path_node->next == NULL)
+                perror("fail to allocate array"), exit(EXIT_FAILURE);
             path_node->next[0] = last;
+            last->parent = path_node;
         }
         last = path_node;
     }
@@ -240,27 +106,8 @@ struct tree_node *Dijkstra_algorithm_in_UDGraph(const struct UDGraph_info *UDGra
 struct tree_node *Prim_algorithm_in_UDGraph(const struct UDGraph_info *UDGraph, int src)
 {
     /* the root of minimum spanning tree */
-    struct tree_node *MST_root;
-    /* put src node into MST as root */
-    *MST_root = (struct tree_node){src, 0, 0, -1, 0};
-    /* loop current node id */
-    struct tree_node *cur = MST_root;
-    /* find the minimum-dist node from binomial heap */
-    struct binomial_heap unvisited = (struct binomial_heap){0};
-    unvisited.head->node = cur;
-    struct tree_node *visited[NODE_NUM];
-    memset(visited, 0, NODE_NUM * sizeof(struct tree_node *));
-    while (unvisited.head != NULL)
-    {
-        /* find the minimum-dist node from binomial heap */
-        cur = extract_min_binomial_node(&unvisited);
-        insert_adj_nodes_in_binomial_heap(cur, UDGraph, &unvisited, PRIM);
-        visited[cur->node_id] = cur;
-        if (cur->parent_id != -1)
-            insert_leaf_in_tree_node(visited[cur->parent_id], cur);
-    }
-    free(&unvisited); free(visited);
-    return MST_root;
+    struct tree_node *cur;
+    return grow_a_tree_by_dist_heap_in_UDGraph(UDGraph, src, -1, PRIM, &cur);
 }
 
 static void merge_sort_undirc_line(struct adj_line **restrict arr, size_t len)
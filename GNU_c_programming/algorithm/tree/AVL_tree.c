@@ -6,13 +6,18 @@
 #include <time.h>
 #include <string.h>
 #include <stddef.h>
+#include "node_pool.c"
 
 static _Atomic(enum {left, right}) side;
 struct AVL_node {
     int32_t node_id;
+    /* the number of nodes in the subtree rooted here, for rank and select */
+    int32_t size;
     struct AVL_node *next[2];
     /*balance factor */
-    int_fast8_t bf;};
+    int_fast8_t bf;
+    /* whether the node came from a struct node_pool rather than the C heap */
+    _Bool pooled;};
 static _Atomic(ptrdiff_t) top = -1;
 static struct AVL_node* volatile stack[INT16_MAX];
 
@@ -32,54 +37,124 @@ static void push(struct AVL_node *node)
     return;
 }
 
+/* a node comes from pool, or from the C heap if pool is NULL */
+static struct AVL_node *alloc_a_new_AVL_node(struct node_pool *pool)
+{
+    struct AVL_node *node = pool ? (struct AVL_node *)alloc_a_node_from_pool(pool)
+    : (struct AVL_node *)malloc(sizeof(struct AVL_node));
+    if (node == NULL)
+        perror("fail to allocate an AVL node"), exit(EXIT_FAILURE);
+    memset(node, 0, sizeof(struct AVL_node));
+    node->pooled = (pool != NULL);
+    return node;
+}
+
+static void free_an_AVL_node(struct AVL_node *node)
+{
+    if (node->pooled) free_a_node_to_pool(node);
+    else free(node);
+    return;
+}
+
+/* start a tree whose nodes come from pool, made by init_node_pool(sizeof(struct
+AVL_node), ...), or from the C heap if pool is NULL. destroy_node_pool() then
+frees the whole tree at once. */
+struct AVL_node *init_an_AVL_root(int32_t root_key, struct node_pool *pool)
+{
+    struct AVL_node *root = alloc_a_new_AVL_node(pool);
+    root->node_id = root_key, root->bf = 0, root->size = 1;
+    root->next[left] = root->next[right] = NULL;
+    return root;
+}
+
 struct AVL_node* look_up_a_key_in_AVL(struct AVL_node **const AVL_tree, int32_t key)
 {
     struct AVL_node *cur = *AVL_tree;
-    while (cur->node_id != key && cur)
+    while (cur && cur->node_id != key)
     {
-        side = (cur->node_id < key) ? left : right;
+        side = (cur->node_id < key) ? right : left;
         cur = cur->next[side];
     }
     if (!cur) fprintf(stderr, "no key value in binary search tree!\n");
     return cur;
 }
 
+static int32_t size_of_an_AVL_subtree(struct AVL_node *node)
+{
+    return node ? node->size : 0;
+}
+
+/* the child of node on the side of rotating_side takes the place of node,
+and node becomes its child on the other side. */
+static struct AVL_node* rotate_an_AVL_node(struct AVL_node *node, _Bool rotating_side)
+{
+    struct AVL_node *child_node = node->next[rotating_side];
+    node->next[rotating_side] = child_node->next[!rotating_side];
+    child_node->next[!rotating_side] = node;
+    child_node->size = node->size;
+    node->size = size_of_an_AVL_subtree(node->next[left]) + size_of_an_AVL_subtree(node->next[right]) + 1;
+    return child_node;
+}
+
+/* bf is the height of the left subtree minus that of the right subtree.
+node->bf is 2 or -2; return the new root of the rebalanced subtree. */
 struct AVL_node* balance_a_node_in_AVL(struct AVL_node *node)
 {
-    side = (node->bf > 0) ? right : left;
-    struct AVL_node *longer_child_node = node->next[side];
-    if (node->bf * longer_child_node->bf < 0)
+    _Bool longer_side = (node->bf > 0) ? left : right;
+    int_fast8_t sign = (node->bf > 0) ? 1 : -1;
+    struct AVL_node *longer_child_node = node->next[longer_side];
+    if (longer_child_node->bf == -sign)
     {
-        /* rotation for the longer child node of the current node,
-        i.e, the first rotation for RL and LR. */
-        node->next[side] = longer_child_node->next[!side];
-        longer_child_node->next[!side] = node->next[side]->next[side];
-        node->next[side]->next[side] = longer_child_node;
-        longer_child_node->bf += ((node->bf > 0) ? 1 : -1) << ((node->bf * node->next[side]->bf < 0) ? 1 : 0);
-        node->next[side]->bf = ((node->bf > 0) ? 1 : -1) << ((node->bf * node->next[side]->bf > 0) ? 1 : 0);
-        longer_child_node = node->next[side];
+        /* the double rotation for RL and LR */
+        struct AVL_node *grandchild_node = longer_child_node->next[!longer_side];
+        node->next[longer_side] = rotate_an_AVL_node(longer_child_node, !longer_side);
+        rotate_an_AVL_node(node, longer_side);
+        node->bf = (grandchild_node->bf == sign) ? -sign : 0;
+        longer_child_node->bf = (grandchild_node->bf == -sign) ? sign : 0;
+        grandchild_node->bf = 0;
+        return grandchild_node;
     }
-    /* rotation for the current node,
-    i.e, the second rotation for RL and LR, or the rotation for LL and RR. */
-    node->next[side] = longer_child_node->next[!side];
-    longer_child_node->next[!side] = node;
-    node->bf += ((node->bf > 0) ? -2 : 2) >> ((longer_child_node->bf & 1) ? 0 : 1);
-    longer_child_node->bf = 0;
-    node = longer_child_node;
-    return node;
+    /* the rotation for LL and RR. The longer child is balanced
+    only after a deletion, and then the subtree keeps its height. */
+    rotate_an_AVL_node(node, longer_side);
+    if (longer_child_node->bf == 0)
+        node->bf = sign, longer_child_node->bf = -sign;
+    else node->bf = longer_child_node->bf = 0;
+    return longer_child_node;
 }
 
-int insert_a_key_in_AVL(struct AVL_node **AVL_tree, int32_t new_key)
+/* hang a rebalanced subtree back on the parent on top of the stack, or make it the root */
+static void relink_an_AVL_subtree(struct AVL_node **AVL_tree, struct AVL_node *old_root,
+struct AVL_node *new_root)
+{
+    if (top == -1) *AVL_tree = new_root;
+    else stack[top]->next[stack[top]->next[right] == old_root] = new_root;
+    return;
+}
+
+/* an AVL tree of n nodes is lower than 1.45 * log2(n + 2) */
+#define AVL_MAX_HEIGHT 96
+
+/* the path from the root down to the node of the last key inserted through
+it, so that a nearby key needs not start from the root again. A deletion, or
+an insertion without it, leaves it stale: start it over with
+init_an_AVL_finger() then. */
+struct AVL_finger {
+    struct AVL_node *root;
+    struct AVL_node *path[AVL_MAX_HEIGHT];
+    int32_t depth;};
+
+void init_an_AVL_finger(struct AVL_finger *finger)
+{
+    finger->root = NULL, finger->depth = 0;
+    return;
+}
+
+/* insert new_key under cur, whose ancestors are on the stack already, in a
+node from pool. If finger is not NULL, leave in it the path to the new node. */
+static int insert_a_key_below_an_AVL_node(struct AVL_node **AVL_tree, struct AVL_node *cur, int32_t new_key,
+struct AVL_finger *finger, struct node_pool *pool)
 {
-    if (*AVL_tree == NULL)
-    {
-        struct AVL_node *root = (struct AVL_node *)calloc(1, sizeof(struct AVL_node));
-        root->node_id = new_key, root->bf = 0, *AVL_tree = root;
-        root->next[left] = root->next[right] = NULL;
-        printf("insert key value %" PRId32" successfully.\n", new_key);
-        return 0;
-    }
-    struct AVL_node *cur = *AVL_tree;
     while (cur)
     {
         if (cur->node_id == new_key)
@@ -88,99 +163,126 @@ int insert_a_key_in_AVL(struct AVL_node **AVL_tree, int32_t new_key)
             top = -1; return -1;
         }
         push(cur);
-        side = (cur->node_id<new_key) ? left : right;
+        side = (cur->node_id < new_key) ? right : left;
         cur = cur->next[side];
     }
-    struct AVL_node *new_node = (struct AVL_node *)calloc(1, sizeof(struct AVL_node));
+    struct AVL_node *new_node = alloc_a_new_AVL_node(pool);
     new_node->node_id = new_key;
     new_node->next[left] = new_node->next[right] = NULL;
-    new_node->bf = 0, cur = new_node;
+    new_node->bf = 0, new_node->size = 1, cur = new_node;
+    stack[top]->next[side] = new_node;
+    for (ptrdiff_t i = 0; i <= top; i++) stack[i]->size++;
+    if (finger)
+    {
+        memcpy(finger->path, (const void *)stack, (top + 1) * sizeof(struct AVL_node *));
+        finger->path[top + 1] = new_node, finger->depth = top + 2;
+    }
+    /* retrace until a subtree keeps its height */
     while (top != -1)
     {
-        stack[top]->bf += (cur == stack[top]->next[left]) ? 1:-1;
-        cur = popup();
-        if (cur->bf == 0)
-            break;
-        if (cur->bf < -1 || cur->bf > 1)
+        struct AVL_node *parent = popup();
+        parent->bf += (cur == parent->next[left]) ? 1 : -1;
+        if (parent->bf == 0) break;
+        if (parent->bf < -1 || parent->bf > 1)
         {
-            _Bool is_right_node = (cur == stack[top]->next[right]);
-            cur = balance_a_node_in_AVL(cur);
-            stack[top]->next[is_right_node] = cur;
+            relink_an_AVL_subtree(AVL_tree, parent, balance_a_node_in_AVL(parent));
+            if (finger)
+            {
+                /* the path is kept down to the parent of the rotated subtree,
+                and the new node is at most two levels below its new root */
+                finger->depth = top + 1;
+                cur = (top == -1) ? *AVL_tree : stack[top]->next[stack[top]->node_id < new_key];
+                for (; cur; cur = cur->next[cur->node_id < new_key])
+                {
+                    finger->path[finger->depth++] = cur;
+                    if (cur->node_id == new_key) break;
+                }
+            }
             break;
         }
+        cur = parent;
     }
-    printf("insert key value %" PRId32" successfully.\n", new_key);
+    if (finger) finger->root = *AVL_tree;
     top = -1; return 0;
 }
 
-int delete_a_key_and_fill_from_left_subtree_in_AVL(struct AVL_node **AVL_tree, int32_t key)
+/* the new node comes from pool, which has to be the same for every insert in
+a tree, or from the C heap if pool is NULL. */
+int insert_a_key_in_AVL(struct AVL_node **AVL_tree, int32_t new_key, struct node_pool *pool)
 {
-    struct AVL_node *cur = *AVL_tree;
-    while (cur->node_id != key && cur)
-    {
-        push(cur);
-        side = (cur->node_id < key) ? left:right;
-        cur = cur->next[side];
-    }
-    if (!cur)
-    {
-        fprintf(stderr, "no key value in binary search tree!\n");
-        top = -1; return -1;
-    }
-    /* delete a leaf node */
-    if (cur->next[left] == NULL && cur->next[right] == NULL)
+    if (*AVL_tree == NULL)
     {
-        struct AVL_node *tmp = cur; 
-        cur = NULL, free(tmp);
+        *AVL_tree = init_an_AVL_root(new_key, pool);
+        printf("insert key value %" PRId32" successfully.\n", new_key);
+        return 0;
     }
-    /* use the maximal node in left subtree of the current node to replace the current node */
-    else if (cur->next[left] != NULL && cur->next[right] != NULL)
+    if (insert_a_key_below_an_AVL_node(AVL_tree, *AVL_tree, new_key, NULL, pool) < 0) return -1;
+    printf("insert key value %" PRId32" successfully.\n", new_key);
+    return 0;
+}
+
+/* insert new_key starting from the last key inserted through finger. The
+subtree of a node on the path holds new_key unless some ancestor of the node
+has its key between the last key and new_key, so the descent starts from the
+first such node on the path, or from the last node if there is none. The
+path is known, so the ancestors are loaded without chasing pointers. Unlike
+insert_a_key_in_AVL(), it reports nothing on stdout. */
+int insert_a_key_in_AVL_with_finger(struct AVL_node **AVL_tree, int32_t new_key, struct AVL_finger *finger,
+struct node_pool *pool)
+{
+    if (*AVL_tree == NULL || finger->root != *AVL_tree || finger->depth == 0)
     {
-        push(cur);
-        struct AVL_node *max_in_left_subtree = cur->next[left];
-        while (max_in_left_subtree->next[right])
+        if (*AVL_tree == NULL)
         {
-            push(max_in_left_subtree);
-            max_in_left_subtree = max_in_left_subtree->next[right];
+            int state = insert_a_key_in_AVL(AVL_tree, new_key, pool);
+            finger->root = *AVL_tree, finger->path[0] = *AVL_tree, finger->depth = 1;
+            return state;
         }
-        cur->node_id = max_in_left_subtree->node_id;
-        stack[top]->next[right] = max_in_left_subtree->next[left];
-        free(max_in_left_subtree);
-        while (stack[top] != cur)
-            stack[top]->bf++, popup();
-        cur = cur->next[left];
+        finger->depth = 1, finger->path[0] = *AVL_tree;
     }
-    /* delete a node who has one subtree */
-    else
+    int32_t last_key = finger->path[finger->depth - 1]->node_id, depth = 1;
+    int32_t lower = (last_key < new_key) ? last_key : new_key, upper = (last_key < new_key) ? new_key : last_key;
+    while (depth < finger->depth)
     {
-        struct AVL_node *tmp = cur;
-        stack[top]->next[side] = (cur->next[left]) ? cur->next[left] : cur->next[right];
-        cur = stack[top]->next[side], free(tmp), cur->bf = 0;
+        int32_t key = finger->path[depth - 1]->node_id;
+        if ((key > lower && key < upper) || key == new_key) break;
+        depth++;
     }
+    for (int32_t i = 0; i < depth - 1; i++) push(finger->path[i]);
+    return insert_a_key_below_an_AVL_node(AVL_tree, finger->path[depth - 1], new_key, finger, pool);
+}
+
+/* the subtree on deleted_side of the node on top of the stack got shorter;
+retrace until a subtree keeps its height. */
+static void retrace_an_AVL_tree_after_deleting(struct AVL_node **AVL_tree, _Bool deleted_side)
+{
     while (top != -1)
     {
-        stack[top]->bf += (cur == stack[top]->next[left]) ? -1 : 1;
-        cur = popup();
-        if (cur->bf & 1)
-            break;
-        if (cur->bf < -1 || cur->bf > 1)
+        struct AVL_node *parent = popup();
+        parent->bf += (deleted_side == left) ? -1 : 1;
+        if (parent->bf == 1 || parent->bf == -1) break;
+        if (parent->bf != 0)
         {
-            _Bool is_right_node = (cur == stack[top]->next[right]);
-            cur = balance_a_node_in_AVL(cur);
-            stack[top]->next[is_right_node] = cur;
+            struct AVL_node *new_root = balance_a_node_in_AVL(parent);
+            relink_an_AVL_subtree(AVL_tree, parent, new_root);
+            /* a balanced new root means the subtree got shorter */
+            if (new_root->bf != 0) break;
+            parent = new_root;
         }
+        if (top != -1) deleted_side = (stack[top]->next[right] == parent);
     }
-    printf("delete key value %" PRId32" successfully.\n", key);
-    top = -1; return 0;
+    top = -1;
+    return;
 }
 
-int delete_a_key_and_fill_from_right_subtree_in_AVL(struct AVL_node **AVL_tree, int32_t key)
+static int delete_a_key_and_fill_from_one_subtree_in_AVL(struct AVL_node **AVL_tree, int32_t key,
+_Bool filling_side)
 {
     struct AVL_node *cur = *AVL_tree;
-    while (cur->node_id != key && cur)
+    while (cur && cur->node_id != key)
     {
         push(cur);
-        side = (cur->node_id < key) ? left : right;
+        side = (cur->node_id < key) ? right : left;
         cur = cur->next[side];
     }
     if (!cur)
@@ -188,51 +290,125 @@ int delete_a_key_and_fill_from_right_subtree_in_AVL(struct AVL_node **AVL_tree,
         fprintf(stderr, "no key value in binary search tree!\n");
         top = -1; return -1;
     }
-    /* delete a leave node */
-    if (cur->next[left] == NULL && cur->next[right] == NULL)
+    /* use the closest node in the filling subtree of the current node to replace the current node */
+    if (cur->next[left] != NULL && cur->next[right] != NULL)
+    {
+        push(cur);
+        side = filling_side;
+        struct AVL_node *closest_node = cur->next[filling_side];
+        while (closest_node->next[!filling_side])
+        {
+            push(closest_node);
+            side = !filling_side;
+            closest_node = closest_node->next[!filling_side];
+        }
+        cur->node_id = closest_node->node_id;
+        cur = closest_node;
+    }
+    /* now cur has one subtree at most */
+    struct AVL_node *child_node = (cur->next[left]) ? cur->next[left] : cur->next[right];
+    if (top == -1) *AVL_tree = child_node;
+    else stack[top]->next[side] = child_node;
+    for (ptrdiff_t i = 0; i <= top; i++) stack[i]->size--;
+    free_an_AVL_node(cur);
+    retrace_an_AVL_tree_after_deleting(AVL_tree, side);
+    printf("delete key value %" PRId32" successfully.\n", key);
+    return 0;
+}
+
+int delete_a_key_and_fill_from_left_subtree_in_AVL(struct AVL_node **AVL_tree, int32_t key)
+{
+    return delete_a_key_and_fill_from_one_subtree_in_AVL(AVL_tree, key, left);
+}
+
+int delete_a_key_and_fill_from_right_subtree_in_AVL(struct AVL_node **AVL_tree, int32_t key)
+{
+    return delete_a_key_and_fill_from_one_subtree_in_AVL(AVL_tree, key, right);
+}
+
+/* return the node with rank keys less than its own, counting from 0, or
+NULL if the tree has no more than rank keys */
+struct AVL_node* select_a_key_in_AVL(struct AVL_node **const AVL_tree, int32_t rank)
+{
+    struct AVL_node *cur = *AVL_tree;
+    if (rank < 0 || rank >= size_of_an_AVL_subtree(cur))
     {
-        struct AVL_node *tmp = cur;
-        cur = NULL, free(tmp);
+        fprintf(stderr, "no key of rank %" PRId32" in AVL tree!\n", rank);
+        return NULL;
     }
-    /* use the minimal node in rigth subtree of the current node to replace the current node */
-    else if (cur->next[left] != NULL && cur->next[right] != NULL)
+    while (rank != size_of_an_AVL_subtree(cur->next[left]))
     {
-        push(cur);
-        struct AVL_node *min_in_right_subtree = cur->next[right];
-        while (min_in_right_subtree->next[left])
+        if (rank < size_of_an_AVL_subtree(cur->next[left]))
+            cur = cur->next[left];
+        else
         {
-            push(min_in_right_subtree);
-            min_in_right_subtree = min_in_right_subtree->next[left];
+            rank -= size_of_an_AVL_subtree(cur->next[left]) + 1;
+            cur = cur->next[right];
         }
-        cur->node_id = min_in_right_subtree->node_id;
-        stack[top]->next[left] = min_in_right_subtree->next[right];
-        free(min_in_right_subtree);
-        while (stack[top] != cur)
-            stack[top]->bf--, popup();
-        cur = cur->next[right];
     }
-    /* delete a node who has one subtree */
-    else
+    return cur;
+}
+
+/* the number of keys less than key, or not greater than key if
+including_key is set. key itself need not be in the tree. */
+static int32_t count_keys_below_in_AVL(struct AVL_node *cur, int32_t key, _Bool including_key)
+{
+    int32_t count = 0;
+    while (cur)
     {
-        struct AVL_node *tmp = cur;
-        stack[top]->next[side] = (cur->next[left]) ? cur->next[left] : cur->next[right];
-        cur = stack[top]->next[side], free(tmp), cur->bf = 0;
+        if (cur->node_id < key || (including_key && cur->node_id == key))
+        {
+            count += size_of_an_AVL_subtree(cur->next[left]) + 1;
+            cur = cur->next[right];
+        }
+        else cur = cur->next[left];
     }
-    while (top != -1)
+    return count;
+}
+
+/* the number of keys less than key, which is the rank of key if it is in
+the tree */
+int32_t rank_of_a_key_in_AVL(struct AVL_node **const AVL_tree, int32_t key)
+{
+    return count_keys_below_in_AVL(*AVL_tree, key, 0);
+}
+
+/* the number of keys in [lower, upper] */
+int32_t count_keys_in_a_range_in_AVL(struct AVL_node **const AVL_tree, int32_t lower, int32_t upper)
+{
+    if (lower > upper) return 0;
+    return count_keys_below_in_AVL(*AVL_tree, upper, 1) - count_keys_below_in_AVL(*AVL_tree, lower, 0);
+}
+
+/* the keys one inorder_trav_to_AVL() call hands to its visitor at a time */
+#define AVL_TRAV_BATCH 256
+
+/* hand every key of the AVL tree in increasing order to visitor,
+AVL_TRAV_BATCH keys at a time. The walk keeps its own stack instead of the
+shared one. A visitor which returns non-zero stops the traversal, and that
+value is returned; otherwise return 0. */
+int inorder_trav_to_AVL(struct AVL_node **const AVL_tree,
+int (*visitor)(const int32_t *key, int32_t key_number, void *arg), void *arg)
+{
+    struct AVL_node *path[AVL_MAX_HEIGHT], *cur = *AVL_tree;
+    int32_t key_buf[AVL_TRAV_BATCH], copied = 0, depth = 0;
+    int state = 0;
+    while (state == 0 && (depth || cur))
     {
-        stack[top]->bf += (cur == stack[top]->next[left]) ? -1 : 1;
-        cur = popup();
-        if (cur->bf & 1)
-            break;
-        if (cur->bf < -1 || cur->bf > 1)
+        if (cur)
         {
-            _Bool is_right_node = (cur == stack[top]->next[right]);
-            cur = balance_a_node_in_AVL(cur);
-            stack[top]->next[is_right_node] = cur;
+            path[depth++] = cur;
+            cur = cur->next[left];
+            continue;
         }
+        cur = path[--depth];
+        key_buf[copied++] = cur->node_id;
+        cur = cur->next[right];
+        if (copied == AVL_TRAV_BATCH)
+            state = visitor(key_buf, copied, arg), copied = 0;
     }
-    printf("delete key value %" PRId32" successfully.\n", key);
-    top = -1; return 0;
+    if (state == 0 && copied) state = visitor(key_buf, copied, arg);
+    return state;
 }
 
 int32_t* Fisher_Yates_shuffle(int32_t *restrict array, size_t len, size_t shuffle_len)
@@ -262,7 +438,7 @@ int main(void)
     struct AVL_node **AVL_tree;
     *AVL_tree = NULL;
     for (size_t i = 0; i < UINT16_MAX; i++)
-        insert_a_key_in_AVL(AVL_tree, key_arr[i]);
+        insert_a_key_in_AVL(AVL_tree, key_arr[i], NULL);
     key_arr = Fisher_Yates_shuffle(key_arr, UINT16_MAX, UINT16_MAX);
     for (size_t i = 0; i < UINT16_MAX; i++)
     {
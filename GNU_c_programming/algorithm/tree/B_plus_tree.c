@@ -4,6 +4,7 @@
 #include <inttypes.h>
 #include <fcntl.h>
 #include <string.h>
+#include "node_pool.c"
 #define MAX_KEY_NUMBER 255
 struct B_plus_node {
     int16_t *key;
@@ -11,6 +12,7 @@ struct B_plus_node {
     int16_t last_index;
     int16_t pos_in_parent_node;
     _Bool isleaf;
+    _Bool pooled;
     int *fd;
     struct B_plus_node *parent;
     struct B_plus_node *sibling;};
@@ -39,29 +41,89 @@ static int get_string(char **ptr_to_ptr)
     else return -1;
 }
 
-void inorder_trav_to_B_plus_tree(struct B_plus_node *node)
+/* the order in which a traversal hands out keys: inorder gives the leaf
+keys only, which are every key of the tree in increasing order; preorder
+and postorder give the keys of every node, before or after its subtrees. */
+enum B_plus_trav_order {B_plus_preorder, B_plus_inorder, B_plus_postorder};
+/* the keys one trav_to_B_plus_tree() call hands to its visitor at a time */
+#define B_PLUS_TRAV_BATCH 256
+
+/* a traversal which can stop after any key and go on later. Every node on
+the path keeps a step counter over its keys and children. It follows child
+pointers only, so it also walks trees whose sibling links are not kept. */
+struct B_plus_trav_iterator {
+    enum B_plus_trav_order order;
+    int8_t top;
+    struct B_plus_node *node_stack[INT8_MAX];
+    int16_t step_stack[INT8_MAX];};
+
+void start_a_trav_to_B_plus_tree(struct B_plus_node **const B_plus_tree, enum B_plus_trav_order order,
+struct B_plus_trav_iterator *iter)
 {
-    if (node == NULL) return;
-    for (int16_t i = 0; i <= node->last_index; i++)
-    {
-        inorder_trav_to_B_plus_tree(node->child[i]);
-        printf("%" PRId16"\040", node->key[i]);
-    }
+    iter->order = order;
+    iter->top = -1;
+    if (*B_plus_tree)
+        iter->node_stack[++iter->top] = *B_plus_tree, iter->step_stack[iter->top] = 0;
     return;
 }
 
-void preorder_trav_to_B_plus_tree(struct B_plus_node *node)
+/* copy the next keys of the traversal, at most batch_size of them, into
+key_buf and their file descriptors into fd_buf if it is not NULL; the keys
+of internal nodes have -1 as their file descriptor.
+Return the number of copied keys, which is 0 at the end. */
+int32_t next_batch_in_trav_to_B_plus_tree(struct B_plus_trav_iterator *iter, int16_t *key_buf, int *fd_buf,
+int32_t batch_size)
 {
-    if (node == NULL) return;
-    for (int16_t i = 0; i <= node->last_index; i++)
+    int32_t copied = 0;
+    while (copied < batch_size && iter->top != -1)
     {
-        printf("%" PRId16"\040", node->key[i]);
-        preorder_trav_to_B_plus_tree(node->child[i]);
+        struct B_plus_node *node = iter->node_stack[iter->top];
+        int16_t step = iter->step_stack[iter->top]++, key_number = node->last_index + 1;
+        int16_t key_pos = -1, child_pos = -1;
+        if (node->isleaf) key_pos = step < key_number ? step : -1;
+        else if (iter->order == B_plus_inorder) child_pos = step < key_number ? step : -1;
+        else if (step < 2 * key_number)
+        {
+            _Bool keys_first = (iter->order == B_plus_preorder);
+            if ((step < key_number) == keys_first) key_pos = step % key_number;
+            else child_pos = step % key_number;
+        }
+        if (key_pos != -1)
+        {
+            key_buf[copied] = node->key[key_pos];
+            if (fd_buf) fd_buf[copied] = node->isleaf ? node->fd[key_pos] : -1;
+            copied++;
+        }
+        else if (child_pos != -1)
+        {
+            if (iter->top == INT8_MAX - 1)
+                perror("the traversal stack overflows"), exit(EXIT_FAILURE);
+            iter->node_stack[++iter->top] = node->child[child_pos];
+            iter->step_stack[iter->top] = 0;
+        }
+        else iter->top--;
     }
-    return;
+    return copied;
 }
 
-static int16_t look_up_a_key_pos_in_a_B_plus_node(struct B_plus_node *const node, int16_t unkown_key)
+/* hand every key of the B plus tree and its file descriptor in order to
+visitor, B_PLUS_TRAV_BATCH keys at a time. A visitor which returns non-zero
+stops the traversal, and that value is returned; otherwise return 0. */
+int trav_to_B_plus_tree(struct B_plus_node **const B_plus_tree, enum B_plus_trav_order order,
+int (*visitor)(const int16_t *key, const int *fd, int32_t key_number, void *arg), void *arg)
+{
+    struct B_plus_trav_iterator iter;
+    int16_t key_buf[B_PLUS_TRAV_BATCH];
+    int fd_buf[B_PLUS_TRAV_BATCH];
+    int32_t copied;
+    int state = 0;
+    start_a_trav_to_B_plus_tree(B_plus_tree, order, &iter);
+    while (state == 0 && (copied = next_batch_in_trav_to_B_plus_tree(&iter, key_buf, fd_buf, B_PLUS_TRAV_BATCH)) > 0)
+        state = visitor(key_buf, fd_buf, copied, arg);
+    return state;
+}
+
+static int16_t look_up_a_key_pos_in_a_B_plus_node_via_binary_search(struct B_plus_node *const node, int16_t unkown_key)
 /* use binary search method to position */
 {
     int16_t left = 0, right = node->last_index;
@@ -74,7 +136,78 @@ static int16_t look_up_a_key_pos_in_a_B_plus_node(struct B_plus_node *const node
             right = middle - 1;
         else left = middle + 1;
     }
-    return node->key[left - 1] < unkown_key ? left : left - 1;
+    /* all keys before left are smaller than unkown_key */
+    return left;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+/* count the keys smaller than unkown_key, 16 keys per compare and movemask.
+Keys are sorted, so the count is the position of unkown_key or of its insertion. */
+__attribute__((target("avx2")))
+static int16_t look_up_a_key_pos_in_a_B_plus_node_via_avx2(struct B_plus_node *const node, int16_t unkown_key)
+{
+    const __m256i broadcast_key = _mm256_set1_epi16(unkown_key);
+    int16_t key_number = node->last_index + 1, pos = 0;
+    for (int16_t i = 0; i < key_number; i += 16)
+    {
+        __m256i keys = _mm256_loadu_si256((const __m256i *)&node->key[i]);
+        /* movemask_epi8 yields two bits per 16-bit lane */
+        uint32_t mask = _mm256_movemask_epi8(_mm256_cmpgt_epi16(broadcast_key, keys));
+        if (key_number - i < 16)
+            mask &= (1u << ((key_number - i) << 1)) - 1;
+        pos += __builtin_popcount(mask) >> 1;
+        if (mask != 0xFFFFFFFF) break;
+    }
+    return pos;
+}
+
+/* the same count as the AVX2 path, 8 keys per compare and movemask. */
+__attribute__((target("sse4.2,popcnt")))
+static int16_t look_up_a_key_pos_in_a_B_plus_node_via_sse42(struct B_plus_node *const node, int16_t unkown_key)
+{
+    const __m128i broadcast_key = _mm_set1_epi16(unkown_key);
+    int16_t key_number = node->last_index + 1, pos = 0;
+    for (int16_t i = 0; i < key_number; i += 8)
+    {
+        __m128i keys = _mm_loadu_si128((const __m128i *)&node->key[i]);
+        uint32_t mask = _mm_movemask_epi8(_mm_cmpgt_epi16(broadcast_key, keys));
+        if (key_number - i < 8)
+            mask &= (1u << ((key_number - i) << 1)) - 1;
+        pos += __builtin_popcount(mask) >> 1;
+        if (mask != 0xFFFF) break;
+    }
+    return pos;
+}
+#endif
+
+/* every call goes through this pointer. It is bound to the best search path
+of the running CPU by a constructor, before main and any thread start, so
+it is only ever read afterwards. */
+static int16_t (*look_up_a_key_pos_in_a_B_plus_node)(struct B_plus_node *const node, int16_t unkown_key)
+= look_up_a_key_pos_in_a_B_plus_node_via_binary_search;
+
+__attribute__((constructor))
+static void resolve_look_up_a_key_pos_in_a_B_plus_node(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        look_up_a_key_pos_in_a_B_plus_node = look_up_a_key_pos_in_a_B_plus_node_via_avx2;
+    else if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt"))
+        look_up_a_key_pos_in_a_B_plus_node = look_up_a_key_pos_in_a_B_plus_node_via_sse42;
+#endif
+    return;
+}
+
+/* key[i] is the minimal key under child[i], so descend into the last child
+whose minimal key is not greater than unkown_key. */
+static int16_t look_up_a_child_pos_in_a_B_plus_node(struct B_plus_node *const node, int16_t unkown_key)
+{
+    int16_t pos = look_up_a_key_pos_in_a_B_plus_node(node, unkown_key);
+    if (pos <= node->last_index && node->key[pos] == unkown_key)
+        return pos;
+    return pos ? pos - 1 : 0;
 }
 
 int16_t look_up_a_leaf_key_in_B_plus_tree(struct B_plus_node **const B_plus_tree, int16_t leaf_key)
@@ -83,14 +216,14 @@ int16_t look_up_a_leaf_key_in_B_plus_tree(struct B_plus_node **const B_plus_tree
     int16_t pos = 0;
     while (cur)
     {
-        pos = look_up_a_key_pos_in_a_B_plus_node(cur, leaf_key);
-        if ((cur->key[pos] == leaf_key) & cur->isleaf)
-            break;
-        else
+        if (cur->isleaf)
         {
-            cur = cur->child[pos];
-            pos = 0;
+            pos = look_up_a_key_pos_in_a_B_plus_node(cur, leaf_key);
+            if (pos > cur->last_index || cur->key[pos] != leaf_key)
+                cur = NULL;
+            break;
         }
+        cur = cur->child[look_up_a_child_pos_in_a_B_plus_node(cur, leaf_key)];
     }
     if (!cur)
     {
@@ -101,23 +234,114 @@ int16_t look_up_a_leaf_key_in_B_plus_tree(struct B_plus_node **const B_plus_tree
     return pos;
 }
 
-struct B_plus_node *alloc_a_new_B_plus_node(_Bool neighbour_isleaf)
+/* a position in the leaf level, walked forward through sibling */
+struct B_plus_iterator {
+    struct B_plus_node *leaf;
+    int16_t pos;};
+
+/* position iter at the first key which is not less than lower_key.
+Return 0, or -1 if every key in the tree is less than lower_key. */
+int lower_bound_in_B_plus_tree(struct B_plus_node **const B_plus_tree, int16_t lower_key,
+struct B_plus_iterator *iter)
+{
+    struct B_plus_node *cur = *B_plus_tree;
+    iter->leaf = NULL, iter->pos = 0;
+    if (cur == NULL) return -1;
+    while (!cur->isleaf)
+        cur = cur->child[look_up_a_child_pos_in_a_B_plus_node(cur, lower_key)];
+    int16_t pos = look_up_a_key_pos_in_a_B_plus_node(cur, lower_key);
+    /* lower_key is greater than every key in this leaf */
+    if (pos > cur->last_index)
+        cur = cur->sibling, pos = 0;
+    if (cur == NULL) return -1;
+    iter->leaf = cur, iter->pos = pos;
+    return 0;
+}
+
+/* copy at most batch_size keys not greater than upper_key, and their file
+descriptors if fd_buf is not NULL, then advance iter past them.
+Return the number of copied keys, which is 0 at the end of the range. */
+int32_t next_batch_in_B_plus_tree(struct B_plus_iterator *iter, int16_t upper_key,
+int16_t *key_buf, int *fd_buf, int32_t batch_size)
+{
+    int32_t copied = 0;
+    while (iter->leaf && copied < batch_size)
+    {
+        struct B_plus_node *leaf = iter->leaf;
+        /* the next leaf is fetched from memory while this one is copied */
+        if (leaf->sibling)
+        {
+            __builtin_prefetch(leaf->sibling->key);
+            __builtin_prefetch(leaf->sibling->fd);
+        }
+        int16_t pos = iter->pos;
+        while (pos <= leaf->last_index && copied < batch_size)
+        {
+            if (leaf->key[pos] > upper_key)
+            {
+                iter->leaf = NULL;
+                return copied;
+            }
+            key_buf[copied] = leaf->key[pos];
+            if (fd_buf) fd_buf[copied] = leaf->fd[pos];
+            copied++, pos++;
+        }
+        if (pos > leaf->last_index)
+        {
+            iter->leaf = leaf->sibling, iter->pos = 0;
+            if (iter->leaf) __builtin_prefetch(iter->leaf->sibling);
+        }
+        else iter->pos = pos;
+    }
+    return copied;
+}
+
+/* the struct and its child, fd and key arrays are carved out of one block,
+so that a node is a single allocation and fits a struct node_pool. */
+#define B_PLUS_NODE_SIZE (sizeof(struct B_plus_node) \
++ (MAX_KEY_NUMBER + 1) * (sizeof(struct B_plus_node *) + sizeof(int) + sizeof(int16_t)))
+
+/* a node comes from pool, made by init_node_pool(B_PLUS_NODE_SIZE, ...),
+or from the C heap if pool is NULL. */
+struct B_plus_node *alloc_a_new_B_plus_node(struct node_pool *pool, _Bool neighbour_isleaf)
 {
-    struct B_plus_node *node = (struct B_plus_node *)malloc(sizeof(struct B_plus_node));
+    struct B_plus_node *node = pool ? (struct B_plus_node *)alloc_a_node_from_pool(pool)
+    : (struct B_plus_node *)malloc(B_PLUS_NODE_SIZE);
+    if (node == NULL)
+        perror("fail to allocate a B plus node"), exit(EXIT_FAILURE);
     *node = (struct B_plus_node){0};
-    node->key = (int16_t *)malloc((MAX_KEY_NUMBER + 1) * sizeof(int16_t));
-    memset(node->key, -1, MAX_KEY_NUMBER * sizeof(int16_t));
-    node->child = (struct B_plus_node **)malloc((MAX_KEY_NUMBER + 1) * sizeof(struct B_plus_node *));
+    node->pooled = (pool != NULL);
+    node->child = (struct B_plus_node **)(node + 1);
+    memset(node->child, 0, (MAX_KEY_NUMBER + 1) * sizeof(struct B_plus_node *));
+    node->fd = (int *)(node->child + MAX_KEY_NUMBER + 1);
+    node->key = (int16_t *)(node->fd + MAX_KEY_NUMBER + 1);
+    memset(node->key, -1, (MAX_KEY_NUMBER + 1) * sizeof(int16_t));
     if (neighbour_isleaf)
     {
         node->isleaf = 1;
-        node->fd = (int *)malloc(MAX_KEY_NUMBER * sizeof(int));
-        memset(node->fd, -1, MAX_KEY_NUMBER * sizeof(int));
+        /* a full leaf holds MAX_KEY_NUMBER + 1 keys until it is split */
+        memset(node->fd, -1, (MAX_KEY_NUMBER + 1) * sizeof(int));
     }
+    else node->fd = NULL;
     node->pos_in_parent_node = -1;
     return node;
 }
 
+/* the pool which node came from, or NULL for the C heap */
+static struct node_pool *node_pool_of_a_B_plus_node(const struct B_plus_node *node)
+{
+    return node->pooled ? node_pool_of_a_node(node) : NULL;
+}
+
+/* start a tree whose nodes come from pool, or from the C heap if pool is NULL.
+destroy_node_pool() then frees the whole tree without delete_all_nodes_in_B_plus_tree(). */
+struct B_plus_node *init_a_B_plus_root(int16_t root_key, struct node_pool *pool)
+{
+    struct B_plus_node *root = alloc_a_new_B_plus_node(pool, 1);
+    root->key[0] = root_key;
+    return root;
+}
+
 int write_a_file_in_a_B_plus_node(struct B_plus_node *node, int16_t pos)
 {
     char *file_path;
@@ -142,21 +366,24 @@ int write_a_file_in_a_B_plus_node(struct B_plus_node *node, int16_t pos)
 
 int16_t insert_a_key_in_a_B_plus_node(struct B_plus_node *node, int16_t new_key)
 {
-    int16_t insert_pos = look_up_a_key_pos_in_a_B_plus_node(node, new_key);
-    if (node->key[insert_pos] == new_key)
+    /* an increasing key goes behind the last one without a search */
+    int16_t insert_pos = (node->last_index >= 0 && node->key[node->last_index] < new_key)
+    ? node->last_index + 1 : look_up_a_key_pos_in_a_B_plus_node(node, new_key);
+    if (insert_pos <= node->last_index && node->key[insert_pos] == new_key)
         return -1;
     for (int16_t i = node->last_index + 1; i > insert_pos; i--)
         node->key[i] = node->key[i - 1], node->child[i] = node->child[i - 1];
     if (node->isleaf)
         for (int16_t i = node->last_index + 1; i > insert_pos; i--)
             node->fd[i] = node->fd[i - 1];
-    node->last_index++, node->key[insert_pos] = new_key, node->fd[insert_pos] = -1;
+    node->last_index++, node->key[insert_pos] = new_key;
+    if (node->isleaf) node->fd[insert_pos] = -1;
     if (insert_pos == 0)
     {
         /* if new_key is the minimum, ascend to change the ancestors until root. */
         struct B_plus_node *ancestor = node;
         int16_t ascend_pos = insert_pos;
-        while (ancestor && !ascend_pos)
+        while (ancestor->parent && !ascend_pos)
         {
             if (ascend_pos == 0)
                 ancestor->parent->key[ancestor->pos_in_parent_node] = new_key;
@@ -167,63 +394,38 @@ int16_t insert_a_key_in_a_B_plus_node(struct B_plus_node *node, int16_t new_key)
     return insert_pos;
 }
 
-int insert_a_key_in_B_plus_tree(struct B_plus_node **B_plus_tree, int16_t new_key)
+/* split up cur and then its ancestors while they hold more than
+MAX_KEY_NUMBER keys, into new nodes from pool */
+static void split_full_B_plus_nodes_upward(struct B_plus_node **B_plus_tree, struct B_plus_node *cur,
+struct node_pool *pool)
 {
-    /* if the B_tree is NULL */
-    if (*B_plus_tree == NULL)
-    {
-        struct B_plus_node *root = alloc_a_new_B_plus_node(1);
-        root->key[0] = new_key;
-        return 0;
-    }
-    /* look up for the position of insertion. */
-    struct B_plus_node *cur = *B_plus_tree;
-    while (!cur->isleaf)
-    {
-        int16_t pos = look_up_a_key_pos_in_a_B_plus_node(cur, new_key);
-        if (cur->key[pos] != new_key)
-        {
-            cur = cur->child[pos];
-            pos = 0;
-        }
-        else
-        {
-            fprintf(stderr, "insert failed. This B plus tree has already a key value %" PRId16".\n", new_key);
-            return -1;
-        }
-    }
-    /* insert the new_key. */
-    if (insert_a_key_in_a_B_plus_node(cur, new_key) < 0)
-    {
-        fprintf(stderr, "insert failed. This B plus tree has already a key value %" PRId16".\n", new_key);
-        return 0;
-    }
-    /* split up the ancestor nodes whose elements is over 255. */
     while (cur->last_index == MAX_KEY_NUMBER)
     {
         int16_t split_pos = (MAX_KEY_NUMBER) >> 1;
-        struct B_plus_node *new_node = alloc_a_new_B_plus_node(cur->isleaf);
+        struct B_plus_node *new_node = alloc_a_new_B_plus_node(pool, cur->isleaf);
         new_node->last_index = MAX_KEY_NUMBER - split_pos;
         for (int16_t i = 0; i <= new_node->last_index; i++)
         {
             new_node->child[i] = cur->child[split_pos + i];
             new_node->key[i] = cur->key[split_pos + i];
+            if (new_node->child[i])
+                new_node->child[i]->parent = new_node, new_node->child[i]->pos_in_parent_node = i;
             cur->child[split_pos + i] = NULL;
             cur->key[split_pos + i] = 0;
         }
-        new_node->child[new_node->last_index + 1] = cur->child[MAX_KEY_NUMBER];
-        cur->child[MAX_KEY_NUMBER] = NULL;
         cur->last_index = split_pos - 1;
         if (new_node->isleaf)
         {
             for (int16_t i = 0; i <= new_node->last_index; i++)
                 new_node->fd[i] = cur->fd[split_pos + i], cur->fd[split_pos+i] = -1;
+            new_node->sibling = cur->sibling;
             cur->sibling = new_node;
         }
         if (!cur->parent)
         {
             /* create a new root after spliting the cur root. */
-            struct B_plus_node *new_root = alloc_a_new_B_plus_node(0);
+            struct B_plus_node *new_root = alloc_a_new_B_plus_node(pool, 0);
+            new_root->last_index = 1;
             new_root->key[0] = cur->key[0];
             new_root->key[1] = new_node->key[0];
             new_root->child[0] = cur;
@@ -236,20 +438,183 @@ int insert_a_key_in_B_plus_tree(struct B_plus_node **B_plus_tree, int16_t new_ke
         }
         else {
             /* insert middle key value in its ancestor node. */
-            new_node->pos_in_parent_node = insert_a_key_in_a_B_plus_node(cur->parent, cur->key[split_pos]);
+            new_node->pos_in_parent_node = insert_a_key_in_a_B_plus_node(cur->parent, new_node->key[0]);
             cur->pos_in_parent_node = new_node->pos_in_parent_node - 1;
             new_node->parent = cur->parent;
             cur->parent->child[cur->pos_in_parent_node] = cur;
             new_node->parent->child[new_node->pos_in_parent_node] = new_node;
+            /* the children behind new_node are shifted right by one */
+            for (int16_t i = new_node->pos_in_parent_node + 1; i <= cur->parent->last_index; i++)
+                cur->parent->child[i]->pos_in_parent_node = i;
             cur = cur->parent;
         }
     }
+    return;
+}
+
+/* walk down from cur to the leaf for new_key. Return the leaf, or NULL if an
+inner node on the way has new_key, which is then in a leaf already. */
+static struct B_plus_node *descend_to_a_B_plus_leaf_for_insert(struct B_plus_node *cur, int16_t new_key)
+{
+    while (!cur->isleaf)
+    {
+        /* an increasing key goes down the last child without a search */
+        int16_t pos = (cur->key[cur->last_index] < new_key) ? cur->last_index
+        : look_up_a_child_pos_in_a_B_plus_node(cur, new_key);
+        if (cur->key[pos] == new_key) return NULL;
+        cur = cur->child[pos];
+    }
+    return cur;
+}
+
+/* the new nodes come from pool, which has to be the same for every insert in
+a tree, or from the C heap if pool is NULL. */
+int insert_a_key_in_B_plus_tree(struct B_plus_node **B_plus_tree, int16_t new_key, struct node_pool *pool)
+{
+    /* if the B_tree is NULL */
+    if (*B_plus_tree == NULL)
+    {
+        *B_plus_tree = init_a_B_plus_root(new_key, pool);
+        return 0;
+    }
+    /* look up for the position of insertion. */
+    struct B_plus_node *cur = descend_to_a_B_plus_leaf_for_insert(*B_plus_tree, new_key);
+    /* insert the new_key. */
+    if (cur == NULL || insert_a_key_in_a_B_plus_node(cur, new_key) < 0)
+    {
+        fprintf(stderr, "insert failed. This B plus tree has already a key value %" PRId16".\n", new_key);
+        return -1;
+    }
+    split_full_B_plus_nodes_upward(B_plus_tree, cur, pool);
     printf("insert key value %" PRId16" successfully.\n", new_key);
+    return 0;
+}
+
+/* whether key falls in the range of keys that belong under node: from its
+minimal key up to the minimal key of the next node on its level */
+static _Bool B_plus_node_covers_a_key(struct B_plus_node *node, int16_t key)
+{
+    if (key < node->key[0]) return 0;
+    /* the next leaf is one link away, so a leaf needs not climb for it */
+    if (node->isleaf) return node->sibling == NULL || key < node->sibling->key[0];
+    for (; node->parent; node = node->parent)
+        if (node->pos_in_parent_node < node->parent->last_index)
+            return key < node->parent->key[node->pos_in_parent_node + 1];
     return 1;
 }
 
+/* insert new_key starting from *finger, the leaf of the last key inserted
+through it, and leave the leaf of new_key in *finger. It climbs only to the
+lowest ancestor whose range holds new_key, so a run of increasing keys goes
+straight into the rightmost leaf. A deletion may free *finger: set it to
+NULL after one. Unlike insert_a_key_in_B_plus_tree(), it reports nothing on stdout. */
+int insert_a_key_in_B_plus_tree_with_finger(struct B_plus_node **B_plus_tree, int16_t new_key,
+struct B_plus_node **finger, struct node_pool *pool)
+{
+    if (*B_plus_tree == NULL)
+    {
+        int state = insert_a_key_in_B_plus_tree(B_plus_tree, new_key, pool);
+        *finger = *B_plus_tree;
+        return state;
+    }
+    struct B_plus_node *cur = *finger ? *finger : *B_plus_tree;
+    while (cur->parent && !B_plus_node_covers_a_key(cur, new_key)) cur = cur->parent;
+    cur = descend_to_a_B_plus_leaf_for_insert(cur, new_key);
+    if (cur == NULL || insert_a_key_in_a_B_plus_node(cur, new_key) < 0)
+    {
+        fprintf(stderr, "insert failed. This B plus tree has already a key value %" PRId16".\n", new_key);
+        return -1;
+    }
+    split_full_B_plus_nodes_upward(B_plus_tree, cur, pool);
+    /* a split moves the upper half of the leaf into its new sibling */
+    if (cur->sibling && cur->sibling->key[0] <= new_key) cur = cur->sibling;
+    *finger = cur;
+    return 0;
+}
+
+/* spread len entries over as few nodes as fill_factor allows, but never leave a
+node below half full, so that deletion does not merge right after bulk loading. */
+static int32_t count_nodes_for_bulk_loading(int32_t len, double fill_factor)
+{
+    int32_t min_keys_per_node = MAX_KEY_NUMBER >> 1;
+    int32_t keys_per_node = (int32_t)(fill_factor * MAX_KEY_NUMBER);
+    if (keys_per_node < min_keys_per_node) keys_per_node = min_keys_per_node;
+    if (keys_per_node > MAX_KEY_NUMBER) keys_per_node = MAX_KEY_NUMBER;
+    int32_t node_number = (len + keys_per_node - 1) / keys_per_node;
+    if (node_number > 1 && len / node_number < min_keys_per_node)
+        node_number = len / min_keys_per_node;
+    return node_number ? node_number : 1;
+}
+
+/* build a B plus tree bottom-up from strictly increasing keys: pack the leaves
+and link them through sibling, then build each internal level from the minimal
+keys of the level below. fd may be NULL, fill_factor is the share of
+MAX_KEY_NUMBER to fill in each node and is raised to at least one half.
+The nodes come from pool, or from the C heap if pool is NULL. */
+int bulk_load_B_plus_tree(struct B_plus_node **B_plus_tree, const int16_t *sorted_key,
+const int *fd, int32_t len, double fill_factor, struct node_pool *pool)
+{
+    if (*B_plus_tree != NULL)
+    {
+        fputs("bulk loading needs an empty B plus tree.\n", stderr);
+        return -1;
+    }
+    if (len <= 0) return 0;
+    for (int32_t i = 1; i < len; i++)
+        if (sorted_key[i - 1] >= sorted_key[i])
+        {
+            fprintf(stderr, "bulk loading failed. Key %" PRId16" at %" PRId32" is not greater than its predecessor.\n",
+            sorted_key[i], i);
+            return -1;
+        }
+    int32_t node_number = count_nodes_for_bulk_loading(len, fill_factor);
+    struct B_plus_node **level = (struct B_plus_node **)malloc(node_number * sizeof(struct B_plus_node *));
+    if (level == NULL)
+        perror("fail to allocate a level of B plus nodes"), exit(EXIT_FAILURE);
+    /* the leaf level */
+    for (int32_t n = 0, i = 0; n < node_number; n++)
+    {
+        struct B_plus_node *leaf = alloc_a_new_B_plus_node(pool, 1);
+        int32_t key_number = len / node_number + (n < len % node_number);
+        for (int16_t j = 0; j < key_number; j++, i++)
+        {
+            leaf->key[j] = sorted_key[i];
+            leaf->fd[j] = fd ? fd[i] : -1;
+        }
+        leaf->last_index = key_number - 1;
+        if (n) level[n - 1]->sibling = leaf;
+        level[n] = leaf;
+    }
+    /* the internal levels, until one node is left as the root */
+    while (node_number > 1)
+    {
+        int32_t parent_number = count_nodes_for_bulk_loading(node_number, fill_factor);
+        for (int32_t n = 0, i = 0; n < parent_number; n++)
+        {
+            struct B_plus_node *parent = alloc_a_new_B_plus_node(pool, 0);
+            int32_t child_number = node_number / parent_number + (n < node_number % parent_number);
+            for (int16_t j = 0; j < child_number; j++, i++)
+            {
+                parent->key[j] = level[i]->key[0];
+                parent->child[j] = level[i];
+                level[i]->parent = parent;
+                level[i]->pos_in_parent_node = j;
+            }
+            parent->last_index = child_number - 1;
+            /* parents are written over children which are already linked */
+            level[n] = parent;
+        }
+        node_number = parent_number;
+    }
+    *B_plus_tree = level[0];
+    free(level);
+    return 0;
+}
+
 _Bool file_is_occupied_in_a_B_plus_leaf(struct B_plus_node *leaf, int16_t pos)
 {
+    /* a key without an open file can always be deleted */
+    if (leaf->fd[pos] < 0) return 0;
     if (fcntl(leaf->fd[pos], F_GETFL, 0) != O_NONBLOCK)
     {
         fprintf(stderr, "The file with key %" PRId16" is occupied by some thread.\n", leaf->key[pos]);
@@ -261,183 +626,162 @@ _Bool file_is_occupied_in_a_B_plus_leaf(struct B_plus_node *leaf, int16_t pos)
 
 void free_a_node_in_B_plus_tree(struct B_plus_node *node)
 {
-    struct B_plus_node *tmp = node;
-    free(tmp->key);
-    free(tmp->child);
-    if (tmp->isleaf) free(tmp->fd);
-    free(tmp);
+    /* the arrays live in the same block as the node */
+    if (node->pooled) free_a_node_to_pool(node);
+    else free(node);
     return;
 }
 
-static struct B_plus_node* merge_left_parent_right_B_plus_nodes(struct B_plus_node *left,
-struct B_plus_node *parent, struct B_plus_node *right)
+/* the minimal key of node changed, so correct it in the ancestors which
+reach node through their first children. */
+static void update_min_key_in_B_plus_ancestors(struct B_plus_node *node)
+{
+    while (node->parent)
+    {
+        node->parent->key[node->pos_in_parent_node] = node->key[0];
+        if (node->pos_in_parent_node) break;
+        node = node->parent;
+    }
+    return;
+}
+
+/* shift the entries of node from pos on by shift, and renumber the moved children */
+static void shift_entries_in_a_B_plus_node(struct B_plus_node *node, int16_t pos, int16_t shift)
 {
-    for (int16_t i = 0; i <= left->last_index; i++)
+    int16_t moved = node->last_index - pos + 1;
+    memmove(&node->key[pos + shift], &node->key[pos], moved * sizeof(int16_t));
+    if (node->isleaf)
+        memmove(&node->fd[pos + shift], &node->fd[pos], moved * sizeof(int));
+    else
     {
-        left->key[left->last_index + 1 + i] = right->key[i];
-        left->fd[left->last_index + 1 + i] = right->fd[i];
-        left->child[left->last_index + 1 + i] = right->child[i];
+        memmove(&node->child[pos + shift], &node->child[pos], moved * sizeof(struct B_plus_node *));
+        for (int16_t i = pos + shift; i <= node->last_index + shift; i++)
+            node->child[i]->pos_in_parent_node = i;
     }
-    left->last_index += 1 + right->last_index;
-    for (int16_t i = right->pos_in_parent_node; i <= parent->last_index; i++)
+    node->last_index += shift;
+    return;
+}
+
+/* append the entry src_pos of src to the end of dst */
+static void move_an_entry_between_B_plus_nodes(struct B_plus_node *dst, struct B_plus_node *src, int16_t src_pos)
+{
+    int16_t dst_pos = ++dst->last_index;
+    dst->key[dst_pos] = src->key[src_pos];
+    if (dst->isleaf)
+        dst->fd[dst_pos] = src->fd[src_pos];
+    else
     {
-        parent->key[i] = parent->key[i + 1];
-        parent->fd[i] = parent->fd[i + 1];
-        parent->child[i] = parent->child[i + 1];
+        dst->child[dst_pos] = src->child[src_pos];
+        dst->child[dst_pos]->parent = dst;
+        dst->child[dst_pos]->pos_in_parent_node = dst_pos;
     }
-    parent->last_index--;
+    return;
+}
+
+/* move every entry of right into left, and drop right from their parent */
+static struct B_plus_node* merge_left_parent_right_B_plus_nodes(struct B_plus_node *left,
+struct B_plus_node *parent, struct B_plus_node *right)
+{
+    for (int16_t i = 0; i <= right->last_index; i++)
+        move_an_entry_between_B_plus_nodes(left, right, i);
+    if (left->isleaf)
+        left->sibling = right->sibling;
+    shift_entries_in_a_B_plus_node(parent, right->pos_in_parent_node + 1, -1);
+    free_a_node_in_B_plus_tree(right);
     return left;
 }
 
-int delete_a_key_in_B_plus_leaf_and_merge(struct B_plus_node *leaf, int16_t del_pos)
+int delete_a_key_in_B_plus_leaf_and_merge(struct B_plus_node **B_plus_tree, struct B_plus_node *leaf, int16_t del_pos)
 {
-    /* once the number of key in this leaf is smaller than 127. */
-    if ( leaf->last_index < (MAX_KEY_NUMBER >> 1) - 1 )
+    if (file_is_occupied_in_a_B_plus_leaf(leaf, del_pos))
+        return -1;
+    shift_entries_in_a_B_plus_node(leaf, del_pos + 1, -1);
+    if (del_pos == 0 && leaf->last_index >= 0)
+        update_min_key_in_B_plus_ancestors(leaf);
+    /* a node under half full borrows one entry from a sibling,
+    or merges with it when both siblings are at half. */
+    struct B_plus_node *cur = leaf;
+    while (cur->parent && cur->last_index < (MAX_KEY_NUMBER >> 1) - 1)
     {
-        if (file_is_occupied_in_a_B_plus_leaf(leaf, del_pos))
-            return -1;
-        else
-        {
-            for (int16_t i = del_pos; i < leaf->last_index; i++)
-                leaf->key[i] = leaf->key[i + 1], leaf->fd[i] = leaf->fd[i + 1];
-            leaf->last_index--;
-        }
-        struct B_plus_node *cur = leaf;
-        while (cur && cur->last_index < (MAX_KEY_NUMBER >> 1) - 1)
+        struct B_plus_node *parent = cur->parent;
+        int16_t pos = cur->pos_in_parent_node;
+        struct B_plus_node *left_sibling = pos ? parent->child[pos - 1] : NULL;
+        struct B_plus_node *right_sibling = (pos < parent->last_index) ? parent->child[pos + 1] : NULL;
+        if (left_sibling && left_sibling->last_index > (MAX_KEY_NUMBER >> 1) - 1)
         {
-            struct B_plus_node *left_sibling = NULL;
-            if (cur->pos_in_parent_node)
-                left_sibling = cur->parent->child[cur->pos_in_parent_node - 1];
-            struct B_plus_node *right_sibling = NULL;
-            if (cur->pos_in_parent_node != cur->parent->last_index + 1)
-                right_sibling = cur->parent->child[cur->pos_in_parent_node + 1];
-            /* when the number of key in left_sibling is greater than or equal to 64. */
-            if (left_sibling && left_sibling->last_index >= (MAX_KEY_NUMBER >> 1) - 1)
-            {
-                insert_a_key_in_a_B_plus_node(cur,
-                cur->parent->key[left_sibling->pos_in_parent_node]);
-                cur->child[0] = left_sibling->child[left_sibling->last_index];
-                cur->fd[0] = left_sibling->fd[left_sibling->last_index];
-                left_sibling->child[left_sibling->last_index] = NULL;
-                left_sibling->key[left_sibling->last_index] = 0;
-                left_sibling->fd[left_sibling->last_index] = -1;
-                left_sibling->last_index--;
-                break;
-            }
-            /* when the number of key in right_sibling is greater than or equal to 64. */
-            else if (right_sibling && right_sibling->last_index >= (MAX_KEY_NUMBER - 2) >> 1)
-            {
-                insert_a_key_in_a_B_plus_node(cur,
-                cur->parent->key[right_sibling->pos_in_parent_node]);
-                cur->child[cur->last_index] = right_sibling->child[0];
-                cur->fd[cur->last_index] = right_sibling->fd[0];
-                for (int16_t i = 0; i <= right_sibling->last_index; i++)
-                {
-                    right_sibling->key[i] = right_sibling->key[i + 1];
-                    right_sibling->fd[i] = right_sibling->fd[i + 1];
-                    right_sibling->child[i] = right_sibling->child[i + 1];
-                }
-                right_sibling->last_index--;
-                /* if minimal key of right_sibling changed, ascend to change the ancestors until root. */
-                for (struct B_plus_node *ancestor = cur;
-                ancestor && ancestor->pos_in_parent_node;
-                ancestor = ancestor->parent)
-                    ancestor->parent->key[ancestor->pos_in_parent_node] = right_sibling->key[0];
-                break;
-            }
-            /* when the numbers of key in both left_sibling and right_sibling are 63. */
+            shift_entries_in_a_B_plus_node(cur, 0, 1);
+            int16_t last = left_sibling->last_index;
+            cur->key[0] = left_sibling->key[last];
+            if (cur->isleaf)
+                cur->fd[0] = left_sibling->fd[last];
             else
             {
-                if (left_sibling)
-                {
-                    left_sibling = merge_left_parent_right_B_plus_nodes(left_sibling,
-                    cur->parent, cur);
-                    if (cur->isleaf)
-                        left_sibling->sibling = cur->sibling;
-                    free_a_node_in_B_plus_tree(cur);
-                    cur = left_sibling;
-                    left_sibling = NULL;
-                }
-                else
-                {
-                    cur = merge_left_parent_right_B_plus_nodes(cur,
-                    cur->parent, right_sibling);
-                    if (cur->isleaf)
-                        cur->sibling = right_sibling->sibling;
-                    free_a_node_in_B_plus_tree(right_sibling);
-                    right_sibling = NULL;
-                }
+                cur->child[0] = left_sibling->child[last];
+                cur->child[0]->parent = cur;
+                cur->child[0]->pos_in_parent_node = 0;
             }
-            cur = cur->parent;
+            left_sibling->last_index--;
+            update_min_key_in_B_plus_ancestors(cur);
+            break;
         }
-        return 0;
+        else if (right_sibling && right_sibling->last_index > (MAX_KEY_NUMBER >> 1) - 1)
+        {
+            move_an_entry_between_B_plus_nodes(cur, right_sibling, 0);
+            shift_entries_in_a_B_plus_node(right_sibling, 1, -1);
+            update_min_key_in_B_plus_ancestors(right_sibling);
+            if (cur->last_index == 0)
+                update_min_key_in_B_plus_ancestors(cur);
+            break;
+        }
+        else if (left_sibling)
+            cur = merge_left_parent_right_B_plus_nodes(left_sibling, parent, cur);
+        else if (right_sibling)
+            cur = merge_left_parent_right_B_plus_nodes(cur, parent, right_sibling);
+        cur = parent;
     }
-    /* when the number of key in this leaf is greater than or equal to 64. */
-    else
+    /* the root keeps one key at least, unless the tree is empty */
+    struct B_plus_node *root = *B_plus_tree;
+    if (root->last_index < 0)
     {
-        if (file_is_occupied_in_a_B_plus_leaf(leaf, del_pos))
-            return -1;
-        for (int16_t i = del_pos; i < leaf->last_index; i++)
-            leaf->key[i] = leaf->key[i + 1], leaf->fd[i] = leaf->fd[i + 1];
-        leaf->last_index--;
-        return 0;
+        free_a_node_in_B_plus_tree(root);
+        *B_plus_tree = NULL;
+    }
+    else if (!root->isleaf && root->last_index == 0)
+    {
+        *B_plus_tree = root->child[0];
+        (*B_plus_tree)->parent = NULL;
+        (*B_plus_tree)->pos_in_parent_node = -1;
+        free_a_node_in_B_plus_tree(root);
     }
+    return 0;
 }
 
 int delete_a_key_and_fill_from_min_key_in_B_plus_tree(struct B_plus_node **B_plus_tree, int16_t key_to_be_del)
 {
     struct B_plus_node *cur = *B_plus_tree;
-    int16_t del_pos;
+    int16_t del_pos = 0;
     while (cur)
     {
-        del_pos = look_up_a_key_pos_in_a_B_plus_node(cur, key_to_be_del);
-        if ((cur->key[del_pos] == key_to_be_del) & cur->isleaf)
-            break;
-        else
+        if (cur->isleaf)
         {
-            cur = cur->child[del_pos];
-            del_pos = 0;
+            del_pos = look_up_a_key_pos_in_a_B_plus_node(cur, key_to_be_del);
+            if (del_pos > cur->last_index || cur->key[del_pos] != key_to_be_del)
+                cur = NULL;
+            break;
         }
+        cur = cur->child[look_up_a_child_pos_in_a_B_plus_node(cur, key_to_be_del)];
     }
     if (!cur)
     {
         fprintf(stderr, "No key value in B plus tree!\n");
         return -1;
     }
-    #define B_PLUS_TREE_HAS_ONLY_ONE_KEY_TO_DELETE !((cur != *B_plus_tree) \
-    | del_pos | cur->last_index | !cur->isleaf)
-    if (B_PLUS_TREE_HAS_ONLY_ONE_KEY_TO_DELETE)
-    {
-        *B_plus_tree = NULL;
-        free_a_node_in_B_plus_tree(cur);
-    }
-    else if (cur->isleaf)
+    /* the separators above are the minimal keys of the leaves, so the
+    next key of the leaf fills them in when key_to_be_del is one. */
+    if (delete_a_key_in_B_plus_leaf_and_merge(B_plus_tree, cur, del_pos))
     {
-        if (!delete_a_key_in_B_plus_leaf_and_merge(cur, del_pos))
-        {
-            fprintf(stderr, "fail to delete key %" PRId16" owe to the file open!\n", key_to_be_del);
-            return -1;
-        }
-    }
-    else
-    {
-        struct B_plus_node *leaf_of_cur = cur->child[del_pos];
-        while (!leaf_of_cur->isleaf)
-            leaf_of_cur = leaf_of_cur->child[0];
-        if (delete_a_key_in_B_plus_leaf_and_merge(leaf_of_cur, 0))
-        {
-            fprintf(stderr, "Fail to delete key %" PRId16".\n"
-            "Because the file of min_key_in_leaf %" PRId16" is open!\n",
-            key_to_be_del, leaf_of_cur->key[0]);
-            return -1;
-        }
-        /* ascend to change the ancestors until the ancestor is not equal to key. */
-        int16_t min_key_in_leaf = leaf_of_cur->key[0];
-        while (leaf_of_cur->parent->key[0] == key_to_be_del)
-        {
-            leaf_of_cur->parent->key[0] = min_key_in_leaf;
-            leaf_of_cur = leaf_of_cur->parent;
-        }
+        fprintf(stderr, "fail to delete key %" PRId16" owe to the file open!\n", key_to_be_del);
+        return -1;
     }
     printf("delete key value %" PRId16" successfully.\n", key_to_be_del);
     return 0;
@@ -0,0 +1,499 @@
+#pragma once
+#include "B_plus_tree.c"
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+/* a copy-on-write B plus tree. A writer never changes a node which readers
+can reach: it copies the nodes on its path, changes the copies and publishes
+the new root with one atomic store, so every reader works on the version it
+started with and takes no lock. Writers are serialized by writer_lock.
+Copied nodes are retired with the epoch they were replaced in, and freed
+once no reader which could still hold them is left (epoch based reclamation).
+parent, pos_in_parent_node and sibling are not kept up, since updating them
+would copy the whole tree; scans walk down a path stack instead. */
+#define COW_MAX_READERS 64
+#define COW_B_PLUS_MAX_HEIGHT 16
+/* a node which is not the root needs more entries than this last_index */
+#define COW_B_PLUS_MIN_LAST_INDEX ((MAX_KEY_NUMBER >> 1) - 1)
+
+/* epoch is 0 while the slot is free, or the global epoch the reader started in */
+struct COW_reader_slot {
+    _Atomic uint64_t epoch;} __attribute__((aligned(64)));
+
+struct COW_retired_node {
+    struct B_plus_node *node;
+    uint64_t epoch;};
+
+struct COW_B_plus_tree {
+    struct B_plus_node *_Atomic root;
+    _Atomic uint64_t global_epoch;
+    struct COW_reader_slot reader[COW_MAX_READERS];
+    pthread_mutex_t writer_lock;
+    /* nodes come from pool, or from the C heap if it is NULL */
+    struct node_pool *pool;
+    /* nodes replaced by writers, in the order of their epochs */
+    struct COW_retired_node *retired;
+    size_t retired_len, retired_capacity;};
+
+/* a point-in-time view of the tree, valid until it is released */
+struct B_plus_snapshot {
+    struct COW_B_plus_tree *tree;
+    struct B_plus_node *root;
+    int16_t reader_slot;};
+
+struct COW_B_plus_tree *init_COW_B_plus_tree(struct node_pool *pool)
+{
+    struct COW_B_plus_tree *tree = (struct COW_B_plus_tree *)aligned_alloc(64,
+    sizeof(struct COW_B_plus_tree));
+    if (tree == NULL)
+        perror("fail to allocate a copy-on-write B plus tree"), exit(EXIT_FAILURE);
+    atomic_init(&tree->root, NULL);
+    atomic_init(&tree->global_epoch, 1);
+    for (int16_t i = 0; i < COW_MAX_READERS; i++)
+        atomic_init(&tree->reader[i].epoch, 0);
+    pthread_mutex_init(&tree->writer_lock, NULL);
+    tree->pool = pool;
+    tree->retired = NULL;
+    tree->retired_len = tree->retired_capacity = 0;
+    return tree;
+}
+
+/* every snapshot has to be released before */
+void destroy_COW_B_plus_tree(struct COW_B_plus_tree *tree)
+{
+    for (size_t i = 0; i < tree->retired_len; i++)
+        free_a_node_in_B_plus_tree(tree->retired[i].node);
+    free(tree->retired);
+    delete_all_nodes_in_B_plus_tree(atomic_load(&tree->root));
+    pthread_mutex_destroy(&tree->writer_lock);
+    free(tree);
+    return;
+}
+
+/* take a reader slot and the current root. Return 0, or -1 if all
+COW_MAX_READERS slots are taken. */
+int take_a_snapshot_of_COW_B_plus_tree(struct COW_B_plus_tree *tree, struct B_plus_snapshot *snapshot)
+{
+    uint64_t epoch = atomic_load(&tree->global_epoch);
+    for (int16_t i = 0; i < COW_MAX_READERS; i++)
+    {
+        uint64_t free_slot = 0;
+        if (atomic_load_explicit(&tree->reader[i].epoch, memory_order_relaxed) != 0
+        || !atomic_compare_exchange_strong(&tree->reader[i].epoch, &free_slot, epoch))
+            continue;
+        /* a writer which did not see the slot yet may have moved the epoch on
+        and reclaimed nodes of the epoch just written, so announce it again
+        until it is current. The root read after that is at least as new. */
+        uint64_t current;
+        while ((current = atomic_load(&tree->global_epoch)) != epoch)
+            atomic_store(&tree->reader[i].epoch, epoch = current);
+        snapshot->tree = tree;
+        snapshot->root = atomic_load(&tree->root);
+        snapshot->reader_slot = i;
+        return 0;
+    }
+    fputs("no free reader slot for a B plus snapshot.\n", stderr);
+    return -1;
+}
+
+void release_a_snapshot_of_COW_B_plus_tree(struct B_plus_snapshot *snapshot)
+{
+    atomic_store(&snapshot->tree->reader[snapshot->reader_slot].epoch, 0);
+    snapshot->root = NULL;
+    return;
+}
+
+/* return 0 and the file descriptor of unkown_key through fd, or -1 if absent. */
+int look_up_a_key_in_B_plus_snapshot(const struct B_plus_snapshot *snapshot, int16_t unkown_key, int *fd)
+{
+    struct B_plus_node *cur = snapshot->root;
+    if (cur == NULL) return -1;
+    while (!cur->isleaf)
+        cur = cur->child[look_up_a_child_pos_in_a_B_plus_node(cur, unkown_key)];
+    int16_t pos = look_up_a_key_pos_in_a_B_plus_node(cur, unkown_key);
+    if (pos > cur->last_index || cur->key[pos] != unkown_key)
+        return -1;
+    if (fd) *fd = cur->fd[pos];
+    return 0;
+}
+
+int look_up_a_key_in_COW_B_plus_tree(struct COW_B_plus_tree *tree, int16_t unkown_key, int *fd)
+{
+    struct B_plus_snapshot snapshot;
+    if (take_a_snapshot_of_COW_B_plus_tree(tree, &snapshot))
+        return -1;
+    int state = look_up_a_key_in_B_plus_snapshot(&snapshot, unkown_key, fd);
+    release_a_snapshot_of_COW_B_plus_tree(&snapshot);
+    return state;
+}
+
+/* a position in the leaf level of a snapshot, kept as the path from the root */
+struct B_plus_snapshot_iterator {
+    struct B_plus_node *node_stack[COW_B_PLUS_MAX_HEIGHT];
+    int16_t pos_stack[COW_B_PLUS_MAX_HEIGHT];
+    int8_t top;};
+
+/* go down the first children from the node on top of the iterator to a leaf */
+static void descend_to_the_first_leaf_in_B_plus_snapshot(struct B_plus_snapshot_iterator *iter)
+{
+    struct B_plus_node *cur = iter->node_stack[iter->top];
+    while (!cur->isleaf)
+    {
+        if (iter->top == COW_B_PLUS_MAX_HEIGHT - 1)
+            perror("B plus snapshot iterator overflow"), exit(-1);
+        cur = cur->child[iter->pos_stack[iter->top]];
+        iter->node_stack[++iter->top] = cur;
+        iter->pos_stack[iter->top] = 0;
+    }
+    return;
+}
+
+/* move iter from the end of a leaf to the start of the next one, or set
+top to -1 at the end of the tree. */
+static void step_to_the_next_leaf_in_B_plus_snapshot(struct B_plus_snapshot_iterator *iter)
+{
+    iter->top--;
+    while (iter->top >= 0)
+    {
+        if (++iter->pos_stack[iter->top] <= iter->node_stack[iter->top]->last_index)
+        {
+            descend_to_the_first_leaf_in_B_plus_snapshot(iter);
+            return;
+        }
+        iter->top--;
+    }
+    return;
+}
+
+/* position iter at the first key of snapshot which is not less than lower_key.
+Return 0, or -1 if every key is less than lower_key. */
+int lower_bound_in_B_plus_snapshot(const struct B_plus_snapshot *snapshot, int16_t lower_key,
+struct B_plus_snapshot_iterator *iter)
+{
+    struct B_plus_node *cur = snapshot->root;
+    iter->top = -1;
+    if (cur == NULL) return -1;
+    while (1)
+    {
+        if (iter->top == COW_B_PLUS_MAX_HEIGHT - 1)
+            perror("B plus snapshot iterator overflow"), exit(-1);
+        iter->node_stack[++iter->top] = cur;
+        if (cur->isleaf) break;
+        iter->pos_stack[iter->top] = look_up_a_child_pos_in_a_B_plus_node(cur, lower_key);
+        cur = cur->child[iter->pos_stack[iter->top]];
+    }
+    iter->pos_stack[iter->top] = look_up_a_key_pos_in_a_B_plus_node(cur, lower_key);
+    /* lower_key is greater than every key in this leaf */
+    if (iter->pos_stack[iter->top] > cur->last_index)
+        step_to_the_next_leaf_in_B_plus_snapshot(iter);
+    return iter->top < 0 ? -1 : 0;
+}
+
+/* the same as next_batch_in_B_plus_tree(), for an iterator of a snapshot */
+int32_t next_batch_in_B_plus_snapshot(struct B_plus_snapshot_iterator *iter, int16_t upper_key,
+int16_t *key_buf, int *fd_buf, int32_t batch_size)
+{
+    int32_t copied = 0;
+    while (iter->top >= 0 && copied < batch_size)
+    {
+        struct B_plus_node *leaf = iter->node_stack[iter->top];
+        int16_t pos = iter->pos_stack[iter->top];
+        while (pos <= leaf->last_index && copied < batch_size)
+        {
+            if (leaf->key[pos] > upper_key)
+            {
+                iter->top = -1;
+                return copied;
+            }
+            key_buf[copied] = leaf->key[pos];
+            if (fd_buf) fd_buf[copied] = leaf->fd[pos];
+            copied++, pos++;
+        }
+        iter->pos_stack[iter->top] = pos;
+        if (pos > leaf->last_index)
+            step_to_the_next_leaf_in_B_plus_snapshot(iter);
+    }
+    return copied;
+}
+
+/* a node replaced in the current epoch; readers of older epochs may still hold it */
+static void retire_a_COW_B_plus_node(struct COW_B_plus_tree *tree, struct B_plus_node *node)
+{
+    if (tree->retired_len == tree->retired_capacity)
+    {
+        tree->retired_capacity = tree->retired_capacity ? tree->retired_capacity << 1 : 64;
+        tree->retired = (struct COW_retired_node *)realloc(tree->retired,
+        tree->retired_capacity * sizeof(struct COW_retired_node));
+        if (tree->retired == NULL)
+            perror("fail to allocate the retired B plus nodes"), exit(EXIT_FAILURE);
+    }
+    tree->retired[tree->retired_len].node = node;
+    tree->retired[tree->retired_len++].epoch = atomic_load_explicit(&tree->global_epoch, memory_order_relaxed);
+    return;
+}
+
+/* free the retired nodes of the epochs before the oldest active reader */
+static void reclaim_retired_COW_B_plus_nodes(struct COW_B_plus_tree *tree)
+{
+    uint64_t oldest_epoch = UINT64_MAX;
+    for (int16_t i = 0; i < COW_MAX_READERS; i++)
+    {
+        uint64_t epoch = atomic_load(&tree->reader[i].epoch);
+        if (epoch && epoch < oldest_epoch) oldest_epoch = epoch;
+    }
+    size_t freed = 0;
+    while (freed < tree->retired_len && tree->retired[freed].epoch < oldest_epoch)
+        free_a_node_in_B_plus_tree(tree->retired[freed++].node);
+    /* nothing to compact if no node was freed */
+    if (freed == 0) return;
+    tree->retired_len -= freed;
+    if (tree->retired_len) memmove(tree->retired, tree->retired + freed, tree->retired_len * sizeof(struct COW_retired_node));
+    return;
+}
+
+/* make new_root visible to new snapshots, then start the next epoch: a reader
+which starts in it reads new_root or a later one. */
+static void publish_a_COW_B_plus_root(struct COW_B_plus_tree *tree, struct B_plus_node *new_root)
+{
+    atomic_store(&tree->root, new_root);
+    atomic_fetch_add(&tree->global_epoch, 1);
+    reclaim_retired_COW_B_plus_nodes(tree);
+    return;
+}
+
+/* a private copy of node, which the writer may change until it is published */
+static struct B_plus_node *copy_a_COW_B_plus_node(struct B_plus_node *node)
+{
+    struct B_plus_node *copy = alloc_a_new_B_plus_node(node_pool_of_a_B_plus_node(node), node->isleaf);
+    int16_t entry_number = node->last_index + 1;
+    copy->last_index = node->last_index;
+    memcpy(copy->key, node->key, entry_number * sizeof(int16_t));
+    if (node->isleaf)
+        memcpy(copy->fd, node->fd, entry_number * sizeof(int));
+    else memcpy(copy->child, node->child, entry_number * sizeof(struct B_plus_node *));
+    return copy;
+}
+
+/* shift the entries of a private node from pos on by shift. Unlike
+shift_entries_in_a_B_plus_node(), the children are shared with older
+versions and are not renumbered. */
+static void shift_entries_in_a_COW_B_plus_node(struct B_plus_node *node, int16_t pos, int16_t shift)
+{
+    int16_t moved = node->last_index - pos + 1;
+    memmove(&node->key[pos + shift], &node->key[pos], moved * sizeof(int16_t));
+    if (node->isleaf)
+        memmove(&node->fd[pos + shift], &node->fd[pos], moved * sizeof(int));
+    else memmove(&node->child[pos + shift], &node->child[pos], moved * sizeof(struct B_plus_node *));
+    node->last_index += shift;
+    return;
+}
+
+static void copy_an_entry_between_COW_B_plus_nodes(struct B_plus_node *dst, int16_t dst_pos,
+struct B_plus_node *src, int16_t src_pos)
+{
+    dst->key[dst_pos] = src->key[src_pos];
+    if (dst->isleaf)
+        dst->fd[dst_pos] = src->fd[src_pos];
+    else dst->child[dst_pos] = src->child[src_pos];
+    return;
+}
+
+/* split a full private node and return its right half */
+static struct B_plus_node *split_a_full_COW_B_plus_node(struct B_plus_node *node)
+{
+    int16_t split_pos = MAX_KEY_NUMBER >> 1;
+    struct B_plus_node *new_node = alloc_a_new_B_plus_node(node_pool_of_a_B_plus_node(node), node->isleaf);
+    new_node->last_index = MAX_KEY_NUMBER - split_pos;
+    for (int16_t i = 0; i <= new_node->last_index; i++)
+        copy_an_entry_between_COW_B_plus_nodes(new_node, i, node, split_pos + i);
+    node->last_index = split_pos - 1;
+    return new_node;
+}
+
+/* insert new_key under node and return the copy of node which holds it, or
+NULL if new_key is there already. *split_node is the right half of the copy
+if it split, else NULL. */
+static struct B_plus_node *insert_a_key_in_a_COW_B_plus_subtree(struct COW_B_plus_tree *tree,
+struct B_plus_node *node, int16_t new_key, struct B_plus_node **split_node)
+{
+    struct B_plus_node *new_child = NULL, *split_child = NULL;
+    int16_t pos;
+    if (node->isleaf)
+    {
+        pos = look_up_a_key_pos_in_a_B_plus_node(node, new_key);
+        if (pos <= node->last_index && node->key[pos] == new_key)
+            return NULL;
+    }
+    else
+    {
+        pos = look_up_a_child_pos_in_a_B_plus_node(node, new_key);
+        new_child = insert_a_key_in_a_COW_B_plus_subtree(tree, node->child[pos], new_key, &split_child);
+        if (new_child == NULL) return NULL;
+    }
+    struct B_plus_node *copy = copy_a_COW_B_plus_node(node);
+    retire_a_COW_B_plus_node(tree, node);
+    if (copy->isleaf)
+    {
+        shift_entries_in_a_COW_B_plus_node(copy, pos, 1);
+        copy->key[pos] = new_key;
+        copy->fd[pos] = -1;
+    }
+    else
+    {
+        /* the minimal key of the child changes if new_key went to its front */
+        copy->child[pos] = new_child;
+        copy->key[pos] = new_child->key[0];
+        if (split_child)
+        {
+            shift_entries_in_a_COW_B_plus_node(copy, pos + 1, 1);
+            copy->child[pos + 1] = split_child;
+            copy->key[pos + 1] = split_child->key[0];
+        }
+    }
+    *split_node = (copy->last_index == MAX_KEY_NUMBER) ? split_a_full_COW_B_plus_node(copy) : NULL;
+    return copy;
+}
+
+int insert_a_key_in_COW_B_plus_tree(struct COW_B_plus_tree *tree, int16_t new_key)
+{
+    pthread_mutex_lock(&tree->writer_lock);
+    struct B_plus_node *root = atomic_load_explicit(&tree->root, memory_order_relaxed), *new_root, *split_node;
+    if (root == NULL)
+    {
+        new_root = alloc_a_new_B_plus_node(tree->pool, 1);
+        new_root->key[0] = new_key;
+    }
+    else if ((new_root = insert_a_key_in_a_COW_B_plus_subtree(tree, root, new_key, &split_node)) == NULL)
+    {
+        pthread_mutex_unlock(&tree->writer_lock);
+        fprintf(stderr, "insert failed. This B plus tree has already a key value %" PRId16".\n", new_key);
+        return -1;
+    }
+    else if (split_node)
+    {
+        /* create a new root after spliting the root. */
+        struct B_plus_node *split_root = alloc_a_new_B_plus_node(tree->pool, 0);
+        split_root->last_index = 1;
+        split_root->key[0] = new_root->key[0];
+        split_root->key[1] = split_node->key[0];
+        split_root->child[0] = new_root;
+        split_root->child[1] = split_node;
+        new_root = split_root;
+    }
+    publish_a_COW_B_plus_root(tree, new_root);
+    pthread_mutex_unlock(&tree->writer_lock);
+    return 0;
+}
+
+/* the private child at pos of the private parent is under half full: borrow
+an entry from a copy of a sibling, or merge with the sibling. */
+static void rebalance_a_COW_B_plus_child(struct COW_B_plus_tree *tree, struct B_plus_node *parent, int16_t pos)
+{
+    struct B_plus_node *child = parent->child[pos];
+    struct B_plus_node *left_sibling = pos ? parent->child[pos - 1] : NULL;
+    struct B_plus_node *right_sibling = (pos < parent->last_index) ? parent->child[pos + 1] : NULL;
+    if (left_sibling && left_sibling->last_index > COW_B_PLUS_MIN_LAST_INDEX)
+    {
+        parent->child[pos - 1] = copy_a_COW_B_plus_node(left_sibling);
+        retire_a_COW_B_plus_node(tree, left_sibling);
+        left_sibling = parent->child[pos - 1];
+        shift_entries_in_a_COW_B_plus_node(child, 0, 1);
+        copy_an_entry_between_COW_B_plus_nodes(child, 0, left_sibling, left_sibling->last_index--);
+        parent->key[pos] = child->key[0];
+    }
+    else if (right_sibling && right_sibling->last_index > COW_B_PLUS_MIN_LAST_INDEX)
+    {
+        parent->child[pos + 1] = copy_a_COW_B_plus_node(right_sibling);
+        retire_a_COW_B_plus_node(tree, right_sibling);
+        right_sibling = parent->child[pos + 1];
+        copy_an_entry_between_COW_B_plus_nodes(child, ++child->last_index, right_sibling, 0);
+        shift_entries_in_a_COW_B_plus_node(right_sibling, 1, -1);
+        parent->key[pos] = child->key[0];
+        parent->key[pos + 1] = right_sibling->key[0];
+    }
+    else if (left_sibling)
+    {
+        /* the merged node replaces left_sibling, and child is dropped */
+        struct B_plus_node *merged = parent->child[pos - 1] = copy_a_COW_B_plus_node(left_sibling);
+        retire_a_COW_B_plus_node(tree, left_sibling);
+        for (int16_t i = 0; i <= child->last_index; i++)
+            copy_an_entry_between_COW_B_plus_nodes(merged, ++merged->last_index, child, i);
+        /* child was never published, so no reader can hold it */
+        free_a_node_in_B_plus_tree(child);
+        shift_entries_in_a_COW_B_plus_node(parent, pos + 1, -1);
+    }
+    else if (right_sibling)
+    {
+        for (int16_t i = 0; i <= right_sibling->last_index; i++)
+            copy_an_entry_between_COW_B_plus_nodes(child, ++child->last_index, right_sibling, i);
+        retire_a_COW_B_plus_node(tree, right_sibling);
+        shift_entries_in_a_COW_B_plus_node(parent, pos + 2, -1);
+        parent->key[pos] = child->key[0];
+    }
+    return;
+}
+
+/* delete key_to_be_del under node and return the copy of node without it,
+which may be under half full, or NULL if the key can not be deleted. */
+static struct B_plus_node *delete_a_key_in_a_COW_B_plus_subtree(struct COW_B_plus_tree *tree,
+struct B_plus_node *node, int16_t key_to_be_del)
+{
+    struct B_plus_node *copy;
+    if (node->isleaf)
+    {
+        int16_t del_pos = look_up_a_key_pos_in_a_B_plus_node(node, key_to_be_del);
+        if (del_pos > node->last_index || node->key[del_pos] != key_to_be_del)
+        {
+            fprintf(stderr, "No key value in B plus tree!\n");
+            return NULL;
+        }
+        if (file_is_occupied_in_a_B_plus_leaf(node, del_pos))
+        {
+            fprintf(stderr, "fail to delete key %" PRId16" owe to the file open!\n", key_to_be_del);
+            return NULL;
+        }
+        copy = copy_a_COW_B_plus_node(node);
+        shift_entries_in_a_COW_B_plus_node(copy, del_pos + 1, -1);
+    }
+    else
+    {
+        int16_t pos = look_up_a_child_pos_in_a_B_plus_node(node, key_to_be_del);
+        struct B_plus_node *new_child = delete_a_key_in_a_COW_B_plus_subtree(tree, node->child[pos], key_to_be_del);
+        if (new_child == NULL) return NULL;
+        copy = copy_a_COW_B_plus_node(node);
+        copy->child[pos] = new_child;
+        if (new_child->last_index >= 0)
+            copy->key[pos] = new_child->key[0];
+        if (new_child->last_index < COW_B_PLUS_MIN_LAST_INDEX)
+            rebalance_a_COW_B_plus_child(tree, copy, pos);
+    }
+    retire_a_COW_B_plus_node(tree, node);
+    return copy;
+}
+
+int delete_a_key_in_COW_B_plus_tree(struct COW_B_plus_tree *tree, int16_t key_to_be_del)
+{
+    pthread_mutex_lock(&tree->writer_lock);
+    struct B_plus_node *root = atomic_load_explicit(&tree->root, memory_order_relaxed), *new_root;
+    if (root == NULL || (new_root = delete_a_key_in_a_COW_B_plus_subtree(tree, root, key_to_be_del)) == NULL)
+    {
+        if (root == NULL) fprintf(stderr, "No key value in B plus tree!\n");
+        pthread_mutex_unlock(&tree->writer_lock);
+        return -1;
+    }
+    /* the root keeps one key at least, unless the tree is empty */
+    if (new_root->last_index < 0)
+    {
+        free_a_node_in_B_plus_tree(new_root);
+        new_root = NULL;
+    }
+    else if (!new_root->isleaf && new_root->last_index == 0)
+    {
+        struct B_plus_node *only_child = new_root->child[0];
+        free_a_node_in_B_plus_tree(new_root);
+        new_root = only_child;
+    }
+    publish_a_COW_B_plus_root(tree, new_root);
+    pthread_mutex_unlock(&tree->writer_lock);
+    return 0;
+}
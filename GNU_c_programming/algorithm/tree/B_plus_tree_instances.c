@@ -0,0 +1,24 @@
+#pragma once
+#include <stdint.h>
+#include <string.h>
+/* B plus trees stamped out from B_plus_tree_template.c */
+
+/* 64-bit ids mapped to 16-byte inline values */
+struct value16 {
+    uint64_t word[2];};
+
+#define B_PLUS_TREE_NAME u64_B_plus_tree
+#define B_PLUS_KEY_TYPE uint64_t
+#define B_PLUS_VALUE_TYPE struct value16
+#include "B_plus_tree_template.c"
+
+/* fixed-length byte-string keys in memcmp() order */
+#define BYTE_KEY_LEN 16
+struct byte_key {
+    unsigned char byte[BYTE_KEY_LEN];};
+
+#define B_PLUS_TREE_NAME bytes_B_plus_tree
+#define B_PLUS_KEY_TYPE struct byte_key
+#define B_PLUS_VALUE_TYPE uint64_t
+#define B_PLUS_KEY_LESS(a, b) (memcmp((a).byte, (b).byte, BYTE_KEY_LEN) < 0)
+#include "B_plus_tree_template.c"
@@ -0,0 +1,369 @@
+/* a B plus tree stamped out for any key and value type. Define the
+parameters below and include this file once per instantiation:
+
+    #define B_PLUS_TREE_NAME u64_B_plus_tree
+    #define B_PLUS_KEY_TYPE uint64_t
+    #define B_PLUS_VALUE_TYPE struct value16
+    #include "B_plus_tree_template.c"
+
+B_PLUS_KEY_LESS(a, b) may be defined for keys without operator <, e.g. a
+memcmp() over fixed-length byte strings. It is expanded in place, so the
+search loops are compiled against the concrete key type without any function
+pointer. B_PLUS_MAX_KEY_NUMBER bounds the keys per node and defaults to 64.
+Keys and values are copied into the nodes by assignment. As in B_plus_tree.c,
+key[i] of an internal node is a lower bound of the keys under child[i].
+There is no #pragma once here on purpose; the parameters are undefined at
+the end so that the next instantiation starts clean. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+
+#ifndef B_PLUS_TREE_NAME
+#error "B_PLUS_TREE_NAME is not defined"
+#endif
+#ifndef B_PLUS_KEY_TYPE
+#error "B_PLUS_KEY_TYPE is not defined"
+#endif
+#ifndef B_PLUS_VALUE_TYPE
+#error "B_PLUS_VALUE_TYPE is not defined"
+#endif
+#ifndef B_PLUS_KEY_LESS
+#define B_PLUS_KEY_LESS(a, b) ((a) < (b))
+#endif
+#ifndef B_PLUS_MAX_KEY_NUMBER
+#define B_PLUS_MAX_KEY_NUMBER 64
+#endif
+#if B_PLUS_MAX_KEY_NUMBER < 4 || B_PLUS_MAX_KEY_NUMBER > INT16_MAX
+#error "B_PLUS_MAX_KEY_NUMBER is out of range"
+#endif
+
+#ifndef B_PLUS_TEMPLATE_COMMON
+#define B_PLUS_TEMPLATE_COMMON
+#define B_PLUS_PASTE(a, b) a##_##b
+#define B_PLUS_CONCAT(a, b) B_PLUS_PASTE(a, b)
+#define B_PLUS_MAX_HEIGHT 32
+#endif
+
+#define B_PLUS_KEY_EQUAL(a, b) (!B_PLUS_KEY_LESS(a, b) && !B_PLUS_KEY_LESS(b, a))
+#define B_PLUS_MIN_KEY_NUMBER (B_PLUS_MAX_KEY_NUMBER >> 1)
+/* B_PLUS_TYPE(node) -> struct u64_B_plus_tree_node,
+B_PLUS_FUNC(insert_a_key_in) -> insert_a_key_in_u64_B_plus_tree */
+#define B_PLUS_TYPE(suffix) B_PLUS_CONCAT(B_PLUS_TREE_NAME, suffix)
+#define B_PLUS_FUNC(prefix) B_PLUS_CONCAT(prefix, B_PLUS_TREE_NAME)
+
+/* leaves and internal nodes share this head, and are told apart by isleaf */
+struct B_PLUS_TYPE(node) {
+    int16_t last_index;
+    _Bool isleaf;
+    B_PLUS_KEY_TYPE key[B_PLUS_MAX_KEY_NUMBER];};
+
+struct B_PLUS_TYPE(leaf) {
+    struct B_PLUS_TYPE(node) head;
+    struct B_PLUS_TYPE(leaf) *sibling;
+    B_PLUS_VALUE_TYPE value[B_PLUS_MAX_KEY_NUMBER];};
+
+struct B_PLUS_TYPE(internal) {
+    struct B_PLUS_TYPE(node) head;
+    struct B_PLUS_TYPE(node) *child[B_PLUS_MAX_KEY_NUMBER];};
+
+struct B_PLUS_TYPE(iterator) {
+    struct B_PLUS_TYPE(leaf) *leaf;
+    int16_t pos;};
+
+/* the path from the root to a leaf, kept per call */
+struct B_PLUS_TYPE(path) {
+    int8_t top;
+    struct B_PLUS_TYPE(internal) *node_stack[B_PLUS_MAX_HEIGHT];
+    int16_t pos_stack[B_PLUS_MAX_HEIGHT];};
+
+#define B_PLUS_LEAF(node) ((struct B_PLUS_TYPE(leaf) *)(node))
+#define B_PLUS_INTERNAL(node) ((struct B_PLUS_TYPE(internal) *)(node))
+
+/* the first pos whose key is not less than unkown_key */
+static inline int16_t B_PLUS_FUNC(look_up_a_key_pos_in_a_node_of)(const struct B_PLUS_TYPE(node) *node,
+B_PLUS_KEY_TYPE unkown_key)
+{
+    int16_t left = 0, right = node->last_index + 1;
+    while (left < right)
+    {
+        int16_t middle = (left + right) >> 1;
+        if (B_PLUS_KEY_LESS(node->key[middle], unkown_key))
+            left = middle + 1;
+        else right = middle;
+    }
+    return left;
+}
+
+/* the last child whose lower bound is not greater than unkown_key, or 0 */
+static inline int16_t B_PLUS_FUNC(look_up_a_child_pos_in_a_node_of)(const struct B_PLUS_TYPE(node) *node,
+B_PLUS_KEY_TYPE unkown_key)
+{
+    int16_t left = 1, right = node->last_index + 1;
+    while (left < right)
+    {
+        int16_t middle = (left + right) >> 1;
+        if (B_PLUS_KEY_LESS(unkown_key, node->key[middle]))
+            right = middle;
+        else left = middle + 1;
+    }
+    return left - 1;
+}
+
+static struct B_PLUS_TYPE(node) *B_PLUS_FUNC(alloc_a_new_node_of)(_Bool isleaf)
+{
+    size_t size = isleaf ? sizeof(struct B_PLUS_TYPE(leaf)) : sizeof(struct B_PLUS_TYPE(internal));
+    struct B_PLUS_TYPE(node) *new_node = (struct B_PLUS_TYPE(node) *)calloc(1, size);
+    if (new_node == NULL)
+        perror("fail to allocate a new B plus node"), exit(EXIT_FAILURE);
+    new_node->last_index = -1;
+    new_node->isleaf = isleaf;
+    return new_node;
+}
+
+int B_PLUS_FUNC(look_up_a_key_in)(struct B_PLUS_TYPE(node) *const *tree, B_PLUS_KEY_TYPE unkown_key,
+B_PLUS_VALUE_TYPE *value)
+{
+    const struct B_PLUS_TYPE(node) *cur = *tree;
+    if (cur == NULL) return -1;
+    while (!cur->isleaf)
+        cur = B_PLUS_INTERNAL(cur)->child[B_PLUS_FUNC(look_up_a_child_pos_in_a_node_of)(cur, unkown_key)];
+    int16_t pos = B_PLUS_FUNC(look_up_a_key_pos_in_a_node_of)(cur, unkown_key);
+    if (pos > cur->last_index || !B_PLUS_KEY_EQUAL(cur->key[pos], unkown_key))
+        return -1;
+    if (value) *value = B_PLUS_LEAF(cur)->value[pos];
+    return 0;
+}
+
+/* shift the entries from pos on one slot to the right, and put the new entry at pos */
+static void B_PLUS_FUNC(insert_an_entry_in_a_node_of)(struct B_PLUS_TYPE(node) *node, int16_t pos,
+B_PLUS_KEY_TYPE new_key, const B_PLUS_VALUE_TYPE *new_value, struct B_PLUS_TYPE(node) *new_child)
+{
+    int16_t moved = node->last_index - pos + 1;
+    memmove(&node->key[pos + 1], &node->key[pos], moved * sizeof(B_PLUS_KEY_TYPE));
+    node->key[pos] = new_key;
+    if (node->isleaf)
+    {
+        memmove(&B_PLUS_LEAF(node)->value[pos + 1], &B_PLUS_LEAF(node)->value[pos],
+        moved * sizeof(B_PLUS_VALUE_TYPE));
+        B_PLUS_LEAF(node)->value[pos] = *new_value;
+    }
+    else
+    {
+        memmove(&B_PLUS_INTERNAL(node)->child[pos + 1], &B_PLUS_INTERNAL(node)->child[pos],
+        moved * sizeof(struct B_PLUS_TYPE(node) *));
+        B_PLUS_INTERNAL(node)->child[pos] = new_child;
+    }
+    node->last_index++;
+    return;
+}
+
+static void B_PLUS_FUNC(delete_an_entry_in_a_node_of)(struct B_PLUS_TYPE(node) *node, int16_t pos)
+{
+    int16_t moved = node->last_index - pos;
+    memmove(&node->key[pos], &node->key[pos + 1], moved * sizeof(B_PLUS_KEY_TYPE));
+    if (node->isleaf)
+        memmove(&B_PLUS_LEAF(node)->value[pos], &B_PLUS_LEAF(node)->value[pos + 1],
+        moved * sizeof(B_PLUS_VALUE_TYPE));
+    else memmove(&B_PLUS_INTERNAL(node)->child[pos], &B_PLUS_INTERNAL(node)->child[pos + 1],
+        moved * sizeof(struct B_PLUS_TYPE(node) *));
+    node->last_index--;
+    return;
+}
+
+/* move the entries [from, last_index] of src to the end of dst */
+static void B_PLUS_FUNC(move_entries_between_nodes_of)(struct B_PLUS_TYPE(node) *dst,
+struct B_PLUS_TYPE(node) *src, int16_t from)
+{
+    int16_t moved = src->last_index - from + 1;
+    memcpy(&dst->key[dst->last_index + 1], &src->key[from], moved * sizeof(B_PLUS_KEY_TYPE));
+    if (src->isleaf)
+        memcpy(&B_PLUS_LEAF(dst)->value[dst->last_index + 1], &B_PLUS_LEAF(src)->value[from],
+        moved * sizeof(B_PLUS_VALUE_TYPE));
+    else memcpy(&B_PLUS_INTERNAL(dst)->child[dst->last_index + 1], &B_PLUS_INTERNAL(src)->child[from],
+        moved * sizeof(struct B_PLUS_TYPE(node) *));
+    dst->last_index += moved;
+    src->last_index = from - 1;
+    return;
+}
+
+/* return -1 if new_key already exists. */
+int B_PLUS_FUNC(insert_a_key_in)(struct B_PLUS_TYPE(node) **tree, B_PLUS_KEY_TYPE new_key,
+B_PLUS_VALUE_TYPE new_value)
+{
+    if (*tree == NULL)
+    {
+        *tree = B_PLUS_FUNC(alloc_a_new_node_of)(1);
+        B_PLUS_FUNC(insert_an_entry_in_a_node_of)(*tree, 0, new_key, &new_value, NULL);
+        return 0;
+    }
+    struct B_PLUS_TYPE(path) path;
+    path.top = -1;
+    struct B_PLUS_TYPE(node) *cur = *tree;
+    while (!cur->isleaf)
+    {
+        int16_t pos = B_PLUS_FUNC(look_up_a_child_pos_in_a_node_of)(cur, new_key);
+        /* a new minimum lowers the bounds along the leftmost path */
+        if (pos == 0 && B_PLUS_KEY_LESS(new_key, cur->key[0]))
+            cur->key[0] = new_key;
+        path.node_stack[++path.top] = B_PLUS_INTERNAL(cur);
+        path.pos_stack[path.top] = pos;
+        cur = B_PLUS_INTERNAL(cur)->child[pos];
+    }
+    int16_t pos = B_PLUS_FUNC(look_up_a_key_pos_in_a_node_of)(cur, new_key);
+    if (pos <= cur->last_index && B_PLUS_KEY_EQUAL(cur->key[pos], new_key))
+        return -1;
+    B_PLUS_KEY_TYPE key_to_insert = new_key;
+    struct B_PLUS_TYPE(node) *child_to_insert = NULL;
+    while (1)
+    {
+        if (cur->last_index < B_PLUS_MAX_KEY_NUMBER - 1)
+        {
+            B_PLUS_FUNC(insert_an_entry_in_a_node_of)(cur, pos, key_to_insert, &new_value, child_to_insert);
+            return 0;
+        }
+        /* split a full node into halves, then insert into the proper half */
+        struct B_PLUS_TYPE(node) *right = B_PLUS_FUNC(alloc_a_new_node_of)(cur->isleaf);
+        B_PLUS_FUNC(move_entries_between_nodes_of)(right, cur, B_PLUS_MIN_KEY_NUMBER);
+        if (cur->isleaf)
+        {
+            B_PLUS_LEAF(right)->sibling = B_PLUS_LEAF(cur)->sibling;
+            B_PLUS_LEAF(cur)->sibling = B_PLUS_LEAF(right);
+        }
+        if (pos < B_PLUS_MIN_KEY_NUMBER)
+            B_PLUS_FUNC(insert_an_entry_in_a_node_of)(cur, pos, key_to_insert, &new_value, child_to_insert);
+        else B_PLUS_FUNC(insert_an_entry_in_a_node_of)(right, pos - B_PLUS_MIN_KEY_NUMBER,
+            key_to_insert, &new_value, child_to_insert);
+        key_to_insert = right->key[0];
+        child_to_insert = right;
+        if (path.top < 0)
+        {
+            struct B_PLUS_TYPE(node) *new_root = B_PLUS_FUNC(alloc_a_new_node_of)(0);
+            B_PLUS_FUNC(insert_an_entry_in_a_node_of)(new_root, 0, cur->key[0], NULL, cur);
+            B_PLUS_FUNC(insert_an_entry_in_a_node_of)(new_root, 1, key_to_insert, NULL, right);
+            *tree = new_root;
+            return 0;
+        }
+        cur = &path.node_stack[path.top]->head;
+        pos = path.pos_stack[path.top--] + 1;
+    }
+}
+
+/* return -1 if key_to_be_del doesn't exist. An underflowing node borrows
+from a sibling under the same parent, or is merged with it. */
+int B_PLUS_FUNC(delete_a_key_in)(struct B_PLUS_TYPE(node) **tree, B_PLUS_KEY_TYPE key_to_be_del)
+{
+    if (*tree == NULL) return -1;
+    struct B_PLUS_TYPE(path) path;
+    path.top = -1;
+    struct B_PLUS_TYPE(node) *cur = *tree;
+    while (!cur->isleaf)
+    {
+        int16_t pos = B_PLUS_FUNC(look_up_a_child_pos_in_a_node_of)(cur, key_to_be_del);
+        path.node_stack[++path.top] = B_PLUS_INTERNAL(cur);
+        path.pos_stack[path.top] = pos;
+        cur = B_PLUS_INTERNAL(cur)->child[pos];
+    }
+    int16_t del_pos = B_PLUS_FUNC(look_up_a_key_pos_in_a_node_of)(cur, key_to_be_del);
+    if (del_pos > cur->last_index || !B_PLUS_KEY_EQUAL(cur->key[del_pos], key_to_be_del))
+        return -1;
+    B_PLUS_FUNC(delete_an_entry_in_a_node_of)(cur, del_pos);
+    while (path.top >= 0 && cur->last_index < B_PLUS_MIN_KEY_NUMBER - 1)
+    {
+        struct B_PLUS_TYPE(internal) *parent = path.node_stack[path.top];
+        int16_t pos = path.pos_stack[path.top--];
+        struct B_PLUS_TYPE(node) *left, *right;
+        if (pos > 0)
+            left = parent->child[pos - 1], right = cur;
+        else left = cur, right = parent->child[++pos];
+        /* pos is now the slot of right in parent. Borrow one entry if the
+        sibling can spare it. */
+        if (left->last_index + right->last_index + 2 > (B_PLUS_MIN_KEY_NUMBER << 1) - 1)
+        {
+            if (cur == right)
+            {
+                B_PLUS_FUNC(insert_an_entry_in_a_node_of)(right, 0, left->key[left->last_index],
+                left->isleaf ? &B_PLUS_LEAF(left)->value[left->last_index] : NULL,
+                left->isleaf ? NULL : B_PLUS_INTERNAL(left)->child[left->last_index]);
+                left->last_index--;
+            }
+            else
+            {
+                B_PLUS_FUNC(insert_an_entry_in_a_node_of)(left, left->last_index + 1, right->key[0],
+                right->isleaf ? &B_PLUS_LEAF(right)->value[0] : NULL,
+                right->isleaf ? NULL : B_PLUS_INTERNAL(right)->child[0]);
+                B_PLUS_FUNC(delete_an_entry_in_a_node_of)(right, 0);
+            }
+            parent->head.key[pos] = right->key[0];
+            return 0;
+        }
+        /* merge right into left and drop right from parent */
+        B_PLUS_FUNC(move_entries_between_nodes_of)(left, right, 0);
+        if (left->isleaf)
+            B_PLUS_LEAF(left)->sibling = B_PLUS_LEAF(right)->sibling;
+        free(right);
+        B_PLUS_FUNC(delete_an_entry_in_a_node_of)(&parent->head, pos);
+        cur = &parent->head;
+    }
+    if (cur == *tree)
+    {
+        if (cur->last_index < 0)
+            free(cur), *tree = NULL;
+        else if (!cur->isleaf && cur->last_index == 0)
+            *tree = B_PLUS_INTERNAL(cur)->child[0], free(cur);
+    }
+    return 0;
+}
+
+/* place iter at the first key not less than lower_key, return -1 if there is none */
+int B_PLUS_FUNC(lower_bound_in)(struct B_PLUS_TYPE(node) *const *tree, B_PLUS_KEY_TYPE lower_key,
+struct B_PLUS_TYPE(iterator) *iter)
+{
+    const struct B_PLUS_TYPE(node) *cur = *tree;
+    iter->leaf = NULL, iter->pos = 0;
+    if (cur == NULL) return -1;
+    while (!cur->isleaf)
+        cur = B_PLUS_INTERNAL(cur)->child[B_PLUS_FUNC(look_up_a_child_pos_in_a_node_of)(cur, lower_key)];
+    iter->leaf = B_PLUS_LEAF(cur);
+    iter->pos = B_PLUS_FUNC(look_up_a_key_pos_in_a_node_of)(cur, lower_key);
+    while (iter->leaf && iter->pos > iter->leaf->head.last_index)
+        iter->leaf = iter->leaf->sibling, iter->pos = 0;
+    return iter->leaf ? 0 : -1;
+}
+
+/* copy out the key and value under iter and step forward, return -1 at the end */
+int B_PLUS_FUNC(next_key_in)(struct B_PLUS_TYPE(iterator) *iter, B_PLUS_KEY_TYPE *key,
+B_PLUS_VALUE_TYPE *value)
+{
+    if (iter->leaf == NULL) return -1;
+    if (key) *key = iter->leaf->head.key[iter->pos];
+    if (value) *value = iter->leaf->value[iter->pos];
+    if (++iter->pos > iter->leaf->head.last_index)
+    {
+        iter->leaf = iter->leaf->sibling, iter->pos = 0;
+        if (iter->leaf) __builtin_prefetch(iter->leaf->head.key, 0, 1);
+    }
+    return 0;
+}
+
+void B_PLUS_FUNC(delete_all_nodes_in)(struct B_PLUS_TYPE(node) *node)
+{
+    if (node == NULL) return;
+    if (!node->isleaf)
+        for (int16_t i = 0; i <= node->last_index; i++)
+            B_PLUS_FUNC(delete_all_nodes_in)(B_PLUS_INTERNAL(node)->child[i]);
+    free(node);
+    return;
+}
+
+#undef B_PLUS_LEAF
+#undef B_PLUS_INTERNAL
+#undef B_PLUS_TYPE
+#undef B_PLUS_FUNC
+#undef B_PLUS_MIN_KEY_NUMBER
+#undef B_PLUS_KEY_EQUAL
+#undef B_PLUS_MAX_KEY_NUMBER
+#undef B_PLUS_KEY_LESS
+#undef B_PLUS_VALUE_TYPE
+#undef B_PLUS_KEY_TYPE
+#undef B_PLUS_TREE_NAME
@@ -4,50 +4,66 @@
 #include <stdint.h>
 #include <fcntl.h>
 #include <string.h>
+#include <stddef.h>
 #include <unistd.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include "node_pool.c"
 /* MAX_DEGREE is the maximum number of children */
 #define MAX_DEGREE 128
+#define CACHE_LINE_SIZE 64
+/* a B node is one 64-byte-aligned block: the header and the keys come first
+so that binary search stays in the leading cache lines, then the children
+it follows, and the file descriptors which are only touched at the end.
+latch is only taken by the struct B_tree functions. */
 struct B_node {
-    int32_t *key;
-    int *fd;
-    struct B_node **child;
     int16_t last_index;
-    _Bool isleaf;};
+    _Bool isleaf;
+    /* whether the node came from a struct node_pool rather than the C heap */
+    _Bool pooled;
+    int32_t key[MAX_DEGREE];
+    struct B_node *child[MAX_DEGREE + 1];
+    int fd[MAX_DEGREE];
+    pthread_rwlock_t latch;} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+/* the descent path of one call: the ancestors of the current node and the
+position of the child taken in each of them. Every call keeps its own path,
+so calls on different trees, or on one struct B_tree, do not share state. */
+struct B_path {
+    int8_t top_in_node_stack;
+    int8_t top_in_pos_stack;
+    struct B_node *node_stack[INT8_MAX];
+    int16_t pos_stack[INT8_MAX];};
 
-static _Atomic(int8_t) top_in_node_stack = -1;
-static struct B_node* volatile node_stack[INT8_MAX];
 /* pop up out of node_stack */
-static struct B_node* popup_node(void)
+static struct B_node* popup_node(struct B_path *path)
 {
-    if (top_in_node_stack == -1)
+    if (path->top_in_node_stack == -1)
         perror("pop up on the empty node_stack, abort:"), exit(-1);
-    return node_stack[top_in_node_stack--];
+    return path->node_stack[path->top_in_node_stack--];
 }
 /* push struct B_node into node_stack */
-static void push_node(struct B_node *node)
+static void push_node(struct B_path *path, struct B_node *node)
 {
-    if (top_in_node_stack == INT8_MAX)
+    if (path->top_in_node_stack == INT8_MAX - 1)
         perror("node_stack overflow:"), exit(-1);
-    node_stack[++top_in_node_stack] = node;
+    path->node_stack[++path->top_in_node_stack] = node;
     return;
 }
 
-static _Atomic(int8_t) top_in_pos_stack = -1;
-static int16_t volatile pos_stack[INT8_MAX];
 /* pop up out of pos_stack */
-static int16_t popup_pos(void)
+static int16_t popup_pos(struct B_path *path)
 {
-    if (top_in_pos_stack == -1)
+    if (path->top_in_pos_stack == -1)
         perror("pop up on the empty node_stack, abort:"), exit(-1);
-    return pos_stack[top_in_pos_stack--];
+    return path->pos_stack[path->top_in_pos_stack--];
 }
 /* push position number into pos_stack */
-static void push_pos(int16_t pos)
+static void push_pos(struct B_path *path, int16_t pos)
 {
-    if (top_in_pos_stack == INT8_MAX)
+    if (path->top_in_pos_stack == INT8_MAX - 1)
         perror("pos_stack overflow:"), exit(-1);
-    pos_stack[++top_in_pos_stack] = pos;
+    path->pos_stack[++path->top_in_pos_stack] = pos;
     return;
 }
 
@@ -75,33 +91,95 @@ static int get_string(char **ptr_to_ptr)
     else return -1;
 }
 
-void inorder_trav_to_B_tree(struct B_node *node)
+/* the order in which a traversal hands out keys: preorder gives the keys
+of a node before its subtrees and postorder after them, node by node */
+enum B_trav_order {B_preorder, B_inorder, B_postorder};
+/* the keys one trav_to_B_tree() call hands to its visitor at a time */
+#define B_TRAV_BATCH 256
+
+/* a traversal which can stop after any key and go on later. Every node on
+the path keeps a step counter: with k keys a node takes 2k + 1 steps, one
+per key and one per child, in the order of the traversal. */
+struct B_trav_iterator {
+    enum B_trav_order order;
+    int8_t top;
+    struct B_node *node_stack[INT8_MAX];
+    int16_t step_stack[INT8_MAX];};
+
+void start_a_trav_to_B_tree(struct B_node **const B_tree, enum B_trav_order order, struct B_trav_iterator *iter)
 {
-    if (node == NULL) return;
-    int16_t i;
-    for (i = 0; i <= node->last_index; i++)
-    {
-        inorder_trav_to_B_tree(node->child[i]);
-        printf("%" PRId32"\040", node->key[i]);
-    }
-    inorder_trav_to_B_tree(node->child[i]);
+    iter->order = order;
+    iter->top = -1;
+    if (*B_tree)
+        iter->node_stack[++iter->top] = *B_tree, iter->step_stack[iter->top] = 0;
     return;
 }
 
-void preorder_trav_to_B_tree(struct B_node *node)
+/* copy the next keys of the traversal, at most batch_size of them, into
+key_buf and their file descriptors into fd_buf if it is not NULL.
+Return the number of copied keys, which is 0 at the end. */
+int32_t next_batch_in_trav_to_B_tree(struct B_trav_iterator *iter, int32_t *key_buf, int *fd_buf, int32_t batch_size)
 {
-    if (node == NULL) return;
-    int16_t i;
-    for (i = 0; i <= node->last_index; i++)
+    int32_t copied = 0;
+    while (copied < batch_size && iter->top != -1)
     {
-        printf("%" PRId32"\040", node->key[i]);
-        preorder_trav_to_B_tree(node->child[i]);
+        struct B_node *node = iter->node_stack[iter->top];
+        int16_t step = iter->step_stack[iter->top]++, key_number = node->last_index + 1;
+        if (step == 2 * key_number + 1)
+        {
+            iter->top--;
+            continue;
+        }
+        int16_t key_pos = -1, child_pos = -1;
+        if (iter->order == B_preorder)
+        {
+            if (step < key_number) key_pos = step;
+            else child_pos = step - key_number;
+        }
+        else if (iter->order == B_inorder)
+        {
+            if (step & 1) key_pos = step >> 1;
+            else child_pos = step >> 1;
+        }
+        else
+        {
+            if (step <= key_number) child_pos = step;
+            else key_pos = step - key_number - 1;
+        }
+        if (key_pos != -1)
+        {
+            key_buf[copied] = node->key[key_pos];
+            if (fd_buf) fd_buf[copied] = node->fd[key_pos];
+            copied++;
+        }
+        else if (!node->isleaf && node->child[child_pos])
+        {
+            if (iter->top == INT8_MAX - 1)
+                perror("the traversal stack overflows"), exit(EXIT_FAILURE);
+            iter->node_stack[++iter->top] = node->child[child_pos];
+            iter->step_stack[iter->top] = 0;
+        }
     }
-    preorder_trav_to_B_tree(node->child[i]);
-    return;
+    return copied;
 }
 
-static int16_t look_up_a_key_pos_in_a_B_node(struct B_node *const node, int32_t unkown_key)
+/* hand every key of the B tree and its file descriptor in order to visitor,
+B_TRAV_BATCH keys at a time. A visitor which returns non-zero stops the
+traversal, and that value is returned; otherwise return 0. */
+int trav_to_B_tree(struct B_node **const B_tree, enum B_trav_order order,
+int (*visitor)(const int32_t *key, const int *fd, int32_t key_number, void *arg), void *arg)
+{
+    struct B_trav_iterator iter;
+    int32_t key_buf[B_TRAV_BATCH], copied;
+    int fd_buf[B_TRAV_BATCH];
+    int state = 0;
+    start_a_trav_to_B_tree(B_tree, order, &iter);
+    while (state == 0 && (copied = next_batch_in_trav_to_B_tree(&iter, key_buf, fd_buf, B_TRAV_BATCH)) > 0)
+        state = visitor(key_buf, fd_buf, copied, arg);
+    return state;
+}
+
+static int16_t look_up_a_key_pos_in_a_B_node_via_binary_search(struct B_node *const node, int32_t unkown_key)
 /* use binary search method to position */
 {
     int16_t left = 0, right = node->last_index;
@@ -114,21 +192,80 @@ static int16_t look_up_a_key_pos_in_a_B_node(struct B_node *const node, int32_t
             right = middle - 1;
         else left = middle + 1;
     }
-    return node->key[left - 1] < unkown_key ? left : left - 1;
+    /* all keys before left are smaller than unkown_key */
+    return left;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+/* count the keys smaller than unkown_key, 8 keys per compare and movemask.
+Keys are sorted, so the count is the position of unkown_key or of its insertion. */
+__attribute__((target("avx2")))
+static int16_t look_up_a_key_pos_in_a_B_node_via_avx2(struct B_node *const node, int32_t unkown_key)
+{
+    const __m256i broadcast_key = _mm256_set1_epi32(unkown_key);
+    int16_t key_number = node->last_index + 1, pos = 0;
+    for (int16_t i = 0; i < key_number; i += 8)
+    {
+        __m256i keys = _mm256_loadu_si256((const __m256i *)&node->key[i]);
+        uint32_t mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(broadcast_key, keys)));
+        if (key_number - i < 8)
+            mask &= (1u << (key_number - i)) - 1;
+        pos += __builtin_popcount(mask);
+        if (mask != 0xFF) break;
+    }
+    return pos;
+}
+
+/* the same count as the AVX2 path, 4 keys per compare and movemask. */
+__attribute__((target("sse4.2,popcnt")))
+static int16_t look_up_a_key_pos_in_a_B_node_via_sse42(struct B_node *const node, int32_t unkown_key)
+{
+    const __m128i broadcast_key = _mm_set1_epi32(unkown_key);
+    int16_t key_number = node->last_index + 1, pos = 0;
+    for (int16_t i = 0; i < key_number; i += 4)
+    {
+        __m128i keys = _mm_loadu_si128((const __m128i *)&node->key[i]);
+        uint32_t mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(broadcast_key, keys)));
+        if (key_number - i < 4)
+            mask &= (1u << (key_number - i)) - 1;
+        pos += __builtin_popcount(mask);
+        if (mask != 0xF) break;
+    }
+    return pos;
+}
+#endif
+
+/* every call goes through this pointer. It is bound to the best search path
+of the running CPU by a constructor, before main and any thread start, so
+it is only ever read afterwards. */
+static int16_t (*look_up_a_key_pos_in_a_B_node)(struct B_node *const node, int32_t unkown_key)
+= look_up_a_key_pos_in_a_B_node_via_binary_search;
+
+__attribute__((constructor))
+static void resolve_look_up_a_key_pos_in_a_B_node(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        look_up_a_key_pos_in_a_B_node = look_up_a_key_pos_in_a_B_node_via_avx2;
+    else if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt"))
+        look_up_a_key_pos_in_a_B_node = look_up_a_key_pos_in_a_B_node_via_sse42;
+#endif
+    return;
 }
 
 int16_t look_up_a_key_in_B_tree(struct B_node **const B_tree, int32_t unkown_key)
 {
+    /* a look-up never walks back up, so it keeps no descent path */
     struct B_node *cur = *B_tree;
     int16_t pos = 0;
     while (cur)
     {
         pos = look_up_a_key_pos_in_a_B_node(cur, unkown_key);
-        if (cur->key[pos] != unkown_key)
+        if (pos > cur->last_index || cur->key[pos] != unkown_key)
         {
-            push_node(cur);
             cur = cur->child[pos];
-            push_pos(pos);
             pos = 0;
         }
         else break;
@@ -136,20 +273,80 @@ int16_t look_up_a_key_in_B_tree(struct B_node **const B_tree, int32_t unkown_key
     if (!cur)
     {
         fprintf(stderr, "no key value in B tree!\n");
-        top_in_node_stack = -1;
-        top_in_pos_stack = -1;
         return -1;
     }
-    top_in_node_stack = -1;
-    top_in_pos_stack = -1;
     /* return the position of key. */
     return pos;
 }
 
+/* the number of keys walked down the tree together by look_up_keys_in_B_tree() */
+#define B_TREE_LOOKUP_GROUP 16
+
+/* fetch the header and the keys of a node, which the in-node search reads */
+static inline void prefetch_a_B_node(const struct B_node *node)
+{
+    for (size_t offset = 0; offset < offsetof(struct B_node, child); offset += CACHE_LINE_SIZE)
+        __builtin_prefetch((const char *)node + offset, 0, 3);
+    return;
+}
+
+/* look up key_number keys at once. The keys are walked down in groups of
+B_TREE_LOOKUP_GROUP, one level per round: every key prefetches its next node
+and the other keys of its group are searched before it is visited again, so
+the cache misses of different keys overlap instead of following each other.
+found_node[i] and found_pos[i] locate unkown_key[i], or are NULL and -1.
+Return the number of keys found. Unlike look_up_a_key_in_B_tree(), a miss
+prints nothing. */
+int32_t look_up_keys_in_B_tree(struct B_node **const B_tree, const int32_t *unkown_key, int32_t key_number,
+struct B_node **found_node, int16_t *found_pos)
+{
+    int32_t found_number = 0;
+    for (int32_t base = 0; base < key_number; base += B_TREE_LOOKUP_GROUP)
+    {
+        int32_t group_len = key_number - base < B_TREE_LOOKUP_GROUP ? key_number - base : B_TREE_LOOKUP_GROUP;
+        struct B_node *cur[B_TREE_LOOKUP_GROUP];
+        for (int32_t i = 0; i < group_len; i++)
+        {
+            cur[i] = *B_tree;
+            found_node[base + i] = NULL;
+            found_pos[base + i] = -1;
+        }
+        int32_t active_number = *B_tree ? group_len : 0;
+        while (active_number)
+        {
+            active_number = 0;
+            for (int32_t i = 0; i < group_len; i++)
+            {
+                struct B_node *node = cur[i];
+                if (node == NULL) continue;
+                int32_t key = unkown_key[base + i];
+                int16_t pos = look_up_a_key_pos_in_a_B_node(node, key);
+                if (pos <= node->last_index && node->key[pos] == key)
+                {
+                    found_node[base + i] = node;
+                    found_pos[base + i] = pos;
+                    found_number++;
+                    cur[i] = NULL;
+                    continue;
+                }
+                cur[i] = node->child[pos];
+                if (cur[i])
+                {
+                    prefetch_a_B_node(cur[i]);
+                    active_number++;
+                }
+            }
+        }
+    }
+    return found_number;
+}
+
 int16_t insert_a_key_in_a_B_node(struct B_node *node, int32_t new_key)
 {
-    int16_t insert_pos = look_up_a_key_pos_in_a_B_node(node, new_key);
-    if (node->key[insert_pos] == new_key)
+    /* an increasing key goes behind the last one without a search */
+    int16_t insert_pos = (node->last_index >= 0 && node->key[node->last_index] < new_key)
+    ? node->last_index + 1 : look_up_a_key_pos_in_a_B_node(node, new_key);
+    if (insert_pos <= node->last_index && node->key[insert_pos] == new_key)
         return -1;
     for (int16_t i = node->last_index + 1; i > insert_pos; i--)
     {
@@ -159,22 +356,40 @@ int16_t insert_a_key_in_a_B_node(struct B_node *node, int32_t new_key)
     }
     node->last_index++;
     node->key[insert_pos] = new_key;
+    node->fd[insert_pos] = -1;
     return insert_pos;
 }
 
-struct B_node *alloc_a_new_B_node(void)
+/* a node comes from pool, or from the C heap if pool is NULL */
+struct B_node *alloc_a_new_B_node(struct node_pool *pool)
 {
-    struct B_node *node = (struct B_node *)malloc(sizeof(struct B_node));
-    *node = (struct B_node){0};
-    node->key = (int32_t *)malloc(MAX_DEGREE * sizeof(int32_t));
-    memset(node->key, -1, MAX_DEGREE * sizeof(int32_t));
-    node->child = (struct B_node **)malloc((MAX_DEGREE + 1) * sizeof(struct B_node *));
-    memset(node->child, 0, (MAX_DEGREE + 1) * sizeof(struct B_node *));
-    node->fd = (int *)malloc(MAX_DEGREE * sizeof(int));
-    memset(node->fd, -1, MAX_DEGREE * sizeof(int));
+    /* one allocation per node instead of the struct plus three arrays */
+    struct B_node *node = pool ? (struct B_node *)alloc_a_node_from_pool(pool)
+    : (struct B_node *)aligned_alloc(CACHE_LINE_SIZE, sizeof(struct B_node));
+    if (node == NULL)
+        perror("fail to allocate a B node"), exit(EXIT_FAILURE);
+    node->last_index = 0;
+    node->isleaf = 0;
+    node->pooled = (pool != NULL);
+    memset(node->key, -1, sizeof(node->key));
+    memset(node->child, 0, sizeof(node->child));
+    memset(node->fd, -1, sizeof(node->fd));
+    pthread_rwlock_init(&node->latch, NULL);
     return node;
 }
 
+/* start a tree whose nodes come from pool, made by init_node_pool(sizeof(struct
+B_node), CACHE_LINE_SIZE), or from the C heap if pool is NULL.
+destroy_node_pool() then frees the whole tree at once and skips the per-node
+latch teardown, which is a no-op for glibc rwlocks. */
+struct B_node *init_a_B_root(int32_t root_key, struct node_pool *pool)
+{
+    struct B_node *root = alloc_a_new_B_node(pool);
+    root->key[0] = root_key;
+    root->isleaf = 1;
+    return root;
+}
+
 int write_a_file_in_a_B_node(struct B_node *node, int16_t pos)
 {
     char *file_path;
@@ -209,86 +424,174 @@ int close_a_file_in_a_B_node(struct B_node *node, int16_t pos)
     return 0;
 }
 
-int insert_a_key_in_B_tree(struct B_node **B_tree, int32_t new_key)
+/* split up the ancestor nodes whose elements is over 128,
+from cur through the ancestors kept in path, into new nodes from pool. */
+static void split_full_B_nodes_upward(struct B_node **B_tree, struct B_node *cur, struct B_path *path,
+struct node_pool *pool)
 {
-    /* if the B_tree is NULL */
-    if (*B_tree == NULL)
-    {
-        struct B_node *root = alloc_a_new_B_node();
-        root->key[0] = new_key;
-        root->isleaf = 1;
-        return 0;
-    }
-    /*look up for the position of insertion. */
-    struct B_node *cur = *B_tree;
-    while ( !cur->isleaf )
-    {
-        int16_t pos = look_up_a_key_pos_in_a_B_node(cur, new_key);
-        if (cur->key[pos] != new_key)
-        {
-            push_node(cur);
-            cur = cur->child[pos];
-            pos = 0;
-        }
-        else
-        {
-            fprintf(stderr, "insert failed. This B tree has already a key value %" PRId32".\n", new_key);
-            return -1;
-        }
-    }
-    /* insert the new_key. */
-    if (insert_a_key_in_a_B_node(cur, new_key) < 0)
-    {
-        fprintf(stderr, "insert failed. This B tree has already a key value %" PRId32".\n", new_key);
-        top_in_node_stack = -1; return -1;
-    }
-    /* split up the ancestor nodes whose elements is over 128. */
     while (cur->last_index == MAX_DEGREE - 1)
     {
         int16_t split_pos = (MAX_DEGREE - 1) >> 1;
-        struct B_node *new_node = alloc_a_new_B_node();
+        struct B_node *new_node = alloc_a_new_B_node(pool);
         new_node->last_index = MAX_DEGREE - 2 - split_pos;
         for (int16_t i = 0; i <= new_node->last_index; i++)
         {
             new_node->child[i] = cur->child[split_pos + 1 + i];
             new_node->key[i] = cur->key[split_pos + 1 + i];
-            new_node->fd[i] = cur->fd[split_pos + i];
+            new_node->fd[i] = cur->fd[split_pos + 1 + i];
             cur->child[split_pos + 1 + i] = NULL;
-            cur->fd[split_pos + i] = -1;
+            cur->fd[split_pos + 1 + i] = -1;
             cur->key[split_pos + 1 + i] = 0;
         }
-        new_node->child[new_node->last_index + 1] = cur->child[MAX_DEGREE - 1];
-        cur->child[MAX_DEGREE - 1] = NULL;
+        new_node->child[new_node->last_index + 1] = cur->child[MAX_DEGREE];
+        cur->child[MAX_DEGREE] = NULL;
         new_node->isleaf = cur->isleaf;
         cur->last_index = split_pos - 1;
-        if (top_in_node_stack == -1)
+        if (path->top_in_node_stack == -1)
         {
             /* create a new root after spliting the current root. */
-            struct B_node *new_root = alloc_a_new_B_node();
+            struct B_node *new_root = alloc_a_new_B_node(pool);
             new_root->key[0] = cur->key[split_pos];
+            new_root->fd[0] = cur->fd[split_pos];
             new_root->child[0] = cur;
             new_root->child[1] = new_node;
             *B_tree = new_root;
             cur->key[split_pos] = 0;
+            cur->fd[split_pos] = -1;
             cur = new_root;
         }
         else
         {
             /* insert middle key value in its ancestor node. */
-            int16_t insert_pos = insert_a_key_in_a_B_node(node_stack[top_in_node_stack], cur->key[split_pos]);
-            node_stack[top_in_node_stack]->child[insert_pos] = cur;
-            node_stack[top_in_node_stack]->child[insert_pos + 1] = new_node;
+            int16_t insert_pos = insert_a_key_in_a_B_node(path->node_stack[path->top_in_node_stack], cur->key[split_pos]);
+            path->node_stack[path->top_in_node_stack]->fd[insert_pos] = cur->fd[split_pos];
+            path->node_stack[path->top_in_node_stack]->child[insert_pos] = cur;
+            path->node_stack[path->top_in_node_stack]->child[insert_pos + 1] = new_node;
             cur->key[split_pos] = 0;
-            cur = popup_node();
+            cur->fd[split_pos] = -1;
+            cur = popup_node(path);
         }
     }
-    top_in_node_stack = -1;
+    return;
+}
+
+/* walk down from cur to the leaf for new_key, pushing every node above the
+leaf and the position of the child taken in it. Return the leaf, or NULL if
+an inner node on the way has new_key. */
+static struct B_node *descend_to_a_B_leaf_for_insert(struct B_node *cur, struct B_path *path, int32_t new_key)
+{
+    while ( !cur->isleaf )
+    {
+        /* an increasing key goes down the last child without a search */
+        int16_t pos = (cur->key[cur->last_index] < new_key) ? cur->last_index + 1
+        : look_up_a_key_pos_in_a_B_node(cur, new_key);
+        if (pos <= cur->last_index && cur->key[pos] == new_key)
+            return NULL;
+        push_node(path, cur);
+        push_pos(path, pos);
+        cur = cur->child[pos];
+    }
+    return cur;
+}
+
+/* the new nodes come from pool, which has to be the same for every insert in
+a tree, or from the C heap if pool is NULL. */
+int insert_a_key_in_B_tree(struct B_node **B_tree, int32_t new_key, struct node_pool *pool)
+{
+    struct B_path path_of_this_call, *path = &path_of_this_call;
+    path->top_in_node_stack = path->top_in_pos_stack = -1;
+    /* if the B_tree is NULL */
+    if (*B_tree == NULL)
+    {
+        *B_tree = init_a_B_root(new_key, pool);
+        return 0;
+    }
+    /*look up for the position of insertion. */
+    struct B_node *cur = descend_to_a_B_leaf_for_insert(*B_tree, path, new_key);
+    /* insert the new_key. */
+    if (cur == NULL || insert_a_key_in_a_B_node(cur, new_key) < 0)
+    {
+        fprintf(stderr, "insert failed. This B tree has already a key value %" PRId32".\n", new_key);
+        return -1;
+    }
+    split_full_B_nodes_upward(B_tree, cur, path, pool);
     printf("insert key value %" PRId32" successfully.\n", new_key);
     return 0;
 }
 
+/* the leaf of the last key inserted through it and the path down to that
+leaf, so that a nearby key needs not search from the root again. A split
+on the way, a deletion, or an insertion without it make the path stale;
+init_a_B_finger() starts it over. */
+struct B_finger {
+    struct B_node *root, *leaf;
+    struct B_path path;
+    /* the keys under node_stack[i] of path, or under leaf for i one above
+    the top, lie strictly between lower_bound[i] and upper_bound[i] */
+    int64_t lower_bound[INT8_MAX + 1], upper_bound[INT8_MAX + 1];};
+
+void init_a_B_finger(struct B_finger *finger)
+{
+    finger->root = finger->leaf = NULL;
+    finger->path.top_in_node_stack = finger->path.top_in_pos_stack = -1;
+    finger->lower_bound[0] = INT64_MIN, finger->upper_bound[0] = INT64_MAX;
+    return;
+}
+
+/* insert new_key starting from the leaf of finger. It climbs from the leaf
+only to the lowest node on the path whose bounds hold new_key and descends
+from there, so a run of increasing keys goes straight into the rightmost
+leaf, and a key d leaves away costs about log(d) levels. Unlike
+insert_a_key_in_B_tree(), it reports nothing on stdout. */
+int insert_a_key_in_B_tree_with_finger(struct B_node **B_tree, int32_t new_key, struct B_finger *finger,
+struct node_pool *pool)
+{
+    struct B_path *path = &finger->path;
+    if (*B_tree == NULL || finger->root != *B_tree || finger->leaf == NULL)
+    {
+        init_a_B_finger(finger);
+        if (*B_tree == NULL) return insert_a_key_in_B_tree(B_tree, new_key, pool);
+        finger->root = *B_tree;
+    }
+    int8_t level = path->top_in_node_stack + 1;
+    if (finger->leaf)
+        while (level > 0 && !(finger->lower_bound[level] < new_key && new_key < finger->upper_bound[level]))
+            level--;
+    /* the root holds every key */
+    struct B_node *cur = (level > path->top_in_node_stack) ? (finger->leaf ? finger->leaf : *B_tree)
+    : path->node_stack[level];
+    path->top_in_node_stack = path->top_in_pos_stack = level - 1;
+    cur = descend_to_a_B_leaf_for_insert(cur, path, new_key);
+    if (cur == NULL || insert_a_key_in_a_B_node(cur, new_key) < 0)
+    {
+        fprintf(stderr, "insert failed. This B tree has already a key value %" PRId32".\n", new_key);
+        init_a_B_finger(finger);
+        return -1;
+    }
+    if (cur->last_index == MAX_DEGREE - 1)
+    {
+        split_full_B_nodes_upward(B_tree, cur, path, pool);
+        init_a_B_finger(finger);
+    }
+    else
+    {
+        /* narrow the bounds down the levels just descended */
+        for (int8_t i = level; i <= path->top_in_node_stack; i++)
+        {
+            struct B_node *node = path->node_stack[i];
+            int16_t pos = path->pos_stack[i];
+            finger->lower_bound[i + 1] = (pos > 0) ? node->key[pos - 1] : finger->lower_bound[i];
+            finger->upper_bound[i + 1] = (pos <= node->last_index) ? node->key[pos] : finger->upper_bound[i];
+        }
+        finger->leaf = cur;
+    }
+    return 0;
+}
+
 _Bool file_is_occupied_in_a_B_node(struct B_node *node, int16_t pos)
 {
+    /* a key without a file can always be deleted */
+    if (node->fd[pos] < 0) return 0;
     if (fcntl(node->fd[pos], F_GETFL) != O_NONBLOCK)
     {
         fprintf(stderr, "The file with key %" PRId32" is occupied by some thread.\n", node->key[pos]);
@@ -300,11 +603,10 @@ _Bool file_is_occupied_in_a_B_node(struct B_node *node, int16_t pos)
 
 void free_a_node_in_B_tree(struct B_node *node)
 {
-    struct B_node *tmp = node;
-    free(tmp->key);
-    free(tmp->fd);
-    free(tmp->child);
-    free(tmp);
+    /* keys, children and file descriptors are freed with the node itself */
+    pthread_rwlock_destroy(&node->latch);
+    if (node->pooled) free_a_node_to_pool(node);
+    else free(node);
     return;
 }
 
@@ -312,6 +614,9 @@ static void borrow_a_key_from_left_sibling(struct B_node *node,
 struct B_node *parent, int16_t pos_in_parent, struct B_node *left_sibling)
 {
     insert_a_key_in_a_B_node(node, parent->key[pos_in_parent - 1]);
+    node->fd[0] = parent->fd[pos_in_parent - 1];
+    /* insert_a_key_in_a_B_node() leaves child[0] in place for the new key 0 */
+    node->child[1] = node->child[0];
     node->child[0] = left_sibling->child[left_sibling->last_index + 1];
     /* copy info from end of left_sibling into correct location in parent */
     parent->key[pos_in_parent - 1] = left_sibling->key[left_sibling->last_index];
@@ -326,6 +631,7 @@ static void borrow_a_key_from_right_sibling(struct B_node *node,
 struct B_node *parent, int16_t pos_in_parent, struct B_node *right_sibling)
 {
     insert_a_key_in_a_B_node(node, parent->key[pos_in_parent]);
+    node->fd[node->last_index] = parent->fd[pos_in_parent];
     node->child[node->last_index + 1] = right_sibling->child[0];
     /* copy info from first of right_sibling into correct location in parent */
     parent->key[pos_in_parent] = right_sibling->key[0];
@@ -336,9 +642,9 @@ struct B_node *parent, int16_t pos_in_parent, struct B_node *right_sibling)
         right_sibling->fd[i] = right_sibling->fd[i + 1];
         right_sibling->child[i] = right_sibling->child[i + 1];
     }
-    right_sibling->child[node->last_index + 1] = NULL;
-    right_sibling->key[node->last_index] = 0;
-    right_sibling->fd[node->last_index] = -1;
+    right_sibling->child[right_sibling->last_index + 1] = NULL;
+    right_sibling->key[right_sibling->last_index] = 0;
+    right_sibling->fd[right_sibling->last_index] = -1;
     right_sibling->last_index--;
 }
 
@@ -347,7 +653,7 @@ struct B_node *parent, int16_t left_pos_in_parent, struct B_node *right)
 {
     left->key[left->last_index + 1] = parent->key[left_pos_in_parent];
     left->fd[left->last_index + 1] = parent->fd[left_pos_in_parent];
-    for (int16_t i = 0; i <= left->last_index; i++)
+    for (int16_t i = 0; i <= right->last_index; i++)
     {
         left->key[left->last_index + 2 + i] = right->key[i];
         left->fd[left->last_index + 2 + i] = right->fd[i];
@@ -368,7 +674,7 @@ struct B_node *parent, int16_t left_pos_in_parent, struct B_node *right)
     return left;
 }
 
-int delete_a_key_in_B_leaf_and_merge(struct B_node *leaf, int16_t del_pos)
+int delete_a_key_in_B_leaf_and_merge(struct B_node *leaf, int16_t del_pos, struct B_path *path)
 {
     /* when the number of key in this leaf is 63. */
     if (leaf->last_index < (MAX_DEGREE - 2) >> 1)
@@ -379,31 +685,32 @@ int delete_a_key_in_B_leaf_and_merge(struct B_node *leaf, int16_t del_pos)
         {
             for (int16_t i = del_pos; i < leaf->last_index; i++)
                 leaf->key[i] = leaf->key[i + 1], leaf->fd[i] = leaf->fd[i + 1];
-            leaf->last_index--;
             leaf->key[leaf->last_index] = 0;
             leaf->fd[leaf->last_index] = -1;
+            leaf->last_index--;
         }
         struct B_node *cur = leaf;
-        while (top_in_node_stack != -1 && cur->last_index < (MAX_DEGREE - 2) >> 1)
+        /* a node split from a full one keeps 63 keys, so it underflows below 63. */
+        while (path->top_in_node_stack != -1 && cur->last_index < ((MAX_DEGREE - 2) >> 1) - 1)
         {
             struct B_node *left_sibling = NULL;
-            if (pos_stack[top_in_pos_stack])
-                left_sibling = node_stack[top_in_node_stack]->child[pos_stack[top_in_pos_stack] - 1];
+            if (path->pos_stack[path->top_in_pos_stack])
+                left_sibling = path->node_stack[path->top_in_node_stack]->child[path->pos_stack[path->top_in_pos_stack] - 1];
             struct B_node *right_sibling = NULL;
-            if (pos_stack[top_in_pos_stack] != node_stack[top_in_node_stack]->last_index + 1)
-                right_sibling = node_stack[top_in_node_stack]->child[pos_stack[top_in_pos_stack] + 1];
+            if (path->pos_stack[path->top_in_pos_stack] != path->node_stack[path->top_in_node_stack]->last_index + 1)
+                right_sibling = path->node_stack[path->top_in_node_stack]->child[path->pos_stack[path->top_in_pos_stack] + 1];
             /* when the number of key in left_sibling is greater than or equal to 64. */
             if (left_sibling && left_sibling->last_index >= (MAX_DEGREE - 2) >> 1)
             {
-                borrow_a_key_from_left_sibling(cur, node_stack[top_in_node_stack]
-                , pos_stack[top_in_pos_stack], left_sibling);
+                borrow_a_key_from_left_sibling(cur, path->node_stack[path->top_in_node_stack]
+                , path->pos_stack[path->top_in_pos_stack], left_sibling);
                 break;
             }
             /* when the number of key in right_sibling is greater than or equal to 64. */
             else if (right_sibling && right_sibling->last_index >= (MAX_DEGREE - 2) >> 1)
             {
-                borrow_a_key_from_right_sibling(cur, node_stack[top_in_node_stack]
-                , pos_stack[top_in_pos_stack], right_sibling);
+                borrow_a_key_from_right_sibling(cur, path->node_stack[path->top_in_node_stack]
+                , path->pos_stack[path->top_in_pos_stack], right_sibling);
                 break;
             }
             /* when the numbers of key in both left_sibling and right_sibling are 63. */
@@ -412,21 +719,21 @@ int delete_a_key_in_B_leaf_and_merge(struct B_node *leaf, int16_t del_pos)
                 if (left_sibling)
                 {
                     left_sibling = merge_left_parent_right_B_nodes(left_sibling,
-                    node_stack[top_in_node_stack], pos_stack[top_in_pos_stack] - 1, cur);
+                    path->node_stack[path->top_in_node_stack], path->pos_stack[path->top_in_pos_stack] - 1, cur);
                     free_a_node_in_B_tree(cur);
                     cur = left_sibling;
                     left_sibling = NULL;
                 }
                 else
                 {
-                    cur = merge_left_parent_right_B_nodes(cur, node_stack[top_in_node_stack],
-                    pos_stack[top_in_pos_stack], right_sibling);
+                    cur = merge_left_parent_right_B_nodes(cur, path->node_stack[path->top_in_node_stack],
+                    path->pos_stack[path->top_in_pos_stack], right_sibling);
                     free_a_node_in_B_tree(right_sibling);
                     right_sibling = NULL;
                 }
             }
-            cur = popup_node();
-            del_pos = popup_pos();
+            cur = popup_node(path);
+            del_pos = popup_pos(path);
         }
         return 0;
     }
@@ -437,25 +744,39 @@ int delete_a_key_in_B_leaf_and_merge(struct B_node *leaf, int16_t del_pos)
             return -1;
         for (int16_t i = del_pos; i < leaf->last_index; i++)
             leaf->key[i] = leaf->key[i + 1], leaf->fd[i] = leaf->fd[i + 1];
-        leaf->last_index--;
         leaf->key[leaf->last_index] = 0;
         leaf->fd[leaf->last_index] = -1;
+        leaf->last_index--;
         return 0;
     }
 }
 
+/* a merge below the root can take its last key, then its only child becomes the root */
+static void shrink_an_empty_B_root(struct B_node **B_tree)
+{
+    struct B_node *root = *B_tree;
+    if (root && root->last_index < 0 && !root->isleaf)
+    {
+        *B_tree = root->child[0];
+        free_a_node_in_B_tree(root);
+    }
+    return;
+}
+
 int delete_a_key_and_fill_from_left_subtree_in_B_tree(struct B_node **B_tree, int32_t key_to_be_del)
 {
+    struct B_path path_of_this_call, *path = &path_of_this_call;
+    path->top_in_node_stack = path->top_in_pos_stack = -1;
     struct B_node *cur = *B_tree;
     int16_t del_pos;
     while (cur)
     {
         del_pos = look_up_a_key_pos_in_a_B_node(cur, key_to_be_del);
-        if (cur->key[del_pos] != key_to_be_del)
+        if (del_pos > cur->last_index || cur->key[del_pos] != key_to_be_del)
         {
-            push_node(cur);
+            push_node(path, cur);
             cur = cur->child[del_pos];
-            push_pos(del_pos);
+            push_pos(path, del_pos);
             del_pos = 0;
         }
         else break;
@@ -463,8 +784,6 @@ int delete_a_key_and_fill_from_left_subtree_in_B_tree(struct B_node **B_tree, in
     if (!cur)
     {
         fprintf(stderr, "no key value in B tree!\n");
-        top_in_node_stack = -1;
-        top_in_pos_stack = -1;
         return -1;
     }
     #define B_TREE_HAS_ONLY_ONE_KEY_TO_DELETE !((cur != *B_tree) \
@@ -476,56 +795,55 @@ int delete_a_key_and_fill_from_left_subtree_in_B_tree(struct B_node **B_tree, in
     }
     else if (cur->isleaf)
     {
-        if (delete_a_key_in_B_leaf_and_merge(cur, del_pos))
+        if (delete_a_key_in_B_leaf_and_merge(cur, del_pos, path))
         {
             fprintf(stderr, "fail to delete key %" PRId32" owe to the file open!\n", cur->key[del_pos]);
-            top_in_node_stack = -1;
-            top_in_pos_stack = -1;
             return -1;
         }
     }
     else
     {
-        push_node(cur);
-        push_pos(del_pos);
+        push_node(path, cur);
+        push_pos(path, del_pos);
         struct B_node *max_in_left_subtree = cur->child[del_pos];
         while (!max_in_left_subtree->isleaf)
         {
-            push_node(max_in_left_subtree);
-            push_pos(max_in_left_subtree->last_index + 1);
+            push_node(path, max_in_left_subtree);
+            push_pos(path, max_in_left_subtree->last_index + 1);
             max_in_left_subtree = max_in_left_subtree->child[max_in_left_subtree->last_index + 1];
         }
-        int32_t tmp_key = max_in_left_subtree->key[max_in_left_subtree->last_index];
-        if (delete_a_key_in_B_leaf_and_merge(max_in_left_subtree,
-        max_in_left_subtree->last_index))
+        if (file_is_occupied_in_a_B_node(max_in_left_subtree, max_in_left_subtree->last_index))
         {
             fprintf(stderr, "fail to delete key %" PRId32".\n"
             "Because the file of max_key_in_left_subtree %" PRId32" is open!\n",
             key_to_be_del, max_in_left_subtree->key[max_in_left_subtree->last_index]);
-            top_in_node_stack = -1;
-            top_in_pos_stack = -1;
             return -1;
         }
-        cur->key[del_pos] = tmp_key;
+        /* fill the key in before rebalancing, which may move it into a child */
+        cur->key[del_pos] = max_in_left_subtree->key[max_in_left_subtree->last_index];
+        cur->fd[del_pos] = max_in_left_subtree->fd[max_in_left_subtree->last_index];
+        max_in_left_subtree->fd[max_in_left_subtree->last_index] = -1;
+        delete_a_key_in_B_leaf_and_merge(max_in_left_subtree, max_in_left_subtree->last_index, path);
     }
-    top_in_node_stack = -1;
-    top_in_pos_stack = -1;
+    shrink_an_empty_B_root(B_tree);
     printf("delete key value %" PRId32" successfully.\n", key_to_be_del);
     return 0;
 }
 
 int delete_a_key_and_fill_from_right_subtree_in_B_tree(struct B_node **B_tree, int32_t key_to_be_del)
 {
+    struct B_path path_of_this_call, *path = &path_of_this_call;
+    path->top_in_node_stack = path->top_in_pos_stack = -1;
     struct B_node *cur = *B_tree;
     int16_t del_pos;
     while (cur)
     {
         del_pos = look_up_a_key_pos_in_a_B_node(cur, key_to_be_del);
-        if (cur->key[del_pos] != key_to_be_del)
+        if (del_pos > cur->last_index || cur->key[del_pos] != key_to_be_del)
         {
-            push_node(cur);
+            push_node(path, cur);
             cur = cur->child[del_pos];
-            push_pos(del_pos);
+            push_pos(path, del_pos);
             del_pos = 0;
         }
         else break;
@@ -533,8 +851,6 @@ int delete_a_key_and_fill_from_right_subtree_in_B_tree(struct B_node **B_tree, i
     if (!cur)
     {
         fprintf(stderr, "no key value in B tree!\n");
-        top_in_node_stack = -1;
-        top_in_pos_stack = -1;
         return -1;
     }
     if (B_TREE_HAS_ONLY_ONE_KEY_TO_DELETE)
@@ -544,39 +860,37 @@ int delete_a_key_and_fill_from_right_subtree_in_B_tree(struct B_node **B_tree, i
     }
     else if (cur->isleaf)
     {
-        if (delete_a_key_in_B_leaf_and_merge(cur, del_pos))
+        if (delete_a_key_in_B_leaf_and_merge(cur, del_pos, path))
         {
             fprintf(stderr, "fail to delete key %" PRId32" owe to the file open!\n", cur->key[del_pos]);
-            top_in_node_stack = -1;
-            top_in_pos_stack = -1;
             return -1;
         }
     }
     else
     {
-        push_node(cur);
-        push_pos(del_pos);
+        push_node(path, cur);
+        push_pos(path, del_pos + 1);
         struct B_node *min_in_right_subtree = cur->child[del_pos + 1];
         while (!min_in_right_subtree->isleaf)
         {
-            push_node(min_in_right_subtree);
-            push_pos(0);
+            push_node(path, min_in_right_subtree);
+            push_pos(path, 0);
             min_in_right_subtree = min_in_right_subtree->child[0];
         }
-        int32_t tmp_key = min_in_right_subtree->key[0];
-        if (delete_a_key_in_B_leaf_and_merge(min_in_right_subtree, 0))
+        if (file_is_occupied_in_a_B_node(min_in_right_subtree, 0))
         {
             fprintf(stderr, "fail to delete key %" PRId32".\n"
             "Because the file of min_key_in_right_subtree %" PRId32" is open!\n",
             key_to_be_del, min_in_right_subtree->key[0]);
-            top_in_node_stack = -1;
-            top_in_pos_stack = -1;
             return -1;
         }
-        cur->key[del_pos] = tmp_key;
+        /* fill the key in before rebalancing, which may move it into a child */
+        cur->key[del_pos] = min_in_right_subtree->key[0];
+        cur->fd[del_pos] = min_in_right_subtree->fd[0];
+        min_in_right_subtree->fd[0] = -1;
+        delete_a_key_in_B_leaf_and_merge(min_in_right_subtree, 0, path);
     }
-    top_in_node_stack = -1;
-    top_in_pos_stack = -1;
+    shrink_an_empty_B_root(B_tree);
     printf("delete key value %" PRId32" successfully.\n", key_to_be_del);
     return 0;
 }
@@ -592,39 +906,414 @@ void delete_all_nodes_in_B_tree(struct B_node *node)
     return;
 }
 
-void postorder_trav_to_B_tree(struct B_node **B_tree)
+/* a B tree shared by threads. Every call crabs the node latches down from
+the root: a reader keeps at most a parent and a child latched, a writer
+keeps the ancestors that a split or a merge could still reach. A sibling is
+only latched while its parent is latched for writing, so no other thread
+can be waiting for a latch at the same level, and latches are always taken
+top down. */
+struct B_tree {
+    struct B_node *root;
+    /* guards the root pointer while a descent latches the root node */
+    pthread_rwlock_t root_latch;
+    /* where the nodes of this tree come from, or NULL for the C heap */
+    struct node_pool *pool;};
+
+/* the nodes come from pool, made by init_node_pool(sizeof(struct B_node),
+CACHE_LINE_SIZE) and shared by any number of trees, or from the C heap if
+pool is NULL. Every thread working on the tree gets its own node cache. */
+struct B_tree *init_concurrent_B_tree(struct node_pool *pool)
+{
+    struct B_tree *tree = (struct B_tree *)malloc(sizeof(struct B_tree));
+    if (tree == NULL)
+        perror("fail to allocate a B tree"), exit(EXIT_FAILURE);
+    tree->root = NULL;
+    tree->pool = pool;
+    pthread_rwlock_init(&tree->root_latch, NULL);
+    return tree;
+}
+
+void destroy_concurrent_B_tree(struct B_tree *tree)
+{
+    delete_all_nodes_in_B_tree(tree->root);
+    pthread_rwlock_destroy(&tree->root_latch);
+    free(tree);
+    return;
+}
+
+/* called with the key of every successful insert or delete while the node
+that holds it is still write latched, so that two mutations of one key reach
+it in the order they took effect; e.g. to append them to a log. A look up
+calls it with its node read latched, so that no mutation of the key can come
+in between. */
+typedef void (*B_tree_mutation_hook)(int32_t key, void *arg);
+
+/* return 0 and the file descriptor of unkown_key through fd, or -1 if absent.
+hook, if not NULL, is called after fd is set and before the key's node is unlatched. */
+int look_up_a_key_in_concurrent_B_tree_with_a_hook(struct B_tree *tree, int32_t unkown_key, int *fd,
+B_tree_mutation_hook hook, void *arg)
 {
-    struct B_node *cur = *B_tree, *visited = NULL;
-    int pos = 0;
-    if (cur == NULL) return;
-    while (top_in_node_stack = -1 || cur != NULL)
+    pthread_rwlock_rdlock(&tree->root_latch);
+    struct B_node *cur = tree->root;
+    if (cur == NULL)
+    {
+        pthread_rwlock_unlock(&tree->root_latch);
+        return -1;
+    }
+    pthread_rwlock_rdlock(&cur->latch);
+    pthread_rwlock_unlock(&tree->root_latch);
+    int state = -1;
+    while (1)
     {
-        if (cur != NULL)
+        int16_t pos = look_up_a_key_pos_in_a_B_node(cur, unkown_key);
+        if (pos <= cur->last_index && cur->key[pos] == unkown_key)
         {
-            push_node(cur);
-            push_pos(pos);
-            cur = cur->child[pos];
+            if (fd) *fd = cur->fd[pos];
+            if (hook) hook(unkown_key, arg);
+            state = 0;
+            break;
         }
-        else
+        struct B_node *child = cur->child[pos];
+        if (child == NULL) break;
+        /* latch the child before letting the parent go */
+        pthread_rwlock_rdlock(&child->latch);
+        pthread_rwlock_unlock(&cur->latch);
+        cur = child;
+    }
+    pthread_rwlock_unlock(&cur->latch);
+    return state;
+}
+
+int look_up_a_key_in_concurrent_B_tree(struct B_tree *tree, int32_t unkown_key, int *fd)
+{
+    return look_up_a_key_in_concurrent_B_tree_with_a_hook(tree, unkown_key, fd, NULL, NULL);
+}
+
+/* a node is safe for insertion if one more key can not make it split */
+#define B_NODE_IS_SAFE_FOR_INSERT(node) ((node)->last_index < MAX_DEGREE - 2)
+
+/* optimistic insertion: read latches down to the parent of the leaf and a
+write latch on the leaf only. Return 1 if the leaf may split, and the
+caller has to retry with insert_a_key_in_concurrent_B_tree_pessimistically(). */
+static int insert_a_key_in_concurrent_B_tree_optimistically(struct B_tree *tree, int32_t new_key,
+B_tree_mutation_hook hook, void *arg)
+{
+    pthread_rwlock_rdlock(&tree->root_latch);
+    struct B_node *cur = tree->root;
+    if (cur == NULL || cur->isleaf)
+    {
+        pthread_rwlock_unlock(&tree->root_latch);
+        return 1;
+    }
+    pthread_rwlock_rdlock(&cur->latch);
+    pthread_rwlock_unlock(&tree->root_latch);
+    while (!cur->isleaf)
+    {
+        int16_t pos = look_up_a_key_pos_in_a_B_node(cur, new_key);
+        if (pos <= cur->last_index && cur->key[pos] == new_key)
         {
-            if (pos > node_stack[top_in_node_stack]->last_index + 1 || node_stack[top_in_node_stack]->child[pos] == NULL)
-            {
-                visited = popup_node();
-                fputs("Here are all node keys: ", stdin);
-                for (int16_t i = 0; i <= visited->last_index; i++)
-                    printf("%" PRId32"\040", visited->key[i]);
-                putchar('\n');
-                fputs("Here are all file discriptors: ", stdin);
-                for (int16_t i = 0; i <= visited->last_index; i++)
-                    printf("%d\040", visited->fd[i]);
-                putchar('\n');
-            }
-            else
-            {
-                pos = popup_pos();
-                cur = node_stack[top_in_node_stack]->child[++pos];
-            }
+            pthread_rwlock_unlock(&cur->latch);
+            fprintf(stderr, "insert failed. This B tree has already a key value %" PRId32".\n", new_key);
+            return -1;
         }
+        /* isleaf never changes after a node is allocated */
+        struct B_node *child = cur->child[pos];
+        if (child->isleaf)
+            pthread_rwlock_wrlock(&child->latch);
+        else pthread_rwlock_rdlock(&child->latch);
+        pthread_rwlock_unlock(&cur->latch);
+        cur = child;
+    }
+    if (!B_NODE_IS_SAFE_FOR_INSERT(cur))
+    {
+        pthread_rwlock_unlock(&cur->latch);
+        return 1;
     }
+    int state = insert_a_key_in_a_B_node(cur, new_key) < 0 ? -1 : 0;
+    if (state == 0 && hook) hook(new_key, arg);
+    pthread_rwlock_unlock(&cur->latch);
+    if (state < 0)
+        fprintf(stderr, "insert failed. This B tree has already a key value %" PRId32".\n", new_key);
+    return state;
+}
+
+/* release the write latches kept on the ancestors in path, and the root latch */
+static void unlatch_B_path(struct B_tree *tree, struct B_path *path, _Bool *root_is_latched)
+{
+    for (int8_t i = 0; i <= path->top_in_node_stack; i++)
+        pthread_rwlock_unlock(&path->node_stack[i]->latch);
+    path->top_in_node_stack = -1;
+    if (*root_is_latched)
+        pthread_rwlock_unlock(&tree->root_latch), *root_is_latched = 0;
     return;
-}
\ No newline at end of file
+}
+
+/* pessimistic insertion: write latches from the root, and every ancestor
+above a safe node is released as soon as that node is latched. */
+static int insert_a_key_in_concurrent_B_tree_pessimistically(struct B_tree *tree, int32_t new_key,
+B_tree_mutation_hook hook, void *arg)
+{
+    struct B_path path_of_this_call, *path = &path_of_this_call;
+    path->top_in_node_stack = path->top_in_pos_stack = -1;
+    _Bool root_is_latched = 1;
+    pthread_rwlock_wrlock(&tree->root_latch);
+    if (tree->root == NULL)
+    {
+        tree->root = init_a_B_root(new_key, tree->pool);
+        if (hook) hook(new_key, arg);
+        pthread_rwlock_unlock(&tree->root_latch);
+        return 0;
+    }
+    struct B_node *cur = tree->root;
+    pthread_rwlock_wrlock(&cur->latch);
+    while (1)
+    {
+        if (B_NODE_IS_SAFE_FOR_INSERT(cur))
+            unlatch_B_path(tree, path, &root_is_latched);
+        if (cur->isleaf) break;
+        int16_t pos = look_up_a_key_pos_in_a_B_node(cur, new_key);
+        if (pos <= cur->last_index && cur->key[pos] == new_key)
+        {
+            pthread_rwlock_unlock(&cur->latch);
+            unlatch_B_path(tree, path, &root_is_latched);
+            fprintf(stderr, "insert failed. This B tree has already a key value %" PRId32".\n", new_key);
+            return -1;
+        }
+        push_node(path, cur);
+        cur = cur->child[pos];
+        pthread_rwlock_wrlock(&cur->latch);
+    }
+    if (insert_a_key_in_a_B_node(cur, new_key) < 0)
+    {
+        pthread_rwlock_unlock(&cur->latch);
+        unlatch_B_path(tree, path, &root_is_latched);
+        fprintf(stderr, "insert failed. This B tree has already a key value %" PRId32".\n", new_key);
+        return -1;
+    }
+    if (hook) hook(new_key, arg);
+    /* splitting pops the ancestors off path, but leaves them in node_stack */
+    int8_t top_of_latched_nodes = path->top_in_node_stack;
+    split_full_B_nodes_upward(&tree->root, cur, path, tree->pool);
+    pthread_rwlock_unlock(&cur->latch);
+    path->top_in_node_stack = top_of_latched_nodes;
+    unlatch_B_path(tree, path, &root_is_latched);
+    return 0;
+}
+
+int insert_a_key_in_concurrent_B_tree_with_a_hook(struct B_tree *tree, int32_t new_key,
+B_tree_mutation_hook hook, void *arg)
+{
+    int state = insert_a_key_in_concurrent_B_tree_optimistically(tree, new_key, hook, arg);
+    if (state > 0)
+        state = insert_a_key_in_concurrent_B_tree_pessimistically(tree, new_key, hook, arg);
+    return state;
+}
+
+int insert_a_key_in_concurrent_B_tree(struct B_tree *tree, int32_t new_key)
+{
+    return insert_a_key_in_concurrent_B_tree_with_a_hook(tree, new_key, NULL, NULL);
+}
+
+/* a node is safe for deletion if losing one key can not make it underflow.
+The root only has to keep a key, or else it is shrunk or emptied. */
+#define B_NODE_IS_SAFE_FOR_DELETE(node, is_root) \
+((is_root) ? (node)->last_index >= 1 : (node)->last_index >= (MAX_DEGREE - 2) >> 1)
+
+/* optimistic deletion: read latches down to the parent of the leaf and a
+write latch on the leaf only. Return 1 if the key is in an inner node or
+the leaf may underflow, and the caller has to retry pessimistically. */
+static int delete_a_key_in_concurrent_B_tree_optimistically(struct B_tree *tree, int32_t key_to_be_del,
+B_tree_mutation_hook hook, void *arg)
+{
+    pthread_rwlock_rdlock(&tree->root_latch);
+    struct B_node *cur = tree->root;
+    if (cur == NULL || cur->isleaf)
+    {
+        pthread_rwlock_unlock(&tree->root_latch);
+        return 1;
+    }
+    pthread_rwlock_rdlock(&cur->latch);
+    pthread_rwlock_unlock(&tree->root_latch);
+    while (!cur->isleaf)
+    {
+        int16_t pos = look_up_a_key_pos_in_a_B_node(cur, key_to_be_del);
+        if (pos <= cur->last_index && cur->key[pos] == key_to_be_del)
+        {
+            pthread_rwlock_unlock(&cur->latch);
+            return 1;
+        }
+        struct B_node *child = cur->child[pos];
+        if (child->isleaf)
+            pthread_rwlock_wrlock(&child->latch);
+        else pthread_rwlock_rdlock(&child->latch);
+        pthread_rwlock_unlock(&cur->latch);
+        cur = child;
+    }
+    int16_t del_pos = look_up_a_key_pos_in_a_B_node(cur, key_to_be_del);
+    int state = 0;
+    if (del_pos > cur->last_index || cur->key[del_pos] != key_to_be_del)
+    {
+        fprintf(stderr, "no key value %" PRId32" in B tree!\n", key_to_be_del);
+        state = -1;
+    }
+    else if (!B_NODE_IS_SAFE_FOR_DELETE(cur, 0)) state = 1;
+    else if (file_is_occupied_in_a_B_node(cur, del_pos))
+    {
+        fprintf(stderr, "fail to delete key %" PRId32" owe to the file open!\n", key_to_be_del);
+        state = -1;
+    }
+    else
+    {
+        for (int16_t i = del_pos; i < cur->last_index; i++)
+            cur->key[i] = cur->key[i + 1], cur->fd[i] = cur->fd[i + 1];
+        cur->key[cur->last_index] = 0;
+        cur->fd[cur->last_index] = -1;
+        cur->last_index--;
+        if (hook) hook(key_to_be_del, arg);
+    }
+    pthread_rwlock_unlock(&cur->latch);
+    return state;
+}
+
+/* the merge loop of delete_a_key_in_B_leaf_and_merge() for a latched path:
+cur and every node in path are write latched, and the siblings are latched
+for the time they are looked at. A node freed by a merge is unlatched first.
+Return the node the loop stops at, which is still latched and off path. */
+static struct B_node *merge_latched_B_nodes_upward(struct B_node *cur, struct B_path *path)
+{
+    while (path->top_in_node_stack != -1 && cur->last_index < ((MAX_DEGREE - 2) >> 1) - 1)
+    {
+        struct B_node *parent = path->node_stack[path->top_in_node_stack];
+        int16_t pos = path->pos_stack[path->top_in_pos_stack];
+        struct B_node *left_sibling = pos ? parent->child[pos - 1] : NULL;
+        struct B_node *right_sibling = pos != parent->last_index + 1 ? parent->child[pos + 1] : NULL;
+        if (left_sibling) pthread_rwlock_wrlock(&left_sibling->latch);
+        if (right_sibling) pthread_rwlock_wrlock(&right_sibling->latch);
+        _Bool borrowed = 1;
+        if (left_sibling && left_sibling->last_index >= (MAX_DEGREE - 2) >> 1)
+            borrow_a_key_from_left_sibling(cur, parent, pos, left_sibling);
+        else if (right_sibling && right_sibling->last_index >= (MAX_DEGREE - 2) >> 1)
+            borrow_a_key_from_right_sibling(cur, parent, pos, right_sibling);
+        else if (left_sibling)
+        {
+            borrowed = 0;
+            merge_left_parent_right_B_nodes(left_sibling, parent, pos - 1, cur);
+            pthread_rwlock_unlock(&cur->latch);
+            free_a_node_in_B_tree(cur);
+            cur = left_sibling, left_sibling = NULL;
+        }
+        else
+        {
+            borrowed = 0;
+            merge_left_parent_right_B_nodes(cur, parent, pos, right_sibling);
+            pthread_rwlock_unlock(&right_sibling->latch);
+            free_a_node_in_B_tree(right_sibling);
+            right_sibling = NULL;
+        }
+        if (left_sibling) pthread_rwlock_unlock(&left_sibling->latch);
+        if (right_sibling) pthread_rwlock_unlock(&right_sibling->latch);
+        /* a borrow leaves the parent as full as it was */
+        if (borrowed) break;
+        pthread_rwlock_unlock(&cur->latch);
+        cur = popup_node(path);
+        popup_pos(path);
+    }
+    return cur;
+}
+
+/* pessimistic deletion: write latches from the root, and every ancestor
+above a safe node is released as soon as that node is latched. Once the key
+is found in an inner node, the path down to its predecessor is kept whole,
+since the inner node still has to take the predecessor. */
+static int delete_a_key_in_concurrent_B_tree_pessimistically(struct B_tree *tree, int32_t key_to_be_del,
+B_tree_mutation_hook hook, void *arg)
+{
+    struct B_path path_of_this_call, *path = &path_of_this_call;
+    path->top_in_node_stack = path->top_in_pos_stack = -1;
+    _Bool root_is_latched = 1;
+    pthread_rwlock_wrlock(&tree->root_latch);
+    struct B_node *cur = tree->root, *found = NULL;
+    if (cur == NULL)
+    {
+        pthread_rwlock_unlock(&tree->root_latch);
+        fprintf(stderr, "no key value %" PRId32" in B tree!\n", key_to_be_del);
+        return -1;
+    }
+    pthread_rwlock_wrlock(&cur->latch);
+    int16_t del_pos = 0;
+    _Bool cur_is_root = 1;
+    while (1)
+    {
+        if (found == NULL && B_NODE_IS_SAFE_FOR_DELETE(cur, cur_is_root))
+        {
+            unlatch_B_path(tree, path, &root_is_latched);
+            path->top_in_pos_stack = -1;
+        }
+        int16_t pos = found ? cur->last_index + 1 : look_up_a_key_pos_in_a_B_node(cur, key_to_be_del);
+        if (found == NULL && pos <= cur->last_index && cur->key[pos] == key_to_be_del)
+        {
+            found = cur, del_pos = pos;
+            if (cur->isleaf) break;
+        }
+        else if (cur->isleaf) break;
+        push_node(path, cur);
+        push_pos(path, pos);
+        cur = cur->child[pos];
+        cur_is_root = 0;
+        pthread_rwlock_wrlock(&cur->latch);
+    }
+    int state = 0;
+    /* in the inner case cur is the predecessor leaf and its last key moves up */
+    int16_t leaf_pos = found == cur ? del_pos : cur->last_index;
+    if (found == NULL)
+    {
+        fprintf(stderr, "no key value %" PRId32" in B tree!\n", key_to_be_del);
+        state = -1;
+    }
+    else if (file_is_occupied_in_a_B_node(cur, leaf_pos))
+    {
+        fprintf(stderr, "fail to delete key %" PRId32" owe to the file open!\n", key_to_be_del);
+        state = -1;
+    }
+    else
+    {
+        if (found != cur)
+        {
+            found->key[del_pos] = cur->key[leaf_pos];
+            found->fd[del_pos] = cur->fd[leaf_pos];
+        }
+        for (int16_t i = leaf_pos; i < cur->last_index; i++)
+            cur->key[i] = cur->key[i + 1], cur->fd[i] = cur->fd[i + 1];
+        cur->key[cur->last_index] = 0;
+        cur->fd[cur->last_index] = -1;
+        cur->last_index--;
+        if (hook) hook(key_to_be_del, arg);
+        cur = merge_latched_B_nodes_upward(cur, path);
+    }
+    /* the root can only be emptied while root_latch is held, and then the
+    merges have climbed up to it */
+    if (state == 0 && root_is_latched && cur == tree->root && cur->last_index < 0)
+    {
+        tree->root = cur->isleaf ? NULL : cur->child[0];
+        pthread_rwlock_unlock(&cur->latch);
+        free_a_node_in_B_tree(cur);
+        cur = NULL;
+    }
+    if (cur) pthread_rwlock_unlock(&cur->latch);
+    unlatch_B_path(tree, path, &root_is_latched);
+    return state;
+}
+
+int delete_a_key_in_concurrent_B_tree_with_a_hook(struct B_tree *tree, int32_t key_to_be_del,
+B_tree_mutation_hook hook, void *arg)
+{
+    int state = delete_a_key_in_concurrent_B_tree_optimistically(tree, key_to_be_del, hook, arg);
+    if (state > 0)
+        state = delete_a_key_in_concurrent_B_tree_pessimistically(tree, key_to_be_del, hook, arg);
+    return state;
+}
+
+int delete_a_key_in_concurrent_B_tree(struct B_tree *tree, int32_t key_to_be_del)
+{
+    return delete_a_key_in_concurrent_B_tree_with_a_hook(tree, key_to_be_del, NULL, NULL);
+}
@@ -0,0 +1,486 @@
+#pragma once
+#include "B_tree.c"
+#include <errno.h>
+#include <sys/stat.h>
+/* a write-ahead log for struct B_tree. Mutations append records to an in-memory
+buffer, and one committer thread writes the buffer out and fdatasync()s it,
+so every caller waiting at that moment is made durable by the same sync
+(group commit). While a group is synced, new records fill the other buffer.
+A record is appended while the node that holds its key is still latched,
+so two mutations of one key are logged in the order they took effect, and
+a mutation which fails is not logged at all. checkpoint_B_tree_WAL() writes
+the keys to <log>.snapshot and empties the log. On open, the snapshot is
+loaded and the records in the log are replayed into the tree. */
+#define WAL_INSERT 1
+#define WAL_DELETE 2
+#define WAL_VALUE 3
+#define WAL_BUFFER_SIZE (1 << 20)
+
+struct WAL_record_header {
+    uint32_t checksum;
+    uint32_t value_len;
+    int32_t key;
+    uint8_t type;} __attribute__((packed));
+
+struct B_tree_WAL {
+    int fd;
+    char *snapshot_path;
+    /* mutations hold it for reading, a checkpoint for writing */
+    pthread_rwlock_t checkpoint_latch;
+    pthread_mutex_t mutex;
+    pthread_cond_t has_records;
+    pthread_cond_t is_durable;
+    /* records are appended to active while committing is being synced */
+    char *active;
+    size_t active_len, active_capacity;
+    char *committing;
+    size_t committing_capacity;
+    /* log sequence numbers count bytes from the start of the log as it was
+    opened; a checkpoint empties the file but does not reset them */
+    uint64_t appended_lsn, durable_lsn;
+    int error;
+    _Bool stopping;
+    pthread_t committer;};
+
+/* FNV-1a over the record after its checksum field */
+static uint32_t checksum_a_WAL_record(const struct WAL_record_header *header, const void *value)
+{
+    uint32_t hash = 2166136261u;
+    const unsigned char *byte = (const unsigned char *)header + sizeof(header->checksum);
+    for (size_t i = sizeof(header->checksum); i < sizeof(struct WAL_record_header); i++, byte++)
+        hash = (hash ^ *byte) * 16777619u;
+    byte = (const unsigned char *)value;
+    for (uint32_t i = 0; i < header->value_len; i++, byte++)
+        hash = (hash ^ *byte) * 16777619u;
+    return hash;
+}
+
+static void *commit_B_tree_WAL_in_groups(void *arg)
+{
+    struct B_tree_WAL *wal = (struct B_tree_WAL *)arg;
+    pthread_mutex_lock(&wal->mutex);
+    while (1)
+    {
+        while (wal->active_len == 0 && !wal->stopping)
+            pthread_cond_wait(&wal->has_records, &wal->mutex);
+        if (wal->active_len == 0) break;
+        /* take every record appended so far as one group */
+        char *group = wal->active;
+        size_t group_len = wal->active_len, group_capacity = wal->active_capacity;
+        uint64_t group_lsn = wal->appended_lsn;
+        wal->active = wal->committing, wal->active_capacity = wal->committing_capacity;
+        wal->active_len = 0;
+        pthread_mutex_unlock(&wal->mutex);
+
+        int error = 0;
+        for (size_t written = 0; written < group_len;)
+        {
+            ssize_t n = write(wal->fd, group + written, group_len - written);
+            if (n < 0 && errno != EINTR) { error = errno; break; }
+            if (n > 0) written += n;
+        }
+        if (!error && fdatasync(wal->fd) < 0)
+            error = errno;
+
+        pthread_mutex_lock(&wal->mutex);
+        wal->committing = group, wal->committing_capacity = group_capacity;
+        if (error)
+        {
+            errno = error;
+            perror("the WAL group commit error");
+            wal->error = error;
+        }
+        else wal->durable_lsn = group_lsn;
+        pthread_cond_broadcast(&wal->is_durable);
+    }
+    pthread_mutex_unlock(&wal->mutex);
+    return NULL;
+}
+
+/* return the log sequence number which is durable once the record is. */
+uint64_t append_a_record_to_B_tree_WAL(struct B_tree_WAL *wal, uint8_t type, int32_t key,
+const void *value, uint32_t value_len)
+{
+    struct WAL_record_header header = {.value_len = value_len, .key = key, .type = type};
+    header.checksum = checksum_a_WAL_record(&header, value);
+    size_t record_len = sizeof(struct WAL_record_header) + value_len;
+    pthread_mutex_lock(&wal->mutex);
+    if (wal->active_len + record_len > wal->active_capacity)
+    {
+        while (wal->active_len + record_len > wal->active_capacity)
+            wal->active_capacity <<= 1;
+        wal->active = (char *)realloc(wal->active, wal->active_capacity);
+        if (wal->active == NULL)
+            perror("fail to grow the WAL buffer"), exit(EXIT_FAILURE);
+    }
+    memcpy(wal->active + wal->active_len, &header, sizeof(struct WAL_record_header));
+    if (value_len)
+        memcpy(wal->active + wal->active_len + sizeof(struct WAL_record_header), value, value_len);
+    wal->active_len += record_len;
+    uint64_t lsn = wal->appended_lsn += record_len;
+    pthread_cond_signal(&wal->has_records);
+    pthread_mutex_unlock(&wal->mutex);
+    return lsn;
+}
+
+/* block until every record up to lsn is on disk, return -1 if the log failed */
+int wait_for_B_tree_WAL_commit(struct B_tree_WAL *wal, uint64_t lsn)
+{
+    pthread_mutex_lock(&wal->mutex);
+    while (wal->durable_lsn < lsn && !wal->error)
+        pthread_cond_wait(&wal->is_durable, &wal->mutex);
+    int state = wal->durable_lsn >= lsn ? 0 : -1;
+    pthread_mutex_unlock(&wal->mutex);
+    return state;
+}
+
+/* replay the records of the log into tree, and cut off a torn record at its
+end. replay_a_value, if not NULL, receives the payload of every value record. */
+static int replay_B_tree_WAL(struct B_tree_WAL *wal, struct B_tree *tree,
+void (*replay_a_value)(int32_t key, const void *value, uint32_t value_len, void *arg), void *arg)
+{
+    struct stat file_info;
+    if (fstat(wal->fd, &file_info) < 0)
+    {
+        perror("fstat error");
+        return -1;
+    }
+    if (file_info.st_size == 0) return 0;
+    char *log = (char *)malloc(file_info.st_size);
+    if (log == NULL)
+        perror("fail to allocate the WAL replay buffer"), exit(EXIT_FAILURE);
+    if (pread(wal->fd, log, file_info.st_size, 0) != file_info.st_size)
+    {
+        perror("the WAL pread error");
+        free(log);
+        return -1;
+    }
+    size_t offset = 0;
+    while (offset + sizeof(struct WAL_record_header) <= (size_t)file_info.st_size)
+    {
+        struct WAL_record_header header;
+        memcpy(&header, log + offset, sizeof(struct WAL_record_header));
+        const char *value = log + offset + sizeof(struct WAL_record_header);
+        if (offset + sizeof(struct WAL_record_header) + header.value_len > (size_t)file_info.st_size
+        || checksum_a_WAL_record(&header, value) != header.checksum)
+            break;
+        if (header.type == WAL_INSERT)
+            insert_a_key_in_concurrent_B_tree(tree, header.key);
+        else if (header.type == WAL_DELETE)
+            delete_a_key_in_concurrent_B_tree(tree, header.key);
+        else if (header.type == WAL_VALUE && replay_a_value)
+            replay_a_value(header.key, value, header.value_len, arg);
+        offset += sizeof(struct WAL_record_header) + header.value_len;
+    }
+    free(log);
+    if (offset != (size_t)file_info.st_size)
+    {
+        fprintf(stderr, "cut off a torn WAL record at offset %zu.\n", offset);
+        if (ftruncate(wal->fd, offset) < 0 || fdatasync(wal->fd) < 0)
+        {
+            perror("fail to truncate the WAL");
+            return -1;
+        }
+    }
+    wal->appended_lsn = wal->durable_lsn = offset;
+    return 0;
+}
+
+/* a snapshot is a header, then the keys of the tree in order */
+struct B_tree_snapshot_header {
+    uint32_t checksum;
+    uint32_t key_number;};
+
+struct B_tree_snapshot_writer {
+    FILE *file;
+    uint32_t checksum, key_number;};
+
+/* the values written through the log are only durable by their records, so
+their files are synced before the snapshot can stand in for the log */
+static int write_a_batch_of_B_tree_snapshot(const int32_t *key, const int *fd, int32_t key_number, void *arg)
+{
+    struct B_tree_snapshot_writer *writer = (struct B_tree_snapshot_writer *)arg;
+    for (int32_t i = 0; i < key_number; i++)
+        if (fd[i] >= 0 && fdatasync(fd[i]) < 0)
+        {
+            perror("fail to sync the value of a key");
+            return -1;
+        }
+    if (fwrite(key, sizeof(int32_t), key_number, writer->file) != (size_t)key_number)
+    {
+        perror("the snapshot fwrite error");
+        return -1;
+    }
+    const unsigned char *byte = (const unsigned char *)key;
+    for (size_t i = 0; i < key_number * sizeof(int32_t); i++, byte++)
+        writer->checksum = (writer->checksum ^ *byte) * 16777619u;
+    writer->key_number += key_number;
+    return 0;
+}
+
+/* fsync the directory of path, so that a rename in it is durable */
+static int sync_the_directory_of(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    char *dir_path = slash ? strndup(path, slash == path ? 1 : slash - path) : strdup(".");
+    if (dir_path == NULL)
+        perror("fail to allocate a directory path"), exit(EXIT_FAILURE);
+    int dir_fd = open(dir_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC), state = 0;
+    free(dir_path);
+    if (dir_fd < 0 || fsync(dir_fd) < 0)
+    {
+        perror("fail to sync a directory");
+        state = -1;
+    }
+    if (dir_fd >= 0) close(dir_fd);
+    return state;
+}
+
+/* write the keys of tree to <path>.tmp, then rename it over path */
+static int write_a_B_tree_snapshot(const char *path, struct B_tree *tree)
+{
+    size_t path_len = strlen(path);
+    char *tmp_path = (char *)malloc(path_len + sizeof(".tmp"));
+    if (tmp_path == NULL)
+        perror("fail to allocate a snapshot path"), exit(EXIT_FAILURE);
+    memcpy(tmp_path, path, path_len);
+    memcpy(tmp_path + path_len, ".tmp", sizeof(".tmp"));
+    struct B_tree_snapshot_writer writer = {.file = fopen(tmp_path, "we"), .checksum = 2166136261u};
+    if (writer.file == NULL)
+    {
+        perror("fopen error");
+        free(tmp_path);
+        return -1;
+    }
+    struct B_tree_snapshot_header header = {0};
+    int state = 0;
+    /* the header is written last, once the checksum is known */
+    if (fwrite(&header, sizeof(header), 1, writer.file) != 1
+    || trav_to_B_tree(&tree->root, B_inorder, write_a_batch_of_B_tree_snapshot, &writer))
+        state = -1;
+    header.checksum = writer.checksum, header.key_number = writer.key_number;
+    if (state == 0 && (fseek(writer.file, 0, SEEK_SET) || fwrite(&header, sizeof(header), 1, writer.file) != 1
+    || fflush(writer.file) || fsync(fileno(writer.file))))
+    {
+        perror("fail to write the snapshot");
+        state = -1;
+    }
+    if (fclose(writer.file) && state == 0)
+        perror("fclose error"), state = -1;
+    if (state == 0 && rename(tmp_path, path) < 0)
+        perror("fail to rename the snapshot"), state = -1;
+    if (state == 0)
+        state = sync_the_directory_of(path);
+    else unlink(tmp_path);
+    free(tmp_path);
+    return state;
+}
+
+/* insert the keys of the snapshot at path into tree; a missing snapshot is
+an empty one. Return -1 if it is unreadable or its checksum is wrong. */
+static int load_a_B_tree_snapshot(const char *path, struct B_tree *tree)
+{
+    FILE *file = fopen(path, "re");
+    if (file == NULL)
+    {
+        if (errno == ENOENT) return 0;
+        perror("fopen error");
+        return -1;
+    }
+    struct B_tree_snapshot_header header;
+    int32_t key_buf[B_TRAV_BATCH];
+    uint32_t checksum = 2166136261u, loaded = 0;
+    int state = fread(&header, sizeof(header), 1, file) == 1 ? 0 : -1;
+    while (state == 0 && loaded < header.key_number)
+    {
+        uint32_t batch_size = header.key_number - loaded < B_TRAV_BATCH ? header.key_number - loaded : B_TRAV_BATCH;
+        if (fread(key_buf, sizeof(int32_t), batch_size, file) != batch_size)
+        {
+            state = -1;
+            break;
+        }
+        const unsigned char *byte = (const unsigned char *)key_buf;
+        for (size_t i = 0; i < batch_size * sizeof(int32_t); i++, byte++)
+            checksum = (checksum ^ *byte) * 16777619u;
+        for (uint32_t i = 0; i < batch_size; i++)
+            insert_a_key_in_concurrent_B_tree(tree, key_buf[i]);
+        loaded += batch_size;
+    }
+    if (state == 0 && checksum != header.checksum)
+        state = -1;
+    if (state < 0)
+        fprintf(stderr, "the snapshot %s is torn or corrupt.\n", path);
+    fclose(file);
+    return state;
+}
+
+struct B_tree_WAL *open_B_tree_WAL(const char *file_path, struct B_tree *tree,
+void (*replay_a_value)(int32_t key, const void *value, uint32_t value_len, void *arg), void *arg)
+{
+    struct B_tree_WAL *wal = (struct B_tree_WAL *)calloc(1, sizeof(struct B_tree_WAL));
+    if (wal == NULL)
+        perror("fail to allocate a WAL"), exit(EXIT_FAILURE);
+    size_t path_len = strlen(file_path);
+    wal->snapshot_path = (char *)malloc(path_len + sizeof(".snapshot"));
+    if (wal->snapshot_path == NULL)
+        perror("fail to allocate the snapshot path"), exit(EXIT_FAILURE);
+    memcpy(wal->snapshot_path, file_path, path_len);
+    memcpy(wal->snapshot_path + path_len, ".snapshot", sizeof(".snapshot"));
+    wal->fd = open(file_path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (wal->fd < 0)
+    {
+        perror("open error");
+        free(wal->snapshot_path), free(wal);
+        return NULL;
+    }
+    /* a crash between writing a snapshot and emptying the log leaves records
+    which the snapshot covers already; replaying them again is harmless,
+    since the last mutation of every key still decides whether it is in */
+    if (load_a_B_tree_snapshot(wal->snapshot_path, tree) < 0
+    || replay_B_tree_WAL(wal, tree, replay_a_value, arg) < 0)
+    {
+        close(wal->fd), free(wal->snapshot_path), free(wal);
+        return NULL;
+    }
+    wal->active_capacity = wal->committing_capacity = WAL_BUFFER_SIZE;
+    wal->active = (char *)malloc(WAL_BUFFER_SIZE);
+    wal->committing = (char *)malloc(WAL_BUFFER_SIZE);
+    if (wal->active == NULL || wal->committing == NULL)
+        perror("fail to allocate the WAL buffers"), exit(EXIT_FAILURE);
+    pthread_rwlock_init(&wal->checkpoint_latch, NULL);
+    pthread_mutex_init(&wal->mutex, NULL);
+    pthread_cond_init(&wal->has_records, NULL);
+    pthread_cond_init(&wal->is_durable, NULL);
+    if (pthread_create(&wal->committer, NULL, commit_B_tree_WAL_in_groups, wal))
+    {
+        perror("fail to start the WAL committer");
+        close(wal->fd), free(wal->active), free(wal->committing), free(wal->snapshot_path), free(wal);
+        return NULL;
+    }
+    return wal;
+}
+
+/* commit the records still buffered, then stop the committer */
+int close_B_tree_WAL(struct B_tree_WAL *wal)
+{
+    pthread_mutex_lock(&wal->mutex);
+    wal->stopping = 1;
+    pthread_cond_signal(&wal->has_records);
+    pthread_mutex_unlock(&wal->mutex);
+    pthread_join(wal->committer, NULL);
+    int state = wal->error ? -1 : 0;
+    if (close(wal->fd) < 0)
+        perror("close error"), state = -1;
+    pthread_rwlock_destroy(&wal->checkpoint_latch);
+    pthread_mutex_destroy(&wal->mutex);
+    pthread_cond_destroy(&wal->has_records);
+    pthread_cond_destroy(&wal->is_durable);
+    free(wal->active);
+    free(wal->committing);
+    free(wal->snapshot_path);
+    free(wal);
+    return state;
+}
+
+/* write a snapshot of tree and empty the log. Mutations wait meanwhile, so
+the snapshot holds exactly the records appended before it. */
+int checkpoint_B_tree_WAL(struct B_tree_WAL *wal, struct B_tree *tree)
+{
+    pthread_rwlock_wrlock(&wal->checkpoint_latch);
+    pthread_mutex_lock(&wal->mutex);
+    uint64_t lsn = wal->appended_lsn;
+    pthread_mutex_unlock(&wal->mutex);
+    /* once everything appended is durable, the committer has nothing left
+    to write, so the log can be truncated under it */
+    int state = wait_for_B_tree_WAL_commit(wal, lsn);
+    if (state == 0)
+        state = write_a_B_tree_snapshot(wal->snapshot_path, tree);
+    if (state == 0 && (ftruncate(wal->fd, 0) < 0 || fdatasync(wal->fd) < 0))
+    {
+        perror("fail to truncate the WAL");
+        state = -1;
+    }
+    pthread_rwlock_unlock(&wal->checkpoint_latch);
+    return state;
+}
+
+/* the following mutations wait until they are durable if lsn is NULL;
+otherwise they return at once and leave the wait to the caller through
+*lsn, so that a batch of mutations can share a single commit. */
+static int finish_a_WAL_mutation(struct B_tree_WAL *wal, uint64_t record_lsn, uint64_t *lsn)
+{
+    if (lsn)
+    {
+        *lsn = record_lsn;
+        return 0;
+    }
+    return wait_for_B_tree_WAL_commit(wal, record_lsn);
+}
+
+struct WAL_mutation {
+    struct B_tree_WAL *wal;
+    uint8_t type;
+    uint64_t lsn;};
+
+/* the B_tree_mutation_hook of the mutations below */
+static void log_a_B_tree_mutation(int32_t key, void *arg)
+{
+    struct WAL_mutation *mutation = (struct WAL_mutation *)arg;
+    mutation->lsn = append_a_record_to_B_tree_WAL(mutation->wal, mutation->type, key, NULL, 0);
+    return;
+}
+
+int insert_a_key_in_B_tree_with_WAL(struct B_tree *tree, struct B_tree_WAL *wal, int32_t new_key, uint64_t *lsn)
+{
+    struct WAL_mutation mutation = {.wal = wal, .type = WAL_INSERT};
+    pthread_rwlock_rdlock(&wal->checkpoint_latch);
+    int state = insert_a_key_in_concurrent_B_tree_with_a_hook(tree, new_key, log_a_B_tree_mutation, &mutation);
+    pthread_rwlock_unlock(&wal->checkpoint_latch);
+    if (state < 0) return -1;
+    return finish_a_WAL_mutation(wal, mutation.lsn, lsn);
+}
+
+int delete_a_key_in_B_tree_with_WAL(struct B_tree *tree, struct B_tree_WAL *wal, int32_t key_to_be_del, uint64_t *lsn)
+{
+    struct WAL_mutation mutation = {.wal = wal, .type = WAL_DELETE};
+    pthread_rwlock_rdlock(&wal->checkpoint_latch);
+    int state = delete_a_key_in_concurrent_B_tree_with_a_hook(tree, key_to_be_del, log_a_B_tree_mutation, &mutation);
+    pthread_rwlock_unlock(&wal->checkpoint_latch);
+    if (state < 0) return -1;
+    return finish_a_WAL_mutation(wal, mutation.lsn, lsn);
+}
+
+struct WAL_value {
+    struct B_tree_WAL *wal;
+    const void *value;
+    uint32_t value_len;
+    int fd;
+    uint64_t lsn;};
+
+/* the hook of the look up below: the key is in its node, which stays read
+latched, so a delete of the key is logged after the value */
+static void log_a_B_tree_value(int32_t key, void *arg)
+{
+    struct WAL_value *value = (struct WAL_value *)arg;
+    value->lsn = append_a_record_to_B_tree_WAL(value->wal, WAL_VALUE, key, value->value, value->value_len);
+    if (value->fd >= 0 && pwrite(value->fd, value->value, value->value_len, BUFSIZ) != (ssize_t)value->value_len)
+        perror("the value pwrite error");
+    return;
+}
+
+/* unlike write_a_file_in_a_B_node(), the file of the key is written without
+O_SYNC: the log record is what makes the value durable. */
+int write_a_value_in_B_tree_with_WAL(struct B_tree *tree, struct B_tree_WAL *wal, int32_t key,
+const void *value, uint32_t value_len, uint64_t *lsn)
+{
+    struct WAL_value record = {.wal = wal, .value = value, .value_len = value_len};
+    pthread_rwlock_rdlock(&wal->checkpoint_latch);
+    int state = look_up_a_key_in_concurrent_B_tree_with_a_hook(tree, key, &record.fd, log_a_B_tree_value, &record);
+    pthread_rwlock_unlock(&wal->checkpoint_latch);
+    if (state < 0)
+    {
+        fprintf(stderr, "no key value %" PRId32" in B tree!\n", key);
+        return -1;
+    }
+    return finish_a_WAL_mutation(wal, record.lsn, lsn);
+}
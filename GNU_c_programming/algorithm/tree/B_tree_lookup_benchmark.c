@@ -0,0 +1,152 @@
+#include "B_tree.c"
+#include <time.h>
+/* point lookup microbenchmark: the cache-line-packed struct B_node against
+the former layout, where key, child and fd were three separate mallocs,
+and look_up_keys_in_B_tree() against one key at a time. */
+#define KEY_NUMBER 10000000
+#define LOOKUP_NUMBER 10000000
+
+struct split_B_node {
+    int32_t *key;
+    int *fd;
+    struct split_B_node **child;
+    int16_t last_index;
+    _Bool isleaf;};
+
+/* copy a packed B tree into the former four-malloc node layout */
+static struct split_B_node *copy_into_split_B_node(struct B_node *node)
+{
+    if (node == NULL) return NULL;
+    struct split_B_node *copy = (struct split_B_node *)malloc(sizeof(struct split_B_node));
+    copy->key = (int32_t *)malloc(MAX_DEGREE * sizeof(int32_t));
+    copy->child = (struct split_B_node **)malloc((MAX_DEGREE + 1) * sizeof(struct split_B_node *));
+    copy->fd = (int *)malloc(MAX_DEGREE * sizeof(int));
+    memcpy(copy->key, node->key, MAX_DEGREE * sizeof(int32_t));
+    memcpy(copy->fd, node->fd, MAX_DEGREE * sizeof(int));
+    copy->last_index = node->last_index;
+    copy->isleaf = node->isleaf;
+    for (int16_t i = 0; i <= MAX_DEGREE; i++)
+        copy->child[i] = copy_into_split_B_node(node->child[i]);
+    return copy;
+}
+
+static void delete_all_split_B_nodes(struct split_B_node *node)
+{
+    if (node == NULL) return;
+    for (int16_t i = 0; i <= node->last_index + 1; i++)
+        delete_all_split_B_nodes(node->child[i]);
+    free(node->key);
+    free(node->fd);
+    free(node->child);
+    free(node);
+    return;
+}
+
+/* the same binary search and descent as look_up_a_key_in_B_tree() */
+static int16_t look_up_a_key_in_split_B_tree(struct split_B_node *cur, int32_t unkown_key)
+{
+    while (cur)
+    {
+        int16_t left = 0, right = cur->last_index;
+        while (left <= right)
+        {
+            int16_t middle = left + ((right - left) >> 1);
+            if (cur->key[middle] == unkown_key)
+                return middle;
+            else if (cur->key[middle] > unkown_key)
+                right = middle - 1;
+            else left = middle + 1;
+        }
+        cur = cur->child[left];
+    }
+    return -1;
+}
+
+static int16_t look_up_a_key_in_packed_B_tree(struct B_node *cur, int32_t unkown_key)
+{
+    while (cur)
+    {
+        int16_t pos = look_up_a_key_pos_in_a_B_node(cur, unkown_key);
+        if (pos <= cur->last_index && cur->key[pos] == unkown_key)
+            return pos;
+        cur = cur->child[pos];
+    }
+    return -1;
+}
+
+static uint64_t xorshift64(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static double elapsed_ns(struct timespec *start, struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
+
+int main(void)
+{
+    int32_t *key_arr = (int32_t *)malloc(KEY_NUMBER * sizeof(int32_t));
+    int32_t *probe_arr = (int32_t *)malloc(LOOKUP_NUMBER * sizeof(int32_t));
+    if (key_arr == NULL || probe_arr == NULL)
+        perror("fail to allocate the key arrays"), exit(EXIT_FAILURE);
+    uint64_t state = 0x9E3779B97F4A7C15;
+    for (int32_t i = 0; i < KEY_NUMBER; i++) key_arr[i] = i;
+    for (int32_t i = KEY_NUMBER - 1; i > 0; i--)
+    {
+        int32_t j = xorshift64(&state) % (i + 1);
+        int32_t tmp = key_arr[i]; key_arr[i] = key_arr[j]; key_arr[j] = tmp;
+    }
+    for (int32_t i = 0; i < LOOKUP_NUMBER; i++)
+        probe_arr[i] = key_arr[xorshift64(&state) % KEY_NUMBER];
+
+    /* insert_a_key_in_B_tree() reports every key on stdout */
+    FILE *saved_stdout = fdopen(dup(fileno(stdout)), "w");
+    freopen("/dev/null", "w", stdout);
+    struct B_node *B_tree = NULL;
+    for (int32_t i = 0; i < KEY_NUMBER; i++)
+        insert_a_key_in_B_tree(&B_tree, key_arr[i], NULL);
+    struct split_B_node *split_B_tree = copy_into_split_B_node(B_tree);
+
+    struct timespec start, end;
+    int64_t found = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int32_t i = 0; i < LOOKUP_NUMBER; i++)
+        found += look_up_a_key_in_split_B_tree(split_B_tree, probe_arr[i]) >= 0;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    fprintf(saved_stdout, "before (key/child/fd in separate mallocs): %.1f ns per lookup, %" PRId64" found\n",
+    elapsed_ns(&start, &end) / LOOKUP_NUMBER, found);
+
+    found = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int32_t i = 0; i < LOOKUP_NUMBER; i++)
+        found += look_up_a_key_in_packed_B_tree(B_tree, probe_arr[i]) >= 0;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    fprintf(saved_stdout, "after (one 64-byte-aligned block per node): %.1f ns per lookup, %" PRId64" found\n",
+    elapsed_ns(&start, &end) / LOOKUP_NUMBER, found);
+
+    struct B_node **found_node = (struct B_node **)malloc(LOOKUP_NUMBER * sizeof(struct B_node *));
+    int16_t *found_pos = (int16_t *)malloc(LOOKUP_NUMBER * sizeof(int16_t));
+    if (found_node == NULL || found_pos == NULL)
+        perror("fail to allocate the result arrays"), exit(EXIT_FAILURE);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    found = look_up_keys_in_B_tree(&B_tree, probe_arr, LOOKUP_NUMBER, found_node, found_pos);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    fprintf(saved_stdout, "batched (%d keys descend together): %.1f ns per lookup, %" PRId64" found\n",
+    B_TREE_LOOKUP_GROUP, elapsed_ns(&start, &end) / LOOKUP_NUMBER, found);
+    for (int32_t i = 0; i < LOOKUP_NUMBER; i++)
+        if (found_pos[i] != look_up_a_key_in_packed_B_tree(B_tree, probe_arr[i]))
+            fprintf(saved_stdout, "batched lookup disagrees on key %" PRId32"\n", probe_arr[i]), exit(EXIT_FAILURE);
+
+    free(found_pos);
+    free(found_node);
+    fclose(saved_stdout);
+    delete_all_split_B_nodes(split_B_tree);
+    delete_all_nodes_in_B_tree(B_tree);
+    free(probe_arr);
+    free(key_arr);
+    return 0;
+}
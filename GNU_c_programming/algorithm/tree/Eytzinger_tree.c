@@ -0,0 +1,197 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+/* a read-only search tree kept in one array in Eytzinger (breadth-first)
+order: the root is at 1 and the children of k are at 2k and 2k + 1, so no
+pointer is stored and the top levels of every search share a few hot cache
+lines. A search goes down without a branch on the comparison, and fetches
+the cache line of the node four levels below ahead of time, which holds all
+16 of its descendants at that depth. */
+#define EYTZINGER_CACHE_LINE_SIZE 64
+#define EYTZINGER_KEYS_PER_LINE (EYTZINGER_CACHE_LINE_SIZE / sizeof(int32_t))
+
+struct Eytzinger_tree {
+    /* key[0] is unused, key[1..key_number] hold the tree */
+    int32_t *key;
+    /* value[k] belongs to key[k], or value is NULL */
+    int64_t *value;
+    int64_t key_number;};
+
+/* sorted keys and their values gathered from an in-order traversal */
+struct Eytzinger_builder {
+    int32_t *key;
+    int64_t *value;
+    int64_t key_number, capacity;
+    _Bool has_value;};
+
+/* lay the sorted keys of subtree k out in order, taking them from *next on */
+static void fill_an_Eytzinger_subtree(struct Eytzinger_tree *tree, const int32_t *sorted_key,
+const int64_t *value, int64_t *next, int64_t k)
+{
+    if (k > tree->key_number) return;
+    fill_an_Eytzinger_subtree(tree, sorted_key, value, next, k << 1);
+    tree->key[k] = sorted_key[*next];
+    if (value) tree->value[k] = value[*next];
+    (*next)++;
+    fill_an_Eytzinger_subtree(tree, sorted_key, value, next, (k << 1) + 1);
+    return;
+}
+
+/* build the tree from len strictly increasing keys, with their values if
+value is not NULL. Return NULL if the keys are not strictly increasing. */
+struct Eytzinger_tree *build_Eytzinger_tree(const int32_t *sorted_key, const int64_t *value, int64_t len)
+{
+    for (int64_t i = 1; i < len; i++)
+        if (sorted_key[i] <= sorted_key[i - 1])
+        {
+            fprintf(stderr, "building failed. Key %" PRId32" at %" PRId64" is not greater than its predecessor.\n",
+            sorted_key[i], i);
+            return NULL;
+        }
+    struct Eytzinger_tree *tree = (struct Eytzinger_tree *)malloc(sizeof(struct Eytzinger_tree));
+    if (tree == NULL)
+        perror("fail to allocate an Eytzinger tree"), exit(EXIT_FAILURE);
+    tree->key_number = len;
+    /* aligned, so that the 16 descendants four levels down share one line */
+    size_t key_bytes = ((len + 1) * sizeof(int32_t) + EYTZINGER_CACHE_LINE_SIZE - 1)
+    & ~(size_t)(EYTZINGER_CACHE_LINE_SIZE - 1);
+    tree->key = (int32_t *)aligned_alloc(EYTZINGER_CACHE_LINE_SIZE, key_bytes);
+    tree->value = value ? (int64_t *)malloc((len + 1) * sizeof(int64_t)) : NULL;
+    if (tree->key == NULL || (value && tree->value == NULL))
+        perror("fail to allocate an Eytzinger tree"), exit(EXIT_FAILURE);
+    tree->key[0] = INT32_MIN;
+    int64_t next = 0;
+    fill_an_Eytzinger_subtree(tree, sorted_key, value, &next, 1);
+    return tree;
+}
+
+void destroy_Eytzinger_tree(struct Eytzinger_tree *tree)
+{
+    free(tree->key);
+    free(tree->value);
+    free(tree);
+    return;
+}
+
+/* return the index of the smallest key not less than key, or 0 if every
+key is less. The loop takes the right child exactly when key[k] < key, so
+k ends as the path to the answer followed by a 1 and then only 0s; cutting
+off those trailing 0s and the 1 gives the answer. */
+int64_t lower_bound_in_Eytzinger_tree(const struct Eytzinger_tree *tree, int32_t key)
+{
+    const int32_t *tree_key = tree->key;
+    uint64_t k = 1, key_number = (uint64_t)tree->key_number;
+    while (k <= key_number)
+    {
+        __builtin_prefetch(tree_key + k * EYTZINGER_KEYS_PER_LINE);
+        k = (k << 1) + (tree_key[k] < key);
+    }
+    k >>= __builtin_ctzll(~k) + 1;
+    return (int64_t)k;
+}
+
+/* return 0 and the value of key through value if it is not NULL, or -1 if
+key is absent. A tree built without values gives nothing through value. */
+int look_up_a_key_in_Eytzinger_tree(const struct Eytzinger_tree *tree, int32_t key, int64_t *value)
+{
+    int64_t k = lower_bound_in_Eytzinger_tree(tree, key);
+    if (k == 0 || tree->key[k] != key) return -1;
+    if (value && tree->value) *value = tree->value[k];
+    return 0;
+}
+
+/* the index of the next key in order after k, or 0 after the last one */
+int64_t next_in_Eytzinger_tree(const struct Eytzinger_tree *tree, int64_t k)
+{
+    if ((k << 1) + 1 <= tree->key_number)
+    {
+        /* the leftmost node of the right subtree */
+        k = (k << 1) + 1;
+        while (k << 1 <= tree->key_number) k <<= 1;
+        return k;
+    }
+    /* climb while k is a right child, then once more */
+    uint64_t path = (uint64_t)k;
+    path >>= __builtin_ctzll(~path) + 1;
+    return (int64_t)path;
+}
+
+void init_Eytzinger_builder(struct Eytzinger_builder *builder)
+{
+    builder->key = NULL, builder->value = NULL;
+    builder->key_number = builder->capacity = 0;
+    builder->has_value = 0;
+    return;
+}
+
+static int append_to_an_Eytzinger_builder(struct Eytzinger_builder *builder, int32_t key, int64_t value)
+{
+    if (builder->key_number && key <= builder->key[builder->key_number - 1])
+    {
+        fprintf(stderr, "building failed. Key %" PRId32" is not greater than its predecessor.\n", key);
+        return -1;
+    }
+    if (builder->key_number == builder->capacity)
+    {
+        builder->capacity = builder->capacity ? builder->capacity << 1 : 4096;
+        builder->key = (int32_t *)realloc(builder->key, builder->capacity * sizeof(int32_t));
+        builder->value = (int64_t *)realloc(builder->value, builder->capacity * sizeof(int64_t));
+        if (builder->key == NULL || builder->value == NULL)
+            perror("fail to grow an Eytzinger builder"), exit(EXIT_FAILURE);
+    }
+    builder->key[builder->key_number] = key;
+    builder->value[builder->key_number++] = value;
+    return 0;
+}
+
+/* a visitor for trav_to_BST() and inorder_trav_to_AVL() in BST_inorder:
+append key_number keys to builder. Return 0, or -1 to stop a traversal
+whose keys are out of order. */
+int append_keys_to_Eytzinger_builder(const int32_t *key, int32_t key_number, void *builder)
+{
+    for (int32_t i = 0; i < key_number; i++)
+        if (append_to_an_Eytzinger_builder((struct Eytzinger_builder *)builder, key[i], 0))
+            return -1;
+    return 0;
+}
+
+/* a visitor for trav_to_B_tree() in B_inorder, which keeps the file
+descriptors as the values */
+int append_B_keys_to_Eytzinger_builder(const int32_t *key, const int *fd, int32_t key_number, void *builder)
+{
+    ((struct Eytzinger_builder *)builder)->has_value = 1;
+    for (int32_t i = 0; i < key_number; i++)
+        if (append_to_an_Eytzinger_builder((struct Eytzinger_builder *)builder, key[i], fd[i]))
+            return -1;
+    return 0;
+}
+
+/* a visitor for inorder_trav_to_RBT(), whose keys have to fit in int32_t */
+int append_int64_keys_to_Eytzinger_builder(const int64_t *key, int32_t key_number, void *builder)
+{
+    for (int32_t i = 0; i < key_number; i++)
+    {
+        if (key[i] < INT32_MIN || key[i] > INT32_MAX)
+        {
+            fprintf(stderr, "building failed. Key %" PRId64" is out of range.\n", key[i]);
+            return -1;
+        }
+        if (append_to_an_Eytzinger_builder((struct Eytzinger_builder *)builder, (int32_t)key[i], 0))
+            return -1;
+    }
+    return 0;
+}
+
+/* build the tree from every key appended so far and empty the builder */
+struct Eytzinger_tree *finish_Eytzinger_builder(struct Eytzinger_builder *builder)
+{
+    struct Eytzinger_tree *tree = build_Eytzinger_tree(builder->key,
+    builder->has_value ? builder->value : NULL, builder->key_number);
+    free(builder->key);
+    free(builder->value);
+    init_Eytzinger_builder(builder);
+    return tree;
+}
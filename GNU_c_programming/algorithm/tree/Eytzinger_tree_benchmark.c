@@ -0,0 +1,136 @@
+/* lookup latency and heap bytes per key of an AVL tree against the
+Eytzinger tree built from its in-order traversal, and against binary search
+over the same sorted array, on uniformly random hits. The AVL and binary
+search look-ups report misses on stderr, so only present keys are probed.
+
+    gcc -O2 Eytzinger_tree_benchmark.c -o Eytzinger_tree_benchmark
+    ./Eytzinger_tree_benchmark [key_number] */
+#define _GNU_SOURCE
+#include <malloc.h>
+#include <time.h>
+#include <unistd.h>
+/* AVL_tree.c has a main() of its own */
+#define main AVL_main
+#include "AVL_tree.c"
+#undef main
+#include "Eytzinger_tree.c"
+#define DEFAULT_KEY_NUMBER 4000000
+#define LOOKUP_NUMBER 8000000
+
+static uint64_t xorshift64(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static double elapsed_ns(struct timespec *start, struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
+
+static size_t heap_in_use(void)
+{
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+static int binary_search_in_a_sorted_array(const int32_t *sorted_key, int64_t len, int32_t key)
+{
+    int64_t left = 0, right = len;
+    while (left < right)
+    {
+        int64_t middle = left + ((right - left) >> 1);
+        if (sorted_key[middle] < key) left = middle + 1;
+        else right = middle;
+    }
+    return left < len && sorted_key[left] == key ? 0 : -1;
+}
+
+static void free_all_AVL_nodes(struct AVL_node *node)
+{
+    while (node)
+    {
+        free_all_AVL_nodes(node->next[left]);
+        struct AVL_node *right_child = node->next[right];
+        free_an_AVL_node(node);
+        node = right_child;
+    }
+    return;
+}
+
+int main(int argc, char *argv[])
+{
+    int64_t key_number = argc > 1 ? atoll(argv[1]) : DEFAULT_KEY_NUMBER;
+    if (key_number < 1)
+    {
+        fprintf(stderr, "usage: %s [key_number >= 1]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (key_number > INT32_MAX) key_number = INT32_MAX;
+    int32_t *probe = (int32_t *)malloc(LOOKUP_NUMBER * sizeof(int32_t));
+    if (probe == NULL)
+        perror("fail to allocate the probes"), exit(EXIT_FAILURE);
+    uint64_t state = 0x9E3779B97F4A7C15;
+    /* insert_a_key_in_AVL() reports every key on stdout */
+    FILE *report = fdopen(dup(fileno(stdout)), "w");
+    if (report == NULL || freopen("/dev/null", "w", stdout) == NULL)
+        perror("fail to redirect stdout"), exit(EXIT_FAILURE);
+
+    struct AVL_node *AVL_tree = NULL;
+    size_t heap_before = heap_in_use();
+    /* an odd multiplier permutes [0, 2^31), so the keys are distinct and unordered */
+    for (int64_t i = 0; i < key_number; i++)
+        insert_a_key_in_AVL(&AVL_tree, (int32_t)((uint32_t)i * 2654435761u & INT32_MAX), NULL);
+    size_t AVL_bytes = heap_in_use() - heap_before;
+
+    struct Eytzinger_builder builder;
+    init_Eytzinger_builder(&builder);
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    inorder_trav_to_AVL(&AVL_tree, append_keys_to_Eytzinger_builder, &builder);
+    /* keep a copy of the sorted keys for binary search */
+    int32_t *sorted_key = (int32_t *)malloc(key_number * sizeof(int32_t));
+    if (sorted_key == NULL)
+        perror("fail to allocate the sorted keys"), exit(EXIT_FAILURE);
+    memcpy(sorted_key, builder.key, key_number * sizeof(int32_t));
+    struct Eytzinger_tree *tree = finish_Eytzinger_builder(&builder);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    size_t Eytzinger_bytes = sizeof(struct Eytzinger_tree) + malloc_usable_size(tree->key);
+    for (int32_t i = 0; i < LOOKUP_NUMBER; i++)
+        probe[i] = sorted_key[xorshift64(&state) % key_number];
+    fprintf(report, "%" PRId64" keys, Eytzinger tree built from the AVL tree in %.1f ms\n",
+    key_number, elapsed_ns(&start, &end) / 1e6);
+
+    int64_t found = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int32_t i = 0; i < LOOKUP_NUMBER; i++)
+        found += look_up_a_key_in_AVL(&AVL_tree, probe[i]) != NULL;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    fprintf(report, "%-16s %6.1f bytes/key, lookup %6.1f ns, %" PRId64" found\n", "AVL",
+    (double)AVL_bytes / key_number, elapsed_ns(&start, &end) / LOOKUP_NUMBER, found);
+
+    found = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int32_t i = 0; i < LOOKUP_NUMBER; i++)
+        found += binary_search_in_a_sorted_array(sorted_key, key_number, probe[i]) == 0;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    fprintf(report, "%-16s %6.1f bytes/key, lookup %6.1f ns, %" PRId64" found\n", "sorted array",
+    (double)sizeof(int32_t), elapsed_ns(&start, &end) / LOOKUP_NUMBER, found);
+
+    found = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int32_t i = 0; i < LOOKUP_NUMBER; i++)
+        found += look_up_a_key_in_Eytzinger_tree(tree, probe[i], NULL) == 0;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    fprintf(report, "%-16s %6.1f bytes/key, lookup %6.1f ns, %" PRId64" found\n", "Eytzinger",
+    (double)Eytzinger_bytes / key_number, elapsed_ns(&start, &end) / LOOKUP_NUMBER, found);
+
+    destroy_Eytzinger_tree(tree);
+    free(sorted_key);
+    free_all_AVL_nodes(AVL_tree);
+    free(probe);
+    fclose(report);
+    return 0;
+}
@@ -0,0 +1,829 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include "../circle_multilist_graph/skip_list.c"
+/* a log-structured merge tree in a directory. Puts and deletes go into a
+skip list (the memtable); a full memtable is written out as an immutable
+sorted run file in level 0. A run file is a sequence of LSM_BLOCK_SIZE
+blocks of sorted entries, followed by the first key of every block (the
+block index), a bloom filter of its keys and a footer. Level 0 runs may
+overlap; in every deeper level the runs cover disjoint key ranges and the
+level holds LSM_LEVEL_RATIO times more entries than the one above. A level
+over its limit is merged into the next one (leveled compaction) by a k-way
+merge over a heap of run cursors. The MANIFEST file names the runs of every
+level, and is replaced by rename() after each flush and compaction.
+A delete is a put of LSM_TOMBSTONE, which can not be stored as a value.
+Puts, deletes, look-ups and scans run concurrently; a flush and the
+compactions after it stop them. The memtable is not logged, so the puts
+since the last flush are lost in a crash. */
+#define LSM_TOMBSTONE INT64_MIN
+#define LSM_BLOCK_SIZE 4096
+#define LSM_MEMTABLE_ENTRIES (1 << 16)
+#define LSM_LEVEL0_RUN_LIMIT 4
+#define LSM_LEVEL1_ENTRIES (4 * LSM_MEMTABLE_ENTRIES)
+#define LSM_LEVEL_RATIO 10
+#define LSM_MAX_LEVEL 7
+/* a compaction cuts its output into runs of about this many entries */
+#define LSM_RUN_ENTRIES (1 << 18)
+#define LSM_BLOOM_BITS_PER_KEY 10
+#define LSM_BLOOM_HASH_NUMBER 7
+#define LSM_RUN_MAGIC 0x4C534D52u
+
+struct LSM_entry {
+    int32_t key;
+    int64_t value;} __attribute__((packed));
+
+#define LSM_BLOCK_ENTRIES ((LSM_BLOCK_SIZE - sizeof(uint32_t)) / sizeof(struct LSM_entry))
+
+struct LSM_block {
+    uint32_t entry_number;
+    struct LSM_entry entry[LSM_BLOCK_ENTRIES];};
+_Static_assert(sizeof(struct LSM_block) == LSM_BLOCK_SIZE, "an LSM block has to fill a page");
+
+struct LSM_run_footer {
+    uint64_t index_offset, bloom_offset;
+    int64_t entry_number;
+    uint32_t block_number, bloom_bits;
+    int32_t min_key, max_key;
+    uint32_t magic;} __attribute__((packed));
+
+/* an open run file, with its block index and bloom filter in memory */
+struct LSM_run {
+    uint32_t file_number;
+    int fd;
+    int64_t entry_number;
+    uint32_t block_number, bloom_bits;
+    int32_t min_key, max_key;
+    int32_t *first_key;
+    uint8_t *bloom;};
+
+struct LSM_level {
+    struct LSM_run **run;
+    int32_t run_number, run_capacity;
+    int64_t entry_number;};
+
+struct LSM_tree {
+    char *dir;
+    pthread_rwlock_t latch;
+    struct skip_list *memtable;
+    _Atomic int32_t memtable_entries;
+    /* level 0 from the newest run to the oldest, deeper levels in key order */
+    struct LSM_level level[LSM_MAX_LEVEL];
+    uint32_t next_file_number;};
+
+static uint64_t hash_an_LSM_key(int32_t key)
+{
+    uint64_t hash = (uint32_t)key * 0x9E3779B97F4A7C15ull;
+    hash ^= hash >> 32;
+    hash *= 0xD6E8FEB86659FD93ull;
+    return hash ^ (hash >> 32);
+}
+
+/* the hash_number probes are spread by double hashing */
+static void add_a_key_to_an_LSM_bloom(uint8_t *bloom, uint32_t bloom_bits, int32_t key)
+{
+    uint64_t hash = hash_an_LSM_key(key);
+    uint32_t h1 = (uint32_t)hash, h2 = (uint32_t)(hash >> 32) | 1;
+    for (uint32_t i = 0; i < LSM_BLOOM_HASH_NUMBER; i++, h1 += h2)
+        bloom[(h1 % bloom_bits) >> 3] |= 1 << ((h1 % bloom_bits) & 7);
+    return;
+}
+
+static _Bool key_may_be_in_an_LSM_run(const struct LSM_run *run, int32_t key)
+{
+    if (key < run->min_key || key > run->max_key) return 0;
+    uint64_t hash = hash_an_LSM_key(key);
+    uint32_t h1 = (uint32_t)hash, h2 = (uint32_t)(hash >> 32) | 1;
+    for (uint32_t i = 0; i < LSM_BLOOM_HASH_NUMBER; i++, h1 += h2)
+        if (!(run->bloom[(h1 % run->bloom_bits) >> 3] & (1 << ((h1 % run->bloom_bits) & 7))))
+            return 0;
+    return 1;
+}
+
+static void name_an_LSM_run(const struct LSM_tree *lsm, uint32_t file_number, char *path)
+{
+    snprintf(path, PATH_MAX, "%s/run-%06" PRIu32".sst", lsm->dir, file_number);
+    return;
+}
+
+static void close_an_LSM_run(struct LSM_run *run)
+{
+    close(run->fd);
+    free(run->first_key);
+    free(run->bloom);
+    free(run);
+    return;
+}
+
+static struct LSM_run *open_an_LSM_run(const struct LSM_tree *lsm, uint32_t file_number)
+{
+    char path[PATH_MAX];
+    name_an_LSM_run(lsm, file_number, path);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        fprintf(stderr, "fail to open the run %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    struct stat file_stat;
+    struct LSM_run_footer footer;
+    if (fstat(fd, &file_stat) || file_stat.st_size < (off_t)sizeof(footer)
+    || pread(fd, &footer, sizeof(footer), file_stat.st_size - sizeof(footer)) != sizeof(footer)
+    || footer.magic != LSM_RUN_MAGIC)
+    {
+        fprintf(stderr, "the run %s is damaged.\n", path);
+        close(fd);
+        return NULL;
+    }
+    struct LSM_run *run = (struct LSM_run *)malloc(sizeof(struct LSM_run));
+    if (run == NULL)
+        perror("fail to allocate an LSM run"), exit(EXIT_FAILURE);
+    run->file_number = file_number, run->fd = fd;
+    run->entry_number = footer.entry_number;
+    run->block_number = footer.block_number, run->bloom_bits = footer.bloom_bits;
+    run->min_key = footer.min_key, run->max_key = footer.max_key;
+    run->first_key = (int32_t *)malloc(footer.block_number * sizeof(int32_t) + 1);
+    run->bloom = (uint8_t *)malloc((footer.bloom_bits >> 3) + 1);
+    if (run->first_key == NULL || run->bloom == NULL)
+        perror("fail to allocate an LSM run index"), exit(EXIT_FAILURE);
+    size_t index_len = footer.block_number * sizeof(int32_t), bloom_len = (footer.bloom_bits >> 3) + 1;
+    if (pread(fd, run->first_key, index_len, footer.index_offset) != (ssize_t)index_len
+    || pread(fd, run->bloom, bloom_len, footer.bloom_offset) != (ssize_t)bloom_len)
+    {
+        fprintf(stderr, "fail to read the index of the run %s.\n", path);
+        close_an_LSM_run(run);
+        return NULL;
+    }
+    return run;
+}
+
+static void read_an_LSM_block(const struct LSM_run *run, uint32_t block_no, struct LSM_block *block)
+{
+    if (pread(run->fd, block, LSM_BLOCK_SIZE, (off_t)block_no * LSM_BLOCK_SIZE) != LSM_BLOCK_SIZE)
+        perror("fail to read an LSM block"), exit(EXIT_FAILURE);
+    return;
+}
+
+/* the last block whose first key is not greater than key, or 0 */
+static uint32_t look_up_a_block_in_an_LSM_run(const struct LSM_run *run, int32_t key)
+{
+    uint32_t left = 0, right = run->block_number;
+    while (right - left > 1)
+    {
+        uint32_t middle = left + ((right - left) >> 1);
+        if (run->first_key[middle] <= key) left = middle;
+        else right = middle;
+    }
+    return left;
+}
+
+/* the first pos in block whose key is not less than key */
+static uint32_t look_up_a_pos_in_an_LSM_block(const struct LSM_block *block, int32_t key)
+{
+    uint32_t left = 0, right = block->entry_number;
+    while (left < right)
+    {
+        uint32_t middle = left + ((right - left) >> 1);
+        if (block->entry[middle].key < key) left = middle + 1;
+        else right = middle;
+    }
+    return left;
+}
+
+/* a run file being written, whose block index and bloom filter are kept
+in memory until the footer is written */
+struct LSM_run_writer {
+    uint32_t file_number;
+    int fd;
+    struct LSM_block *block;
+    int32_t *first_key;
+    uint32_t block_number, block_capacity;
+    uint8_t *bloom;
+    uint32_t bloom_bits;
+    int64_t entry_number;
+    int32_t min_key, max_key;};
+
+/* expected_entries sizes the bloom filter, and may be an upper bound */
+static void open_an_LSM_run_writer(struct LSM_tree *lsm, struct LSM_run_writer *writer, int64_t expected_entries)
+{
+    char path[PATH_MAX];
+    writer->file_number = lsm->next_file_number++;
+    name_an_LSM_run(lsm, writer->file_number, path);
+    writer->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (writer->fd < 0)
+        perror("fail to create an LSM run"), exit(EXIT_FAILURE);
+    writer->block = (struct LSM_block *)malloc(LSM_BLOCK_SIZE);
+    writer->block_number = 0, writer->block_capacity = 64;
+    writer->first_key = (int32_t *)malloc(writer->block_capacity * sizeof(int32_t));
+    writer->bloom_bits = (uint32_t)(expected_entries * LSM_BLOOM_BITS_PER_KEY) | 64;
+    writer->bloom = (uint8_t *)calloc((writer->bloom_bits >> 3) + 1, 1);
+    if (writer->block == NULL || writer->first_key == NULL || writer->bloom == NULL)
+        perror("fail to allocate an LSM run writer"), exit(EXIT_FAILURE);
+    writer->block->entry_number = 0;
+    writer->entry_number = 0;
+    return;
+}
+
+static void flush_a_block_of_an_LSM_run_writer(struct LSM_run_writer *writer)
+{
+    if (writer->block->entry_number == 0) return;
+    if (writer->block_number == writer->block_capacity)
+    {
+        writer->block_capacity <<= 1;
+        writer->first_key = (int32_t *)realloc(writer->first_key, writer->block_capacity * sizeof(int32_t));
+        if (writer->first_key == NULL)
+            perror("fail to allocate an LSM block index"), exit(EXIT_FAILURE);
+    }
+    writer->first_key[writer->block_number++] = writer->block->entry[0].key;
+    /* the unused tail of the block is written too, so blocks stay aligned */
+    memset(&writer->block->entry[writer->block->entry_number], 0,
+    (LSM_BLOCK_ENTRIES - writer->block->entry_number) * sizeof(struct LSM_entry));
+    if (write(writer->fd, writer->block, LSM_BLOCK_SIZE) != LSM_BLOCK_SIZE)
+        perror("fail to write an LSM block"), exit(EXIT_FAILURE);
+    writer->block->entry_number = 0;
+    return;
+}
+
+/* keys have to be appended in increasing order */
+static void append_an_entry_to_an_LSM_run_writer(struct LSM_run_writer *writer, int32_t key, int64_t value)
+{
+    if (writer->entry_number == 0) writer->min_key = key;
+    writer->max_key = key;
+    writer->block->entry[writer->block->entry_number].key = key;
+    writer->block->entry[writer->block->entry_number++].value = value;
+    add_a_key_to_an_LSM_bloom(writer->bloom, writer->bloom_bits, key);
+    writer->entry_number++;
+    if (writer->block->entry_number == LSM_BLOCK_ENTRIES)
+        flush_a_block_of_an_LSM_run_writer(writer);
+    return;
+}
+
+/* write the index, the bloom filter and the footer, sync the file and
+open it as a run. An empty writer leaves no run and returns NULL. */
+static struct LSM_run *close_an_LSM_run_writer(struct LSM_tree *lsm, struct LSM_run_writer *writer)
+{
+    struct LSM_run *run = NULL;
+    flush_a_block_of_an_LSM_run_writer(writer);
+    if (writer->entry_number)
+    {
+        struct LSM_run_footer footer;
+        footer.index_offset = (uint64_t)writer->block_number * LSM_BLOCK_SIZE;
+        size_t index_len = writer->block_number * sizeof(int32_t), bloom_len = (writer->bloom_bits >> 3) + 1;
+        footer.bloom_offset = footer.index_offset + index_len;
+        footer.entry_number = writer->entry_number;
+        footer.block_number = writer->block_number, footer.bloom_bits = writer->bloom_bits;
+        footer.min_key = writer->min_key, footer.max_key = writer->max_key;
+        footer.magic = LSM_RUN_MAGIC;
+        if (write(writer->fd, writer->first_key, index_len) != (ssize_t)index_len
+        || write(writer->fd, writer->bloom, bloom_len) != (ssize_t)bloom_len
+        || write(writer->fd, &footer, sizeof(footer)) != sizeof(footer) || fsync(writer->fd))
+            perror("fail to finish an LSM run"), exit(EXIT_FAILURE);
+    }
+    close(writer->fd);
+    free(writer->block);
+    free(writer->first_key);
+    free(writer->bloom);
+    if (writer->entry_number)
+    {
+        if ((run = open_an_LSM_run(lsm, writer->file_number)) == NULL)
+            exit(EXIT_FAILURE);
+    }
+    else
+    {
+        char path[PATH_MAX];
+        name_an_LSM_run(lsm, writer->file_number, path);
+        unlink(path);
+    }
+    return run;
+}
+
+/* one input of a k-way merge: the memtable, or a run read block by block.
+rank orders the inputs from the newest, which wins on equal keys. */
+struct LSM_cursor {
+    int32_t key;
+    int64_t value;
+    int32_t rank;
+    struct LSM_run *run;
+    uint32_t block_no, pos;
+    struct LSM_block *block;
+    struct skip_list_iterator iter;
+    int32_t key_buf[64];
+    int64_t value_buf[64];
+    int32_t buffered, upper_key;};
+
+/* load the entry under cursor into key and value. Return -1 at the end. */
+static int advance_an_LSM_cursor(struct LSM_cursor *cursor)
+{
+    if (cursor->run == NULL)
+    {
+        if (cursor->pos == (uint32_t)cursor->buffered)
+        {
+            cursor->buffered = next_batch_in_skip_list(&cursor->iter, cursor->upper_key,
+            cursor->key_buf, cursor->value_buf, 64);
+            cursor->pos = 0;
+            if (cursor->buffered == 0) return -1;
+        }
+        cursor->key = cursor->key_buf[cursor->pos];
+        cursor->value = cursor->value_buf[cursor->pos++];
+    }
+    else
+    {
+        while (cursor->pos == cursor->block->entry_number)
+        {
+            if (++cursor->block_no == cursor->run->block_number) return -1;
+            read_an_LSM_block(cursor->run, cursor->block_no, cursor->block);
+            cursor->pos = 0;
+        }
+        cursor->key = cursor->block->entry[cursor->pos].key;
+        cursor->value = cursor->block->entry[cursor->pos++].value;
+        if (cursor->key > cursor->upper_key) return -1;
+    }
+    return 0;
+}
+
+/* place a run cursor before the first key not less than lower_key */
+static void seek_an_LSM_run_cursor(struct LSM_cursor *cursor, struct LSM_run *run, int32_t rank,
+int32_t lower_key, int32_t upper_key)
+{
+    cursor->run = run, cursor->rank = rank, cursor->upper_key = upper_key;
+    cursor->block = (struct LSM_block *)malloc(LSM_BLOCK_SIZE);
+    if (cursor->block == NULL)
+        perror("fail to allocate an LSM cursor block"), exit(EXIT_FAILURE);
+    cursor->block_no = look_up_a_block_in_an_LSM_run(run, lower_key);
+    read_an_LSM_block(run, cursor->block_no, cursor->block);
+    cursor->pos = look_up_a_pos_in_an_LSM_block(cursor->block, lower_key);
+    return;
+}
+
+static void close_an_LSM_cursor(struct LSM_cursor *cursor)
+{
+    if (cursor->run) free(cursor->block);
+    else close_a_skip_list_iterator(&cursor->iter);
+    return;
+}
+
+static _Bool is_an_LSM_cursor_before(const struct LSM_cursor *a, const struct LSM_cursor *b)
+{
+    return a->key < b->key || (a->key == b->key && a->rank < b->rank);
+}
+
+/* the same sift-down as min_bin_heapify(), over cursors */
+static void heapify_LSM_cursors(struct LSM_cursor **heap, int32_t len, int32_t start)
+{
+    int32_t cur = start, min_child = (cur << 1) + 1;
+    while (min_child < len)
+    {
+        if (min_child + 1 < len && is_an_LSM_cursor_before(heap[min_child + 1], heap[min_child]))
+            min_child++;
+        if (!is_an_LSM_cursor_before(heap[min_child], heap[cur])) return;
+        struct LSM_cursor *tmp = heap[cur]; heap[cur] = heap[min_child]; heap[min_child] = tmp;
+        cur = min_child;
+        min_child = (cur << 1) + 1;
+    }
+    return;
+}
+
+/* a k-way merge: the newest version of every key, in key order */
+struct LSM_merge {
+    struct LSM_cursor *cursor;
+    struct LSM_cursor **heap;
+    int32_t cursor_number, heap_len;};
+
+static void open_an_LSM_merge(struct LSM_merge *merge, int32_t capacity)
+{
+    merge->cursor = (struct LSM_cursor *)calloc(capacity, sizeof(struct LSM_cursor));
+    merge->heap = (struct LSM_cursor **)malloc(capacity * sizeof(struct LSM_cursor *));
+    if (merge->cursor == NULL || merge->heap == NULL)
+        perror("fail to allocate an LSM merge"), exit(EXIT_FAILURE);
+    merge->cursor_number = merge->heap_len = 0;
+    return;
+}
+
+static void add_a_run_to_an_LSM_merge(struct LSM_merge *merge, struct LSM_run *run, int32_t lower_key, int32_t upper_key)
+{
+    struct LSM_cursor *cursor = &merge->cursor[merge->cursor_number];
+    seek_an_LSM_run_cursor(cursor, run, merge->cursor_number++, lower_key, upper_key);
+    if (advance_an_LSM_cursor(cursor) == 0)
+        merge->heap[merge->heap_len++] = cursor;
+    return;
+}
+
+static void add_a_memtable_to_an_LSM_merge(struct LSM_merge *merge, struct skip_list *memtable,
+int32_t lower_key, int32_t upper_key)
+{
+    struct LSM_cursor *cursor = &merge->cursor[merge->cursor_number];
+    cursor->run = NULL, cursor->rank = merge->cursor_number++, cursor->upper_key = upper_key;
+    cursor->pos = cursor->buffered = 0;
+    lower_bound_in_skip_list(memtable, lower_key, &cursor->iter);
+    if (advance_an_LSM_cursor(cursor) == 0)
+        merge->heap[merge->heap_len++] = cursor;
+    return;
+}
+
+/* give the smallest key of the merge and its newest value, and skip its
+older versions. Return -1 when every input is drained. */
+static int next_entry_in_an_LSM_merge(struct LSM_merge *merge, int32_t *key, int64_t *value)
+{
+    if (merge->heap_len == 0) return -1;
+    *key = merge->heap[0]->key, *value = merge->heap[0]->value;
+    while (merge->heap_len && merge->heap[0]->key == *key)
+    {
+        if (advance_an_LSM_cursor(merge->heap[0]))
+            merge->heap[0] = merge->heap[--merge->heap_len];
+        heapify_LSM_cursors(merge->heap, merge->heap_len, 0);
+    }
+    return 0;
+}
+
+static void close_an_LSM_merge(struct LSM_merge *merge)
+{
+    for (int32_t i = 0; i < merge->cursor_number; i++)
+        close_an_LSM_cursor(&merge->cursor[i]);
+    free(merge->cursor);
+    free(merge->heap);
+    return;
+}
+
+static void start_an_LSM_merge(struct LSM_merge *merge)
+{
+    for (int32_t i = (merge->heap_len >> 1) - 1; i >= 0; i--)
+        heapify_LSM_cursors(merge->heap, merge->heap_len, i);
+    return;
+}
+
+static void insert_a_run_in_an_LSM_level(struct LSM_level *level, int32_t pos, struct LSM_run *run)
+{
+    if (level->run_number == level->run_capacity)
+    {
+        level->run_capacity = level->run_capacity ? level->run_capacity << 1 : 16;
+        level->run = (struct LSM_run **)realloc(level->run, level->run_capacity * sizeof(struct LSM_run *));
+        if (level->run == NULL)
+            perror("fail to allocate an LSM level"), exit(EXIT_FAILURE);
+    }
+    memmove(&level->run[pos + 1], &level->run[pos], (level->run_number - pos) * sizeof(struct LSM_run *));
+    level->run[pos] = run;
+    level->run_number++;
+    level->entry_number += run->entry_number;
+    return;
+}
+
+/* write the run list of every level to MANIFEST.tmp, then rename it over MANIFEST */
+static void write_the_LSM_manifest(struct LSM_tree *lsm)
+{
+    char path[PATH_MAX], tmp_path[PATH_MAX];
+    snprintf(path, PATH_MAX, "%s/MANIFEST", lsm->dir);
+    snprintf(tmp_path, PATH_MAX, "%s/MANIFEST.tmp", lsm->dir);
+    FILE *manifest = fopen(tmp_path, "w");
+    if (manifest == NULL)
+        perror("fail to write the LSM manifest"), exit(EXIT_FAILURE);
+    fprintf(manifest, "%" PRIu32"\n", lsm->next_file_number);
+    for (int32_t i = 0; i < LSM_MAX_LEVEL; i++)
+        for (int32_t j = 0; j < lsm->level[i].run_number; j++)
+            fprintf(manifest, "%" PRId32" %" PRIu32"\n", i, lsm->level[i].run[j]->file_number);
+    if (fflush(manifest) || fsync(fileno(manifest)) || fclose(manifest) || rename(tmp_path, path))
+        perror("fail to write the LSM manifest"), exit(EXIT_FAILURE);
+    /* the rename is only durable once the directory is synced */
+    int dir_fd = open(lsm->dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd < 0 || fsync(dir_fd))
+        perror("fail to sync the LSM directory"), exit(EXIT_FAILURE);
+    close(dir_fd);
+    return;
+}
+
+/* move the runs [first, first + number) of a level to detached, which the
+caller deletes with delete_detached_LSM_runs() once the manifest is written */
+static void detach_runs_from_an_LSM_level(struct LSM_level *level, int32_t first, int32_t number,
+struct LSM_run **detached)
+{
+    if (number == 0) return;
+    memcpy(detached, &level->run[first], number * sizeof(struct LSM_run *));
+    for (int32_t i = 0; i < number; i++)
+        level->entry_number -= detached[i]->entry_number;
+    memmove(&level->run[first], &level->run[first + number], (level->run_number - first - number) * sizeof(struct LSM_run *));
+    level->run_number -= number;
+    return;
+}
+
+static void delete_detached_LSM_runs(struct LSM_tree *lsm, struct LSM_run **detached, int32_t number)
+{
+    char path[PATH_MAX];
+    for (int32_t i = 0; i < number; i++)
+    {
+        name_an_LSM_run(lsm, detached[i]->file_number, path);
+        close_an_LSM_run(detached[i]);
+        unlink(path);
+    }
+    return;
+}
+
+static int64_t entry_limit_of_an_LSM_level(int32_t level_no)
+{
+    int64_t limit = LSM_LEVEL1_ENTRIES;
+    for (int32_t i = 1; i < level_no; i++) limit *= LSM_LEVEL_RATIO;
+    return limit;
+}
+
+/* merge the runs of level_no in [first, first + number) with the runs of
+the next level which they overlap, and put the merged runs there. */
+static void compact_LSM_runs_into_the_next_level(struct LSM_tree *lsm, int32_t level_no, int32_t first, int32_t number)
+{
+    struct LSM_level *upper = &lsm->level[level_no], *lower = &lsm->level[level_no + 1];
+    int32_t min_key = INT32_MAX, max_key = INT32_MIN;
+    int64_t input_entries = 0;
+    for (int32_t i = first; i < first + number; i++)
+    {
+        if (upper->run[i]->min_key < min_key) min_key = upper->run[i]->min_key;
+        if (upper->run[i]->max_key > max_key) max_key = upper->run[i]->max_key;
+        input_entries += upper->run[i]->entry_number;
+    }
+    int32_t lower_first = 0, lower_number = 0;
+    while (lower_first < lower->run_number && lower->run[lower_first]->max_key < min_key)
+        lower_first++;
+    while (lower_first + lower_number < lower->run_number && lower->run[lower_first + lower_number]->min_key <= max_key)
+        input_entries += lower->run[lower_first + lower_number++]->entry_number;
+    /* a tombstone is needed as long as an older value may lie below the output */
+    _Bool dropping_tombstones = 1;
+    for (int32_t i = level_no + 2; i < LSM_MAX_LEVEL; i++)
+        if (lsm->level[i].run_number) dropping_tombstones = 0;
+    struct LSM_merge merge;
+    open_an_LSM_merge(&merge, number + lower_number);
+    /* the upper runs are newer, and in level 0 the first run is the newest */
+    for (int32_t i = first; i < first + number; i++)
+        add_a_run_to_an_LSM_merge(&merge, upper->run[i], INT32_MIN, INT32_MAX);
+    for (int32_t i = lower_first; i < lower_first + lower_number; i++)
+        add_a_run_to_an_LSM_merge(&merge, lower->run[i], INT32_MIN, INT32_MAX);
+    start_an_LSM_merge(&merge);
+    struct LSM_run_writer writer;
+    struct LSM_run **output = NULL;
+    int32_t output_number = 0;
+    int32_t key;
+    int64_t value;
+    _Bool writing = 0;
+    while (next_entry_in_an_LSM_merge(&merge, &key, &value) == 0)
+    {
+        if (dropping_tombstones && value == LSM_TOMBSTONE) continue;
+        if (!writing)
+        {
+            open_an_LSM_run_writer(lsm, &writer, input_entries < LSM_RUN_ENTRIES ? input_entries : LSM_RUN_ENTRIES);
+            writing = 1;
+        }
+        append_an_entry_to_an_LSM_run_writer(&writer, key, value);
+        if (writer.entry_number == LSM_RUN_ENTRIES)
+        {
+            output = (struct LSM_run **)realloc(output, (output_number + 1) * sizeof(struct LSM_run *));
+            output[output_number++] = close_an_LSM_run_writer(lsm, &writer);
+            input_entries -= LSM_RUN_ENTRIES;
+            writing = 0;
+        }
+    }
+    if (writing)
+    {
+        output = (struct LSM_run **)realloc(output, (output_number + 1) * sizeof(struct LSM_run *));
+        if ((output[output_number] = close_an_LSM_run_writer(lsm, &writer)))
+            output_number++;
+    }
+    close_an_LSM_merge(&merge);
+    /* the inputs of both levels are deleted only after the manifest stops
+    naming them, so a crash before the rename still finds every input */
+    struct LSM_run **input = (struct LSM_run **)malloc((number + lower_number) * sizeof(struct LSM_run *));
+    if (input == NULL)
+        perror("fail to allocate the LSM compaction inputs"), exit(EXIT_FAILURE);
+    detach_runs_from_an_LSM_level(upper, first, number, input);
+    detach_runs_from_an_LSM_level(lower, lower_first, lower_number, input + number);
+    for (int32_t i = 0; i < output_number; i++)
+        insert_a_run_in_an_LSM_level(lower, lower_first + i, output[i]);
+    free(output);
+    write_the_LSM_manifest(lsm);
+    delete_detached_LSM_runs(lsm, input, number + lower_number);
+    free(input);
+    return;
+}
+
+/* level 0 is merged whole into level 1 when it has too many runs; a deeper
+level over its limit gives its run with the fewest entries to the next. */
+static void compact_LSM_tree(struct LSM_tree *lsm)
+{
+    if (lsm->level[0].run_number > LSM_LEVEL0_RUN_LIMIT)
+        compact_LSM_runs_into_the_next_level(lsm, 0, 0, lsm->level[0].run_number);
+    for (int32_t i = 1; i < LSM_MAX_LEVEL - 1; i++)
+        while (lsm->level[i].entry_number > entry_limit_of_an_LSM_level(i))
+        {
+            int32_t smallest = 0;
+            for (int32_t j = 1; j < lsm->level[i].run_number; j++)
+                if (lsm->level[i].run[j]->entry_number < lsm->level[i].run[smallest]->entry_number)
+                    smallest = j;
+            compact_LSM_runs_into_the_next_level(lsm, i, smallest, 1);
+        }
+    return;
+}
+
+/* write the memtable out as the newest level 0 run. The caller holds latch exclusively. */
+static void flush_the_LSM_memtable(struct LSM_tree *lsm)
+{
+    if (atomic_load(&lsm->memtable_entries) == 0) return;
+    struct LSM_run_writer writer;
+    open_an_LSM_run_writer(lsm, &writer, atomic_load(&lsm->memtable_entries));
+    struct skip_list_iterator iter;
+    int32_t key_buf[256];
+    int64_t value_buf[256];
+    int32_t copied;
+    lower_bound_in_skip_list(lsm->memtable, INT32_MIN, &iter);
+    while ((copied = next_batch_in_skip_list(&iter, INT32_MAX, key_buf, value_buf, 256)) > 0)
+        for (int32_t i = 0; i < copied; i++)
+            append_an_entry_to_an_LSM_run_writer(&writer, key_buf[i], value_buf[i]);
+    close_a_skip_list_iterator(&iter);
+    struct LSM_run *run = close_an_LSM_run_writer(lsm, &writer);
+    if (run) insert_a_run_in_an_LSM_level(&lsm->level[0], 0, run);
+    write_the_LSM_manifest(lsm);
+    empty_a_skip_list(lsm->memtable);
+    atomic_store(&lsm->memtable_entries, 0);
+    compact_LSM_tree(lsm);
+    return;
+}
+
+/* open the LSM tree in dir, which is created if it does not exist */
+struct LSM_tree *open_LSM_tree(const char *dir)
+{
+    if (mkdir(dir, 0755) && errno != EEXIST)
+    {
+        fprintf(stderr, "fail to create %s: %s\n", dir, strerror(errno));
+        return NULL;
+    }
+    struct LSM_tree *lsm = (struct LSM_tree *)calloc(1, sizeof(struct LSM_tree));
+    if (lsm == NULL || (lsm->dir = strdup(dir)) == NULL)
+        perror("fail to allocate an LSM tree"), exit(EXIT_FAILURE);
+    pthread_rwlock_init(&lsm->latch, NULL);
+    lsm->memtable = init_skip_list();
+    atomic_init(&lsm->memtable_entries, 0);
+    char path[PATH_MAX];
+    snprintf(path, PATH_MAX, "%s/MANIFEST", dir);
+    FILE *manifest = fopen(path, "r");
+    if (manifest == NULL) return lsm;
+    int32_t level_no;
+    uint32_t file_number;
+    if (fscanf(manifest, "%" SCNu32, &lsm->next_file_number) != 1)
+        lsm->next_file_number = 0;
+    while (fscanf(manifest, "%" SCNd32" %" SCNu32, &level_no, &file_number) == 2)
+    {
+        struct LSM_run *run = open_an_LSM_run(lsm, file_number);
+        if (run == NULL || level_no < 0 || level_no >= LSM_MAX_LEVEL)
+        {
+            fprintf(stderr, "the LSM manifest in %s is damaged.\n", dir);
+            exit(EXIT_FAILURE);
+        }
+        insert_a_run_in_an_LSM_level(&lsm->level[level_no], lsm->level[level_no].run_number, run);
+    }
+    fclose(manifest);
+    return lsm;
+}
+
+/* flush the memtable, then close every run */
+void close_LSM_tree(struct LSM_tree *lsm)
+{
+    pthread_rwlock_wrlock(&lsm->latch);
+    flush_the_LSM_memtable(lsm);
+    pthread_rwlock_unlock(&lsm->latch);
+    for (int32_t i = 0; i < LSM_MAX_LEVEL; i++)
+    {
+        for (int32_t j = 0; j < lsm->level[i].run_number; j++)
+            close_an_LSM_run(lsm->level[i].run[j]);
+        free(lsm->level[i].run);
+    }
+    destroy_skip_list(lsm->memtable);
+    pthread_rwlock_destroy(&lsm->latch);
+    free(lsm->dir);
+    free(lsm);
+    return;
+}
+
+/* return 0, or -1 if value is LSM_TOMBSTONE. */
+int put_a_key_in_LSM_tree(struct LSM_tree *lsm, int32_t key, int64_t value)
+{
+    if (value == LSM_TOMBSTONE)
+    {
+        fputs("put failed. LSM_TOMBSTONE can not be stored as a value.\n", stderr);
+        return -1;
+    }
+    pthread_rwlock_rdlock(&lsm->latch);
+    _Bool full = put_a_key_in_skip_list(lsm->memtable, key, value) == 0
+    && atomic_fetch_add(&lsm->memtable_entries, 1) + 1 == LSM_MEMTABLE_ENTRIES;
+    pthread_rwlock_unlock(&lsm->latch);
+    /* only the put which filled the memtable flushes it */
+    if (full)
+    {
+        pthread_rwlock_wrlock(&lsm->latch);
+        flush_the_LSM_memtable(lsm);
+        pthread_rwlock_unlock(&lsm->latch);
+    }
+    return 0;
+}
+
+/* a delete is a put of a tombstone, which hides the older values of key
+until a compaction into the last level drops it. */
+int delete_a_key_in_LSM_tree(struct LSM_tree *lsm, int32_t key)
+{
+    pthread_rwlock_rdlock(&lsm->latch);
+    _Bool full = put_a_key_in_skip_list(lsm->memtable, key, LSM_TOMBSTONE) == 0
+    && atomic_fetch_add(&lsm->memtable_entries, 1) + 1 == LSM_MEMTABLE_ENTRIES;
+    pthread_rwlock_unlock(&lsm->latch);
+    if (full)
+    {
+        pthread_rwlock_wrlock(&lsm->latch);
+        flush_the_LSM_memtable(lsm);
+        pthread_rwlock_unlock(&lsm->latch);
+    }
+    return 0;
+}
+
+/* look key up in one run: the key range and the bloom filter first, then
+the block index and one block read. Return 1 if found. */
+static _Bool look_up_a_key_in_an_LSM_run(const struct LSM_run *run, int32_t key, int64_t *value,
+struct LSM_block *block)
+{
+    if (!key_may_be_in_an_LSM_run(run, key)) return 0;
+    read_an_LSM_block(run, look_up_a_block_in_an_LSM_run(run, key), block);
+    uint32_t pos = look_up_a_pos_in_an_LSM_block(block, key);
+    if (pos == block->entry_number || block->entry[pos].key != key) return 0;
+    *value = block->entry[pos].value;
+    return 1;
+}
+
+/* return 0 and the value of key through value, or -1 if absent. */
+int look_up_a_key_in_LSM_tree(struct LSM_tree *lsm, int32_t key, int64_t *value)
+{
+    int64_t found_value;
+    _Bool found = 0;
+    pthread_rwlock_rdlock(&lsm->latch);
+    if (look_up_a_key_in_skip_list(lsm->memtable, key, &found_value) == 0)
+        found = 1;
+    else
+    {
+        struct LSM_block *block = (struct LSM_block *)malloc(LSM_BLOCK_SIZE);
+        if (block == NULL)
+            perror("fail to allocate an LSM block"), exit(EXIT_FAILURE);
+        for (int32_t i = 0; i < lsm->level[0].run_number && !found; i++)
+            found = look_up_a_key_in_an_LSM_run(lsm->level[0].run[i], key, &found_value, block);
+        for (int32_t i = 1; i < LSM_MAX_LEVEL && !found; i++)
+        {
+            /* the runs of a deeper level are disjoint, so one at most can hold key */
+            struct LSM_level *level = &lsm->level[i];
+            int32_t left = 0, right = level->run_number - 1;
+            while (left <= right)
+            {
+                int32_t middle = left + ((right - left) >> 1);
+                if (level->run[middle]->max_key < key) left = middle + 1;
+                else right = middle - 1;
+            }
+            if (left < level->run_number)
+                found = look_up_a_key_in_an_LSM_run(level->run[left], key, &found_value, block);
+        }
+        free(block);
+    }
+    pthread_rwlock_unlock(&lsm->latch);
+    if (!found || found_value == LSM_TOMBSTONE) return -1;
+    if (value) *value = found_value;
+    return 0;
+}
+
+/* copy at most batch_size live keys in [lower_key, upper_key] and their
+values, in key order. Return the number of copied keys; the next scan can
+start from the last key plus one. */
+int32_t scan_LSM_tree(struct LSM_tree *lsm, int32_t lower_key, int32_t upper_key,
+int32_t *key_buf, int64_t *value_buf, int32_t batch_size)
+{
+    pthread_rwlock_rdlock(&lsm->latch);
+    int32_t run_number = 0;
+    for (int32_t i = 0; i < LSM_MAX_LEVEL; i++) run_number += lsm->level[i].run_number;
+    struct LSM_merge merge;
+    open_an_LSM_merge(&merge, run_number + 1);
+    add_a_memtable_to_an_LSM_merge(&merge, lsm->memtable, lower_key, upper_key);
+    for (int32_t i = 0; i < LSM_MAX_LEVEL; i++)
+        for (int32_t j = 0; j < lsm->level[i].run_number; j++)
+        {
+            struct LSM_run *run = lsm->level[i].run[j];
+            if (run->max_key >= lower_key && run->min_key <= upper_key)
+                add_a_run_to_an_LSM_merge(&merge, run, lower_key, upper_key);
+        }
+    start_an_LSM_merge(&merge);
+    int32_t copied = 0, key;
+    int64_t value;
+    while (copied < batch_size && next_entry_in_an_LSM_merge(&merge, &key, &value) == 0)
+        if (value != LSM_TOMBSTONE)
+        {
+            key_buf[copied] = key;
+            if (value_buf) value_buf[copied] = value;
+            copied++;
+        }
+    close_an_LSM_merge(&merge);
+    pthread_rwlock_unlock(&lsm->latch);
+    return copied;
+}
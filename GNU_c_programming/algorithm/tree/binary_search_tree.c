@@ -4,272 +4,256 @@
 #include <inttypes.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
+#include "node_pool.c"
 struct bin_node {
     int32_t node_id;
+    /* whether the node came from a struct node_pool rather than the C heap */
+    _Bool pooled;
     struct bin_node *left, *right;};
 
-// *stack[INT16_MAX] is an array consist of pointers.
-static struct bin_node* volatile stack[INT16_MAX];
-static _Atomic(ptrdiff_t) top = -1;
-/* pop up out of stack */
-static struct bin_node* popup(void)
+/* the order in which a traversal hands out the keys of a BST */
+enum BST_trav_order {BST_preorder, BST_inorder, BST_postorder};
+/* the keys one trav_to_BST() call hands to its visitor at a time */
+#define BST_TRAV_BATCH 256
+
+/* a traversal which can stop after any key and go on later. Its stack is
+on the heap and grows with the path, so a degenerate tree of any height
+is walked without recursion. */
+struct BST_trav_iterator {
+    enum BST_trav_order order;
+    struct bin_node **stack;
+    int64_t top, capacity;
+    /* the next subtree to walk down, and the last node given in postorder */
+    struct bin_node *cur, *visited;};
+
+static void push_a_bin_node(struct BST_trav_iterator *iter, struct bin_node *node)
 {
-    if (top == -1)
-        perror("popup() on the empty stack, abort"), exit(-1);
-    return stack[top--];
+    if (iter->top + 1 == iter->capacity)
+    {
+        iter->capacity = iter->capacity ? iter->capacity << 1 : 64;
+        iter->stack = (struct bin_node **)realloc(iter->stack, iter->capacity * sizeof(struct bin_node *));
+        if (iter->stack == NULL)
+            perror("fail to grow the traversal stack"), exit(EXIT_FAILURE);
+    }
+    iter->stack[++iter->top] = node;
+    return;
 }
-/* push into stack */
-static void push(struct bin_node *node)
+
+/* a node comes from pool, or from the C heap if pool is NULL */
+static struct bin_node *alloc_a_new_bin_node(struct node_pool *pool)
 {
-    if (top == INT16_MAX)
-        perror("stack overflow"), exit(-1);
-    stack[++top] = node;
+    struct bin_node *node = pool ? (struct bin_node *)alloc_a_node_from_pool(pool)
+    : (struct bin_node *)malloc(sizeof(struct bin_node));
+    if (node == NULL)
+        perror("fail to allocate a binary search tree node"), exit(EXIT_FAILURE);
+    memset(node, 0, sizeof(struct bin_node));
+    node->pooled = (pool != NULL);
+    return node;
+}
+
+static void free_a_bin_node(struct bin_node *node)
+{
+    if (node->pooled) free_a_node_to_pool(node);
+    else free(node);
     return;
 }
 
-struct bin_node* init_bin_root(int32_t root_key)
+/* start a tree whose nodes come from pool, made by init_node_pool(sizeof(struct
+bin_node), ...), or from the C heap if pool is NULL. destroy_node_pool() then
+frees the whole tree without delete_all_nodes_in_BST(). */
+struct bin_node* init_bin_root(int32_t root_key, struct node_pool *pool)
 {
-    struct bin_node *root = (struct bin_node *)calloc(1, sizeof(struct bin_node));
+    struct bin_node *root = alloc_a_new_bin_node(pool);
     root->node_id = root_key;
     root->right = root->left = NULL;
     return root;
 }
 
-int insert_a_node_in_BST(struct bin_node **BST, int32_t new_key)
+/* the new node comes from pool, which has to be the same for every insert in
+a tree, or from the C heap if pool is NULL. */
+int insert_a_node_in_BST(struct bin_node **BST, int32_t new_key, struct node_pool *pool)
 {
-    struct bin_node *cur = *BST;
-    while (cur)
+    /* link is the pointer in the parent node where the new node hangs */
+    struct bin_node **link = BST;
+    while (*link)
     {
-        if (cur->node_id == new_key)
+        if ((*link)->node_id == new_key)
         {
-            fprintf(stderr, "insert failed. This tree has already a node with key value %" PRId64".\n", new_key);
+            fprintf(stderr, "insert failed. This tree has already a node with key value %" PRId32".\n", new_key);
             return -1;
         }
-        else cur = (cur->node_id < new_key) ? cur->left : cur->right;
+        else link = ((*link)->node_id < new_key) ? &(*link)->right : &(*link)->left;
     }
-    struct bin_node *new_node = (struct bin_node *)calloc(1, sizeof(struct bin_node));
+    struct bin_node *new_node = alloc_a_new_bin_node(pool);
     new_node->node_id = new_key;
     new_node->left = new_node->right = NULL;
-    cur = new_node;
+    *link = new_node;
     return 0;
 }
 
 struct bin_node* look_up_a_node_in_BST(const struct bin_node **BST, int32_t key)
 {
-    struct bin_node *cur = *BST;
-    while (cur->node_id != key && cur)
-    cur = (cur->node_id < key) ? cur->left : cur->right;
+    struct bin_node *cur = (struct bin_node *)*BST;
+    while (cur && cur->node_id != key)
+    cur = (cur->node_id < key) ? cur->right : cur->left;
     if (!cur) fprintf(stderr, "no key value in binary search tree!\n");
     return cur;
 }
 
 int delete_a_node_and_fill_from_left_subtree_in_BST(struct bin_node **BST, int32_t key)
 {
-    struct bin_node *cur = *BST, *prev_of_cur;
-    while (cur->node_id != key && cur)
-    {
-        prev_of_cur = cur;
-        cur = (cur->node_id < key) ? cur->left : cur->right;
-    }
-    if (!cur)
+    struct bin_node **link = BST;
+    while (*link && (*link)->node_id != key)
+        link = ((*link)->node_id < key) ? &(*link)->right : &(*link)->left;
+    if (*link == NULL)
     {
         fprintf(stderr, "no key value in binary search tree!\n");
         return -1;
     }
-    /* delete a leave node */
-    if (cur->left == NULL && cur->right == NULL)
-    {
-        struct bin_node *tmp = cur;
-        cur = NULL;
-        free(tmp); return 0;
-    }
+    struct bin_node *cur = *link;
     /* use the maximum node in left subtree of the current node to replace the current node */
-    else if (cur->left != NULL && cur->right != NULL)
+    if (cur->left != NULL && cur->right != NULL)
     {
-        struct bin_node *max_in_left_subtree = cur->left, *prev_of_max = cur;
-        while (max_in_left_subtree->right)
-        {
-            prev_of_max = max_in_left_subtree;
-            max_in_left_subtree = max_in_left_subtree->right;
-        }
+        struct bin_node **link_to_max = &cur->left;
+        while ((*link_to_max)->right)
+            link_to_max = &(*link_to_max)->right;
+        struct bin_node *max_in_left_subtree = *link_to_max;
         cur->node_id = max_in_left_subtree->node_id;
-        prev_of_max->right = max_in_left_subtree->left;
-        free(max_in_left_subtree);
-        return 0;
-    }
-    /* delete a node who has one subtree */
-    else
-    {
-        struct bin_node *tmp = cur;
-        if (cur->left && prev_of_cur->left == cur)
-            prev_of_cur->left = cur->left;
-        if (cur->left && prev_of_cur->right == cur)
-            prev_of_cur->left = cur->right;
-        if (cur->right && prev_of_cur->left == cur)
-            prev_of_cur->right = cur->left;
-        if (cur->right && prev_of_cur->right == cur)
-            prev_of_cur->right = cur->right;
-        free(tmp);
+        *link_to_max = max_in_left_subtree->left;
+        free_a_bin_node(max_in_left_subtree);
         return 0;
     }
+    /* delete a leaf node or a node who has one subtree */
+    *link = (cur->left) ? cur->left : cur->right;
+    free_a_bin_node(cur);
+    return 0;
 }
 
 int delete_a_node_and_fill_from_right_subtree_in_BST(struct bin_node **BST, int32_t key)
 {
-    struct bin_node *cur = *BST, *prev_of_cur;
-    while (cur->node_id != key && cur)
-    {
-        prev_of_cur = cur;
-        cur = (cur->node_id < key)? cur->left : cur->right;
-    }
-    if (!cur)
+    struct bin_node **link = BST;
+    while (*link && (*link)->node_id != key)
+        link = ((*link)->node_id < key) ? &(*link)->right : &(*link)->left;
+    if (*link == NULL)
     {
         fprintf(stderr, "no key value in binary search tree!\n");
         return -1;
     }
-    /* delete a leaf node */
-    if (cur->left == NULL && cur->right == NULL)
-    {
-        struct bin_node *tmp = cur;
-        cur = NULL;
-        free(tmp);
-        return 0;
-    }
+    struct bin_node *cur = *link;
     /* use the minimum node in right subtree of the current node to replace the current node */
-    else if (cur->left != NULL && cur->right != NULL)
+    if (cur->left != NULL && cur->right != NULL)
     {
-        struct bin_node *min_in_right_subtree = cur->right, *prev_of_min = cur;
-        while (min_in_right_subtree->left)
-        {
-            prev_of_min = min_in_right_subtree;
-            min_in_right_subtree = min_in_right_subtree->left;
-        }
+        struct bin_node **link_to_min = &cur->right;
+        while ((*link_to_min)->left)
+            link_to_min = &(*link_to_min)->left;
+        struct bin_node *min_in_right_subtree = *link_to_min;
         cur->node_id = min_in_right_subtree->node_id;
-        prev_of_min->left = min_in_right_subtree->right;
-        free(min_in_right_subtree);
-        return 0;
-    }
-    /* delete a node who has one subtree */
-    else
-    {
-        struct bin_node *tmp = cur;
-        if (cur->left && prev_of_cur->left == cur)
-            prev_of_cur->left = cur->left;
-        if (cur->left && prev_of_cur->right == cur)
-            prev_of_cur->left = cur->right;
-        if (cur->right && prev_of_cur->left == cur)
-            prev_of_cur->right = cur->left;
-        if (cur->right && prev_of_cur->right == cur)
-            prev_of_cur->right = cur->right;
-        free(tmp);
+        *link_to_min = min_in_right_subtree->right;
+        free_a_bin_node(min_in_right_subtree);
         return 0;
     }
+    /* delete a leaf node or a node who has one subtree */
+    *link = (cur->left) ? cur->left : cur->right;
+    free_a_bin_node(cur);
+    return 0;
 }
 
-void the_1st_preorder_trav_to_BST(struct bin_node **BST)
+void start_a_trav_to_BST(struct bin_node **BST, enum BST_trav_order order, struct BST_trav_iterator *iter)
 {
-    struct bin_node *cur = *BST;
-    if (cur == NULL) return;
-    /* push the root node into the stack */
-    push(cur);
-    while (top != -1)
-    {
-        /* popup every node on top of the stack */
-        cur = popup();
-        printf("%" PRId32"\040", cur->node_id);
-        /* first push right then left.
-        Because it makes it sure that every left node pop up first,
-        right node underneath its sibling left node will be popped up next time. */
-        if (cur->right != NULL) push(cur->right);
-        if (cur->left != NULL) push(cur->left);
-    }
+    iter->order = order;
+    iter->stack = NULL;
+    iter->top = -1, iter->capacity = 0;
+    iter->cur = *BST, iter->visited = NULL;
+    /* preorder takes its nodes from the stack only */
+    if (order == BST_preorder && *BST)
+        push_a_bin_node(iter, *BST), iter->cur = NULL;
     return;
 }
 
-void the_2nd_preorder_trav_to_BST(struct bin_node **BST)
+/* copy the next keys of the traversal, at most batch_size of them, into
+key_buf. Return the number of copied keys, which is 0 at the end. */
+int32_t next_batch_in_trav_to_BST(struct BST_trav_iterator *iter, int32_t *key_buf, int32_t batch_size)
 {
-    struct bin_node *cur = *BST;
-    if (cur == NULL) return;
-    while (top != -1 || cur != NULL)
+    int32_t copied = 0;
+    struct bin_node *cur = iter->cur;
+    while (copied < batch_size && (iter->top != -1 || cur != NULL))
     {
-        /* when stack is empty and current is NULL, loop done.
-        Because when it traverses to the root node,
-        stack is empty but cur == (*BST)->right. */
-        if (cur != NULL)
+        if (iter->order == BST_preorder)
         {
-            printf("%" PRId32"\040", cur->node_id);
-            /* use the node data first */
-            push(cur);
+            /* first push right then left, so that the left subtree pops up first */
+            cur = iter->stack[iter->top--];
+            key_buf[copied++] = cur->node_id;
+            if (cur->right) push_a_bin_node(iter, cur->right);
+            if (cur->left) push_a_bin_node(iter, cur->left);
+            cur = NULL;
+        }
+        else if (cur != NULL)
+        {
+            push_a_bin_node(iter, cur);
             cur = cur->left;
         }
-        else
+        else if (iter->order == BST_inorder)
         {
-            cur = popup();
+            cur = iter->stack[iter->top--];
+            key_buf[copied++] = cur->node_id;
             cur = cur->right;
         }
+        /* the top node is given once its right subtree is done or absent */
+        else if (iter->stack[iter->top]->right == NULL || iter->stack[iter->top]->right == iter->visited)
+        {
+            iter->visited = iter->stack[iter->top--];
+            key_buf[copied++] = iter->visited->node_id;
+        }
+        else cur = iter->stack[iter->top]->right;
     }
-    return;
+    iter->cur = cur;
+    return copied;
 }
 
-void inorder_trav_to_BST(struct bin_node **BST)
+void close_a_trav_to_BST(struct BST_trav_iterator *iter)
 {
-    struct bin_node *cur = *BST;
-    if (cur == NULL) return;
-    while (top != -1 || cur != NULL)
-    {
-        /* when stack is empty and current is NULL,
-        loop done. Because when it traverses to the root node,
-        stack is empty but cur == (*BST)->right. */
-        if (cur != NULL)
-        {
-            push(cur);
-            cur = cur->left;
-        }
-        else
-        {
-            cur = popup();
-            printf("%" PRId32"\040", cur->node_id);
-            cur = cur->right;
-        }
-    }
+    free(iter->stack);
+    iter->stack = NULL;
+    iter->top = -1, iter->capacity = 0;
     return;
 }
 
-void postorder_trav_to_BST(struct bin_node **BST)
+/* hand every key of the BST in order to visitor, BST_TRAV_BATCH keys at a
+time. A visitor which returns non-zero stops the traversal, and that value
+is returned; otherwise return 0. */
+int trav_to_BST(struct bin_node **BST, enum BST_trav_order order,
+int (*visitor)(const int32_t *key, int32_t key_number, void *arg), void *arg)
+{
+    struct BST_trav_iterator iter;
+    int32_t key_buf[BST_TRAV_BATCH], copied;
+    int state = 0;
+    start_a_trav_to_BST(BST, order, &iter);
+    while (state == 0 && (copied = next_batch_in_trav_to_BST(&iter, key_buf, BST_TRAV_BATCH)) > 0)
+        state = visitor(key_buf, copied, arg);
+    close_a_trav_to_BST(&iter);
+    return state;
+}
+
+/* free every node without recursion: rotate each left child up until the
+node on top has none, then free it and go on down its right side. */
+void delete_all_nodes_in_BST(struct bin_node *node)
 {
-    struct bin_node *cur = *BST, *visited = NULL;
-    if (cur == NULL) return;
-    while (top != -1 || cur != NULL)
+    while (node)
     {
-        /* when stack is empty and current is NULL, loop done.
-        Because when it traverses to the root node,
-        stack is empty but cur == (*BST)->right. */
-        if (cur != NULL)
+        if (node->left)
         {
-            push(cur);
-            cur = cur->left;
+            struct bin_node *left_child = node->left;
+            node->left = left_child->right;
+            left_child->right = node;
+            node = left_child;
         }
         else
         {
-            /* judge whether the top element in stack has the right subtree
-            and whether the top element was ever used before. */
-            if (visited == stack[top]->right || stack[top]->right == NULL)
-            {
-                visited = popup();
-                printf("%" PRId32"\040", visited->node_id);
-            }
-            /* if it didn't, push the right subtree of the top element into stack. */
-            else cur = stack[top]->right;
+            struct bin_node *right_child = node->right;
+            free_a_bin_node(node);
+            node = right_child;
         }
     }
     return;
-}
-
-void delete_all_nodes_in_BST(struct bin_node *node)
-{
-    if (node == NULL) return;
-    delete_all_nodes_in_BST(node->left);
-    delete_all_nodes_in_BST(node->right);
-    free(node);
-    return;
 }
\ No newline at end of file
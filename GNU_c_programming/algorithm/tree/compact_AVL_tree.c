@@ -0,0 +1,290 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+/* an AVL tree whose nodes live in one growable array and link to each
+other by 32-bit indices instead of pointers. Index 0 is the empty subtree,
+and the balance factor is kept in the top two bits of the left link, so a
+node takes 12 bytes where a struct AVL_node takes 24. Freed slots are
+chained through their right link and handed out again before the array
+grows. Every call keeps its own path, so nothing is shared between trees. */
+#define COMPACT_AVL_INDEX_MASK 0x3FFFFFFFu
+#define COMPACT_AVL_MAX_NODE_NUMBER COMPACT_AVL_INDEX_MASK
+/* an AVL tree of n nodes is lower than 1.45 * log2(n + 2) */
+#define COMPACT_AVL_MAX_HEIGHT 48
+#define COMPACT_AVL_TRAV_BATCH 256
+
+struct compact_AVL_node {
+    int32_t node_id;
+    /* next[0] is the left link and holds bf + 1 above its index, next[1] is the right link */
+    uint32_t next[2];};
+
+struct compact_AVL_tree {
+    struct compact_AVL_node *node;
+    uint32_t root, free_list;
+    /* the slots in use or on the free list, including slot 0 */
+    uint32_t node_number, capacity;
+    int64_t key_number;};
+
+static inline uint32_t compact_AVL_child(const struct compact_AVL_tree *tree, uint32_t index, _Bool side)
+{
+    return tree->node[index].next[side] & COMPACT_AVL_INDEX_MASK;
+}
+
+static inline void set_compact_AVL_child(struct compact_AVL_tree *tree, uint32_t index, _Bool side, uint32_t child)
+{
+    tree->node[index].next[side] = (tree->node[index].next[side] & ~COMPACT_AVL_INDEX_MASK) | child;
+    return;
+}
+
+/* bf is the height of the left subtree minus that of the right subtree */
+static inline int_fast8_t compact_AVL_bf(const struct compact_AVL_tree *tree, uint32_t index)
+{
+    return (int_fast8_t)(tree->node[index].next[0] >> 30) - 1;
+}
+
+static inline void set_compact_AVL_bf(struct compact_AVL_tree *tree, uint32_t index, int_fast8_t bf)
+{
+    tree->node[index].next[0] = (tree->node[index].next[0] & COMPACT_AVL_INDEX_MASK) | (uint32_t)(bf + 1) << 30;
+    return;
+}
+
+struct compact_AVL_tree *init_compact_AVL_tree(void)
+{
+    struct compact_AVL_tree *tree = (struct compact_AVL_tree *)malloc(sizeof(struct compact_AVL_tree));
+    if (tree == NULL)
+        perror("fail to allocate a compact AVL tree"), exit(EXIT_FAILURE);
+    tree->capacity = 1024;
+    tree->node = (struct compact_AVL_node *)malloc(tree->capacity * sizeof(struct compact_AVL_node));
+    if (tree->node == NULL)
+        perror("fail to allocate compact AVL nodes"), exit(EXIT_FAILURE);
+    /* slot 0 is the empty subtree, with no children and a bf of 0 */
+    tree->node[0].node_id = 0;
+    tree->node[0].next[0] = 1u << 30, tree->node[0].next[1] = 0;
+    tree->root = tree->free_list = 0;
+    tree->node_number = 1;
+    tree->key_number = 0;
+    return tree;
+}
+
+void destroy_compact_AVL_tree(struct compact_AVL_tree *tree)
+{
+    free(tree->node);
+    free(tree);
+    return;
+}
+
+/* return the index of a new leaf, or 0 when no index is left */
+static uint32_t alloc_a_compact_AVL_node(struct compact_AVL_tree *tree, int32_t key)
+{
+    uint32_t index = tree->free_list;
+    if (index) tree->free_list = tree->node[index].next[1];
+    else
+    {
+        if (tree->node_number == COMPACT_AVL_MAX_NODE_NUMBER) return 0;
+        if (tree->node_number == tree->capacity)
+        {
+            uint64_t capacity = (uint64_t)tree->capacity << 1;
+            if (capacity > COMPACT_AVL_MAX_NODE_NUMBER) capacity = COMPACT_AVL_MAX_NODE_NUMBER;
+            tree->node = (struct compact_AVL_node *)realloc(tree->node, capacity * sizeof(struct compact_AVL_node));
+            if (tree->node == NULL)
+                perror("fail to grow compact AVL nodes"), exit(EXIT_FAILURE);
+            tree->capacity = (uint32_t)capacity;
+        }
+        index = tree->node_number++;
+    }
+    tree->node[index].node_id = key;
+    tree->node[index].next[0] = 1u << 30, tree->node[index].next[1] = 0;
+    return index;
+}
+
+static void free_a_compact_AVL_node(struct compact_AVL_tree *tree, uint32_t index)
+{
+    tree->node[index].next[1] = tree->free_list;
+    tree->free_list = index;
+    return;
+}
+
+/* return 0 if key is in the tree, or -1 */
+int look_up_a_key_in_compact_AVL(const struct compact_AVL_tree *tree, int32_t key)
+{
+    uint32_t cur = tree->root;
+    while (cur && tree->node[cur].node_id != key)
+        cur = compact_AVL_child(tree, cur, tree->node[cur].node_id < key);
+    return cur ? 0 : -1;
+}
+
+static uint32_t rotate_a_compact_AVL_node(struct compact_AVL_tree *tree, uint32_t index, _Bool rotating_side)
+{
+    uint32_t child = compact_AVL_child(tree, index, rotating_side);
+    set_compact_AVL_child(tree, index, rotating_side, compact_AVL_child(tree, child, !rotating_side));
+    set_compact_AVL_child(tree, child, !rotating_side, index);
+    return child;
+}
+
+/* bf, which two bits can not hold, is 2 or -2 at index;
+return the new root of the rebalanced subtree */
+static uint32_t balance_a_node_in_compact_AVL(struct compact_AVL_tree *tree, uint32_t index, int_fast8_t bf)
+{
+    int_fast8_t sign = bf > 0 ? 1 : -1;
+    _Bool longer_side = sign > 0 ? 0 : 1;
+    uint32_t longer_child = compact_AVL_child(tree, index, longer_side);
+    int_fast8_t child_bf = compact_AVL_bf(tree, longer_child);
+    if (child_bf == -sign)
+    {
+        /* the double rotation for RL and LR */
+        uint32_t grandchild = compact_AVL_child(tree, longer_child, !longer_side);
+        int_fast8_t grandchild_bf = compact_AVL_bf(tree, grandchild);
+        set_compact_AVL_child(tree, index, longer_side, rotate_a_compact_AVL_node(tree, longer_child, !longer_side));
+        rotate_a_compact_AVL_node(tree, index, longer_side);
+        set_compact_AVL_bf(tree, index, grandchild_bf == sign ? -sign : 0);
+        set_compact_AVL_bf(tree, longer_child, grandchild_bf == -sign ? sign : 0);
+        set_compact_AVL_bf(tree, grandchild, 0);
+        return grandchild;
+    }
+    /* the rotation for LL and RR. The longer child is balanced
+    only after a deletion, and then the subtree keeps its height. */
+    rotate_a_compact_AVL_node(tree, index, longer_side);
+    if (child_bf == 0)
+        set_compact_AVL_bf(tree, index, sign), set_compact_AVL_bf(tree, longer_child, -sign);
+    else set_compact_AVL_bf(tree, index, 0), set_compact_AVL_bf(tree, longer_child, 0);
+    return longer_child;
+}
+
+/* the ancestors of a node and the side taken from each of them */
+struct compact_AVL_path {
+    int32_t depth;
+    uint32_t node[COMPACT_AVL_MAX_HEIGHT];
+    _Bool side[COMPACT_AVL_MAX_HEIGHT];};
+
+/* hang a subtree on the parent at depth - 1 in path, or make it the root */
+static void relink_a_compact_AVL_subtree(struct compact_AVL_tree *tree, struct compact_AVL_path *path,
+int32_t depth, uint32_t subtree)
+{
+    if (depth == 0) tree->root = subtree;
+    else set_compact_AVL_child(tree, path->node[depth - 1], path->side[depth - 1], subtree);
+    return;
+}
+
+/* return 0, or -1 if key is already in the tree or no index is left */
+int insert_a_key_in_compact_AVL(struct compact_AVL_tree *tree, int32_t new_key)
+{
+    struct compact_AVL_path path;
+    path.depth = 0;
+    uint32_t cur = tree->root;
+    while (cur)
+    {
+        if (tree->node[cur].node_id == new_key)
+        {
+            fprintf(stderr, "insert failed. This tree has already a node with key value %" PRId32".\n", new_key);
+            return -1;
+        }
+        path.node[path.depth] = cur;
+        path.side[path.depth] = tree->node[cur].node_id < new_key;
+        cur = compact_AVL_child(tree, cur, path.side[path.depth++]);
+    }
+    uint32_t new_node = alloc_a_compact_AVL_node(tree, new_key);
+    if (new_node == 0)
+    {
+        fputs("insert failed. The compact AVL tree has no index left.\n", stderr);
+        return -1;
+    }
+    relink_a_compact_AVL_subtree(tree, &path, path.depth, new_node);
+    tree->key_number++;
+    /* retrace until a subtree keeps its height */
+    while (path.depth--)
+    {
+        uint32_t parent = path.node[path.depth];
+        int_fast8_t bf = compact_AVL_bf(tree, parent) + (path.side[path.depth] ? -1 : 1);
+        if (bf < -1 || bf > 1)
+        {
+            relink_a_compact_AVL_subtree(tree, &path, path.depth, balance_a_node_in_compact_AVL(tree, parent, bf));
+            break;
+        }
+        set_compact_AVL_bf(tree, parent, bf);
+        if (bf == 0) break;
+    }
+    return 0;
+}
+
+/* return 0, or -1 if key is not in the tree. A node with two subtrees
+takes the key of its in-order successor, which is removed instead. */
+int delete_a_key_in_compact_AVL(struct compact_AVL_tree *tree, int32_t key)
+{
+    struct compact_AVL_path path;
+    path.depth = 0;
+    uint32_t cur = tree->root;
+    while (cur && tree->node[cur].node_id != key)
+    {
+        path.node[path.depth] = cur;
+        path.side[path.depth] = tree->node[cur].node_id < key;
+        cur = compact_AVL_child(tree, cur, path.side[path.depth++]);
+    }
+    if (cur == 0)
+    {
+        fprintf(stderr, "no key value in compact AVL tree!\n");
+        return -1;
+    }
+    if (compact_AVL_child(tree, cur, 0) && compact_AVL_child(tree, cur, 1))
+    {
+        uint32_t successor = compact_AVL_child(tree, cur, 1);
+        path.node[path.depth] = cur, path.side[path.depth++] = 1;
+        while (compact_AVL_child(tree, successor, 0))
+        {
+            path.node[path.depth] = successor, path.side[path.depth++] = 0;
+            successor = compact_AVL_child(tree, successor, 0);
+        }
+        tree->node[cur].node_id = tree->node[successor].node_id;
+        cur = successor;
+    }
+    /* now cur has one subtree at most */
+    uint32_t child = compact_AVL_child(tree, cur, 0) ? compact_AVL_child(tree, cur, 0) : compact_AVL_child(tree, cur, 1);
+    relink_a_compact_AVL_subtree(tree, &path, path.depth, child);
+    free_a_compact_AVL_node(tree, cur);
+    tree->key_number--;
+    /* retrace until a subtree keeps its height */
+    while (path.depth--)
+    {
+        uint32_t parent = path.node[path.depth];
+        int_fast8_t bf = compact_AVL_bf(tree, parent) + (path.side[path.depth] ? 1 : -1);
+        if (bf >= -1 && bf <= 1) set_compact_AVL_bf(tree, parent, bf);
+        if (bf == 1 || bf == -1) break;
+        if (bf != 0)
+        {
+            uint32_t new_root = balance_a_node_in_compact_AVL(tree, parent, bf);
+            relink_a_compact_AVL_subtree(tree, &path, path.depth, new_root);
+            /* a balanced new root means the subtree got shorter */
+            if (compact_AVL_bf(tree, new_root) != 0) break;
+        }
+    }
+    return 0;
+}
+
+/* hand every key of the tree in increasing order to visitor,
+COMPACT_AVL_TRAV_BATCH keys at a time. A visitor which returns non-zero
+stops the traversal, and that value is returned; otherwise return 0. */
+int inorder_trav_to_compact_AVL(const struct compact_AVL_tree *tree,
+int (*visitor)(const int32_t *key, int32_t key_number, void *arg), void *arg)
+{
+    uint32_t path[COMPACT_AVL_MAX_HEIGHT], cur = tree->root;
+    int32_t key_buf[COMPACT_AVL_TRAV_BATCH], copied = 0, depth = 0;
+    int state = 0;
+    while (state == 0 && (depth || cur))
+    {
+        if (cur)
+        {
+            path[depth++] = cur;
+            cur = compact_AVL_child(tree, cur, 0);
+            continue;
+        }
+        cur = path[--depth];
+        key_buf[copied++] = tree->node[cur].node_id;
+        cur = compact_AVL_child(tree, cur, 1);
+        if (copied == COMPACT_AVL_TRAV_BATCH)
+            state = visitor(key_buf, copied, arg), copied = 0;
+    }
+    if (state == 0 && copied) state = visitor(key_buf, copied, arg);
+    return state;
+}
@@ -0,0 +1,316 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+/* a red black tree whose nodes live in one growable array and link to each
+other by 32-bit indices instead of pointers. Index 0 is the black empty
+subtree, and the color is kept in the top bit of the left link. There is no
+parent link: insert and delete keep the path they walked down, so a node
+takes 16 bytes where a struct RB_node takes 40. Freed slots are chained
+through their right link and handed out again before the array grows. */
+#define COMPACT_RB_INDEX_MASK 0x7FFFFFFFu
+#define COMPACT_RB_RED_BIT 0x80000000u
+#define COMPACT_RB_MAX_NODE_NUMBER COMPACT_RB_INDEX_MASK
+/* a red black tree of n nodes is lower than 2 * log2(n + 1), and a delete
+may push one more node on its path */
+#define COMPACT_RB_MAX_HEIGHT 66
+#define COMPACT_RB_TRAV_BATCH 256
+
+struct compact_RB_node {
+    int64_t node_id;
+    /* next[0] is the left link and holds the red bit, next[1] is the right link */
+    uint32_t next[2];};
+
+struct compact_RB_tree {
+    struct compact_RB_node *node;
+    uint32_t root, free_list;
+    /* the slots in use or on the free list, including slot 0 */
+    uint32_t node_number, capacity;
+    int64_t key_number;};
+
+static inline uint32_t compact_RB_child(const struct compact_RB_tree *tree, uint32_t index, _Bool side)
+{
+    return tree->node[index].next[side] & COMPACT_RB_INDEX_MASK;
+}
+
+static inline void set_compact_RB_child(struct compact_RB_tree *tree, uint32_t index, _Bool side, uint32_t child)
+{
+    tree->node[index].next[side] = (tree->node[index].next[side] & ~COMPACT_RB_INDEX_MASK) | child;
+    return;
+}
+
+/* slot 0 is never red */
+static inline _Bool is_a_red_compact_RB_node(const struct compact_RB_tree *tree, uint32_t index)
+{
+    return tree->node[index].next[0] & COMPACT_RB_RED_BIT;
+}
+
+static inline void paint_a_compact_RB_node(struct compact_RB_tree *tree, uint32_t index, _Bool is_red)
+{
+    tree->node[index].next[0] = (tree->node[index].next[0] & COMPACT_RB_INDEX_MASK) | (is_red ? COMPACT_RB_RED_BIT : 0);
+    return;
+}
+
+struct compact_RB_tree *init_compact_RB_tree(void)
+{
+    struct compact_RB_tree *tree = (struct compact_RB_tree *)malloc(sizeof(struct compact_RB_tree));
+    if (tree == NULL)
+        perror("fail to allocate a compact red black tree"), exit(EXIT_FAILURE);
+    tree->capacity = 1024;
+    tree->node = (struct compact_RB_node *)malloc(tree->capacity * sizeof(struct compact_RB_node));
+    if (tree->node == NULL)
+        perror("fail to allocate compact red black nodes"), exit(EXIT_FAILURE);
+    tree->node[0].node_id = 0;
+    tree->node[0].next[0] = tree->node[0].next[1] = 0;
+    tree->root = tree->free_list = 0;
+    tree->node_number = 1;
+    tree->key_number = 0;
+    return tree;
+}
+
+void destroy_compact_RB_tree(struct compact_RB_tree *tree)
+{
+    free(tree->node);
+    free(tree);
+    return;
+}
+
+/* return the index of a new red leaf, or 0 when no index is left */
+static uint32_t alloc_a_compact_RB_node(struct compact_RB_tree *tree, int64_t key)
+{
+    uint32_t index = tree->free_list;
+    if (index) tree->free_list = tree->node[index].next[1];
+    else
+    {
+        if (tree->node_number == COMPACT_RB_MAX_NODE_NUMBER) return 0;
+        if (tree->node_number == tree->capacity)
+        {
+            uint64_t capacity = (uint64_t)tree->capacity << 1;
+            if (capacity > COMPACT_RB_MAX_NODE_NUMBER) capacity = COMPACT_RB_MAX_NODE_NUMBER;
+            tree->node = (struct compact_RB_node *)realloc(tree->node, capacity * sizeof(struct compact_RB_node));
+            if (tree->node == NULL)
+                perror("fail to grow compact red black nodes"), exit(EXIT_FAILURE);
+            tree->capacity = (uint32_t)capacity;
+        }
+        index = tree->node_number++;
+    }
+    tree->node[index].node_id = key;
+    tree->node[index].next[0] = COMPACT_RB_RED_BIT, tree->node[index].next[1] = 0;
+    return index;
+}
+
+static void free_a_compact_RB_node(struct compact_RB_tree *tree, uint32_t index)
+{
+    tree->node[index].next[0] = 0;
+    tree->node[index].next[1] = tree->free_list;
+    tree->free_list = index;
+    return;
+}
+
+/* return 0 if key is in the tree, or -1 */
+int look_up_a_key_in_compact_RBT(const struct compact_RB_tree *tree, int64_t key)
+{
+    uint32_t cur = tree->root;
+    while (cur && tree->node[cur].node_id != key)
+        cur = compact_RB_child(tree, cur, tree->node[cur].node_id < key);
+    return cur ? 0 : -1;
+}
+
+/* lift the child on rotating_side of index over it, and return the child */
+static uint32_t rotate_a_compact_RB_node(struct compact_RB_tree *tree, uint32_t index, _Bool rotating_side)
+{
+    uint32_t child = compact_RB_child(tree, index, rotating_side);
+    set_compact_RB_child(tree, index, rotating_side, compact_RB_child(tree, child, !rotating_side));
+    set_compact_RB_child(tree, child, !rotating_side, index);
+    return child;
+}
+
+/* the ancestors of a node and the side taken from each of them */
+struct compact_RB_path {
+    int32_t depth;
+    uint32_t node[COMPACT_RB_MAX_HEIGHT];
+    _Bool side[COMPACT_RB_MAX_HEIGHT];};
+
+/* hang a subtree on the parent at depth - 1 in path, or make it the root */
+static void relink_a_compact_RB_subtree(struct compact_RB_tree *tree, struct compact_RB_path *path,
+int32_t depth, uint32_t subtree)
+{
+    if (depth == 0) tree->root = subtree;
+    else set_compact_RB_child(tree, path->node[depth - 1], path->side[depth - 1], subtree);
+    return;
+}
+
+/* return 0, or -1 if key is already in the tree or no index is left */
+int insert_a_key_in_compact_RBT(struct compact_RB_tree *tree, int64_t new_key)
+{
+    struct compact_RB_path path;
+    path.depth = 0;
+    uint32_t cur = tree->root;
+    while (cur)
+    {
+        if (tree->node[cur].node_id == new_key)
+        {
+            fprintf(stderr, "insert failed. This tree has already a node with key value %" PRId64".\n", new_key);
+            return -1;
+        }
+        path.node[path.depth] = cur;
+        path.side[path.depth] = tree->node[cur].node_id < new_key;
+        cur = compact_RB_child(tree, cur, path.side[path.depth++]);
+    }
+    cur = alloc_a_compact_RB_node(tree, new_key);
+    if (cur == 0)
+    {
+        fputs("insert failed. The compact red black tree has no index left.\n", stderr);
+        return -1;
+    }
+    relink_a_compact_RB_subtree(tree, &path, path.depth, cur);
+    tree->key_number++;
+    /* path.node[depth - 1] is the parent of cur */
+    int32_t depth = path.depth;
+    while (depth > 0 && is_a_red_compact_RB_node(tree, path.node[depth - 1]))
+    {
+        /* a red parent is never the root, so the grandparent exists */
+        uint32_t parent = path.node[depth - 1], grandparent = path.node[depth - 2];
+        _Bool parent_side = path.side[depth - 2];
+        uint32_t uncle = compact_RB_child(tree, grandparent, !parent_side);
+        if (is_a_red_compact_RB_node(tree, uncle))
+        {
+            paint_a_compact_RB_node(tree, parent, 0), paint_a_compact_RB_node(tree, uncle, 0);
+            paint_a_compact_RB_node(tree, grandparent, 1);
+            cur = grandparent, depth -= 2;
+            continue;
+        }
+        /* an inner grandchild is rotated outside first */
+        if (path.side[depth - 1] != parent_side)
+        {
+            set_compact_RB_child(tree, grandparent, parent_side,
+            rotate_a_compact_RB_node(tree, parent, !parent_side));
+            parent = cur;
+        }
+        relink_a_compact_RB_subtree(tree, &path, depth - 2, rotate_a_compact_RB_node(tree, grandparent, parent_side));
+        paint_a_compact_RB_node(tree, parent, 0);
+        paint_a_compact_RB_node(tree, grandparent, 1);
+        break;
+    }
+    paint_a_compact_RB_node(tree, tree->root, 0);
+    return 0;
+}
+
+/* return 0, or -1 if key is not in the tree. A node with two subtrees
+takes the key of its in-order successor, which is removed instead. */
+int delete_a_key_in_compact_RBT(struct compact_RB_tree *tree, int64_t key)
+{
+    struct compact_RB_path path;
+    path.depth = 0;
+    uint32_t cur = tree->root;
+    while (cur && tree->node[cur].node_id != key)
+    {
+        path.node[path.depth] = cur;
+        path.side[path.depth] = tree->node[cur].node_id < key;
+        cur = compact_RB_child(tree, cur, path.side[path.depth++]);
+    }
+    if (cur == 0)
+    {
+        fprintf(stderr, "no key value in compact red black tree!\n");
+        return -1;
+    }
+    if (compact_RB_child(tree, cur, 0) && compact_RB_child(tree, cur, 1))
+    {
+        uint32_t successor = compact_RB_child(tree, cur, 1);
+        path.node[path.depth] = cur, path.side[path.depth++] = 1;
+        while (compact_RB_child(tree, successor, 0))
+        {
+            path.node[path.depth] = successor, path.side[path.depth++] = 0;
+            successor = compact_RB_child(tree, successor, 0);
+        }
+        tree->node[cur].node_id = tree->node[successor].node_id;
+        cur = successor;
+    }
+    /* now cur has one subtree at most, which is a red leaf if any */
+    uint32_t child = compact_RB_child(tree, cur, 0) ? compact_RB_child(tree, cur, 0) : compact_RB_child(tree, cur, 1);
+    _Bool removed_red = is_a_red_compact_RB_node(tree, cur);
+    relink_a_compact_RB_subtree(tree, &path, path.depth, child);
+    free_a_compact_RB_node(tree, cur);
+    tree->key_number--;
+    if (removed_red) return 0;
+    if (is_a_red_compact_RB_node(tree, child))
+    {
+        paint_a_compact_RB_node(tree, child, 0);
+        return 0;
+    }
+    /* the subtree on side of parent is one black node short */
+    int32_t depth = path.depth;
+    while (depth > 0)
+    {
+        uint32_t parent = path.node[depth - 1];
+        _Bool side = path.side[depth - 1];
+        uint32_t sibling = compact_RB_child(tree, parent, !side);
+        if (is_a_red_compact_RB_node(tree, sibling))
+        {
+            /* make the sibling black by rotating it above parent, which stays on the path */
+            paint_a_compact_RB_node(tree, sibling, 0);
+            paint_a_compact_RB_node(tree, parent, 1);
+            relink_a_compact_RB_subtree(tree, &path, depth - 1, rotate_a_compact_RB_node(tree, parent, !side));
+            path.node[depth - 1] = sibling, path.side[depth - 1] = side;
+            path.node[depth] = parent, path.side[depth] = side;
+            depth++;
+            sibling = compact_RB_child(tree, parent, !side);
+        }
+        if (!is_a_red_compact_RB_node(tree, compact_RB_child(tree, sibling, 0))
+        && !is_a_red_compact_RB_node(tree, compact_RB_child(tree, sibling, 1)))
+        {
+            paint_a_compact_RB_node(tree, sibling, 1);
+            if (is_a_red_compact_RB_node(tree, parent))
+            {
+                paint_a_compact_RB_node(tree, parent, 0);
+                return 0;
+            }
+            depth--;
+            continue;
+        }
+        /* a red near nephew is rotated outside first */
+        if (!is_a_red_compact_RB_node(tree, compact_RB_child(tree, sibling, !side)))
+        {
+            paint_a_compact_RB_node(tree, compact_RB_child(tree, sibling, side), 0);
+            paint_a_compact_RB_node(tree, sibling, 1);
+            sibling = rotate_a_compact_RB_node(tree, sibling, side);
+            set_compact_RB_child(tree, parent, !side, sibling);
+        }
+        paint_a_compact_RB_node(tree, sibling, is_a_red_compact_RB_node(tree, parent));
+        paint_a_compact_RB_node(tree, parent, 0);
+        paint_a_compact_RB_node(tree, compact_RB_child(tree, sibling, !side), 0);
+        relink_a_compact_RB_subtree(tree, &path, depth - 1, rotate_a_compact_RB_node(tree, parent, !side));
+        return 0;
+    }
+    return 0;
+}
+
+/* hand every key of the tree in increasing order to visitor,
+COMPACT_RB_TRAV_BATCH keys at a time. A visitor which returns non-zero
+stops the traversal, and that value is returned; otherwise return 0. */
+int inorder_trav_to_compact_RBT(const struct compact_RB_tree *tree,
+int (*visitor)(const int64_t *key, int32_t key_number, void *arg), void *arg)
+{
+    uint32_t path[COMPACT_RB_MAX_HEIGHT], cur = tree->root;
+    int64_t key_buf[COMPACT_RB_TRAV_BATCH];
+    int32_t copied = 0, depth = 0;
+    int state = 0;
+    while (state == 0 && (depth || cur))
+    {
+        if (cur)
+        {
+            path[depth++] = cur;
+            cur = compact_RB_child(tree, cur, 0);
+            continue;
+        }
+        cur = path[--depth];
+        key_buf[copied++] = tree->node[cur].node_id;
+        cur = compact_RB_child(tree, cur, 1);
+        if (copied == COMPACT_RB_TRAV_BATCH)
+            state = visitor(key_buf, copied, arg), copied = 0;
+    }
+    if (state == 0 && copied) state = visitor(key_buf, copied, arg);
+    return state;
+}
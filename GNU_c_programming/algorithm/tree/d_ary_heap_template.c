@@ -0,0 +1,229 @@
+/* an array-based d-ary min heap with decrease-key, stamped out for any key
+type. Define the parameters below and include this file once per
+instantiation:
+
+    #define D_ARY_HEAP_NAME dist_heap
+    #define D_ARY_HEAP_KEY_TYPE int64_t
+    #include "d_ary_heap_template.c"
+
+Every entry carries a handle, a small non-negative integer chosen by the
+caller such as a graph node id, and pos[handle] follows the entry as it
+moves, so decrease-key finds it in O(1) and sifts it up in O(log_d n).
+D_ARY_HEAP_KEY_LESS(a, b) may be defined for keys without operator <.
+D_ARY_HEAP_ARITY defaults to 4: the heap is shallower than a binary one, and
+the entries are laid out so that the 4 children of a node, 16 bytes each
+for a 64-bit key, fill one cache line. There is no #pragma once here on
+purpose; the parameters are undefined at the end so that the next
+instantiation starts clean. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+
+#ifndef D_ARY_HEAP_NAME
+#error "D_ARY_HEAP_NAME is not defined"
+#endif
+#ifndef D_ARY_HEAP_KEY_TYPE
+#error "D_ARY_HEAP_KEY_TYPE is not defined"
+#endif
+#ifndef D_ARY_HEAP_KEY_LESS
+#define D_ARY_HEAP_KEY_LESS(a, b) ((a) < (b))
+#endif
+#ifndef D_ARY_HEAP_ARITY
+#define D_ARY_HEAP_ARITY 4
+#endif
+#if D_ARY_HEAP_ARITY < 2
+#error "D_ARY_HEAP_ARITY is out of range"
+#endif
+
+#ifndef D_ARY_HEAP_TEMPLATE_COMMON
+#define D_ARY_HEAP_TEMPLATE_COMMON
+#define D_ARY_HEAP_PASTE(a, b) a##_##b
+#define D_ARY_HEAP_CONCAT(a, b) D_ARY_HEAP_PASTE(a, b)
+#define D_ARY_HEAP_CACHE_LINE_SIZE 64
+#define D_ARY_HEAP_FIRST_CAPACITY 64
+#endif
+
+/* D_ARY_HEAP_TYPE(entry) -> struct dist_heap_entry,
+D_ARY_HEAP_FUNC(push_a_key_in) -> push_a_key_in_dist_heap */
+#define D_ARY_HEAP_TYPE(suffix) D_ARY_HEAP_CONCAT(D_ARY_HEAP_NAME, suffix)
+#define D_ARY_HEAP_FUNC(prefix) D_ARY_HEAP_CONCAT(prefix, D_ARY_HEAP_NAME)
+
+struct D_ARY_HEAP_TYPE(entry) {
+    D_ARY_HEAP_KEY_TYPE key;
+    int32_t handle;};
+
+struct D_ARY_HEAP_NAME {
+    /* entry[0] is the minimum and the children of i are d * i + 1 .. d * i + d.
+    entry points D_ARY_HEAP_ARITY - 1 entries into an aligned block, so that
+    every group of siblings starts on a cache line. */
+    struct D_ARY_HEAP_TYPE(entry) *entry, *block;
+    int32_t size, capacity;
+    /* pos[handle] is the index of the entry of handle, or -1 */
+    int32_t *pos;
+    int32_t handle_number;};
+
+static struct D_ARY_HEAP_TYPE(entry) *D_ARY_HEAP_FUNC(alloc_entries_for)(int32_t capacity,
+struct D_ARY_HEAP_TYPE(entry) **block)
+{
+    size_t bytes = (capacity + D_ARY_HEAP_ARITY - 1) * sizeof(struct D_ARY_HEAP_TYPE(entry));
+    bytes = (bytes + D_ARY_HEAP_CACHE_LINE_SIZE - 1) & ~(size_t)(D_ARY_HEAP_CACHE_LINE_SIZE - 1);
+    *block = (struct D_ARY_HEAP_TYPE(entry) *)aligned_alloc(D_ARY_HEAP_CACHE_LINE_SIZE, bytes);
+    if (*block == NULL)
+        perror("fail to allocate the entries of a d-ary heap"), exit(EXIT_FAILURE);
+    return *block + D_ARY_HEAP_ARITY - 1;
+}
+
+/* handles are taken from [0, handle_number), which grows on demand */
+struct D_ARY_HEAP_NAME *D_ARY_HEAP_FUNC(init)(int32_t handle_number)
+{
+    struct D_ARY_HEAP_NAME *heap = (struct D_ARY_HEAP_NAME *)malloc(sizeof(struct D_ARY_HEAP_NAME));
+    if (heap == NULL)
+        perror("fail to allocate a d-ary heap"), exit(EXIT_FAILURE);
+    heap->size = 0;
+    heap->capacity = D_ARY_HEAP_FIRST_CAPACITY;
+    heap->entry = D_ARY_HEAP_FUNC(alloc_entries_for)(heap->capacity, &heap->block);
+    heap->handle_number = handle_number > 0 ? handle_number : 1;
+    heap->pos = (int32_t *)malloc(heap->handle_number * sizeof(int32_t));
+    if (heap->pos == NULL)
+        perror("fail to allocate the positions of a d-ary heap"), exit(EXIT_FAILURE);
+    memset(heap->pos, -1, heap->handle_number * sizeof(int32_t));
+    return heap;
+}
+
+void D_ARY_HEAP_FUNC(destroy)(struct D_ARY_HEAP_NAME *heap)
+{
+    free(heap->block);
+    free(heap->pos);
+    free(heap);
+    return;
+}
+
+/* move the entry at index up into place, keeping the hole instead of swapping */
+static void D_ARY_HEAP_FUNC(sift_up_in)(struct D_ARY_HEAP_NAME *heap, int32_t index)
+{
+    struct D_ARY_HEAP_TYPE(entry) moving = heap->entry[index];
+    while (index > 0)
+    {
+        int32_t parent = (index - 1) / D_ARY_HEAP_ARITY;
+        if (!D_ARY_HEAP_KEY_LESS(moving.key, heap->entry[parent].key)) break;
+        heap->entry[index] = heap->entry[parent];
+        heap->pos[heap->entry[index].handle] = index;
+        index = parent;
+    }
+    heap->entry[index] = moving;
+    heap->pos[moving.handle] = index;
+    return;
+}
+
+static void D_ARY_HEAP_FUNC(sift_down_in)(struct D_ARY_HEAP_NAME *heap, int32_t index)
+{
+    struct D_ARY_HEAP_TYPE(entry) moving = heap->entry[index];
+    for (;;)
+    {
+        int32_t first_child = index * D_ARY_HEAP_ARITY + 1;
+        if (first_child >= heap->size) break;
+        int32_t last_child = first_child + D_ARY_HEAP_ARITY - 1;
+        if (last_child >= heap->size) last_child = heap->size - 1;
+        int32_t min_child = first_child;
+        for (int32_t child = first_child + 1; child <= last_child; child++)
+            if (D_ARY_HEAP_KEY_LESS(heap->entry[child].key, heap->entry[min_child].key))
+                min_child = child;
+        if (!D_ARY_HEAP_KEY_LESS(heap->entry[min_child].key, moving.key)) break;
+        heap->entry[index] = heap->entry[min_child];
+        heap->pos[heap->entry[index].handle] = index;
+        index = min_child;
+    }
+    heap->entry[index] = moving;
+    heap->pos[moving.handle] = index;
+    return;
+}
+
+_Bool D_ARY_HEAP_FUNC(handle_is_in)(const struct D_ARY_HEAP_NAME *heap, int32_t handle)
+{
+    return handle >= 0 && handle < heap->handle_number && heap->pos[handle] >= 0;
+}
+
+/* return 0, or -1 if handle is negative or already in the heap */
+int D_ARY_HEAP_FUNC(push_a_key_in)(struct D_ARY_HEAP_NAME *heap, int32_t handle, D_ARY_HEAP_KEY_TYPE key)
+{
+    if (handle < 0 || D_ARY_HEAP_FUNC(handle_is_in)(heap, handle))
+    {
+        fprintf(stderr, "push failed. Handle %" PRId32" is invalid or in the heap already.\n", handle);
+        return -1;
+    }
+    if (handle >= heap->handle_number)
+    {
+        int32_t handle_number = heap->handle_number;
+        while (handle_number <= handle) handle_number <<= 1;
+        heap->pos = (int32_t *)realloc(heap->pos, handle_number * sizeof(int32_t));
+        if (heap->pos == NULL)
+            perror("fail to grow the positions of a d-ary heap"), exit(EXIT_FAILURE);
+        memset(heap->pos + heap->handle_number, -1, (handle_number - heap->handle_number) * sizeof(int32_t));
+        heap->handle_number = handle_number;
+    }
+    if (heap->size == heap->capacity)
+    {
+        struct D_ARY_HEAP_TYPE(entry) *block;
+        struct D_ARY_HEAP_TYPE(entry) *entry = D_ARY_HEAP_FUNC(alloc_entries_for)(heap->capacity << 1, &block);
+        memcpy(entry, heap->entry, heap->size * sizeof(struct D_ARY_HEAP_TYPE(entry)));
+        free(heap->block);
+        heap->entry = entry, heap->block = block;
+        heap->capacity <<= 1;
+    }
+    heap->entry[heap->size].key = key;
+    heap->entry[heap->size].handle = handle;
+    D_ARY_HEAP_FUNC(sift_up_in)(heap, heap->size++);
+    return 0;
+}
+
+/* the minimum entry stays in the heap; return -1 if the heap is empty */
+int D_ARY_HEAP_FUNC(look_up_the_min_key_in)(const struct D_ARY_HEAP_NAME *heap, int32_t *handle,
+D_ARY_HEAP_KEY_TYPE *key)
+{
+    if (heap->size == 0) return -1;
+    if (handle) *handle = heap->entry[0].handle;
+    if (key) *key = heap->entry[0].key;
+    return 0;
+}
+
+/* remove the entry of handle wherever it is; return -1 if it is absent */
+int D_ARY_HEAP_FUNC(delete_a_handle_in)(struct D_ARY_HEAP_NAME *heap, int32_t handle)
+{
+    if (!D_ARY_HEAP_FUNC(handle_is_in)(heap, handle)) return -1;
+    int32_t index = heap->pos[handle];
+    heap->pos[handle] = -1;
+    if (index == --heap->size) return 0;
+    /* the last entry fills the hole and goes whichever way it has to */
+    heap->entry[index] = heap->entry[heap->size];
+    if (index > 0 && D_ARY_HEAP_KEY_LESS(heap->entry[index].key, heap->entry[(index - 1) / D_ARY_HEAP_ARITY].key))
+        D_ARY_HEAP_FUNC(sift_up_in)(heap, index);
+    else D_ARY_HEAP_FUNC(sift_down_in)(heap, index);
+    return 0;
+}
+
+/* take the minimum entry out; return -1 if the heap is empty */
+int D_ARY_HEAP_FUNC(pop_the_min_key_in)(struct D_ARY_HEAP_NAME *heap, int32_t *handle, D_ARY_HEAP_KEY_TYPE *key)
+{
+    if (D_ARY_HEAP_FUNC(look_up_the_min_key_in)(heap, handle, key) < 0) return -1;
+    return D_ARY_HEAP_FUNC(delete_a_handle_in)(heap, heap->entry[0].handle);
+}
+
+/* return 0, or -1 if handle is absent or new_key is not less than its key */
+int D_ARY_HEAP_FUNC(decrease_a_key_in)(struct D_ARY_HEAP_NAME *heap, int32_t handle, D_ARY_HEAP_KEY_TYPE new_key)
+{
+    if (!D_ARY_HEAP_FUNC(handle_is_in)(heap, handle)
+    || !D_ARY_HEAP_KEY_LESS(new_key, heap->entry[heap->pos[handle]].key))
+        return -1;
+    heap->entry[heap->pos[handle]].key = new_key;
+    D_ARY_HEAP_FUNC(sift_up_in)(heap, heap->pos[handle]);
+    return 0;
+}
+
+#undef D_ARY_HEAP_TYPE
+#undef D_ARY_HEAP_FUNC
+#undef D_ARY_HEAP_NAME
+#undef D_ARY_HEAP_KEY_TYPE
+#undef D_ARY_HEAP_KEY_LESS
+#undef D_ARY_HEAP_ARITY
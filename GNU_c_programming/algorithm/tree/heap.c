@@ -82,13 +82,29 @@ void min_bin_heapify(int *arr, int len, int start)
     return;
 }
 
+/* a handle follows its key while the key is swapped up the tree, so that
+decrease and delete find it in O(1) and finish in O(log n). It stays valid
+until its key is deleted or popped. */
+struct binomial_handle
+{   struct binomial_node *node;
+    int id;};
+
 struct binomial_node
 {   int key;
     int degree;
+    struct binomial_handle *handle;
     struct binomial_node *left_child;
     struct binomial_node *parent;
     struct binomial_node *sibling;};
 
+struct binomial_heap
+{   /* the roots in ascending order of degree */
+    struct binomial_node *head;
+    size_t size;
+    /* handle_of[id] is the handle of id, or NULL, when id_number > 0 */
+    struct binomial_handle **handle_of;
+    int id_number;};
+
 /* the complexity of lookup in binomial heap is O(n) */
 struct binomial_node *lookup_a_key_in_binomial_heap(struct binomial_node *node, int unkown_key)
 {
@@ -108,151 +124,227 @@ struct binomial_node *lookup_a_key_in_binomial_heap(struct binomial_node *node,
     }
 }
 
-static struct binomial_node *link_binomial_trees(struct binomial_node *front, struct binomial_node *rear, struct binomial_node **binomial_heap)
+/* make rear the leftmost child of front; both are roots of degree k */
+static struct binomial_node *link_binomial_trees(struct binomial_node *front, struct binomial_node *rear)
 {
-    if (front->key <= rear->key)
-    {
-        front->sibling = rear->sibling;
-        rear->parent = front;
-        rear->sibling = front->left_child;
-        front->left_child = rear;
-        front->degree++;
-    }
-    else
-    {
-        if (front == *binomial_heap) rear = *binomial_heap;
-        front->parent = rear;
-        front->sibling = rear->left_child;
-        rear->left_child = front;
-        rear->degree++;
-        front = rear;
-    }
+    rear->parent = front;
+    rear->sibling = front->left_child;
+    front->left_child = rear;
+    front->degree++;
     return front;
 }
 
-struct binomial_node** init_binomial_heap(int *arr, int len)
+/* merge two root lists by degree and link the roots of equal degree */
+static struct binomial_node *unite_binomial_root_lists(struct binomial_node *list1, struct binomial_node *list2)
 {
-    struct binomial_node **binomial_heap;
-    *binomial_heap = NULL;
-    for (int i = 0; i < len; i++)
+    struct binomial_node *head = NULL, **tail = &head;
+    while (list1 != NULL && list2 != NULL)
     {
-        struct binomial_node *new_node;
-        *new_node = (struct binomial_node){0};
-        new_node->key = arr[i];
-        /* set new_node as the first binomial tree in binomial_heap */
-        new_node->sibling = *binomial_heap;
-        *binomial_heap = new_node;
-        /* add new node in first of heap and unite binomial trees one by one */
-        struct binomial_node *cur, *next_of_cur;
-        for (cur = new_node; cur->sibling != NULL;)
-        /* worst comlexity of inserting a node in binomial heap is O(log n) */
-        {
-            next_of_cur = cur->sibling;
-            if (next_of_cur->sibling != NULL &&
-            next_of_cur->degree == next_of_cur->sibling->degree) cur = cur->sibling;
-            else if (cur->degree != next_of_cur->degree) break;
-            else cur = link_binomial_trees(cur, next_of_cur, binomial_heap);
-        }
-
+        struct binomial_node **smaller = list1->degree <= list2->degree ? &list1 : &list2;
+        *tail = *smaller;
+        tail = &(*smaller)->sibling;
+        *smaller = (*smaller)->sibling;
     }
-    return binomial_heap;
-}
-
-void delete_min_binomial_node(struct binomial_node **binomial_heap)
-{
-    struct binomial_node *min = *binomial_heap, *prev_of_min = NULL;
-    struct binomial_node *i;
-    *i = (struct binomial_node){0};
-    for (i->sibling = *binomial_heap; i->sibling != NULL; i = i->sibling)
-        if (i->sibling->key < min->key)
-        {
-            min = i->sibling;
-            prev_of_min = i;
-        }
-    /* delete minimum-key node */
-    if (prev_of_min == NULL)
-        *binomial_heap = min->sibling;
-    else prev_of_min->sibling = min->sibling;
-    /* sort binomial trees in the degree of root */
-    struct binomial_node *cur1 = *binomial_heap;
-    struct binomial_node *cur2 = min->left_child;
-    for (i = min->left_child; i != NULL; i = i->sibling)
-        i->parent = NULL;
-    /* delete minimum-key node */
-    free(min);
-    /* sort binomial trees in the degree of root */
-    *binomial_heap = (cur1->degree < cur2->degree) ? cur1 : cur2;
-    while (cur1 != NULL && cur2 != NULL)
+    *tail = list1 != NULL ? list1 : list2;
+    if (head == NULL) return NULL;
+    struct binomial_node *prev = NULL, *cur = head, *next_of_cur = cur->sibling;
+    while (next_of_cur != NULL)
     {
-        if (cur1->degree < cur2->degree)
+        /* skip while the degrees differ, or while three in a row are equal so
+        that the last two are linked first */
+        if (cur->degree != next_of_cur->degree ||
+        (next_of_cur->sibling != NULL && next_of_cur->sibling->degree == cur->degree))
+            prev = cur, cur = next_of_cur;
+        else if (cur->key <= next_of_cur->key)
         {
-            i = cur1;
-            i = i->sibling;
-            cur1 = cur1->sibling;
+            cur->sibling = next_of_cur->sibling;
+            link_binomial_trees(cur, next_of_cur);
         }
         else
         {
-            i = cur2;
-            i = i->sibling;
-            cur2 = cur2->sibling;
+            if (prev == NULL) head = next_of_cur;
+            else prev->sibling = next_of_cur;
+            cur = link_binomial_trees(next_of_cur, cur);
         }
+        next_of_cur = cur->sibling;
     }
-    while (cur1 != NULL)
+    return head;
+}
+
+/* id_number > 0 builds an index from the ids [0, id_number) to their handles */
+struct binomial_heap *init_binomial_heap(int id_number)
+{
+    struct binomial_heap *binomial_heap = (struct binomial_heap *)malloc(sizeof(struct binomial_heap));
+    if (binomial_heap == NULL)
+        perror("fail to allocate a binomial heap"), exit(EXIT_FAILURE);
+    binomial_heap->head = NULL;
+    binomial_heap->size = 0;
+    binomial_heap->id_number = id_number > 0 ? id_number : 0;
+    binomial_heap->handle_of = NULL;
+    if (id_number > 0 &&
+    (binomial_heap->handle_of = (struct binomial_handle **)calloc(id_number, sizeof(struct binomial_handle *))) == NULL)
+        perror("fail to allocate the index of a binomial heap"), exit(EXIT_FAILURE);
+    return binomial_heap;
+}
+
+static void delete_all_binomial_nodes(struct binomial_node *node)
+{
+    while (node != NULL)
     {
-        i = cur1;
-        i = i->sibling;
-        cur1 = cur1->sibling;
+        struct binomial_node *sibling = node->sibling;
+        delete_all_binomial_nodes(node->left_child);
+        free(node->handle);
+        free(node);
+        node = sibling;
     }
-    while (cur2 != NULL)
+    return;
+}
+
+void destroy_binomial_heap(struct binomial_heap *binomial_heap)
+{
+    delete_all_binomial_nodes(binomial_heap->head);
+    free(binomial_heap->handle_of);
+    free(binomial_heap);
+    return;
+}
+
+/* return the handle of the new key, or NULL if the heap has an index and id
+is out of it or in the heap already */
+struct binomial_handle *insert_a_key_in_binomial_heap(struct binomial_heap *binomial_heap, int key, int id)
+{
+    if (binomial_heap->id_number > 0 &&
+    (id < 0 || id >= binomial_heap->id_number || binomial_heap->handle_of[id] != NULL))
     {
-        i = cur2;
-        i = i->sibling;
-        cur2 = cur2->sibling;
+        fprintf(stderr, "insert failed. Id %d is out of the index or in binomial_heap already.\n", id);
+        return NULL;
     }
-    /* merge binomial trees from head of binomial_heap */
-    for (i = *binomial_heap; i->sibling != NULL;)
+    struct binomial_node *new_node = (struct binomial_node *)malloc(sizeof(struct binomial_node));
+    struct binomial_handle *handle = (struct binomial_handle *)malloc(sizeof(struct binomial_handle));
+    if (new_node == NULL || handle == NULL)
+        perror("fail to allocate a binomial node"), exit(EXIT_FAILURE);
+    *new_node = (struct binomial_node){key, 0, handle, NULL, NULL, NULL};
+    *handle = (struct binomial_handle){new_node, id};
+    binomial_heap->head = unite_binomial_root_lists(binomial_heap->head, new_node);
+    binomial_heap->size++;
+    if (binomial_heap->id_number > 0) binomial_heap->handle_of[id] = handle;
+    return handle;
+}
+
+/* return the handle of id in O(1), or NULL; the heap needs an index */
+struct binomial_handle *look_up_an_id_in_binomial_heap(const struct binomial_heap *binomial_heap, int id)
+{
+    if (id < 0 || id >= binomial_heap->id_number) return NULL;
+    return binomial_heap->handle_of[id];
+}
+
+static struct binomial_node *look_up_the_min_binomial_root(const struct binomial_heap *binomial_heap,
+struct binomial_node **prev_of_min)
+{
+    struct binomial_node *min = binomial_heap->head;
+    *prev_of_min = NULL;
+    for (struct binomial_node *i = binomial_heap->head; i != NULL && i->sibling != NULL; i = i->sibling)
+        if (i->sibling->key < min->key)
+        {
+            min = i->sibling;
+            *prev_of_min = i;
+        }
+    return min;
+}
+
+/* the minimum key stays in the heap; return -1 if the heap is empty */
+int look_up_the_min_key_in_binomial_heap(const struct binomial_heap *binomial_heap, int *key, int *id)
+{
+    struct binomial_node *prev_of_min;
+    struct binomial_node *min = look_up_the_min_binomial_root(binomial_heap, &prev_of_min);
+    if (min == NULL) return -1;
+    if (key) *key = min->key;
+    if (id) *id = min->handle->id;
+    return 0;
+}
+
+/* cut root out of the root list after prev_of_root, and put its children back */
+static void delete_a_binomial_root(struct binomial_heap *binomial_heap, struct binomial_node *root,
+struct binomial_node *prev_of_root)
+{
+    if (prev_of_root == NULL) binomial_heap->head = root->sibling;
+    else prev_of_root->sibling = root->sibling;
+    /* the children are in descending order of degree, so reverse them */
+    struct binomial_node *children = NULL;
+    for (struct binomial_node *i = root->left_child, *next_of_i; i != NULL; i = next_of_i)
     {
-        struct binomial_node *next_of_i = i->sibling;
-        if ((i->degree != next_of_i->degree) ||
-        ((next_of_i->sibling != NULL) && (next_of_i->degree == next_of_i->sibling->degree)))
-            i = i->sibling;
-        else i = link_binomial_trees(i, next_of_i, binomial_heap);
+        next_of_i = i->sibling;
+        i->parent = NULL;
+        i->sibling = children;
+        children = i;
     }
+    binomial_heap->head = unite_binomial_root_lists(binomial_heap->head, children);
+    binomial_heap->size--;
+    if (binomial_heap->id_number > 0) binomial_heap->handle_of[root->handle->id] = NULL;
+    free(root->handle);
+    free(root);
     return;
 }
 
-int decrease_binomial_key(struct binomial_node **binomial_heap, int decreased_key, int new_key)
+/* pop the minimum key; return -1 if the heap is empty */
+int delete_min_binomial_node(struct binomial_heap *binomial_heap, int *key, int *id)
+{
+    struct binomial_node *prev_of_min;
+    struct binomial_node *min = look_up_the_min_binomial_root(binomial_heap, &prev_of_min);
+    if (min == NULL) return -1;
+    if (key) *key = min->key;
+    if (id) *id = min->handle->id;
+    delete_a_binomial_root(binomial_heap, min, prev_of_min);
+    return 0;
+}
+
+/* swap the key of node with its parents while it is less than theirs, or all
+the way to the root if to_root is set; the handles follow their keys */
+static struct binomial_node *sift_a_binomial_node_up(struct binomial_node *node, _Bool to_root)
 {
-    if (decreased_key <= new_key)
+    while (node->parent != NULL && (to_root || node->key < node->parent->key))
     {
-        fprintf(stderr, "decreased_key %d <=  new_key %d.\n", decreased_key, new_key);
-        return -1;
+        struct binomial_node *parent = node->parent;
+        int tmp_key = node->key; node->key = parent->key; parent->key = tmp_key;
+        struct binomial_handle *tmp_handle = node->handle; node->handle = parent->handle; parent->handle = tmp_handle;
+        node->handle->node = node;
+        parent->handle->node = parent;
+        node = parent;
     }
-    struct binomial_node *decreased_node = lookup_a_key_in_binomial_heap(*binomial_heap, decreased_key);
-    if (decreased_node == NULL)
+    return node;
+}
+
+/* with an index, a handle belongs to the heap only if its id maps back to it */
+static _Bool binomial_handle_is_foreign(const struct binomial_heap *binomial_heap,
+const struct binomial_handle *handle)
+{
+    if (binomial_heap->id_number == 0) return 0;
+    if (look_up_an_id_in_binomial_heap(binomial_heap, handle->id) == handle) return 0;
+    fprintf(stderr, "handle of id %d is not in this binomial heap.\n", handle->id);
+    return 1;
+}
+
+int decrease_binomial_key(struct binomial_heap *binomial_heap, struct binomial_handle *handle, int new_key)
+{
+    if (binomial_handle_is_foreign(binomial_heap, handle)) return -1;
+    if (handle->node->key <= new_key)
     {
-        fprintf(stderr, "No decreased_key %d in binomial_heap.\n", decreased_key);
+        fprintf(stderr, "decreased_key %d <=  new_key %d.\n", handle->node->key, new_key);
         return -1;
     }
-    decreased_node->key = new_key;
-    for (struct binomial_node *cur = decreased_node;
-    cur->parent != NULL && cur->key < cur->parent->key;
-    cur = cur->parent)
-    {
-        int tmp = cur->key;
-        cur->key = cur->parent->key;
-        cur->parent->key = tmp;
-    }
+    handle->node->key = new_key;
+    sift_a_binomial_node_up(handle->node, 0);
     return 0;
 }
 
-int delete_binomial_node(struct binomial_node **binomial_heap, int key_to_be_del)
+/* the key of handle is carried up to its root and deleted there; the
+handle is freed. Return -1 if the handle is not in the heap. */
+int delete_binomial_node(struct binomial_heap *binomial_heap, struct binomial_handle *handle)
 {
-    if ( decrease_binomial_key(binomial_heap, key_to_be_del, INT32_MIN) < 0 )
-        return -1;
-    else
-    {
-        delete_min_binomial_node(binomial_heap);
-        return 0;
-    }
-}
\ No newline at end of file
+    if (binomial_handle_is_foreign(binomial_heap, handle)) return -1;
+    struct binomial_node *root = sift_a_binomial_node_up(handle->node, 1);
+    struct binomial_node *prev_of_root = NULL;
+    for (struct binomial_node *i = binomial_heap->head; i != root; i = i->sibling)
+        prev_of_root = i;
+    delete_a_binomial_root(binomial_heap, root, prev_of_root);
+    return 0;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "B_plus_tree.c"
+#include "../circle_multilist_graph/skip_list.c"
+/* a skip list as a memtable: writes go into the skip list, and once it is
+large enough it is frozen (the writers move on to a new list) and its keys
+are streamed in order into a B plus tree built bottom-up, instead of one
+insert_a_key_in_B_plus_tree() per key. */
+#define MEMTABLE_FLUSH_BATCH 256
+
+/* bulk load every key of list into the empty B_plus_tree, with the value of
+each key as its fd. Keys and values have to fit in int16_t and int.
+Return the number of keys, or -1. */
+int32_t flush_skip_list_into_B_plus_tree(struct skip_list *list, struct B_plus_node **B_plus_tree,
+double fill_factor)
+{
+    if (*B_plus_tree != NULL)
+    {
+        fputs("flushing needs an empty B plus tree.\n", stderr);
+        return -1;
+    }
+    int32_t key_buf[MEMTABLE_FLUSH_BATCH];
+    int64_t value_buf[MEMTABLE_FLUSH_BATCH];
+    int16_t *sorted_key = NULL;
+    int *fd = NULL;
+    int32_t len = 0, capacity = 0, copied;
+    struct skip_list_iterator iter;
+    lower_bound_in_skip_list(list, INT32_MIN, &iter);
+    while ((copied = next_batch_in_skip_list(&iter, INT32_MAX, key_buf, value_buf, MEMTABLE_FLUSH_BATCH)) > 0)
+    {
+        if (len + copied > capacity)
+        {
+            capacity = capacity ? capacity << 1 : 4096;
+            sorted_key = (int16_t *)realloc(sorted_key, capacity * sizeof(int16_t));
+            fd = (int *)realloc(fd, capacity * sizeof(int));
+            if (sorted_key == NULL || fd == NULL)
+                perror("fail to allocate the flushed keys"), exit(EXIT_FAILURE);
+        }
+        for (int32_t i = 0; i < copied; i++, len++)
+        {
+            if (key_buf[i] < INT16_MIN || key_buf[i] > INT16_MAX || value_buf[i] < INT_MIN || value_buf[i] > INT_MAX)
+            {
+                close_a_skip_list_iterator(&iter);
+                fprintf(stderr, "flushing failed. Key %" PRId32" or its value %" PRId64" is out of range.\n",
+                key_buf[i], value_buf[i]);
+                free(sorted_key), free(fd);
+                return -1;
+            }
+            sorted_key[len] = (int16_t)key_buf[i];
+            fd[len] = (int)value_buf[i];
+        }
+    }
+    close_a_skip_list_iterator(&iter);
+    int state = bulk_load_B_plus_tree(B_plus_tree, sorted_key, fd, len, fill_factor, NULL);
+    free(sorted_key), free(fd);
+    return state < 0 ? -1 : len;
+}
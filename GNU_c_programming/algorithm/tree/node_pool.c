@@ -0,0 +1,201 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+/* a slab allocator for tree nodes of one size. Nodes are cut out of
+SLAB_SIZE-aligned slabs, so the slab and the pool of any node are found from
+its address. Each thread allocates from and frees into its own cache, and
+only a batch of NODE_CACHE_BATCH nodes at a time moves between the cache and
+the pool under the pool mutex. destroy_node_pool() frees every node of every
+tree built on the pool in O(slabs), without walking the trees. */
+#define SLAB_SIZE (1 << 18)
+#define NODE_CACHE_BATCH 64
+
+struct free_node {
+    struct free_node *next;};
+
+struct node_pool;
+struct slab {
+    struct node_pool *pool;
+    struct slab *next;};
+
+struct node_cache {
+    struct node_pool *pool;
+    struct free_node *free_list;
+    uint32_t free_number;
+    struct node_cache *prev, *next;};
+
+struct node_pool {
+    size_t node_size;
+    size_t first_node_offset;
+    pthread_mutex_t mutex;
+    pthread_key_t cache_key;
+    struct slab *slab_list;
+    size_t slab_number;
+    /* the unused tail of the newest slab */
+    char *bump, *bump_end;
+    /* nodes handed back by thread caches */
+    struct free_node *free_list;
+    struct node_cache *cache_list;};
+
+/* give the nodes of an exiting thread back to the pool */
+static void release_a_node_cache(void *arg)
+{
+    struct node_cache *cache = (struct node_cache *)arg;
+    struct node_pool *pool = cache->pool;
+    pthread_mutex_lock(&pool->mutex);
+    while (cache->free_list)
+    {
+        struct free_node *node = cache->free_list;
+        cache->free_list = node->next;
+        node->next = pool->free_list, pool->free_list = node;
+    }
+    if (cache->prev) cache->prev->next = cache->next;
+    else pool->cache_list = cache->next;
+    if (cache->next) cache->next->prev = cache->prev;
+    pthread_mutex_unlock(&pool->mutex);
+    free(cache);
+    return;
+}
+
+/* node_size is rounded up to align, which must be a power of 2 */
+struct node_pool *init_node_pool(size_t node_size, size_t align)
+{
+    if (align < sizeof(void *)) align = sizeof(void *);
+    if (align & (align - 1))
+    {
+        fprintf(stderr, "the node alignment %zu is not a power of 2.\n", align);
+        return NULL;
+    }
+    if (node_size < sizeof(struct free_node)) node_size = sizeof(struct free_node);
+    node_size = (node_size + align - 1) & ~(align - 1);
+    size_t first_node_offset = (sizeof(struct slab) + align - 1) & ~(align - 1);
+    if (first_node_offset + node_size > SLAB_SIZE)
+    {
+        fprintf(stderr, "a node of %zu bytes doesn't fit in a slab.\n", node_size);
+        return NULL;
+    }
+    struct node_pool *pool = (struct node_pool *)calloc(1, sizeof(struct node_pool));
+    if (pool == NULL)
+        perror("fail to allocate a node pool"), exit(EXIT_FAILURE);
+    pool->node_size = node_size;
+    pool->first_node_offset = first_node_offset;
+    pthread_mutex_init(&pool->mutex, NULL);
+    if (pthread_key_create(&pool->cache_key, release_a_node_cache))
+        perror("fail to create the node cache key"), exit(EXIT_FAILURE);
+    return pool;
+}
+
+static struct node_cache *get_the_node_cache_of_this_thread(struct node_pool *pool)
+{
+    struct node_cache *cache = (struct node_cache *)pthread_getspecific(pool->cache_key);
+    if (__builtin_expect(cache != NULL, 1)) return cache;
+    cache = (struct node_cache *)calloc(1, sizeof(struct node_cache));
+    if (cache == NULL)
+        perror("fail to allocate a node cache"), exit(EXIT_FAILURE);
+    cache->pool = pool;
+    pthread_mutex_lock(&pool->mutex);
+    cache->next = pool->cache_list;
+    if (pool->cache_list) pool->cache_list->prev = cache;
+    pool->cache_list = cache;
+    pthread_mutex_unlock(&pool->mutex);
+    pthread_setspecific(pool->cache_key, cache);
+    return cache;
+}
+
+/* move a batch of nodes from the pool into cache, cutting a new slab if needed */
+static void refill_a_node_cache(struct node_pool *pool, struct node_cache *cache)
+{
+    pthread_mutex_lock(&pool->mutex);
+    while (cache->free_number < NODE_CACHE_BATCH)
+    {
+        struct free_node *node;
+        if (pool->free_list)
+            node = pool->free_list, pool->free_list = node->next;
+        else
+        {
+            if (pool->bump + pool->node_size > pool->bump_end)
+            {
+                /* hand out what we have rather than waiting on a new slab */
+                if (cache->free_number) break;
+                struct slab *slab = (struct slab *)aligned_alloc(SLAB_SIZE, SLAB_SIZE);
+                if (slab == NULL)
+                    perror("fail to allocate a slab"), exit(EXIT_FAILURE);
+                slab->pool = pool;
+                slab->next = pool->slab_list, pool->slab_list = slab;
+                pool->slab_number++;
+                pool->bump = (char *)slab + pool->first_node_offset;
+                pool->bump_end = (char *)slab + SLAB_SIZE;
+            }
+            node = (struct free_node *)pool->bump;
+            pool->bump += pool->node_size;
+        }
+        node->next = cache->free_list, cache->free_list = node;
+        cache->free_number++;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return;
+}
+
+/* the node is not zeroed. */
+void *alloc_a_node_from_pool(struct node_pool *pool)
+{
+    struct node_cache *cache = get_the_node_cache_of_this_thread(pool);
+    if (__builtin_expect(cache->free_list == NULL, 0))
+        refill_a_node_cache(pool, cache);
+    struct free_node *node = cache->free_list;
+    cache->free_list = node->next;
+    cache->free_number--;
+    return node;
+}
+
+/* the pool which node was allocated from; node must come from some pool */
+struct node_pool *node_pool_of_a_node(const void *node)
+{
+    return ((const struct slab *)((uintptr_t)node & ~(uintptr_t)(SLAB_SIZE - 1)))->pool;
+}
+
+/* node goes back to the pool it came from */
+void free_a_node_to_pool(void *node)
+{
+    struct node_pool *pool = node_pool_of_a_node(node);
+    struct node_cache *cache = get_the_node_cache_of_this_thread(pool);
+    struct free_node *freed = (struct free_node *)node;
+    freed->next = cache->free_list, cache->free_list = freed;
+    if (++cache->free_number < NODE_CACHE_BATCH << 1) return;
+    /* keep one batch, and give the other back for other threads */
+    pthread_mutex_lock(&pool->mutex);
+    while (cache->free_number > NODE_CACHE_BATCH)
+    {
+        freed = cache->free_list;
+        cache->free_list = freed->next;
+        freed->next = pool->free_list, pool->free_list = freed;
+        cache->free_number--;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return;
+}
+
+/* free every node allocated from pool at once. No thread may use the pool,
+or any tree built on it, during or after the call. */
+void destroy_node_pool(struct node_pool *pool)
+{
+    pthread_key_delete(pool->cache_key);
+    while (pool->cache_list)
+    {
+        struct node_cache *cache = pool->cache_list;
+        pool->cache_list = cache->next;
+        free(cache);
+    }
+    while (pool->slab_list)
+    {
+        struct slab *slab = pool->slab_list;
+        pool->slab_list = slab->next;
+        free(slab);
+    }
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool);
+    return;
+}
@@ -0,0 +1,505 @@
+/* benchmark of every ordered map in this directory through one interface:
+uniform, Zipfian, sequential and mixed read/write workloads, reporting
+throughput, p50/p99 latency, heap bytes per key and cache misses per op.
+Then the trees which can take their nodes from a struct node_pool are loaded
+twice more, to time freeing them node by node against destroy_node_pool().
+
+    gcc -O2 -pthread ordered_map_benchmark.c -lm -o ordered_map_benchmark
+    ./ordered_map_benchmark [key_number] [op_number]
+
+The tree files were written to be included one at a time, so the names that
+collide between them are renamed around each #include below. */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define stack BST_stack
+#define top BST_top
+#define push BST_push
+#define popup BST_popup
+#include "binary_search_tree.c"
+#undef stack
+#undef top
+#undef push
+#undef popup
+
+#define side AVL_side
+#define left AVL_left
+#define right AVL_right
+#define stack AVL_stack
+#define top AVL_top
+#define push AVL_push
+#define popup AVL_popup
+#define main AVL_main
+#include "AVL_tree.c"
+#undef side
+#undef left
+#undef right
+#undef stack
+#undef top
+#undef push
+#undef popup
+#undef main
+
+#define side RB_side
+#define left RB_left
+#define right RB_right
+#include "red_black_tree.c"
+#undef side
+#undef left
+#undef right
+
+#define get_string B_get_string
+#include "B_tree.c"
+#undef get_string
+
+#define get_string B_plus_get_string
+#include "B_plus_tree.c"
+#undef get_string
+
+#include "B_plus_tree_instances.c"
+#include "compact_AVL_tree.c"
+#include "compact_red_black_tree.c"
+
+#define DEFAULT_KEY_NUMBER 1000000
+#define DEFAULT_OP_NUMBER 2000000
+/* one op in LATENCY_SAMPLE_INTERVAL is timed on its own */
+#define LATENCY_SAMPLE_INTERVAL 8
+#define ZIPFIAN_THETA 0.99
+
+/* every tree behind the same calls; the root of each one is kept here */
+struct ordered_map {
+    const char *name;
+    /* keys are taken from [0, key_limit) */
+    int64_t key_limit;
+    /* sorted input turns the tree into a list */
+    _Bool is_unbalanced;
+    int (*insert)(int64_t key);
+    /* return 0 if key is found */
+    int (*look_up)(int64_t key);
+    int (*delete)(int64_t key);
+    void (*delete_all)(void);
+    /* the node of a tree which can be pooled, or 0 */
+    size_t node_size, node_align;};
+
+/* the pool the trees take their nodes from while it is not NULL */
+static struct node_pool *node_pool;
+
+/* free a pooled tree with its pool. Return 0 if there is no pool. */
+static _Bool destroy_the_node_pool(void)
+{
+    if (node_pool == NULL) return 0;
+    destroy_node_pool(node_pool), node_pool = NULL;
+    return 1;
+}
+
+static struct bin_node *BST_root;
+static int insert_in_BST(int64_t key) { return insert_a_node_in_BST(&BST_root, (int32_t)key, node_pool); }
+static int look_up_in_BST(int64_t key)
+{
+    return look_up_a_node_in_BST((const struct bin_node **)&BST_root, (int32_t)key) ? 0 : -1;
+}
+static int delete_in_BST(int64_t key) { return delete_a_node_and_fill_from_left_subtree_in_BST(&BST_root, (int32_t)key); }
+static void delete_all_in_BST(void)
+{
+    if (!destroy_the_node_pool()) delete_all_nodes_in_BST(BST_root);
+    BST_root = NULL;
+}
+
+static struct AVL_node *AVL_root;
+static int insert_in_AVL(int64_t key) { return insert_a_key_in_AVL(&AVL_root, (int32_t)key, node_pool); }
+static int look_up_in_AVL(int64_t key) { return look_up_a_key_in_AVL(&AVL_root, (int32_t)key) ? 0 : -1; }
+static int delete_in_AVL(int64_t key) { return delete_a_key_and_fill_from_left_subtree_in_AVL(&AVL_root, (int32_t)key); }
+static void delete_all_AVL_nodes(struct AVL_node *node)
+{
+    if (node == NULL) return;
+    delete_all_AVL_nodes(node->next[0]);
+    delete_all_AVL_nodes(node->next[1]);
+    free_an_AVL_node(node);
+}
+static void delete_all_in_AVL(void)
+{
+    if (!destroy_the_node_pool()) delete_all_AVL_nodes(AVL_root);
+    AVL_root = NULL;
+}
+
+/* the same trees loaded through a finger, which a deletion makes stale */
+static struct AVL_finger AVL_finger;
+static int insert_in_AVL_with_finger(int64_t key)
+{
+    return insert_a_key_in_AVL_with_finger(&AVL_root, (int32_t)key, &AVL_finger, node_pool);
+}
+static int delete_in_AVL_with_finger(int64_t key) { init_an_AVL_finger(&AVL_finger); return delete_in_AVL(key); }
+static void delete_all_in_AVL_with_finger(void) { init_an_AVL_finger(&AVL_finger), delete_all_in_AVL(); }
+
+static struct RB_node *RB_root;
+static int insert_in_RBT(int64_t key) { return insert_a_key_in_RBT(&RB_root, key, node_pool); }
+static int look_up_in_RBT(int64_t key) { return look_up_a_key_in_RBT(&RB_root, key) ? 0 : -1; }
+static int delete_in_RBT(int64_t key) { return delete_a_key_and_fill_from_left_subtree_in_RBT(&RB_root, key); }
+static void delete_all_RB_nodes(struct RB_node *node)
+{
+    if (node == NULL) return;
+    delete_all_RB_nodes(node->next[0]);
+    delete_all_RB_nodes(node->next[1]);
+    free_an_RB_node(node);
+}
+static void delete_all_in_RBT(void)
+{
+    if (!destroy_the_node_pool()) delete_all_RB_nodes(RB_root);
+    RB_root = NULL;
+}
+
+static struct RB_finger RB_finger;
+static int insert_in_RBT_with_finger(int64_t key) { return insert_a_key_in_RBT_with_finger(&RB_root, key, &RB_finger, node_pool); }
+static int delete_in_RBT_with_finger(int64_t key) { init_an_RB_finger(&RB_finger); return delete_in_RBT(key); }
+static void delete_all_in_RBT_with_finger(void) { init_an_RB_finger(&RB_finger), delete_all_in_RBT(); }
+
+static struct compact_AVL_tree *compact_AVL;
+static int insert_in_compact_AVL(int64_t key)
+{
+    if (compact_AVL == NULL) compact_AVL = init_compact_AVL_tree();
+    return insert_a_key_in_compact_AVL(compact_AVL, (int32_t)key);
+}
+static int look_up_in_compact_AVL(int64_t key) { return look_up_a_key_in_compact_AVL(compact_AVL, (int32_t)key); }
+static int delete_in_compact_AVL(int64_t key) { return delete_a_key_in_compact_AVL(compact_AVL, (int32_t)key); }
+static void delete_all_in_compact_AVL(void) { destroy_compact_AVL_tree(compact_AVL), compact_AVL = NULL; }
+
+static struct compact_RB_tree *compact_RBT;
+static int insert_in_compact_RBT(int64_t key)
+{
+    if (compact_RBT == NULL) compact_RBT = init_compact_RB_tree();
+    return insert_a_key_in_compact_RBT(compact_RBT, key);
+}
+static int look_up_in_compact_RBT(int64_t key) { return look_up_a_key_in_compact_RBT(compact_RBT, key); }
+static int delete_in_compact_RBT(int64_t key) { return delete_a_key_in_compact_RBT(compact_RBT, key); }
+static void delete_all_in_compact_RBT(void) { destroy_compact_RB_tree(compact_RBT), compact_RBT = NULL; }
+
+static struct B_node *B_root;
+static int insert_in_B_tree(int64_t key) { return insert_a_key_in_B_tree(&B_root, (int32_t)key, node_pool); }
+static int look_up_in_B_tree(int64_t key) { return look_up_a_key_in_B_tree(&B_root, (int32_t)key) < 0 ? -1 : 0; }
+static int delete_in_B_tree(int64_t key) { return delete_a_key_and_fill_from_left_subtree_in_B_tree(&B_root, (int32_t)key); }
+static void delete_all_in_B_tree(void)
+{
+    if (!destroy_the_node_pool()) delete_all_nodes_in_B_tree(B_root);
+    B_root = NULL;
+}
+
+static struct B_finger B_finger;
+static int insert_in_B_tree_with_finger(int64_t key)
+{
+    return insert_a_key_in_B_tree_with_finger(&B_root, (int32_t)key, &B_finger, node_pool);
+}
+static int delete_in_B_tree_with_finger(int64_t key) { init_a_B_finger(&B_finger); return delete_in_B_tree(key); }
+static void delete_all_in_B_tree_with_finger(void) { init_a_B_finger(&B_finger), delete_all_in_B_tree(); }
+
+static struct B_plus_node *B_plus_root;
+static int insert_in_B_plus_tree(int64_t key) { return insert_a_key_in_B_plus_tree(&B_plus_root, (int16_t)key, node_pool); }
+static int look_up_in_B_plus_tree(int64_t key)
+{
+    return look_up_a_leaf_key_in_B_plus_tree(&B_plus_root, (int16_t)key) < 0 ? -1 : 0;
+}
+static int delete_in_B_plus_tree(int64_t key)
+{
+    return delete_a_key_and_fill_from_min_key_in_B_plus_tree(&B_plus_root, (int16_t)key);
+}
+static void delete_all_in_B_plus_tree(void)
+{
+    if (!destroy_the_node_pool()) delete_all_nodes_in_B_plus_tree(B_plus_root);
+    B_plus_root = NULL;
+}
+
+static struct B_plus_node *B_plus_finger;
+static int insert_in_B_plus_tree_with_finger(int64_t key)
+{
+    return insert_a_key_in_B_plus_tree_with_finger(&B_plus_root, (int16_t)key, &B_plus_finger, node_pool);
+}
+static int delete_in_B_plus_tree_with_finger(int64_t key) { B_plus_finger = NULL; return delete_in_B_plus_tree(key); }
+static void delete_all_in_B_plus_tree_with_finger(void) { B_plus_finger = NULL, delete_all_in_B_plus_tree(); }
+
+static struct u64_B_plus_tree_node *u64_B_plus_root;
+static int insert_in_u64_B_plus_tree(int64_t key)
+{
+    struct value16 value = {{(uint64_t)key, 0}};
+    return insert_a_key_in_u64_B_plus_tree(&u64_B_plus_root, (uint64_t)key, value);
+}
+static int look_up_in_u64_B_plus_tree(int64_t key)
+{
+    return look_up_a_key_in_u64_B_plus_tree(&u64_B_plus_root, (uint64_t)key, NULL);
+}
+static int delete_in_u64_B_plus_tree(int64_t key) { return delete_a_key_in_u64_B_plus_tree(&u64_B_plus_root, (uint64_t)key); }
+static void delete_all_in_u64_B_plus_tree(void)
+{
+    delete_all_nodes_in_u64_B_plus_tree(u64_B_plus_root), u64_B_plus_root = NULL;
+}
+
+static const struct ordered_map ordered_maps[] = {
+    {"BST", INT32_MAX, 1, insert_in_BST, look_up_in_BST, delete_in_BST, delete_all_in_BST,
+    sizeof(struct bin_node), _Alignof(struct bin_node)},
+    {"AVL", INT32_MAX, 0, insert_in_AVL, look_up_in_AVL, delete_in_AVL, delete_all_in_AVL,
+    sizeof(struct AVL_node), _Alignof(struct AVL_node)},
+    {"AVL finger", INT32_MAX, 0, insert_in_AVL_with_finger, look_up_in_AVL,
+    delete_in_AVL_with_finger, delete_all_in_AVL_with_finger},
+    {"red black", INT64_MAX, 0, insert_in_RBT, look_up_in_RBT, delete_in_RBT, delete_all_in_RBT,
+    sizeof(struct RB_node), _Alignof(struct RB_node)},
+    {"RB finger", INT64_MAX, 0, insert_in_RBT_with_finger, look_up_in_RBT,
+    delete_in_RBT_with_finger, delete_all_in_RBT_with_finger},
+    {"compact AVL", INT32_MAX, 0, insert_in_compact_AVL, look_up_in_compact_AVL,
+    delete_in_compact_AVL, delete_all_in_compact_AVL},
+    {"compact RB", INT64_MAX, 0, insert_in_compact_RBT, look_up_in_compact_RBT,
+    delete_in_compact_RBT, delete_all_in_compact_RBT},
+    {"B tree", INT32_MAX, 0, insert_in_B_tree, look_up_in_B_tree, delete_in_B_tree, delete_all_in_B_tree,
+    sizeof(struct B_node), CACHE_LINE_SIZE},
+    {"B tree finger", INT32_MAX, 0, insert_in_B_tree_with_finger, look_up_in_B_tree,
+    delete_in_B_tree_with_finger, delete_all_in_B_tree_with_finger},
+    /* int16_t keys, and -1 fills the unused key slots */
+    {"B plus (int16)", INT16_MAX, 0, insert_in_B_plus_tree, look_up_in_B_plus_tree,
+    delete_in_B_plus_tree, delete_all_in_B_plus_tree, B_PLUS_NODE_SIZE, _Alignof(struct B_plus_node)},
+    {"B plus finger", INT16_MAX, 0, insert_in_B_plus_tree_with_finger, look_up_in_B_plus_tree,
+    delete_in_B_plus_tree_with_finger, delete_all_in_B_plus_tree_with_finger},
+    {"B plus (u64)", INT64_MAX, 0, insert_in_u64_B_plus_tree, look_up_in_u64_B_plus_tree,
+    delete_in_u64_B_plus_tree, delete_all_in_u64_B_plus_tree}};
+
+enum workload {uniform, zipfian, sequential, mixed};
+static const char *const workload_names[] = {"uniform", "zipfian", "sequential", "mixed"};
+
+static uint64_t xorshift64(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/* the Zipfian generator of YCSB over the ranks [0, n) */
+struct zipfian_generator {
+    int64_t n;
+    double theta, alpha, zetan, eta;};
+
+static void init_zipfian_generator(struct zipfian_generator *zipf, int64_t n, double theta)
+{
+    double zeta2 = 1.0 + pow(0.5, theta);
+    zipf->n = n, zipf->theta = theta;
+    zipf->zetan = 0;
+    for (int64_t i = 1; i <= n; i++)
+        zipf->zetan += 1.0 / pow((double)i, theta);
+    zipf->alpha = 1.0 / (1.0 - theta);
+    zipf->eta = (1.0 - pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / zipf->zetan);
+    return;
+}
+
+static int64_t next_zipfian_rank(struct zipfian_generator *zipf, uint64_t *state)
+{
+    double u = (xorshift64(state) >> 11) * 0x1.0p-53;
+    double uz = u * zipf->zetan;
+    if (uz < 1.0) return 0;
+    if (uz < 1.0 + pow(0.5, zipf->theta)) return 1;
+    int64_t rank = (int64_t)(zipf->n * pow(zipf->eta * u - zipf->eta + 1.0, zipf->alpha));
+    return rank < zipf->n ? rank : zipf->n - 1;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static size_t heap_in_use(void)
+{
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+/* return -1 where hardware counters are not available, e.g. in a VM */
+static int open_cache_miss_counter(void)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static int compare_uint64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void shuffle_keys(int64_t *key_arr, int64_t len, uint64_t *state)
+{
+    for (int64_t i = len - 1; i > 0; i--)
+    {
+        int64_t j = xorshift64(state) % (i + 1);
+        int64_t tmp = key_arr[i]; key_arr[i] = key_arr[j]; key_arr[j] = tmp;
+    }
+    return;
+}
+
+/* load key_number keys into map, run op_number ops of workload, and print one row */
+static void run_a_workload(FILE *report, const struct ordered_map *map, enum workload workload,
+int64_t key_number, int64_t op_number, int cache_miss_counter)
+{
+    if (map->is_unbalanced && workload == sequential)
+    {
+        fprintf(report, "%-11s %-15s skipped: sorted input degenerates this tree\n",
+        workload_names[workload], map->name);
+        return;
+    }
+    if (key_number > map->key_limit) key_number = map->key_limit;
+    uint64_t state = 0x9E3779B97F4A7C15;
+    int64_t *key_arr = (int64_t *)malloc(key_number * sizeof(int64_t));
+    uint64_t *latency = (uint64_t *)malloc((op_number / LATENCY_SAMPLE_INTERVAL + 1) * sizeof(uint64_t));
+    if (key_arr == NULL || latency == NULL)
+        perror("fail to allocate the benchmark arrays"), exit(EXIT_FAILURE);
+    for (int64_t i = 0; i < key_number; i++) key_arr[i] = i;
+    if (workload != sequential) shuffle_keys(key_arr, key_number, &state);
+    struct zipfian_generator zipf = {0};
+    if (workload == zipfian) init_zipfian_generator(&zipf, key_number, ZIPFIAN_THETA);
+
+    size_t heap_before = heap_in_use();
+    uint64_t start = now_ns();
+    for (int64_t i = 0; i < key_number; i++)
+        map->insert(key_arr[i]);
+    double load_ns = (double)(now_ns() - start);
+    double bytes_per_key = (double)(heap_in_use() - heap_before) / key_number;
+
+    /* for mixed, key_arr[0, live_number) are in the map and the rest are not */
+    int64_t live_number = key_number, sample_number = 0, missing = 0;
+    if (cache_miss_counter >= 0)
+    {
+        ioctl(cache_miss_counter, PERF_EVENT_IOC_RESET, 0);
+        ioctl(cache_miss_counter, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    start = now_ns();
+    for (int64_t i = 0; i < op_number; i++)
+    {
+        uint64_t op_start = 0;
+        if (i % LATENCY_SAMPLE_INTERVAL == 0) op_start = now_ns();
+        switch (workload)
+        {
+            case uniform:
+                missing += map->look_up(key_arr[xorshift64(&state) % key_number]) != 0;
+                break;
+            case zipfian:
+                missing += map->look_up(key_arr[next_zipfian_rank(&zipf, &state)]) != 0;
+                break;
+            case sequential:
+                missing += map->look_up(key_arr[i % key_number]) != 0;
+                break;
+            case mixed:
+            {
+                uint64_t dice = xorshift64(&state);
+                if ((dice & 3) < 2)
+                    missing += map->look_up(key_arr[dice % live_number]) != 0;
+                else if (((dice & 3) == 2 && live_number > 1) || live_number == key_number)
+                {
+                    int64_t pos = (dice >> 2) % live_number;
+                    missing += map->delete(key_arr[pos]) != 0;
+                    live_number--;
+                    int64_t tmp = key_arr[pos]; key_arr[pos] = key_arr[live_number]; key_arr[live_number] = tmp;
+                }
+                else
+                {
+                    int64_t pos = live_number + (dice >> 2) % (key_number - live_number);
+                    missing += map->insert(key_arr[pos]) != 0;
+                    int64_t tmp = key_arr[pos]; key_arr[pos] = key_arr[live_number]; key_arr[live_number] = tmp;
+                    live_number++;
+                }
+                break;
+            }
+        }
+        if (op_start) latency[sample_number++] = now_ns() - op_start;
+    }
+    double run_ns = (double)(now_ns() - start);
+    long long cache_misses = -1;
+    if (cache_miss_counter >= 0)
+    {
+        ioctl(cache_miss_counter, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(cache_miss_counter, &cache_misses, sizeof(cache_misses)) != sizeof(cache_misses))
+            cache_misses = -1;
+    }
+    qsort(latency, sample_number, sizeof(uint64_t), compare_uint64);
+    char miss_column[32] = "n/a";
+    if (cache_misses >= 0)
+        snprintf(miss_column, sizeof(miss_column), "%.2f", (double)cache_misses / op_number);
+    fprintf(report, "%-11s %-15s %9" PRId64" %9.3f %9.3f %8" PRIu64" %8" PRIu64" %9.1f %9s%s\n",
+    workload_names[workload], map->name, key_number, key_number / load_ns * 1e3, op_number / run_ns * 1e3,
+    latency[sample_number / 2], latency[sample_number * 99 / 100], bytes_per_key, miss_column,
+    missing ? "  (some ops missed)" : "");
+    fflush(report);
+    map->delete_all();
+    free(latency);
+    free(key_arr);
+    return;
+}
+
+/* load key_number shuffled keys into map from the C heap and then from a
+pool, and print how long freeing the tree takes either way */
+static void run_a_teardown(FILE *report, const struct ordered_map *map, int64_t key_number)
+{
+    if (key_number > map->key_limit) key_number = map->key_limit;
+    uint64_t state = 0x9E3779B97F4A7C15;
+    int64_t *key_arr = (int64_t *)malloc(key_number * sizeof(int64_t));
+    if (key_arr == NULL)
+        perror("fail to allocate the benchmark keys"), exit(EXIT_FAILURE);
+    for (int64_t i = 0; i < key_number; i++) key_arr[i] = i;
+    shuffle_keys(key_arr, key_number, &state);
+    double teardown_ms[2];
+    for (int pooled = 0; pooled < 2; pooled++)
+    {
+        if (pooled && (node_pool = init_node_pool(map->node_size, map->node_align)) == NULL)
+            exit(EXIT_FAILURE);
+        for (int64_t i = 0; i < key_number; i++)
+            map->insert(key_arr[i]);
+        uint64_t start = now_ns();
+        map->delete_all();
+        teardown_ms[pooled] = (now_ns() - start) / 1e6;
+    }
+    fprintf(report, "%-15s %9" PRId64" %12.3f %12.3f\n", map->name, key_number, teardown_ms[0], teardown_ms[1]);
+    fflush(report);
+    free(key_arr);
+    return;
+}
+
+int main(int argc, char *argv[])
+{
+    int64_t key_number = argc > 1 ? atoll(argv[1]) : DEFAULT_KEY_NUMBER;
+    int64_t op_number = argc > 2 ? atoll(argv[2]) : DEFAULT_OP_NUMBER;
+    if (key_number < 2 || op_number < 1)
+    {
+        fprintf(stderr, "usage: %s [key_number >= 2] [op_number >= 1]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    /* the trees report every insert and delete on stdout */
+    FILE *report = fdopen(dup(fileno(stdout)), "w");
+    if (report == NULL || freopen("/dev/null", "w", stdout) == NULL)
+        perror("fail to redirect stdout"), exit(EXIT_FAILURE);
+    setvbuf(stdout, NULL, _IOFBF, 1 << 16);
+    int cache_miss_counter = open_cache_miss_counter();
+    fprintf(report, "%-11s %-15s %9s %9s %9s %8s %8s %9s %9s\n", "workload", "tree", "keys",
+    "load Mop/s", "run Mop/s", "p50 ns", "p99 ns", "bytes/key", "miss/op");
+    for (int w = uniform; w <= mixed; w++)
+        for (size_t m = 0; m < sizeof(ordered_maps) / sizeof(ordered_maps[0]); m++)
+            run_a_workload(report, &ordered_maps[m], (enum workload)w, key_number, op_number, cache_miss_counter);
+    fprintf(report, "\n%-15s %9s %12s %12s\n", "tree", "keys", "free ms", "pool ms");
+    for (size_t m = 0; m < sizeof(ordered_maps) / sizeof(ordered_maps[0]); m++)
+        if (ordered_maps[m].node_size) run_a_teardown(report, &ordered_maps[m], key_number);
+    if (cache_miss_counter >= 0) close(cache_miss_counter);
+    fclose(report);
+    return 0;
+}
@@ -0,0 +1,528 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+/* a B plus tree kept in one file of fixed-size pages. Children and siblings
+are page ids instead of pointers, values are stored inline in the leaves.
+Look-ups read pages through a read-only mmap of the file, changes are made
+on copies held in a dirty page cache, which is written back in page id
+order with pwritev() and made durable with one fdatasync() per batch. */
+#define B_PLUS_PAGE_SIZE 4096
+#define B_PLUS_PAGE_HEADER_SIZE 8
+#define LEAF_KEY_NUMBER ((B_PLUS_PAGE_SIZE - B_PLUS_PAGE_HEADER_SIZE) / (sizeof(int32_t) + sizeof(int64_t)))
+#define INTERNAL_KEY_NUMBER ((B_PLUS_PAGE_SIZE - B_PLUS_PAGE_HEADER_SIZE) / (sizeof(int32_t) + sizeof(uint32_t)))
+/* the dirty page cache is flushed once it holds this many pages */
+#define DIRTY_PAGE_THRESHOLD 4096
+#define MAX_PAGED_B_PLUS_TREE_HEIGHT 32
+#define PAGED_B_PLUS_TREE_MAGIC "BPLUSPG1"
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+/* page id 0 is the meta page, so it also stands for "no page" */
+#define NO_PAGE 0
+
+/* as in B_plus_tree.c, key[i] of an internal page is the minimal key under child[i] */
+struct B_plus_page {
+    uint8_t isleaf;
+    int16_t last_index;
+    uint32_t sibling;
+    union {
+        struct {
+            int32_t key[LEAF_KEY_NUMBER];
+            int64_t value[LEAF_KEY_NUMBER];} leaf;
+        struct {
+            int32_t key[INTERNAL_KEY_NUMBER];
+            uint32_t child[INTERNAL_KEY_NUMBER];} internal;
+    };};
+_Static_assert(sizeof(struct B_plus_page) <= B_PLUS_PAGE_SIZE, "struct B_plus_page overflows a page");
+
+struct B_plus_meta_page {
+    char magic[8];
+    uint32_t page_size;
+    uint32_t root;
+    uint32_t page_count;};
+
+struct dirty_page_slot {
+    uint32_t page_id;
+    struct B_plus_page *page;};
+
+struct paged_B_plus_tree {
+    int fd;
+    char *map;
+    size_t map_len;
+    struct B_plus_meta_page meta;
+    /* open addressing table from page id to the modified copy of the page */
+    struct dirty_page_slot *dirty;
+    uint32_t dirty_capacity;
+    uint32_t dirty_number;};
+
+static struct dirty_page_slot *look_up_a_dirty_page_slot(struct paged_B_plus_tree *tree, uint32_t page_id)
+{
+    uint32_t i = (page_id * 2654435761u) & (tree->dirty_capacity - 1);
+    while (tree->dirty[i].page_id != NO_PAGE && tree->dirty[i].page_id != page_id)
+        i = (i + 1) & (tree->dirty_capacity - 1);
+    return &tree->dirty[i];
+}
+
+static void grow_dirty_page_table(struct paged_B_plus_tree *tree)
+{
+    struct dirty_page_slot *old = tree->dirty;
+    uint32_t old_capacity = tree->dirty_capacity;
+    tree->dirty_capacity <<= 1;
+    tree->dirty = (struct dirty_page_slot *)calloc(tree->dirty_capacity, sizeof(struct dirty_page_slot));
+    if (tree->dirty == NULL)
+        perror("fail to grow the dirty page table"), exit(EXIT_FAILURE);
+    for (uint32_t i = 0; i < old_capacity; i++)
+        if (old[i].page_id != NO_PAGE)
+            *look_up_a_dirty_page_slot(tree, old[i].page_id) = old[i];
+    free(old);
+    return;
+}
+
+static const struct B_plus_page *get_a_page_for_read(struct paged_B_plus_tree *tree, uint32_t page_id)
+{
+    struct dirty_page_slot *slot = look_up_a_dirty_page_slot(tree, page_id);
+    if (slot->page_id == page_id)
+        return slot->page;
+    return (const struct B_plus_page *)(tree->map + (size_t)page_id * B_PLUS_PAGE_SIZE);
+}
+
+/* the returned copy stays valid until the next flush */
+static struct B_plus_page *get_a_page_for_write(struct paged_B_plus_tree *tree, uint32_t page_id)
+{
+    struct dirty_page_slot *slot = look_up_a_dirty_page_slot(tree, page_id);
+    if (slot->page_id == page_id)
+        return slot->page;
+    if ((tree->dirty_number + 1) << 1 > tree->dirty_capacity)
+    {
+        grow_dirty_page_table(tree);
+        slot = look_up_a_dirty_page_slot(tree, page_id);
+    }
+    struct B_plus_page *page = (struct B_plus_page *)aligned_alloc(B_PLUS_PAGE_SIZE, B_PLUS_PAGE_SIZE);
+    if (page == NULL)
+        perror("fail to allocate a dirty page"), exit(EXIT_FAILURE);
+    if ((size_t)page_id * B_PLUS_PAGE_SIZE < tree->map_len)
+        memcpy(page, tree->map + (size_t)page_id * B_PLUS_PAGE_SIZE, B_PLUS_PAGE_SIZE);
+    else memset(page, 0, B_PLUS_PAGE_SIZE);
+    slot->page_id = page_id;
+    slot->page = page;
+    tree->dirty_number++;
+    return page;
+}
+
+static uint32_t alloc_a_new_B_plus_page(struct paged_B_plus_tree *tree, _Bool isleaf)
+{
+    uint32_t page_id = tree->meta.page_count++;
+    struct B_plus_page *page = get_a_page_for_write(tree, page_id);
+    page->isleaf = isleaf;
+    page->last_index = -1;
+    page->sibling = NO_PAGE;
+    return page_id;
+}
+
+static int map_paged_B_plus_tree(struct paged_B_plus_tree *tree)
+{
+    if (tree->map)
+        munmap(tree->map, tree->map_len);
+    tree->map_len = (size_t)tree->meta.page_count * B_PLUS_PAGE_SIZE;
+    tree->map = (char *)mmap(NULL, tree->map_len, PROT_READ, MAP_SHARED, tree->fd, 0);
+    if (tree->map == MAP_FAILED)
+    {
+        perror("mmap error");
+        tree->map = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+static int compare_dirty_page_slots(const void *a, const void *b)
+{
+    uint32_t x = ((const struct dirty_page_slot *)a)->page_id, y = ((const struct dirty_page_slot *)b)->page_id;
+    return (x > y) - (x < y);
+}
+
+/* write back every dirty page, runs of consecutive page ids in one pwritev(),
+then make them durable before the meta page which publishes the new root. */
+int flush_paged_B_plus_tree(struct paged_B_plus_tree *tree)
+{
+    struct dirty_page_slot *sorted = (struct dirty_page_slot *)malloc(
+    (tree->dirty_number + 1) * sizeof(struct dirty_page_slot));
+    if (sorted == NULL)
+        perror("fail to allocate the flush list"), exit(EXIT_FAILURE);
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < tree->dirty_capacity; i++)
+        if (tree->dirty[i].page_id != NO_PAGE)
+            sorted[n++] = tree->dirty[i];
+    qsort(sorted, n, sizeof(struct dirty_page_slot), compare_dirty_page_slots);
+    int state = 0;
+    struct iovec run[IOV_MAX];
+    for (uint32_t i = 0; i < n;)
+    {
+        int run_len = 0;
+        uint32_t first = sorted[i].page_id;
+        while (i < n && run_len < IOV_MAX && sorted[i].page_id == first + run_len)
+        {
+            run[run_len].iov_base = sorted[i].page;
+            run[run_len].iov_len = B_PLUS_PAGE_SIZE;
+            run_len++, i++;
+        }
+        if (pwritev(tree->fd, run, run_len, (off_t)first * B_PLUS_PAGE_SIZE)
+        != (ssize_t)run_len * B_PLUS_PAGE_SIZE)
+            perror("the page pwritev error"), state = -1;
+    }
+    if (state == 0 && fdatasync(tree->fd) < 0)
+        perror("fdatasync error"), state = -1;
+    if (state == 0)
+    {
+        if (pwrite(tree->fd, &tree->meta, sizeof(struct B_plus_meta_page), 0) != sizeof(struct B_plus_meta_page))
+            perror("the meta page pwrite error"), state = -1;
+        else if (fdatasync(tree->fd) < 0)
+            perror("fdatasync error"), state = -1;
+    }
+    /* on failure the pages stay dirty, so that the next flush retries them */
+    if (state == 0)
+    {
+        for (uint32_t i = 0; i < n; i++)
+            free(sorted[i].page);
+        memset(tree->dirty, 0, tree->dirty_capacity * sizeof(struct dirty_page_slot));
+        tree->dirty_number = 0;
+        if ((size_t)tree->meta.page_count * B_PLUS_PAGE_SIZE != tree->map_len)
+            state = map_paged_B_plus_tree(tree);
+    }
+    free(sorted);
+    return state;
+}
+
+struct paged_B_plus_tree *open_paged_B_plus_tree(const char *file_path)
+{
+    struct paged_B_plus_tree *tree = (struct paged_B_plus_tree *)calloc(1, sizeof(struct paged_B_plus_tree));
+    if (tree == NULL)
+        perror("fail to allocate a paged B plus tree"), exit(EXIT_FAILURE);
+    tree->fd = open(file_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (tree->fd < 0)
+    {
+        perror("open error");
+        free(tree);
+        return NULL;
+    }
+    struct stat file_info;
+    if (fstat(tree->fd, &file_info) < 0)
+    {
+        perror("fstat error");
+        close(tree->fd), free(tree);
+        return NULL;
+    }
+    if (file_info.st_size == 0)
+    {
+        /* a new file has only its meta page */
+        memcpy(tree->meta.magic, PAGED_B_PLUS_TREE_MAGIC, sizeof(tree->meta.magic));
+        tree->meta.page_size = B_PLUS_PAGE_SIZE;
+        tree->meta.root = NO_PAGE;
+        tree->meta.page_count = 1;
+        if (ftruncate(tree->fd, B_PLUS_PAGE_SIZE) < 0
+        || pwrite(tree->fd, &tree->meta, sizeof(struct B_plus_meta_page), 0) != sizeof(struct B_plus_meta_page)
+        || fdatasync(tree->fd) < 0)
+        {
+            perror("fail to initialize the meta page");
+            close(tree->fd), free(tree);
+            return NULL;
+        }
+    }
+    else if (pread(tree->fd, &tree->meta, sizeof(struct B_plus_meta_page), 0) != sizeof(struct B_plus_meta_page)
+    || memcmp(tree->meta.magic, PAGED_B_PLUS_TREE_MAGIC, sizeof(tree->meta.magic))
+    || tree->meta.page_size != B_PLUS_PAGE_SIZE)
+    {
+        fprintf(stderr, "%s is not a paged B plus tree.\n", file_path);
+        close(tree->fd), free(tree);
+        return NULL;
+    }
+    tree->dirty_capacity = 64;
+    tree->dirty = (struct dirty_page_slot *)calloc(tree->dirty_capacity, sizeof(struct dirty_page_slot));
+    if (tree->dirty == NULL || map_paged_B_plus_tree(tree) < 0)
+    {
+        close(tree->fd), free(tree->dirty), free(tree);
+        return NULL;
+    }
+    return tree;
+}
+
+int close_paged_B_plus_tree(struct paged_B_plus_tree *tree)
+{
+    int state = flush_paged_B_plus_tree(tree);
+    munmap(tree->map, tree->map_len);
+    if (close(tree->fd) < 0)
+        perror("close error"), state = -1;
+    free(tree->dirty);
+    free(tree);
+    return state;
+}
+
+/* the number of keys smaller than unkown_key */
+static int16_t look_up_a_key_pos_in_a_B_plus_page(const int32_t *key, int16_t last_index, int32_t unkown_key)
+{
+    int16_t left = 0, right = last_index;
+    while (left <= right)
+    {
+        int16_t middle = left + ((right - left) >> 1);
+        if (key[middle] < unkown_key)
+            left = middle + 1;
+        else right = middle - 1;
+    }
+    return left;
+}
+
+static int16_t look_up_a_child_pos_in_a_B_plus_page(const struct B_plus_page *page, int32_t unkown_key)
+{
+    int16_t pos = look_up_a_key_pos_in_a_B_plus_page(page->internal.key, page->last_index, unkown_key);
+    if (pos <= page->last_index && page->internal.key[pos] == unkown_key)
+        return pos;
+    return pos ? pos - 1 : 0;
+}
+
+int look_up_a_key_in_paged_B_plus_tree(struct paged_B_plus_tree *tree, int32_t unkown_key, int64_t *value)
+{
+    if (tree->meta.root == NO_PAGE) return -1;
+    const struct B_plus_page *page = get_a_page_for_read(tree, tree->meta.root);
+    while (!page->isleaf)
+        page = get_a_page_for_read(tree, page->internal.child[look_up_a_child_pos_in_a_B_plus_page(page, unkown_key)]);
+    int16_t pos = look_up_a_key_pos_in_a_B_plus_page(page->leaf.key, page->last_index, unkown_key);
+    if (pos > page->last_index || page->leaf.key[pos] != unkown_key)
+        return -1;
+    if (value) *value = page->leaf.value[pos];
+    return 0;
+}
+
+/* insert key and child at pos of a full internal page: the upper half moves
+into a new page, whose id and minimal key are returned for the parent. */
+static uint32_t split_an_internal_B_plus_page(struct paged_B_plus_tree *tree, struct B_plus_page *page,
+int16_t pos, int32_t key, uint32_t child, int32_t *new_min_key)
+{
+    int32_t all_key[INTERNAL_KEY_NUMBER + 1];
+    uint32_t all_child[INTERNAL_KEY_NUMBER + 1];
+    memcpy(all_key, page->internal.key, pos * sizeof(int32_t));
+    memcpy(all_child, page->internal.child, pos * sizeof(uint32_t));
+    all_key[pos] = key, all_child[pos] = child;
+    memcpy(all_key + pos + 1, page->internal.key + pos, (INTERNAL_KEY_NUMBER - pos) * sizeof(int32_t));
+    memcpy(all_child + pos + 1, page->internal.child + pos, (INTERNAL_KEY_NUMBER - pos) * sizeof(uint32_t));
+    int16_t left_number = (INTERNAL_KEY_NUMBER + 1) >> 1;
+    int16_t right_number = INTERNAL_KEY_NUMBER + 1 - left_number;
+    uint32_t new_page_id = alloc_a_new_B_plus_page(tree, 0);
+    struct B_plus_page *new_page = get_a_page_for_write(tree, new_page_id);
+    memcpy(page->internal.key, all_key, left_number * sizeof(int32_t));
+    memcpy(page->internal.child, all_child, left_number * sizeof(uint32_t));
+    memcpy(new_page->internal.key, all_key + left_number, right_number * sizeof(int32_t));
+    memcpy(new_page->internal.child, all_child + left_number, right_number * sizeof(uint32_t));
+    page->last_index = left_number - 1;
+    new_page->last_index = right_number - 1;
+    *new_min_key = new_page->internal.key[0];
+    return new_page_id;
+}
+
+/* the same as split_an_internal_B_plus_page() for a full leaf and a value */
+static uint32_t split_a_leaf_B_plus_page(struct paged_B_plus_tree *tree, struct B_plus_page *page,
+int16_t pos, int32_t key, int64_t value, int32_t *new_min_key)
+{
+    int32_t all_key[LEAF_KEY_NUMBER + 1];
+    int64_t all_value[LEAF_KEY_NUMBER + 1];
+    memcpy(all_key, page->leaf.key, pos * sizeof(int32_t));
+    memcpy(all_value, page->leaf.value, pos * sizeof(int64_t));
+    all_key[pos] = key, all_value[pos] = value;
+    memcpy(all_key + pos + 1, page->leaf.key + pos, (LEAF_KEY_NUMBER - pos) * sizeof(int32_t));
+    memcpy(all_value + pos + 1, page->leaf.value + pos, (LEAF_KEY_NUMBER - pos) * sizeof(int64_t));
+    int16_t left_number = (LEAF_KEY_NUMBER + 1) >> 1;
+    int16_t right_number = LEAF_KEY_NUMBER + 1 - left_number;
+    uint32_t new_page_id = alloc_a_new_B_plus_page(tree, 1);
+    struct B_plus_page *new_page = get_a_page_for_write(tree, new_page_id);
+    memcpy(page->leaf.key, all_key, left_number * sizeof(int32_t));
+    memcpy(page->leaf.value, all_value, left_number * sizeof(int64_t));
+    memcpy(new_page->leaf.key, all_key + left_number, right_number * sizeof(int32_t));
+    memcpy(new_page->leaf.value, all_value + left_number, right_number * sizeof(int64_t));
+    page->last_index = left_number - 1;
+    new_page->last_index = right_number - 1;
+    new_page->sibling = page->sibling;
+    page->sibling = new_page_id;
+    *new_min_key = new_page->leaf.key[0];
+    return new_page_id;
+}
+
+int insert_a_key_in_paged_B_plus_tree(struct paged_B_plus_tree *tree, int32_t new_key, int64_t value)
+{
+    if (tree->meta.root == NO_PAGE)
+    {
+        tree->meta.root = alloc_a_new_B_plus_page(tree, 1);
+        struct B_plus_page *root = get_a_page_for_write(tree, tree->meta.root);
+        root->leaf.key[0] = new_key, root->leaf.value[0] = value, root->last_index = 0;
+        return 0;
+    }
+    /* look up for the position of insertion and keep the path of page ids. */
+    uint32_t page_stack[MAX_PAGED_B_PLUS_TREE_HEIGHT];
+    int16_t pos_stack[MAX_PAGED_B_PLUS_TREE_HEIGHT];
+    int8_t top = -1;
+    uint32_t page_id = tree->meta.root;
+    const struct B_plus_page *cur = get_a_page_for_read(tree, page_id);
+    while (!cur->isleaf)
+    {
+        int16_t pos = look_up_a_child_pos_in_a_B_plus_page(cur, new_key);
+        /* a new minimum lowers the bounds along the leftmost path, or a
+        later split of child 0 would put a smaller separator after key[0] */
+        if (pos == 0 && new_key < cur->internal.key[0])
+        {
+            struct B_plus_page *page = get_a_page_for_write(tree, page_id);
+            page->internal.key[0] = new_key;
+            cur = page;
+        }
+        page_stack[++top] = page_id, pos_stack[top] = pos;
+        page_id = cur->internal.child[pos];
+        cur = get_a_page_for_read(tree, page_id);
+    }
+    int16_t pos = look_up_a_key_pos_in_a_B_plus_page(cur->leaf.key, cur->last_index, new_key);
+    if (pos <= cur->last_index && cur->leaf.key[pos] == new_key)
+    {
+        fprintf(stderr, "insert failed. This paged B plus tree has already a key value %" PRId32".\n", new_key);
+        return -1;
+    }
+    struct B_plus_page *leaf = get_a_page_for_write(tree, page_id);
+    if (leaf->last_index + 1 < (int16_t)LEAF_KEY_NUMBER)
+    {
+        memmove(leaf->leaf.key + pos + 1, leaf->leaf.key + pos, (leaf->last_index + 1 - pos) * sizeof(int32_t));
+        memmove(leaf->leaf.value + pos + 1, leaf->leaf.value + pos, (leaf->last_index + 1 - pos) * sizeof(int64_t));
+        leaf->leaf.key[pos] = new_key, leaf->leaf.value[pos] = value;
+        leaf->last_index++;
+    }
+    else
+    {
+        /* split up the ancestor pages which are full. */
+        int32_t separator;
+        uint32_t new_page_id = split_a_leaf_B_plus_page(tree, leaf, pos, new_key, value, &separator);
+        int32_t min_key_of_left = leaf->leaf.key[0];
+        for (; new_page_id != NO_PAGE && top >= 0; top--)
+        {
+            struct B_plus_page *parent = get_a_page_for_write(tree, page_stack[top]);
+            int16_t insert_pos = pos_stack[top] + 1;
+            min_key_of_left = parent->internal.key[0];
+            if (parent->last_index + 1 < (int16_t)INTERNAL_KEY_NUMBER)
+            {
+                memmove(parent->internal.key + insert_pos + 1, parent->internal.key + insert_pos,
+                (parent->last_index + 1 - insert_pos) * sizeof(int32_t));
+                memmove(parent->internal.child + insert_pos + 1, parent->internal.child + insert_pos,
+                (parent->last_index + 1 - insert_pos) * sizeof(uint32_t));
+                parent->internal.key[insert_pos] = separator;
+                parent->internal.child[insert_pos] = new_page_id;
+                parent->last_index++;
+                new_page_id = NO_PAGE;
+            }
+            else new_page_id = split_an_internal_B_plus_page(tree, parent, insert_pos,
+            separator, new_page_id, &separator);
+        }
+        if (new_page_id != NO_PAGE)
+        {
+            /* create a new root after spliting the current root. */
+            uint32_t old_root = tree->meta.root;
+            tree->meta.root = alloc_a_new_B_plus_page(tree, 0);
+            struct B_plus_page *root = get_a_page_for_write(tree, tree->meta.root);
+            root->internal.key[0] = min_key_of_left, root->internal.child[0] = old_root;
+            root->internal.key[1] = separator, root->internal.child[1] = new_page_id;
+            root->last_index = 1;
+        }
+    }
+    if (tree->dirty_number >= DIRTY_PAGE_THRESHOLD)
+        return flush_paged_B_plus_tree(tree);
+    return 0;
+}
+
+/* leaves are not merged: an emptied leaf stays linked and is reused by later
+inserts into its key range. */
+int delete_a_key_in_paged_B_plus_tree(struct paged_B_plus_tree *tree, int32_t key_to_be_del)
+{
+    if (tree->meta.root == NO_PAGE) return -1;
+    uint32_t page_id = tree->meta.root;
+    const struct B_plus_page *cur = get_a_page_for_read(tree, page_id);
+    while (!cur->isleaf)
+    {
+        page_id = cur->internal.child[look_up_a_child_pos_in_a_B_plus_page(cur, key_to_be_del)];
+        cur = get_a_page_for_read(tree, page_id);
+    }
+    int16_t pos = look_up_a_key_pos_in_a_B_plus_page(cur->leaf.key, cur->last_index, key_to_be_del);
+    if (pos > cur->last_index || cur->leaf.key[pos] != key_to_be_del)
+    {
+        fprintf(stderr, "No key value %" PRId32" in paged B plus tree!\n", key_to_be_del);
+        return -1;
+    }
+    struct B_plus_page *leaf = get_a_page_for_write(tree, page_id);
+    memmove(leaf->leaf.key + pos, leaf->leaf.key + pos + 1, (leaf->last_index - pos) * sizeof(int32_t));
+    memmove(leaf->leaf.value + pos, leaf->leaf.value + pos + 1, (leaf->last_index - pos) * sizeof(int64_t));
+    leaf->last_index--;
+    if (tree->dirty_number >= DIRTY_PAGE_THRESHOLD)
+        return flush_paged_B_plus_tree(tree);
+    return 0;
+}
+
+/* walk the pages under page_id, whose keys have to lie in [lower, upper) */
+static int check_the_order_under_a_B_plus_page(struct paged_B_plus_tree *tree, uint32_t page_id,
+int64_t lower, int64_t upper, int depth, int *leaf_depth)
+{
+    const struct B_plus_page *page = get_a_page_for_read(tree, page_id);
+    const int32_t *key = page->isleaf ? page->leaf.key : page->internal.key;
+    for (int16_t i = 0; i <= page->last_index; i++)
+        if (key[i] < lower || key[i] >= upper || (i && key[i - 1] >= key[i]))
+        {
+            fprintf(stderr, "%s page %" PRIu32" is out of order at key[%" PRId16"] %" PRId32".\n",
+            page->isleaf ? "leaf" : "internal", page_id, i, key[i]);
+            return -1;
+        }
+    if (page->isleaf)
+    {
+        if (*leaf_depth < 0) *leaf_depth = depth;
+        if (*leaf_depth == depth) return 0;
+        fprintf(stderr, "leaf page %" PRIu32" is at depth %d, not %d.\n", page_id, depth, *leaf_depth);
+        return -1;
+    }
+    if (page->last_index < 0)
+    {
+        fprintf(stderr, "internal page %" PRIu32" has no child.\n", page_id);
+        return -1;
+    }
+    for (int16_t i = 0; i <= page->last_index; i++)
+        if (check_the_order_under_a_B_plus_page(tree, page->internal.child[i], i ? key[i] : lower,
+        i < page->last_index ? key[i + 1] : upper, depth + 1, leaf_depth) < 0)
+            return -1;
+    return 0;
+}
+
+/* return 0 if every page is sorted, every key lies within the bounds of its
+parent, all leaves are at one depth and the leaf chain ascends; else -1 and
+the first fault on stderr */
+int check_the_order_in_paged_B_plus_tree(struct paged_B_plus_tree *tree)
+{
+    if (tree->meta.root == NO_PAGE) return 0;
+    int leaf_depth = -1;
+    if (check_the_order_under_a_B_plus_page(tree, tree->meta.root, INT64_MIN, INT64_MAX, 0, &leaf_depth) < 0)
+        return -1;
+    uint32_t page_id = tree->meta.root;
+    const struct B_plus_page *page = get_a_page_for_read(tree, page_id);
+    while (!page->isleaf)
+        page = get_a_page_for_read(tree, page_id = page->internal.child[0]);
+    int64_t last_key = INT64_MIN;
+    for (; page_id != NO_PAGE; page_id = page->sibling)
+    {
+        page = get_a_page_for_read(tree, page_id);
+        for (int16_t i = 0; i <= page->last_index; i++)
+        {
+            if (page->leaf.key[i] <= last_key)
+            {
+                fprintf(stderr, "the leaf chain goes back at page %" PRIu32".\n", page_id);
+                return -1;
+            }
+            last_key = page->leaf.key[i];
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,92 @@
+/* random inserts, look-ups, duplicate inserts and deletes on a paged B plus
+tree against a bitmap of the keys it should hold, checking the page order
+after every round and once more after the file is reopened.
+
+    gcc -O2 paged_B_plus_tree_check.c -o paged_B_plus_tree_check
+    ./paged_B_plus_tree_check [file_path] [key_range] [op_number] */
+#include "paged_B_plus_tree.c"
+#define DEFAULT_FILE_PATH "paged_B_plus_tree_check.db"
+#define DEFAULT_KEY_RANGE 200000
+#define DEFAULT_OP_NUMBER 1000000
+#define CHECK_INTERVAL 50000
+
+static uint64_t xorshift64(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/* return the number of keys that disagree with is_in */
+static int64_t compare_with_the_bitmap(struct paged_B_plus_tree *tree, const uint8_t *is_in, int32_t key_range)
+{
+    int64_t wrong = 0, value;
+    for (int32_t key = 0; key < key_range; key++)
+    {
+        int found = look_up_a_key_in_paged_B_plus_tree(tree, key, &value) == 0;
+        if (found != is_in[key] || (found && value != (int64_t)key * 3))
+            wrong++;
+    }
+    return wrong;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *file_path = argc > 1 ? argv[1] : DEFAULT_FILE_PATH;
+    int32_t key_range = argc > 2 ? atoi(argv[2]) : DEFAULT_KEY_RANGE;
+    int64_t op_number = argc > 3 ? atoll(argv[3]) : DEFAULT_OP_NUMBER;
+    if (key_range < 1 || op_number < 1)
+    {
+        fprintf(stderr, "usage: %s [file_path] [key_range >= 1] [op_number >= 1]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    unlink(file_path);
+    struct paged_B_plus_tree *tree = open_paged_B_plus_tree(file_path);
+    uint8_t *is_in = (uint8_t *)calloc(key_range, sizeof(uint8_t));
+    if (tree == NULL || is_in == NULL)
+        return EXIT_FAILURE;
+    /* the misses and duplicates are expected, so their messages are dropped */
+    if (freopen("/dev/null", "w", stderr) == NULL)
+        return EXIT_FAILURE;
+    int64_t wrong = 0;
+    uint64_t state = 0x9E3779B97F4A7C15;
+    for (int64_t i = 1; i <= op_number && wrong == 0; i++)
+    {
+        uint64_t dice = xorshift64(&state);
+        /* keys count down half of the time, so that new minimums keep coming */
+        int32_t key = (int32_t)((dice >> 8) % key_range);
+        if ((dice & 7) == 7) key = key_range - 1 - (int32_t)(i * key_range / op_number);
+        if ((dice & 3) < 2)
+        {
+            int state_of_insert = insert_a_key_in_paged_B_plus_tree(tree, key, (int64_t)key * 3);
+            if ((state_of_insert == 0) == is_in[key])
+                printf("insert %" PRId64": key %" PRId32" returned %d\n", i, key, state_of_insert), wrong++;
+            is_in[key] = 1;
+        }
+        else if ((dice & 3) == 2)
+        {
+            if ((look_up_a_key_in_paged_B_plus_tree(tree, key, NULL) == 0) != is_in[key])
+                printf("look-up %" PRId64": key %" PRId32" is wrong\n", i, key), wrong++;
+        }
+        else
+        {
+            if ((delete_a_key_in_paged_B_plus_tree(tree, key) == 0) != is_in[key])
+                printf("delete %" PRId64": key %" PRId32" is wrong\n", i, key), wrong++;
+            is_in[key] = 0;
+        }
+        if (i % CHECK_INTERVAL == 0 && check_the_order_in_paged_B_plus_tree(tree) < 0)
+            printf("the pages are out of order after op %" PRId64"\n", i), wrong++;
+    }
+    if (wrong == 0 && (check_the_order_in_paged_B_plus_tree(tree) < 0 || compare_with_the_bitmap(tree, is_in, key_range)))
+        printf("the tree differs from the bitmap\n"), wrong++;
+    if (close_paged_B_plus_tree(tree) < 0 || (tree = open_paged_B_plus_tree(file_path)) == NULL)
+        return EXIT_FAILURE;
+    if (wrong == 0 && (check_the_order_in_paged_B_plus_tree(tree) < 0 || compare_with_the_bitmap(tree, is_in, key_range)))
+        printf("the reopened tree differs from the bitmap\n"), wrong++;
+    close_paged_B_plus_tree(tree);
+    unlink(file_path);
+    free(is_in);
+    puts(wrong ? "paged B plus tree check failed" : "paged B plus tree check passed");
+    return wrong ? EXIT_FAILURE : 0;
+}
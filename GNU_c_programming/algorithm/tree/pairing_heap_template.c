@@ -0,0 +1,234 @@
+/* a pairing heap with O(1) amortized decrease-key, behind the same calls as
+d_ary_heap_template.c. Define the parameters below and include this file
+once per instantiation:
+
+    #define PAIRING_HEAP_NAME dist_pairing_heap
+    #define PAIRING_HEAP_KEY_TYPE int64_t
+    #include "pairing_heap_template.c"
+
+The nodes live in one array indexed by handle and link to each other with
+32-bit indices, so a handle is its own node and no position table is kept.
+PAIRING_HEAP_KEY_LESS(a, b) may be defined for keys without operator <.
+There is no #pragma once here on purpose; the parameters are undefined at
+the end so that the next instantiation starts clean. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#ifndef PAIRING_HEAP_NAME
+#error "PAIRING_HEAP_NAME is not defined"
+#endif
+#ifndef PAIRING_HEAP_KEY_TYPE
+#error "PAIRING_HEAP_KEY_TYPE is not defined"
+#endif
+#ifndef PAIRING_HEAP_KEY_LESS
+#define PAIRING_HEAP_KEY_LESS(a, b) ((a) < (b))
+#endif
+
+#ifndef PAIRING_HEAP_TEMPLATE_COMMON
+#define PAIRING_HEAP_TEMPLATE_COMMON
+#define PAIRING_HEAP_PASTE(a, b) a##_##b
+#define PAIRING_HEAP_CONCAT(a, b) PAIRING_HEAP_PASTE(a, b)
+/* prev of a node that is not in the heap */
+#define PAIRING_HEAP_ABSENT -2
+#endif
+
+#define PAIRING_HEAP_TYPE(suffix) PAIRING_HEAP_CONCAT(PAIRING_HEAP_NAME, suffix)
+#define PAIRING_HEAP_FUNC(prefix) PAIRING_HEAP_CONCAT(prefix, PAIRING_HEAP_NAME)
+
+struct PAIRING_HEAP_TYPE(node) {
+    PAIRING_HEAP_KEY_TYPE key;
+    /* the leftmost child and the next sibling, or -1 */
+    int32_t child, sibling;
+    /* the parent of a leftmost child, else the previous sibling; -1 for the
+    root and PAIRING_HEAP_ABSENT outside the heap */
+    int32_t prev;};
+
+struct PAIRING_HEAP_NAME {
+    struct PAIRING_HEAP_TYPE(node) *node;
+    int32_t root, size;
+    int32_t handle_number;};
+
+static void PAIRING_HEAP_FUNC(grow_the_nodes_of)(struct PAIRING_HEAP_NAME *heap, int32_t handle_number)
+{
+    heap->node = (struct PAIRING_HEAP_TYPE(node) *)realloc(heap->node,
+    handle_number * sizeof(struct PAIRING_HEAP_TYPE(node)));
+    if (heap->node == NULL)
+        perror("fail to allocate the nodes of a pairing heap"), exit(EXIT_FAILURE);
+    for (int32_t i = heap->handle_number; i < handle_number; i++)
+        heap->node[i].prev = PAIRING_HEAP_ABSENT;
+    heap->handle_number = handle_number;
+    return;
+}
+
+/* handles are taken from [0, handle_number), which grows on demand */
+struct PAIRING_HEAP_NAME *PAIRING_HEAP_FUNC(init)(int32_t handle_number)
+{
+    struct PAIRING_HEAP_NAME *heap = (struct PAIRING_HEAP_NAME *)malloc(sizeof(struct PAIRING_HEAP_NAME));
+    if (heap == NULL)
+        perror("fail to allocate a pairing heap"), exit(EXIT_FAILURE);
+    heap->node = NULL;
+    heap->root = -1, heap->size = 0;
+    heap->handle_number = 0;
+    PAIRING_HEAP_FUNC(grow_the_nodes_of)(heap, handle_number > 0 ? handle_number : 1);
+    return heap;
+}
+
+void PAIRING_HEAP_FUNC(destroy)(struct PAIRING_HEAP_NAME *heap)
+{
+    free(heap->node);
+    free(heap);
+    return;
+}
+
+_Bool PAIRING_HEAP_FUNC(handle_is_in)(const struct PAIRING_HEAP_NAME *heap, int32_t handle)
+{
+    return handle >= 0 && handle < heap->handle_number && heap->node[handle].prev != PAIRING_HEAP_ABSENT;
+}
+
+/* link two roots and return the winner; the loser becomes its leftmost child */
+static int32_t PAIRING_HEAP_FUNC(meld_two_roots_in)(struct PAIRING_HEAP_NAME *heap, int32_t a, int32_t b)
+{
+    struct PAIRING_HEAP_TYPE(node) *node = heap->node;
+    if (PAIRING_HEAP_KEY_LESS(node[b].key, node[a].key))
+    {
+        int32_t tmp = a; a = b; b = tmp;
+    }
+    node[b].sibling = node[a].child;
+    if (node[a].child != -1) node[node[a].child].prev = b;
+    node[b].prev = a;
+    node[a].child = b;
+    return a;
+}
+
+/* unhook the subtree of a non-root node from its parent and siblings */
+static void PAIRING_HEAP_FUNC(cut_a_subtree_in)(struct PAIRING_HEAP_NAME *heap, int32_t x)
+{
+    struct PAIRING_HEAP_TYPE(node) *node = heap->node;
+    int32_t prev = node[x].prev, sibling = node[x].sibling;
+    if (node[prev].child == x) node[prev].child = sibling;
+    else node[prev].sibling = sibling;
+    if (sibling != -1) node[sibling].prev = prev;
+    node[x].prev = node[x].sibling = -1;
+    return;
+}
+
+/* meld the children of x pairwise from left to right, then fold the pairs
+from right to left into one tree; return its root, or -1 */
+static int32_t PAIRING_HEAP_FUNC(pair_the_children_in)(struct PAIRING_HEAP_NAME *heap, int32_t x)
+{
+    struct PAIRING_HEAP_TYPE(node) *node = heap->node;
+    /* the pairs are pushed on a list through sibling, so it comes out reversed */
+    int32_t pairs = -1;
+    for (int32_t first = node[x].child; first != -1;)
+    {
+        int32_t second = node[first].sibling, next = -1, merged = first;
+        if (second != -1)
+        {
+            next = node[second].sibling;
+            merged = PAIRING_HEAP_FUNC(meld_two_roots_in)(heap, first, second);
+        }
+        node[merged].sibling = pairs;
+        pairs = merged;
+        first = next;
+    }
+    node[x].child = -1;
+    if (pairs == -1) return -1;
+    int32_t merged = pairs;
+    for (int32_t rest = node[pairs].sibling; rest != -1;)
+    {
+        int32_t next = node[rest].sibling;
+        merged = PAIRING_HEAP_FUNC(meld_two_roots_in)(heap, merged, rest);
+        rest = next;
+    }
+    node[merged].prev = node[merged].sibling = -1;
+    return merged;
+}
+
+static void PAIRING_HEAP_FUNC(meld_a_tree_into)(struct PAIRING_HEAP_NAME *heap, int32_t x)
+{
+    if (x == -1) return;
+    heap->root = heap->root == -1 ? x : PAIRING_HEAP_FUNC(meld_two_roots_in)(heap, heap->root, x);
+    heap->node[heap->root].prev = heap->node[heap->root].sibling = -1;
+    return;
+}
+
+/* return 0, or -1 if handle is negative or already in the heap */
+int PAIRING_HEAP_FUNC(push_a_key_in)(struct PAIRING_HEAP_NAME *heap, int32_t handle, PAIRING_HEAP_KEY_TYPE key)
+{
+    if (handle < 0 || PAIRING_HEAP_FUNC(handle_is_in)(heap, handle))
+    {
+        fprintf(stderr, "push failed. Handle %" PRId32" is invalid or in the heap already.\n", handle);
+        return -1;
+    }
+    if (handle >= heap->handle_number)
+    {
+        int32_t handle_number = heap->handle_number;
+        while (handle_number <= handle) handle_number <<= 1;
+        PAIRING_HEAP_FUNC(grow_the_nodes_of)(heap, handle_number);
+    }
+    struct PAIRING_HEAP_TYPE(node) *new_node = &heap->node[handle];
+    new_node->key = key;
+    new_node->child = new_node->sibling = new_node->prev = -1;
+    PAIRING_HEAP_FUNC(meld_a_tree_into)(heap, handle);
+    heap->size++;
+    return 0;
+}
+
+/* the minimum node stays in the heap; return -1 if the heap is empty */
+int PAIRING_HEAP_FUNC(look_up_the_min_key_in)(const struct PAIRING_HEAP_NAME *heap, int32_t *handle,
+PAIRING_HEAP_KEY_TYPE *key)
+{
+    if (heap->root == -1) return -1;
+    if (handle) *handle = heap->root;
+    if (key) *key = heap->node[heap->root].key;
+    return 0;
+}
+
+/* remove the node of handle wherever it is; return -1 if it is absent */
+int PAIRING_HEAP_FUNC(delete_a_handle_in)(struct PAIRING_HEAP_NAME *heap, int32_t handle)
+{
+    if (!PAIRING_HEAP_FUNC(handle_is_in)(heap, handle)) return -1;
+    if (handle == heap->root)
+        heap->root = PAIRING_HEAP_FUNC(pair_the_children_in)(heap, handle);
+    else
+    {
+        PAIRING_HEAP_FUNC(cut_a_subtree_in)(heap, handle);
+        PAIRING_HEAP_FUNC(meld_a_tree_into)(heap, PAIRING_HEAP_FUNC(pair_the_children_in)(heap, handle));
+    }
+    heap->node[handle].prev = PAIRING_HEAP_ABSENT;
+    heap->size--;
+    return 0;
+}
+
+/* take the minimum node out; return -1 if the heap is empty */
+int PAIRING_HEAP_FUNC(pop_the_min_key_in)(struct PAIRING_HEAP_NAME *heap, int32_t *handle,
+PAIRING_HEAP_KEY_TYPE *key)
+{
+    if (PAIRING_HEAP_FUNC(look_up_the_min_key_in)(heap, handle, key) < 0) return -1;
+    return PAIRING_HEAP_FUNC(delete_a_handle_in)(heap, heap->root);
+}
+
+/* return 0, or -1 if handle is absent or new_key is not less than its key.
+A decreased node is cut out with its subtree and melded with the root. */
+int PAIRING_HEAP_FUNC(decrease_a_key_in)(struct PAIRING_HEAP_NAME *heap, int32_t handle,
+PAIRING_HEAP_KEY_TYPE new_key)
+{
+    if (!PAIRING_HEAP_FUNC(handle_is_in)(heap, handle)
+    || !PAIRING_HEAP_KEY_LESS(new_key, heap->node[handle].key))
+        return -1;
+    heap->node[handle].key = new_key;
+    if (handle != heap->root)
+    {
+        PAIRING_HEAP_FUNC(cut_a_subtree_in)(heap, handle);
+        PAIRING_HEAP_FUNC(meld_a_tree_into)(heap, handle);
+    }
+    return 0;
+}
+
+#undef PAIRING_HEAP_TYPE
+#undef PAIRING_HEAP_FUNC
+#undef PAIRING_HEAP_NAME
+#undef PAIRING_HEAP_KEY_TYPE
+#undef PAIRING_HEAP_KEY_LESS
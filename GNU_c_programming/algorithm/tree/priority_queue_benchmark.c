@@ -0,0 +1,321 @@
+/* Dijkstra on a road-network-shaped graph through every decrease-key heap in
+this directory: 4-ary and binary d-ary heaps, the binomial heap of heap.c,
+a pairing heap and a radix heap behind one interface. The graph is a grid
+where most cells link to their four neighbours with street-length weights,
+a few links are missing, and one node in HIGHWAY_INTERVAL gets a long fast
+link, which is the low-degree, high-diameter shape of real road networks.
+
+    gcc -O2 priority_queue_benchmark.c -lm -o priority_queue_benchmark
+    ./priority_queue_benchmark [node_number] [query_number]
+
+Every heap has to settle the same distances as the first one; a mismatch is
+reported next to its row. */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <limits.h>
+
+#include "heap.c"
+
+#define D_ARY_HEAP_NAME dist_heap
+#define D_ARY_HEAP_KEY_TYPE int64_t
+#include "d_ary_heap_template.c"
+
+#define D_ARY_HEAP_NAME dist_binary_heap
+#define D_ARY_HEAP_KEY_TYPE int64_t
+#define D_ARY_HEAP_ARITY 2
+#include "d_ary_heap_template.c"
+
+#define PAIRING_HEAP_NAME dist_pairing_heap
+#define PAIRING_HEAP_KEY_TYPE int64_t
+#include "pairing_heap_template.c"
+
+#define RADIX_HEAP_NAME dist_radix_heap
+#define RADIX_HEAP_KEY_TYPE uint64_t
+#include "radix_heap_template.c"
+
+#define DEFAULT_NODE_NUMBER 1000000
+#define DEFAULT_QUERY_NUMBER 8
+/* one link in MISSING_LINK_INTERVAL of the grid is left out */
+#define MISSING_LINK_INTERVAL 10
+#define HIGHWAY_INTERVAL 64
+#define HIGHWAY_REACH 64
+/* street lengths in metres, and a highway costs a third per metre */
+#define STREET_MIN_LENGTH 50
+#define STREET_MAX_LENGTH 500
+
+/* an out-edge list in compressed sparse row form */
+struct road_graph {
+    int32_t node_number;
+    int64_t edge_number;
+    /* the out-edges of v are first_edge[v] .. first_edge[v + 1] - 1 */
+    int64_t *first_edge;
+    int32_t *edge_dest;
+    int64_t *edge_weight;};
+
+/* every heap behind the same calls */
+struct priority_queue {
+    const char *name;
+    void *(*init)(int32_t handle_number);
+    void (*destroy)(void *heap);
+    int (*push)(void *heap, int32_t handle, int64_t key);
+    int (*pop)(void *heap, int32_t *handle, int64_t *key);
+    int (*decrease)(void *heap, int32_t handle, int64_t new_key);};
+
+static void *init_a_4_ary_heap(int32_t handle_number) { return init_dist_heap(handle_number); }
+static void destroy_a_4_ary_heap(void *heap) { destroy_dist_heap(heap); }
+static int push_in_a_4_ary_heap(void *heap, int32_t handle, int64_t key) { return push_a_key_in_dist_heap(heap, handle, key); }
+static int pop_in_a_4_ary_heap(void *heap, int32_t *handle, int64_t *key) { return pop_the_min_key_in_dist_heap(heap, handle, key); }
+static int decrease_in_a_4_ary_heap(void *heap, int32_t handle, int64_t new_key)
+{
+    return decrease_a_key_in_dist_heap(heap, handle, new_key);
+}
+
+static void *init_a_binary_heap(int32_t handle_number) { return init_dist_binary_heap(handle_number); }
+static void destroy_a_binary_heap(void *heap) { destroy_dist_binary_heap(heap); }
+static int push_in_a_binary_heap(void *heap, int32_t handle, int64_t key)
+{
+    return push_a_key_in_dist_binary_heap(heap, handle, key);
+}
+static int pop_in_a_binary_heap(void *heap, int32_t *handle, int64_t *key)
+{
+    return pop_the_min_key_in_dist_binary_heap(heap, handle, key);
+}
+static int decrease_in_a_binary_heap(void *heap, int32_t handle, int64_t new_key)
+{
+    return decrease_a_key_in_dist_binary_heap(heap, handle, new_key);
+}
+
+static void *init_a_pairing_heap(int32_t handle_number) { return init_dist_pairing_heap(handle_number); }
+static void destroy_a_pairing_heap(void *heap) { destroy_dist_pairing_heap(heap); }
+static int push_in_a_pairing_heap(void *heap, int32_t handle, int64_t key)
+{
+    return push_a_key_in_dist_pairing_heap(heap, handle, key);
+}
+static int pop_in_a_pairing_heap(void *heap, int32_t *handle, int64_t *key)
+{
+    return pop_the_min_key_in_dist_pairing_heap(heap, handle, key);
+}
+static int decrease_in_a_pairing_heap(void *heap, int32_t handle, int64_t new_key)
+{
+    return decrease_a_key_in_dist_pairing_heap(heap, handle, new_key);
+}
+
+/* the binomial heap has int keys, which the dist of these graphs fits in,
+and finds the node of a handle through its id index */
+static void *init_a_binomial_heap(int32_t handle_number) { return init_binomial_heap(handle_number); }
+static void destroy_a_binomial_heap(void *heap) { destroy_binomial_heap(heap); }
+static int push_in_a_binomial_heap(void *heap, int32_t handle, int64_t key)
+{
+    if (key > INT_MAX) return -1;
+    return insert_a_key_in_binomial_heap(heap, (int)key, handle) ? 0 : -1;
+}
+static int pop_in_a_binomial_heap(void *heap, int32_t *handle, int64_t *key)
+{
+    int int_key, id;
+    if (delete_min_binomial_node(heap, &int_key, &id) < 0) return -1;
+    *handle = id, *key = int_key;
+    return 0;
+}
+static int decrease_in_a_binomial_heap(void *heap, int32_t handle, int64_t new_key)
+{
+    struct binomial_handle *binomial_handle = look_up_an_id_in_binomial_heap(heap, handle);
+    if (binomial_handle == NULL) return -1;
+    return decrease_binomial_key(heap, binomial_handle, (int)new_key);
+}
+
+/* dist is never negative, so it goes through the radix heap unsigned */
+static void *init_a_radix_heap(int32_t handle_number) { return init_dist_radix_heap(handle_number); }
+static void destroy_a_radix_heap(void *heap) { destroy_dist_radix_heap(heap); }
+static int push_in_a_radix_heap(void *heap, int32_t handle, int64_t key)
+{
+    return push_a_key_in_dist_radix_heap(heap, handle, (uint64_t)key);
+}
+static int pop_in_a_radix_heap(void *heap, int32_t *handle, int64_t *key)
+{
+    uint64_t unsigned_key;
+    if (pop_the_min_key_in_dist_radix_heap(heap, handle, &unsigned_key) < 0) return -1;
+    *key = (int64_t)unsigned_key;
+    return 0;
+}
+static int decrease_in_a_radix_heap(void *heap, int32_t handle, int64_t new_key)
+{
+    return decrease_a_key_in_dist_radix_heap(heap, handle, (uint64_t)new_key);
+}
+
+static const struct priority_queue priority_queues[] = {
+    {"4-ary heap", init_a_4_ary_heap, destroy_a_4_ary_heap, push_in_a_4_ary_heap,
+    pop_in_a_4_ary_heap, decrease_in_a_4_ary_heap},
+    {"binary heap", init_a_binary_heap, destroy_a_binary_heap, push_in_a_binary_heap,
+    pop_in_a_binary_heap, decrease_in_a_binary_heap},
+    {"binomial heap", init_a_binomial_heap, destroy_a_binomial_heap, push_in_a_binomial_heap,
+    pop_in_a_binomial_heap, decrease_in_a_binomial_heap},
+    {"pairing heap", init_a_pairing_heap, destroy_a_pairing_heap, push_in_a_pairing_heap,
+    pop_in_a_pairing_heap, decrease_in_a_pairing_heap},
+    {"radix heap", init_a_radix_heap, destroy_a_radix_heap, push_in_a_radix_heap,
+    pop_in_a_radix_heap, decrease_in_a_radix_heap}};
+
+static uint64_t xorshift64(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static int64_t street_length(uint64_t *state)
+{
+    return STREET_MIN_LENGTH + xorshift64(state) % (STREET_MAX_LENGTH - STREET_MIN_LENGTH + 1);
+}
+
+/* a side x side grid with both directions of every kept link */
+static struct road_graph *build_a_road_graph(int32_t node_number)
+{
+    int32_t side = (int32_t)sqrt((double)node_number);
+    if (side < 2) side = 2;
+    node_number = side * side;
+    struct road_graph *graph = (struct road_graph *)malloc(sizeof(struct road_graph));
+    int32_t *degree = (int32_t *)calloc(node_number + 1, sizeof(int32_t));
+    /* the undirected links, kept as pairs of nodes and a weight; a node
+    adds at most two streets and one highway */
+    int64_t link_capacity = (int64_t)node_number * 3, link_number = 0;
+    int32_t (*link)[2] = (int32_t (*)[2])malloc(link_capacity * sizeof(int32_t[2]));
+    int64_t *link_weight = (int64_t *)malloc(link_capacity * sizeof(int64_t));
+    if (graph == NULL || degree == NULL || link == NULL || link_weight == NULL)
+        perror("fail to allocate the road graph"), exit(EXIT_FAILURE);
+    uint64_t state = 0x9E3779B97F4A7C15;
+    for (int32_t v = 0; v < node_number; v++)
+    {
+        int32_t row = v / side, column = v % side;
+        if (column + 1 < side && xorshift64(&state) % MISSING_LINK_INTERVAL != 0)
+            link[link_number][0] = v, link[link_number][1] = v + 1, link_weight[link_number++] = street_length(&state);
+        if (row + 1 < side && xorshift64(&state) % MISSING_LINK_INTERVAL != 0)
+            link[link_number][0] = v, link[link_number][1] = v + side, link_weight[link_number++] = street_length(&state);
+        if (xorshift64(&state) % HIGHWAY_INTERVAL == 0)
+        {
+            int32_t to_row = row + (int32_t)(xorshift64(&state) % (2 * HIGHWAY_REACH + 1)) - HIGHWAY_REACH;
+            int32_t to_column = column + (int32_t)(xorshift64(&state) % (2 * HIGHWAY_REACH + 1)) - HIGHWAY_REACH;
+            if (to_row < 0 || to_row >= side || to_column < 0 || to_column >= side) continue;
+            double metres = hypot(to_row - row, to_column - column) * (STREET_MIN_LENGTH + STREET_MAX_LENGTH) / 2;
+            link[link_number][0] = v, link[link_number][1] = to_row * side + to_column;
+            link_weight[link_number++] = (int64_t)(metres / 3) + 1;
+        }
+    }
+    for (int64_t e = 0; e < link_number; e++)
+        degree[link[e][0] + 1]++, degree[link[e][1] + 1]++;
+    graph->node_number = node_number;
+    graph->edge_number = link_number * 2;
+    graph->first_edge = (int64_t *)malloc((node_number + 1) * sizeof(int64_t));
+    graph->edge_dest = (int32_t *)malloc(graph->edge_number * sizeof(int32_t));
+    graph->edge_weight = (int64_t *)malloc(graph->edge_number * sizeof(int64_t));
+    if (graph->first_edge == NULL || graph->edge_dest == NULL || graph->edge_weight == NULL)
+        perror("fail to allocate the road graph"), exit(EXIT_FAILURE);
+    graph->first_edge[0] = 0;
+    for (int32_t v = 0; v < node_number; v++)
+        graph->first_edge[v + 1] = graph->first_edge[v] + degree[v + 1];
+    /* degree[v] is reused as the number of out-edges of v filled so far */
+    memset(degree, 0, (node_number + 1) * sizeof(int32_t));
+    for (int64_t e = 0; e < link_number; e++)
+        for (int end = 0; end < 2; end++)
+        {
+            int32_t from = link[e][end];
+            int64_t slot = graph->first_edge[from] + degree[from]++;
+            graph->edge_dest[slot] = link[e][!end];
+            graph->edge_weight[slot] = link_weight[e];
+        }
+    free(degree); free(link); free(link_weight);
+    return graph;
+}
+
+static void delete_a_road_graph(struct road_graph *graph)
+{
+    free(graph->first_edge);
+    free(graph->edge_dest);
+    free(graph->edge_weight);
+    free(graph);
+    return;
+}
+
+/* fill dist from src, INT64_MAX where it is unreachable, and count the heap calls */
+static void Dijkstra_with_a_priority_queue(const struct road_graph *graph, const struct priority_queue *queue,
+int32_t src, int64_t *dist, int64_t *push_number, int64_t *decrease_number)
+{
+    for (int32_t v = 0; v < graph->node_number; v++) dist[v] = INT64_MAX;
+    void *heap = queue->init(graph->node_number);
+    dist[src] = 0;
+    queue->push(heap, src, 0);
+    (*push_number)++;
+    int32_t u;
+    int64_t dist_of_u;
+    while (queue->pop(heap, &u, &dist_of_u) == 0)
+        for (int64_t e = graph->first_edge[u]; e < graph->first_edge[u + 1]; e++)
+        {
+            int32_t v = graph->edge_dest[e];
+            int64_t new_dist = dist_of_u + graph->edge_weight[e];
+            if (new_dist >= dist[v]) continue;
+            if (dist[v] == INT64_MAX)
+                queue->push(heap, v, new_dist), (*push_number)++;
+            else queue->decrease(heap, v, new_dist), (*decrease_number)++;
+            dist[v] = new_dist;
+        }
+    queue->destroy(heap);
+    return;
+}
+
+int main(int argc, char *argv[])
+{
+    int64_t node_number = argc > 1 ? atoll(argv[1]) : DEFAULT_NODE_NUMBER;
+    int64_t query_number = argc > 2 ? atoll(argv[2]) : DEFAULT_QUERY_NUMBER;
+    if (node_number < 4 || node_number > INT32_MAX || query_number < 1)
+    {
+        fprintf(stderr, "usage: %s [4 <= node_number <= INT32_MAX] [query_number >= 1]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    struct road_graph *graph = build_a_road_graph((int32_t)node_number);
+    int32_t *src = (int32_t *)malloc(query_number * sizeof(int32_t));
+    int64_t *dist = (int64_t *)malloc(graph->node_number * sizeof(int64_t));
+    uint64_t *checksum = (uint64_t *)malloc(query_number * sizeof(uint64_t));
+    if (src == NULL || dist == NULL || checksum == NULL)
+        perror("fail to allocate the benchmark arrays"), exit(EXIT_FAILURE);
+    uint64_t state = 0xD1B54A32D192ED03;
+    for (int64_t q = 0; q < query_number; q++)
+        src[q] = (int32_t)(xorshift64(&state) % graph->node_number);
+    printf("%" PRId32" nodes, %" PRId64" edges, %" PRId64" queries\n",
+    graph->node_number, graph->edge_number, query_number);
+    printf("%-13s %10s %12s %12s %12s\n", "heap", "ms/query", "Mnode/s", "push/query", "decr/query");
+    for (size_t h = 0; h < sizeof(priority_queues) / sizeof(priority_queues[0]); h++)
+    {
+        int64_t push_number = 0, decrease_number = 0, settled_number = 0;
+        _Bool mismatch = 0;
+        double run_ns = 0;
+        for (int64_t q = 0; q < query_number; q++)
+        {
+            uint64_t start = now_ns();
+            Dijkstra_with_a_priority_queue(graph, &priority_queues[h], src[q], dist, &push_number, &decrease_number);
+            run_ns += (double)(now_ns() - start);
+            uint64_t sum = 0;
+            for (int32_t v = 0; v < graph->node_number; v++)
+                if (dist[v] != INT64_MAX) sum = sum * 31 + (uint64_t)dist[v], settled_number++;
+            if (h == 0) checksum[q] = sum;
+            else mismatch |= checksum[q] != sum;
+        }
+        printf("%-13s %10.2f %12.2f %12.0f %12.0f%s\n", priority_queues[h].name, run_ns / query_number / 1e6,
+        settled_number / run_ns * 1e3, (double)push_number / query_number, (double)decrease_number / query_number,
+        mismatch ? "  (dist differs from the first heap)" : "");
+    }
+    free(src); free(dist); free(checksum);
+    delete_a_road_graph(graph);
+    return 0;
+}
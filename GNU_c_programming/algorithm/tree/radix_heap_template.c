@@ -0,0 +1,228 @@
+/* a monotone radix heap for unsigned integer keys, behind the same calls as
+d_ary_heap_template.c. Define the parameters below and include this file
+once per instantiation:
+
+    #define RADIX_HEAP_NAME dist_radix_heap
+    #define RADIX_HEAP_KEY_TYPE uint64_t
+    #include "radix_heap_template.c"
+
+Monotone means that no key pushed or decreased to may be less than the last
+key popped, which holds for Dijkstra with non-negative weights. Bucket 0
+holds the keys equal to the last popped key and bucket i holds those whose
+highest bit differing from it is bit i - 1. A pop refills bucket 0 from the
+first non-empty bucket, and every key only ever moves to a lower bucket, so
+a key is moved at most once per bit of RADIX_HEAP_KEY_TYPE.
+There is no #pragma once here on purpose; the parameters are undefined at
+the end so that the next instantiation starts clean. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+
+#ifndef RADIX_HEAP_NAME
+#error "RADIX_HEAP_NAME is not defined"
+#endif
+#ifndef RADIX_HEAP_KEY_TYPE
+#error "RADIX_HEAP_KEY_TYPE is not defined"
+#endif
+
+#ifndef RADIX_HEAP_TEMPLATE_COMMON
+#define RADIX_HEAP_TEMPLATE_COMMON
+#define RADIX_HEAP_PASTE(a, b) a##_##b
+#define RADIX_HEAP_CONCAT(a, b) RADIX_HEAP_PASTE(a, b)
+#define RADIX_HEAP_FIRST_BUCKET_CAPACITY 16
+#endif
+
+#define RADIX_HEAP_KEY_BITS ((int)(sizeof(RADIX_HEAP_KEY_TYPE) * 8))
+#define RADIX_HEAP_TYPE(suffix) RADIX_HEAP_CONCAT(RADIX_HEAP_NAME, suffix)
+#define RADIX_HEAP_FUNC(prefix) RADIX_HEAP_CONCAT(prefix, RADIX_HEAP_NAME)
+
+_Static_assert((RADIX_HEAP_KEY_TYPE)-1 > 0, "RADIX_HEAP_KEY_TYPE must be unsigned");
+_Static_assert(sizeof(RADIX_HEAP_KEY_TYPE) <= sizeof(unsigned long long), "RADIX_HEAP_KEY_TYPE is too wide");
+
+struct RADIX_HEAP_TYPE(entry) {
+    RADIX_HEAP_KEY_TYPE key;
+    int32_t handle;};
+
+struct RADIX_HEAP_TYPE(bucket) {
+    struct RADIX_HEAP_TYPE(entry) *entry;
+    int32_t size, capacity;};
+
+struct RADIX_HEAP_NAME {
+    struct RADIX_HEAP_TYPE(bucket) bucket[RADIX_HEAP_KEY_BITS + 1];
+    RADIX_HEAP_KEY_TYPE last_key;
+    int32_t size;
+    /* bucket_of[handle] is -1 outside the heap, and index_of[handle] is the
+    index of the entry in that bucket */
+    int32_t *bucket_of, *index_of;
+    int32_t handle_number;};
+
+static int RADIX_HEAP_FUNC(bucket_of_a_key_in)(const struct RADIX_HEAP_NAME *heap, RADIX_HEAP_KEY_TYPE key)
+{
+    unsigned long long diff = (unsigned long long)(key ^ heap->last_key);
+    return diff == 0 ? 0 : (int)(sizeof(unsigned long long) * 8) - __builtin_clzll(diff);
+}
+
+static void RADIX_HEAP_FUNC(append_an_entry_in)(struct RADIX_HEAP_NAME *heap, int b,
+RADIX_HEAP_KEY_TYPE key, int32_t handle)
+{
+    struct RADIX_HEAP_TYPE(bucket) *bucket = &heap->bucket[b];
+    if (bucket->size == bucket->capacity)
+    {
+        bucket->capacity = bucket->capacity ? bucket->capacity << 1 : RADIX_HEAP_FIRST_BUCKET_CAPACITY;
+        bucket->entry = (struct RADIX_HEAP_TYPE(entry) *)realloc(bucket->entry,
+        bucket->capacity * sizeof(struct RADIX_HEAP_TYPE(entry)));
+        if (bucket->entry == NULL)
+            perror("fail to grow a bucket of a radix heap"), exit(EXIT_FAILURE);
+    }
+    bucket->entry[bucket->size].key = key;
+    bucket->entry[bucket->size].handle = handle;
+    heap->bucket_of[handle] = b;
+    heap->index_of[handle] = bucket->size++;
+    return;
+}
+
+/* the last entry of the bucket fills the hole */
+static void RADIX_HEAP_FUNC(remove_an_entry_in)(struct RADIX_HEAP_NAME *heap, int32_t handle)
+{
+    struct RADIX_HEAP_TYPE(bucket) *bucket = &heap->bucket[heap->bucket_of[handle]];
+    int32_t index = heap->index_of[handle];
+    bucket->entry[index] = bucket->entry[--bucket->size];
+    heap->index_of[bucket->entry[index].handle] = index;
+    heap->bucket_of[handle] = -1;
+    return;
+}
+
+/* handles are taken from [0, handle_number), which grows on demand */
+struct RADIX_HEAP_NAME *RADIX_HEAP_FUNC(init)(int32_t handle_number)
+{
+    struct RADIX_HEAP_NAME *heap = (struct RADIX_HEAP_NAME *)calloc(1, sizeof(struct RADIX_HEAP_NAME));
+    if (heap == NULL)
+        perror("fail to allocate a radix heap"), exit(EXIT_FAILURE);
+    heap->handle_number = handle_number > 0 ? handle_number : 1;
+    heap->bucket_of = (int32_t *)malloc(heap->handle_number * sizeof(int32_t));
+    heap->index_of = (int32_t *)malloc(heap->handle_number * sizeof(int32_t));
+    if (heap->bucket_of == NULL || heap->index_of == NULL)
+        perror("fail to allocate the positions of a radix heap"), exit(EXIT_FAILURE);
+    memset(heap->bucket_of, -1, heap->handle_number * sizeof(int32_t));
+    return heap;
+}
+
+void RADIX_HEAP_FUNC(destroy)(struct RADIX_HEAP_NAME *heap)
+{
+    for (int b = 0; b <= RADIX_HEAP_KEY_BITS; b++)
+        free(heap->bucket[b].entry);
+    free(heap->bucket_of);
+    free(heap->index_of);
+    free(heap);
+    return;
+}
+
+_Bool RADIX_HEAP_FUNC(handle_is_in)(const struct RADIX_HEAP_NAME *heap, int32_t handle)
+{
+    return handle >= 0 && handle < heap->handle_number && heap->bucket_of[handle] >= 0;
+}
+
+/* return 0, or -1 if handle is negative or already in the heap, or if key
+is less than the last key popped */
+int RADIX_HEAP_FUNC(push_a_key_in)(struct RADIX_HEAP_NAME *heap, int32_t handle, RADIX_HEAP_KEY_TYPE key)
+{
+    if (handle < 0 || RADIX_HEAP_FUNC(handle_is_in)(heap, handle))
+    {
+        fprintf(stderr, "push failed. Handle %" PRId32" is invalid or in the heap already.\n", handle);
+        return -1;
+    }
+    if (key < heap->last_key)
+    {
+        fputs("push failed. A radix heap only takes keys from the last key popped on.\n", stderr);
+        return -1;
+    }
+    if (handle >= heap->handle_number)
+    {
+        int32_t handle_number = heap->handle_number;
+        while (handle_number <= handle) handle_number <<= 1;
+        heap->bucket_of = (int32_t *)realloc(heap->bucket_of, handle_number * sizeof(int32_t));
+        heap->index_of = (int32_t *)realloc(heap->index_of, handle_number * sizeof(int32_t));
+        if (heap->bucket_of == NULL || heap->index_of == NULL)
+            perror("fail to grow the positions of a radix heap"), exit(EXIT_FAILURE);
+        memset(heap->bucket_of + heap->handle_number, -1, (handle_number - heap->handle_number) * sizeof(int32_t));
+        heap->handle_number = handle_number;
+    }
+    RADIX_HEAP_FUNC(append_an_entry_in)(heap, RADIX_HEAP_FUNC(bucket_of_a_key_in)(heap, key), key, handle);
+    heap->size++;
+    return 0;
+}
+
+/* move the least key of the first non-empty bucket to last_key and spread
+that bucket over the lower ones, so that bucket 0 holds the minimum */
+static void RADIX_HEAP_FUNC(refill_bucket_0_in)(struct RADIX_HEAP_NAME *heap)
+{
+    int b = 1;
+    while (heap->bucket[b].size == 0) b++;
+    struct RADIX_HEAP_TYPE(bucket) *bucket = &heap->bucket[b];
+    RADIX_HEAP_KEY_TYPE min_key = bucket->entry[0].key;
+    for (int32_t i = 1; i < bucket->size; i++)
+        if (bucket->entry[i].key < min_key) min_key = bucket->entry[i].key;
+    heap->last_key = min_key;
+    int32_t size = bucket->size;
+    bucket->size = 0;
+    for (int32_t i = 0; i < size; i++)
+        RADIX_HEAP_FUNC(append_an_entry_in)(heap, RADIX_HEAP_FUNC(bucket_of_a_key_in)(heap, bucket->entry[i].key),
+        bucket->entry[i].key, bucket->entry[i].handle);
+    return;
+}
+
+/* the minimum entry stays in the heap; return -1 if the heap is empty */
+int RADIX_HEAP_FUNC(look_up_the_min_key_in)(struct RADIX_HEAP_NAME *heap, int32_t *handle,
+RADIX_HEAP_KEY_TYPE *key)
+{
+    if (heap->size == 0) return -1;
+    if (heap->bucket[0].size == 0) RADIX_HEAP_FUNC(refill_bucket_0_in)(heap);
+    if (handle) *handle = heap->bucket[0].entry[heap->bucket[0].size - 1].handle;
+    if (key) *key = heap->last_key;
+    return 0;
+}
+
+/* remove the entry of handle wherever it is; return -1 if it is absent */
+int RADIX_HEAP_FUNC(delete_a_handle_in)(struct RADIX_HEAP_NAME *heap, int32_t handle)
+{
+    if (!RADIX_HEAP_FUNC(handle_is_in)(heap, handle)) return -1;
+    RADIX_HEAP_FUNC(remove_an_entry_in)(heap, handle);
+    heap->size--;
+    return 0;
+}
+
+/* take the minimum entry out; return -1 if the heap is empty */
+int RADIX_HEAP_FUNC(pop_the_min_key_in)(struct RADIX_HEAP_NAME *heap, int32_t *handle, RADIX_HEAP_KEY_TYPE *key)
+{
+    int32_t min_handle;
+    if (RADIX_HEAP_FUNC(look_up_the_min_key_in)(heap, &min_handle, key) < 0) return -1;
+    if (handle) *handle = min_handle;
+    return RADIX_HEAP_FUNC(delete_a_handle_in)(heap, min_handle);
+}
+
+/* return 0, or -1 if handle is absent, new_key is not less than its key or
+new_key is less than the last key popped */
+int RADIX_HEAP_FUNC(decrease_a_key_in)(struct RADIX_HEAP_NAME *heap, int32_t handle, RADIX_HEAP_KEY_TYPE new_key)
+{
+    if (!RADIX_HEAP_FUNC(handle_is_in)(heap, handle) || new_key < heap->last_key)
+        return -1;
+    const struct RADIX_HEAP_TYPE(bucket) *bucket = &heap->bucket[heap->bucket_of[handle]];
+    if (!(new_key < bucket->entry[heap->index_of[handle]].key)) return -1;
+    int b = RADIX_HEAP_FUNC(bucket_of_a_key_in)(heap, new_key);
+    if (b == heap->bucket_of[handle])
+    {
+        heap->bucket[b].entry[heap->index_of[handle]].key = new_key;
+        return 0;
+    }
+    RADIX_HEAP_FUNC(remove_an_entry_in)(heap, handle);
+    RADIX_HEAP_FUNC(append_an_entry_in)(heap, b, new_key, handle);
+    return 0;
+}
+
+#undef RADIX_HEAP_KEY_BITS
+#undef RADIX_HEAP_TYPE
+#undef RADIX_HEAP_FUNC
+#undef RADIX_HEAP_NAME
+#undef RADIX_HEAP_KEY_TYPE
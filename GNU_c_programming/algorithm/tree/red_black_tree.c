@@ -2,235 +2,448 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <string.h>
+#include "node_pool.c"
 #define red 1
 #define black 0
 static _Atomic(enum {left, right}) side;
 struct RB_node {
     int64_t node_id;
     _Bool color;
+    /* whether the node came from a struct node_pool rather than the C heap */
+    _Bool pooled;
+    /* the number of nodes in the subtree rooted here, for rank and select */
+    int32_t size;
     struct RB_node *next[2], *parent;};
 
+/* a node comes from pool, or from the C heap if pool is NULL */
+static struct RB_node *alloc_a_new_RB_node(struct node_pool *pool)
+{
+    struct RB_node *node = pool ? (struct RB_node *)alloc_a_node_from_pool(pool)
+    : (struct RB_node *)malloc(sizeof(struct RB_node));
+    if (node == NULL)
+        perror("fail to allocate a red black node"), exit(EXIT_FAILURE);
+    memset(node, 0, sizeof(struct RB_node));
+    node->pooled = (pool != NULL);
+    return node;
+}
+
+static void free_an_RB_node(struct RB_node *node)
+{
+    if (node->pooled) free_a_node_to_pool(node);
+    else free(node);
+    return;
+}
+
+/* the pool of the nodes of a tree, or NULL for the C heap or an empty tree */
+static struct node_pool *node_pool_of_an_RBT(struct RB_node *const *RB_tree)
+{
+    return (*RB_tree && (*RB_tree)->pooled) ? node_pool_of_a_node(*RB_tree) : NULL;
+}
+
+/* start a tree whose nodes come from pool, made by init_node_pool(sizeof(struct
+RB_node), ...), or from the C heap if pool is NULL. destroy_node_pool() then
+frees the whole tree at once. */
+struct RB_node *init_an_RB_root(int64_t root_key, struct node_pool *pool)
+{
+    struct RB_node *root = alloc_a_new_RB_node(pool);
+    root->node_id = root_key;
+    root->next[left] = root->next[right] = root->parent = NULL;
+    root->color = black, root->size = 1;
+    return root;
+}
+
 struct RB_node* look_up_a_key_in_RBT(struct RB_node **const RB_tree, int64_t key)
 {
     struct RB_node *cur = *RB_tree;
-    while (cur->node_id != key && cur)
+    while (cur && cur->node_id != key)
     {
-        side = (cur->node_id < key) ? left : right;
+        side = (cur->node_id < key) ? right : left;
         cur = cur->next[side];
     }
     if (!cur) fputs("no key value in binary search tree!\n", stderr);
     return cur;
 }
 
-struct RB_node* balance_and_recolor_a_node_in_RBT_after_insert(struct RB_node *node)
+static int32_t size_of_an_RB_subtree(struct RB_node *node)
 {
-    side = (node->next[left]->color == red) ? left : right;
-    struct RB_node *red_child_node = node->next[side];
-    if (node->next[side]->next[!side]->color == red)
-    {
-        /* rotation for the longer child node of the current node, */
-        /* i.e, the first rotation for RL and LR. */
-        node->next[side] = red_child_node->next[!side];
-        node->next[side]->parent = node;
-        red_child_node->next[!side] = node->next[side]->next[side];
-        red_child_node->next[!side]->parent = red_child_node;
-        red_child_node->parent = node->next[side];
-        node->next[side]->next[side] = red_child_node;
-        red_child_node = node->next[side];
-    }
-    /* rotation for the current node, */
-    /* i.e, the second rotation for RL and LR, or the rotation for LL and RR. */
-    node->next[side] = red_child_node->next[!side];
-    node->next[side]->parent = red_child_node;
-    red_child_node->next[!side] = node;
-    red_child_node->parent = node->parent;
-    node->parent->next[node->parent->next[right] == node] = red_child_node;
-    node->parent = red_child_node;
-    red_child_node->color = black;
-    node->color = red;
-    node = red_child_node;
-    return node;
+    return node ? node->size : 0;
 }
 
-int insert_a_key_in_RBT(struct RB_node **RB_tree, int64_t new_key)
+/* the child of node on rotating_side takes the place of node, and node
+becomes its child on the other side. */
+static struct RB_node* rotate_an_RB_node(struct RB_node **RB_tree, struct RB_node *node, _Bool rotating_side)
 {
-    if (*RB_tree == NULL)
+    struct RB_node *child_node = node->next[rotating_side];
+    node->next[rotating_side] = child_node->next[!rotating_side];
+    if (node->next[rotating_side])
+        node->next[rotating_side]->parent = node;
+    child_node->parent = node->parent;
+    if (node->parent == NULL) *RB_tree = child_node;
+    else node->parent->next[node->parent->next[right] == node] = child_node;
+    child_node->next[!rotating_side] = node;
+    node->parent = child_node;
+    child_node->size = node->size;
+    node->size = size_of_an_RB_subtree(node->next[left]) + size_of_an_RB_subtree(node->next[right]) + 1;
+    return child_node;
+}
+
+static _Bool is_a_black_RB_node(struct RB_node *node)
+{
+    return node == NULL || node->color == black;
+}
+
+/* node is red with a red parent and a black uncle. Rotate the grandparent,
+after the parent if node is an inner grandchild, and return the new black
+root of the subtree. */
+struct RB_node* balance_and_recolor_a_node_in_RBT_after_insert(struct RB_node **RB_tree, struct RB_node *node)
+{
+    struct RB_node *parent = node->parent, *grandparent = parent->parent;
+    _Bool parent_side = (grandparent->next[right] == parent);
+    if (parent->next[!parent_side] == node)
+        parent = rotate_an_RB_node(RB_tree, parent, !parent_side);
+    rotate_an_RB_node(RB_tree, grandparent, parent_side);
+    parent->color = black;
+    grandparent->color = red;
+    return parent;
+}
+
+/* cur is a red node just linked under a parent that may be red. Push the
+red upward while the uncle is red, then rotate once; the root ends black.
+Return 1 if the root was red before, so the black height grew by one. */
+static _Bool recolor_RBT_after_linking_a_red_node(struct RB_node **RB_tree, struct RB_node *cur)
+{
+    while (cur->parent && cur->parent->color == red)
     {
-        struct RB_node *root = (struct RB_node *)calloc(1, sizeof(struct RB_node));
-        root->node_id = new_key;
-        root->next[left] = root->next[right] = root->parent = NULL;
-        root->color = black;
-        *RB_tree = root;
-        printf("insert key value %" PRId64" successfully.\n", new_key);
-        return 0;
+        /* a red parent is never the root, so the grandparent exists */
+        struct RB_node *grandparent = cur->parent->parent;
+        struct RB_node *uncle_node = grandparent->next[grandparent->next[left] == cur->parent];
+        if (!is_a_black_RB_node(uncle_node))
+        {
+            uncle_node->color = cur->parent->color = black;
+            grandparent->color = red;
+            cur = grandparent;
+        }
+        else
+        {
+            balance_and_recolor_a_node_in_RBT_after_insert(RB_tree, cur);
+            break;
+        }
     }
-    struct RB_node *cur=*RB_tree, *previous_of_cur;
+    _Bool root_was_red = ((*RB_tree)->color == red);
+    (*RB_tree)->color = black;
+    return root_was_red;
+}
+
+/* insert new_key somewhere under cur in a node from pool, and return the new
+node or NULL if new_key is there already */
+static struct RB_node *insert_a_key_below_an_RB_node(struct RB_node **RB_tree, struct RB_node *cur, int64_t new_key,
+struct node_pool *pool)
+{
+    struct RB_node *previous_of_cur = NULL;
     while (cur)
     {
         if (cur->node_id == new_key)
         {
             fprintf(stderr, "insert failed. This tree has already a node with key value %" PRId64".\n", new_key);
-            return -1;
+            return NULL;
         }
         previous_of_cur = cur;
-        side = (cur->node_id < new_key) ? left : right;
+        side = (cur->node_id < new_key) ? right : left;
         cur = cur->next[side];
     }
-    struct RB_node *new_node = (struct RB_node *)calloc(1, sizeof(struct RB_node));
+    struct RB_node *new_node = alloc_a_new_RB_node(pool);
     new_node->node_id = new_key;
     new_node->next[left] = new_node->next[right] = NULL;
     new_node->parent = previous_of_cur;
-    new_node->color = red; cur = new_node;
-    if (cur->parent->color == black) return 0;
-    while (cur->parent->color == red)
+    new_node->color = red, new_node->size = 1, cur = new_node;
+    previous_of_cur->next[side] = new_node;
+    for (struct RB_node *ancestor = previous_of_cur; ancestor; ancestor = ancestor->parent)
+        ancestor->size++;
+    recolor_RBT_after_linking_a_red_node(RB_tree, cur);
+    return new_node;
+}
+
+/* the new node comes from pool, which has to be the same for every insert in
+a tree, or from the C heap if pool is NULL. */
+int insert_a_key_in_RBT(struct RB_node **RB_tree, int64_t new_key, struct node_pool *pool)
+{
+    if (*RB_tree == NULL)
     {
-        side = (cur->parent->parent->next[left] == cur->parent) ? right : left;
-        struct RB_node *uncle_node = cur->parent->parent->next[side];
-        if (uncle_node->color == red)
+        *RB_tree = init_an_RB_root(new_key, pool);
+        printf("insert key value %" PRId64" successfully.\n", new_key);
+        return 0;
+    }
+    if (insert_a_key_below_an_RB_node(RB_tree, *RB_tree, new_key, pool) == NULL) return -1;
+    printf("insert key value %" PRId64" successfully.\n", new_key);
+    return 0;
+}
+
+/* the node of the last key inserted through it and the keys next to that
+key in the tree, which are absent for the least or the greatest key. A
+deletion, or an insertion without it, leaves it stale: start it over with
+init_an_RB_finger() then. */
+struct RB_finger {
+    struct RB_node *node;
+    int64_t lower, upper;
+    _Bool has_lower, has_upper;};
+
+void init_an_RB_finger(struct RB_finger *finger)
+{
+    finger->node = NULL;
+    finger->has_lower = finger->has_upper = 0;
+    return;
+}
+
+/* insert new_key starting from the node of finger. A key between the
+neighbours of the last key goes right below its node with no climb, so a run
+of increasing keys costs O(1) levels. Otherwise the subtree to descend is
+under the highest ancestor whose key lies between the last key and new_key,
+and no ancestor above the first one beyond new_key can be such, so the climb
+stops there, and that ancestor bounds the subtree. Unlike insert_a_key_in_RBT(),
+it reports nothing on stdout. */
+int insert_a_key_in_RBT_with_finger(struct RB_node **RB_tree, int64_t new_key, struct RB_finger *finger,
+struct node_pool *pool)
+{
+    if (*RB_tree == NULL)
+    {
+        int state = insert_a_key_in_RBT(RB_tree, new_key, pool);
+        init_an_RB_finger(finger);
+        finger->node = *RB_tree;
+        return state;
+    }
+    struct RB_node *start = finger->node ? finger->node : *RB_tree;
+    int64_t lower = finger->lower, upper = finger->upper;
+    _Bool has_lower = finger->node && finger->has_lower, has_upper = finger->node && finger->has_upper;
+    if ((has_lower && new_key <= lower) || (has_upper && new_key >= upper))
+    {
+        int64_t last_key = start->node_id;
+        _Bool upward = (last_key < new_key);
+        has_lower = has_upper = 0;
+        for (struct RB_node *ancestor = start->parent; ancestor; ancestor = ancestor->parent)
         {
-            uncle_node->color = cur->parent->color = black;
-            cur->parent->parent->color = red;
+            if (ancestor->node_id == new_key) { start = ancestor; break; }
+            if ((ancestor->node_id < new_key) != upward)
+            {
+                if (upward) upper = ancestor->node_id, has_upper = 1;
+                else lower = ancestor->node_id, has_lower = 1;
+                break;
+            }
+            if ((ancestor->node_id > last_key) == upward) start = ancestor;
         }
-        else cur->parent->parent = balance_and_recolor_a_node_in_RBT_after_insert(cur->parent->parent);
-        cur = cur->parent;
     }
-    printf("insert key value %" PRId64" successfully.\n", new_key);
+    /* walk down to the parent of the new node; every key passed narrows the
+    bounds, which end up as the neighbours of new_key */
+    struct RB_node *parent = start;
+    for (struct RB_node *cur = start; cur;)
+    {
+        parent = cur;
+        if (cur->node_id == new_key) break;
+        if (cur->node_id < new_key) lower = cur->node_id, has_lower = 1, cur = cur->next[right];
+        else upper = cur->node_id, has_upper = 1, cur = cur->next[left];
+    }
+    struct RB_node *new_node = insert_a_key_below_an_RB_node(RB_tree, parent, new_key, pool);
+    if (new_node == NULL)
+    {
+        init_an_RB_finger(finger);
+        return -1;
+    }
+    finger->node = new_node;
+    finger->lower = lower, finger->upper = upper;
+    finger->has_lower = has_lower, finger->has_upper = has_upper;
     return 0;
 }
 
-struct RB_node* delete_a_node_with_one_child_in_BST(struct RB_node *node)
+/* unlink node, which has one child at most, and return the child */
+struct RB_node* delete_a_node_with_one_child_in_BST(struct RB_node **RB_tree, struct RB_node *node)
 {
     struct RB_node *child_node;
     child_node = (node->next[left]) ? node->next[left] : node->next[right];
-    child_node->parent = node->parent;
-    node->parent->next[side] = child_node;
-    free(node);
+    if (child_node) child_node->parent = node->parent;
+    if (node->parent == NULL) *RB_tree = child_node;
+    else node->parent->next[side] = child_node;
+    free_an_RB_node(node);
     return child_node;
 }
 
-struct RB_node* balance_and_recolor_a_black_node_in_RBT_after_deleting_a_black_node(struct RB_node *parent_of_node)
+/* the subtree on side of parent_of_node lost a black node. Fix it up by
+rotations around parent_of_node, or push the missing black upward. */
+struct RB_node* balance_and_recolor_a_black_node_in_RBT_after_deleting_a_black_node(struct RB_node **RB_tree,
+struct RB_node *parent_of_node)
 {
-    struct RB_node *sibling_node = parent_of_node->next[!side];
-    _Bool nephew_color_in_same_side, nephew_color_in_another_side;
-    nephew_color_in_same_side = (sibling_node->next[side]->color == black || !sibling_node->next[side]) ? black : red;
-    nephew_color_in_another_side = (sibling_node->next[!side]->color == black || !sibling_node->next[!side]) ? black : red;
-    if (nephew_color_in_same_side | nephew_color_in_another_side | sibling_node->color | parent_of_node->color)
+    while (parent_of_node)
     {
-        if (sibling_node->color == red)
+        struct RB_node *node = parent_of_node->next[side];
+        if (!is_a_black_RB_node(node))
         {
-            parent_of_node->next[side] = sibling_node->next[!side];
-            parent_of_node->next[side]->parent = sibling_node;
-            sibling_node->next[!side] = parent_of_node;
-            sibling_node->parent = parent_of_node->parent;
-            if (!parent_of_node->parent)
-                parent_of_node->parent->next[parent_of_node->parent->next[right] == parent_of_node] = sibling_node;
-            parent_of_node->parent = sibling_node;
-            parent_of_node->color = red;
-            sibling_node->color = black;
-            parent_of_node = balance_and_recolor_a_black_node_in_RBT_after_deleting_a_black_node(parent_of_node);
+            node->color = black;
+            return parent_of_node;
         }
-        else if (nephew_color_in_another_side == red)
+        struct RB_node *sibling_node = parent_of_node->next[!side];
+        if (sibling_node->color == red)
         {
-            struct RB_node *left_nephew_node = sibling_node->next[!side];
-            parent_of_node->next[side] = left_nephew_node;
-            left_nephew_node->parent = parent_of_node;
-            sibling_node->next[!side] = left_nephew_node->next[side];
-            sibling_node->next[!side]->parent = sibling_node;
-            left_nephew_node->next[side] = sibling_node;
-            sibling_node->parent = left_nephew_node;
-            parent_of_node = balance_and_recolor_a_black_node_in_RBT_after_deleting_a_black_node(parent_of_node);
+            sibling_node->color = black;
+            parent_of_node->color = red;
+            rotate_an_RB_node(RB_tree, parent_of_node, !side);
+            sibling_node = parent_of_node->next[!side];
         }
-        else if (nephew_color_in_same_side == red)
+        struct RB_node *nephew_node_in_same_side = sibling_node->next[side];
+        struct RB_node *nephew_node_in_another_side = sibling_node->next[!side];
+        if (is_a_black_RB_node(nephew_node_in_same_side) && is_a_black_RB_node(nephew_node_in_another_side))
         {
-            parent_of_node->next[side] = sibling_node->next[!side];
-            parent_of_node->next[side]->parent = sibling_node;
-            sibling_node->next[!side] = parent_of_node;
-            sibling_node->parent = parent_of_node->parent;
-            if (!parent_of_node->parent)
-                parent_of_node->parent->next[parent_of_node->parent->next[right] == parent_of_node] = sibling_node;
-            parent_of_node->parent = sibling_node;
-            _Bool tmp = sibling_node->color; sibling_node->color = parent_of_node->color; parent_of_node->color = tmp;
-            parent_of_node = sibling_node;
-            parent_of_node->next[side]->color = black;
-        }
-        else {
             sibling_node->color = red;
-            parent_of_node->color = black;
+            node = parent_of_node;
+            parent_of_node = node->parent;
+            if (parent_of_node) side = (parent_of_node->next[right] == node);
+            else node->color = black;
+            continue;
         }
-    }
-    else {
-        sibling_node->color = red;
-        if (!parent_of_node->parent)
+        if (is_a_black_RB_node(nephew_node_in_another_side))
         {
-            side = (parent_of_node->parent->next[left] == parent_of_node) ? left : right;
-            parent_of_node->parent = balance_and_recolor_a_black_node_in_RBT_after_deleting_a_black_node(parent_of_node->parent);
+            nephew_node_in_same_side->color = black;
+            sibling_node->color = red;
+            sibling_node = rotate_an_RB_node(RB_tree, sibling_node, side);
+            nephew_node_in_another_side = sibling_node->next[!side];
         }
+        sibling_node->color = parent_of_node->color;
+        parent_of_node->color = black;
+        nephew_node_in_another_side->color = black;
+        rotate_an_RB_node(RB_tree, parent_of_node, !side);
+        return sibling_node;
     }
-    return parent_of_node;
+    return NULL;
 }
 
-int delete_a_key_and_fill_from_left_subtree_in_RBT(struct RB_node **RB_tree, int64_t key)
+static int delete_a_key_and_fill_from_one_subtree_in_RBT(struct RB_node **RB_tree, int64_t key, _Bool filling_side)
 {
     struct RB_node *cur = look_up_a_key_in_RBT(RB_tree, key);
     if (!cur) return -1;
-    struct RB_node *previous_of_cur = cur->parent;
-    _Bool deleted_color = cur->color;
-    if (cur->next[left] == NULL && cur->next[right] == NULL)
+    /* use the closest node in the filling subtree of the current node to replace the current node */
+    if (cur->next[left] != NULL && cur->next[right] != NULL)
     {
-        struct RB_node *tmp = cur;
-        cur = NULL, free(tmp);
+        struct RB_node *closest_node = cur->next[filling_side];
+        side = filling_side;
+        while (closest_node->next[!filling_side])
+        {
+            closest_node = closest_node->next[!filling_side];
+            side = !filling_side;
+        }
+        cur->node_id = closest_node->node_id;
+        cur = closest_node;
     }
-    /* use the maximal node in left subtree of the current node to replace the current node */
-    else if (cur->next[left] != NULL && cur->next[right] != NULL)
+    else if (cur->parent) side = (cur->parent->next[right] == cur);
+    struct RB_node *previous_of_cur = cur->parent;
+    _Bool deleted_color = cur->color;
+    struct RB_node *child_node = delete_a_node_with_one_child_in_BST(RB_tree, cur);
+    for (struct RB_node *ancestor = previous_of_cur; ancestor; ancestor = ancestor->parent)
+        ancestor->size--;
+    if (deleted_color == black)
     {
-        struct RB_node *max_in_left_subtree = cur->next[left];
-        while (max_in_left_subtree->next[right])
-            max_in_left_subtree = max_in_left_subtree->next[right];
-        cur->node_id = max_in_left_subtree->node_id;
-        cur = max_in_left_subtree;
-        previous_of_cur = max_in_left_subtree->parent;
-        deleted_color = max_in_left_subtree->color;
-        side = right;
-        cur = delete_a_node_with_one_child_in_BST(cur);
+        if (!is_a_black_RB_node(child_node))
+            child_node->color = black;
+        else balance_and_recolor_a_black_node_in_RBT_after_deleting_a_black_node(RB_tree, previous_of_cur);
     }
-    else cur = delete_a_node_with_one_child_in_BST(cur);
-    if (deleted_color == red);
-    else if (deleted_color == black && cur->color == red)
-        cur->color = black;
-    else previous_of_cur = balance_and_recolor_a_black_node_in_RBT_after_deleting_a_black_node(previous_of_cur);
     printf("delete key value %" PRId64" successfully.\n", key);
     return 0;
 }
 
+int delete_a_key_and_fill_from_left_subtree_in_RBT(struct RB_node **RB_tree, int64_t key)
+{
+    return delete_a_key_and_fill_from_one_subtree_in_RBT(RB_tree, key, left);
+}
+
 int delete_a_key_and_fill_from_right_subtree_in_RBT(struct RB_node **RB_tree, int64_t key)
 {
-    struct RB_node *cur = look_up_a_key_in_RBT(RB_tree, key);
-    if (!cur) return -1;
-    struct RB_node *previous_of_cur = cur->parent;
-    _Bool deleted_color = cur->color;
-    if (cur->next[left] == NULL && cur->next[right] == NULL)
+    return delete_a_key_and_fill_from_one_subtree_in_RBT(RB_tree, key, right);
+}
+
+/* return the node with rank keys less than its own, counting from 0, or
+NULL if the tree has no more than rank keys */
+struct RB_node* select_a_key_in_RBT(struct RB_node **const RB_tree, int32_t rank)
+{
+    struct RB_node *cur = *RB_tree;
+    if (rank < 0 || rank >= size_of_an_RB_subtree(cur))
     {
-        struct RB_node *tmp = cur;
-        cur = NULL, free(tmp);
+        fprintf(stderr, "no key of rank %" PRId32" in red black tree!\n", rank);
+        return NULL;
     }
-    /* use the minimal node in right subtree of the current node to replace the current node */
-    else if (cur->next[left] != NULL && cur->next[right] != NULL)
+    while (rank != size_of_an_RB_subtree(cur->next[left]))
     {
-        struct RB_node *min_in_right_subtree = cur->next[right];
-        while (min_in_right_subtree->next[left])
-            min_in_right_subtree = min_in_right_subtree->next[left];
-        cur->node_id = min_in_right_subtree->node_id;
-        cur = min_in_right_subtree;
-        previous_of_cur = min_in_right_subtree->parent;
-        deleted_color = min_in_right_subtree->color;
-        side = left;
-        cur = delete_a_node_with_one_child_in_BST(cur);
+        if (rank < size_of_an_RB_subtree(cur->next[left]))
+            cur = cur->next[left];
+        else
+        {
+            rank -= size_of_an_RB_subtree(cur->next[left]) + 1;
+            cur = cur->next[right];
+        }
     }
-    else cur = delete_a_node_with_one_child_in_BST(cur);
-    if (deleted_color == red);
-    else if (deleted_color == black && cur->color == red)
-        cur->color = black;
-    else previous_of_cur = balance_and_recolor_a_black_node_in_RBT_after_deleting_a_black_node(previous_of_cur);
-    printf("delete key value %" PRId64" successfully.\n", key);
-    return 0;
-}
\ No newline at end of file
+    return cur;
+}
+
+/* the number of keys less than key, or not greater than key if
+including_key is set. key itself need not be in the tree. */
+static int32_t count_keys_below_in_RBT(struct RB_node *cur, int64_t key, _Bool including_key)
+{
+    int32_t count = 0;
+    while (cur)
+    {
+        if (cur->node_id < key || (including_key && cur->node_id == key))
+        {
+            count += size_of_an_RB_subtree(cur->next[left]) + 1;
+            cur = cur->next[right];
+        }
+        else cur = cur->next[left];
+    }
+    return count;
+}
+
+/* the number of keys less than key, which is the rank of key if it is in
+the tree */
+int32_t rank_of_a_key_in_RBT(struct RB_node **const RB_tree, int64_t key)
+{
+    return count_keys_below_in_RBT(*RB_tree, key, 0);
+}
+
+/* the number of keys in [lower, upper] */
+int32_t count_keys_in_a_range_in_RBT(struct RB_node **const RB_tree, int64_t lower, int64_t upper)
+{
+    if (lower > upper) return 0;
+    return count_keys_below_in_RBT(*RB_tree, upper, 1) - count_keys_below_in_RBT(*RB_tree, lower, 0);
+}
+
+/* the keys one inorder_trav_to_RBT() call hands to its visitor at a time */
+#define RB_TRAV_BATCH 256
+
+/* hand every key of the red black tree in increasing order to visitor,
+RB_TRAV_BATCH keys at a time. It climbs back through the parent pointers,
+so it needs no stack. A visitor which returns non-zero stops the traversal,
+and that value is returned; otherwise return 0. */
+int inorder_trav_to_RBT(struct RB_node **const RB_tree,
+int (*visitor)(const int64_t *key, int32_t key_number, void *arg), void *arg)
+{
+    int64_t key_buf[RB_TRAV_BATCH];
+    int32_t copied = 0;
+    int state = 0;
+    struct RB_node *cur = *RB_tree;
+    if (cur) while (cur->next[left]) cur = cur->next[left];
+    while (state == 0 && cur)
+    {
+        key_buf[copied++] = cur->node_id;
+        if (copied == RB_TRAV_BATCH)
+            state = visitor(key_buf, copied, arg), copied = 0;
+        /* the successor is the leftmost node of the right subtree, or the
+        first ancestor which cur lies on the left of */
+        if (cur->next[right])
+        {
+            cur = cur->next[right];
+            while (cur->next[left]) cur = cur->next[left];
+        }
+        else
+        {
+            while (cur->parent && cur->parent->next[right] == cur) cur = cur->parent;
+            cur = cur->parent;
+        }
+    }
+    if (state == 0 && copied) state = visitor(key_buf, copied, arg);
+    return state;
+}
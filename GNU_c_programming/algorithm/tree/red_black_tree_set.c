@@ -0,0 +1,352 @@
+#pragma once
+#include <pthread.h>
+#include "red_black_tree.c"
+/* split and join of red black trees, and the union, intersection and
+difference built on them. join() links two trees and a middle node in
+O(|difference of black heights|), and every set operation splits one tree by
+the root of the other, recurses on both halves and joins the results, which
+costs O(m log(n/m + 1)) for trees of m <= n nodes. The two recursive calls
+touch disjoint subtrees, so the top RB_SET_FORK_DEPTH levels of an operation
+on two trees of at least RB_SET_FORK_SIZE nodes run the left one on another
+thread. join() and split() keep the subtree sizes up to date.
+
+Every tree passed around here is detached (its root has no parent) and has a
+black root, and its black height, the number of black nodes on any path from
+the root down to a leaf, travels along with it. */
+#define RB_SET_FORK_DEPTH 3
+#define RB_SET_FORK_SIZE 4096
+
+enum RB_set_operation {RB_union, RB_intersection, RB_difference};
+
+struct RB_set_task {
+    enum RB_set_operation operation;
+    struct RB_node *tree1, *tree2;
+    int32_t height1, height2, depth;
+    struct RB_node *result;
+    int32_t result_height;};
+
+static int32_t black_height_of_RBT(struct RB_node *root)
+{
+    int32_t height = 0;
+    for (; root; root = root->next[left])
+        height += (root->color == black);
+    return height;
+}
+
+/* make a subtree of node a detached tree with a black root, and return its
+black height. node is black and has black height node_height. */
+static int32_t detach_an_RB_subtree(struct RB_node *subtree, int32_t node_height)
+{
+    if (subtree == NULL) return 0;
+    subtree->parent = NULL;
+    if (subtree->color == black) return node_height - 1;
+    subtree->color = black;
+    return node_height;
+}
+
+/* hang middle, painted red, on the spine of taller on spine_side where the
+black height equals that of shorter, with shorter on its spine_side. */
+static struct RB_node *join_RB_trees_on_one_side(struct RB_node *taller, int32_t taller_height,
+struct RB_node *middle, struct RB_node *shorter, int32_t shorter_height, _Bool spine_side, int32_t *height)
+{
+    struct RB_node *cur = taller, *parent_of_cur = NULL;
+    int32_t cur_height = taller_height;
+    while (cur_height != shorter_height || !is_a_black_RB_node(cur))
+    {
+        cur_height -= (cur->color == black);
+        parent_of_cur = cur;
+        cur = cur->next[spine_side];
+    }
+    middle->next[!spine_side] = cur, middle->next[spine_side] = shorter;
+    middle->parent = parent_of_cur, middle->color = red;
+    if (cur) cur->parent = middle;
+    if (shorter) shorter->parent = middle;
+    parent_of_cur->next[spine_side] = middle;
+    middle->size = size_of_an_RB_subtree(cur) + size_of_an_RB_subtree(shorter) + 1;
+    for (; parent_of_cur; parent_of_cur = parent_of_cur->parent)
+        parent_of_cur->size += size_of_an_RB_subtree(shorter) + 1;
+    *height = taller_height + recolor_RBT_after_linking_a_red_node(&taller, middle);
+    return taller;
+}
+
+/* every key of left_tree < middle->node_id < every key of right_tree */
+static struct RB_node *join_RB_trees_with_heights(struct RB_node *left_tree, int32_t left_height,
+struct RB_node *middle, struct RB_node *right_tree, int32_t right_height, int32_t *height)
+{
+    if (left_height > right_height)
+        return join_RB_trees_on_one_side(left_tree, left_height, middle, right_tree, right_height, right, height);
+    if (left_height < right_height)
+        return join_RB_trees_on_one_side(right_tree, right_height, middle, left_tree, left_height, left, height);
+    middle->next[left] = left_tree, middle->next[right] = right_tree;
+    middle->parent = NULL, middle->color = black;
+    if (left_tree) left_tree->parent = middle;
+    if (right_tree) right_tree->parent = middle;
+    middle->size = size_of_an_RB_subtree(left_tree) + size_of_an_RB_subtree(right_tree) + 1;
+    *height = left_height + 1;
+    return middle;
+}
+
+/* split tree into the keys less than key and those greater than it. Return
+the detached node with key, or NULL if there is none. */
+static struct RB_node *split_RBT_with_heights(struct RB_node *tree, int32_t tree_height, int64_t key,
+struct RB_node **left_tree, int32_t *left_height, struct RB_node **right_tree, int32_t *right_height)
+{
+    if (tree == NULL)
+    {
+        *left_tree = *right_tree = NULL;
+        *left_height = *right_height = 0;
+        return NULL;
+    }
+    struct RB_node *left_child = tree->next[left], *right_child = tree->next[right];
+    int32_t left_child_height = detach_an_RB_subtree(left_child, tree_height);
+    int32_t right_child_height = detach_an_RB_subtree(right_child, tree_height);
+    struct RB_node *found_node;
+    if (key == tree->node_id)
+    {
+        *left_tree = left_child, *left_height = left_child_height;
+        *right_tree = right_child, *right_height = right_child_height;
+        tree->next[left] = tree->next[right] = NULL;
+        tree->size = 1;
+        return tree;
+    }
+    if (key < tree->node_id)
+    {
+        struct RB_node *rest;
+        int32_t rest_height;
+        found_node = split_RBT_with_heights(left_child, left_child_height, key,
+        left_tree, left_height, &rest, &rest_height);
+        *right_tree = join_RB_trees_with_heights(rest, rest_height, tree,
+        right_child, right_child_height, right_height);
+    }
+    else
+    {
+        struct RB_node *rest;
+        int32_t rest_height;
+        found_node = split_RBT_with_heights(right_child, right_child_height, key,
+        &rest, &rest_height, right_tree, right_height);
+        *left_tree = join_RB_trees_with_heights(left_child, left_child_height, tree,
+        rest, rest_height, left_height);
+    }
+    return found_node;
+}
+
+/* detach the node with the greatest key of a non-empty tree into *last_node */
+static struct RB_node *split_the_last_node_of_RBT(struct RB_node *tree, int32_t tree_height,
+struct RB_node **last_node, int32_t *height)
+{
+    struct RB_node *left_child = tree->next[left], *right_child = tree->next[right];
+    int32_t left_child_height = detach_an_RB_subtree(left_child, tree_height);
+    if (right_child == NULL)
+    {
+        tree->next[left] = NULL, tree->size = 1;
+        *last_node = tree, *height = left_child_height;
+        return left_child;
+    }
+    int32_t right_child_height = detach_an_RB_subtree(right_child, tree_height);
+    right_child = split_the_last_node_of_RBT(right_child, right_child_height, last_node, &right_child_height);
+    return join_RB_trees_with_heights(left_child, left_child_height, tree,
+    right_child, right_child_height, height);
+}
+
+/* join two trees without a middle node */
+static struct RB_node *join_RB_trees_without_a_middle_node(struct RB_node *left_tree, int32_t left_height,
+struct RB_node *right_tree, int32_t right_height, int32_t *height)
+{
+    if (left_tree == NULL) return *height = right_height, right_tree;
+    if (right_tree == NULL) return *height = left_height, left_tree;
+    struct RB_node *middle;
+    left_tree = split_the_last_node_of_RBT(left_tree, left_height, &middle, &left_height);
+    return join_RB_trees_with_heights(left_tree, left_height, middle, right_tree, right_height, height);
+}
+
+static void free_all_nodes_in_an_RB_subtree(struct RB_node *node)
+{
+    /* rotate left children up until there is none, then free and go right */
+    while (node)
+    {
+        struct RB_node *left_child = node->next[left];
+        if (left_child)
+        {
+            node->next[left] = left_child->next[right];
+            left_child->next[right] = node;
+            node = left_child;
+            continue;
+        }
+        struct RB_node *right_child = node->next[right];
+        free_an_RB_node(node);
+        node = right_child;
+    }
+    return;
+}
+
+static void run_an_RB_set_task(struct RB_set_task *task);
+
+static void *run_an_RB_set_task_on_a_thread(void *task)
+{
+    run_an_RB_set_task((struct RB_set_task *)task);
+    return NULL;
+}
+
+/* run the two halves of a task, the first one on a new thread if the task is
+near the top and both of its trees are large */
+static void run_two_RB_set_tasks(struct RB_set_task *first, struct RB_set_task *second)
+{
+    pthread_t thread;
+    _Bool forked = first->depth <= RB_SET_FORK_DEPTH
+    && size_of_an_RB_subtree(first->tree1) >= RB_SET_FORK_SIZE
+    && size_of_an_RB_subtree(first->tree2) >= RB_SET_FORK_SIZE
+    && pthread_create(&thread, NULL, run_an_RB_set_task_on_a_thread, first) == 0;
+    /* without a thread the work still gets done on this one */
+    if (!forked) run_an_RB_set_task(first);
+    run_an_RB_set_task(second);
+    if (forked && pthread_join(thread, NULL))
+        perror("fail to join a set operation thread"), exit(EXIT_FAILURE);
+    return;
+}
+
+static void run_an_RB_set_task(struct RB_set_task *task)
+{
+    struct RB_node *tree1 = task->tree1, *tree2 = task->tree2;
+    if (tree1 == NULL || tree2 == NULL)
+    {
+        if (task->operation == RB_intersection)
+        {
+            free_all_nodes_in_an_RB_subtree(tree1 ? tree1 : tree2);
+            task->result = NULL, task->result_height = 0;
+        }
+        else if (task->operation == RB_difference)
+        {
+            free_all_nodes_in_an_RB_subtree(tree2);
+            task->result = tree1, task->result_height = task->height1;
+        }
+        else if (tree1) task->result = tree1, task->result_height = task->height1;
+        else task->result = tree2, task->result_height = task->height2;
+        return;
+    }
+    /* split the tree the result does not build on by the root of the other */
+    struct RB_node *root = (task->operation == RB_difference) ? tree2 : tree1;
+    struct RB_node *other = (task->operation == RB_difference) ? tree1 : tree2;
+    int32_t root_height = (task->operation == RB_difference) ? task->height2 : task->height1;
+    int32_t other_height = (task->operation == RB_difference) ? task->height1 : task->height2;
+    struct RB_node *left_child = root->next[left], *right_child = root->next[right];
+    int32_t left_child_height = detach_an_RB_subtree(left_child, root_height);
+    int32_t right_child_height = detach_an_RB_subtree(right_child, root_height);
+    struct RB_set_task half[2] = {{.operation = task->operation, .depth = task->depth + 1},
+    {.operation = task->operation, .depth = task->depth + 1}};
+    struct RB_node *other_half[2];
+    int32_t other_half_height[2];
+    struct RB_node *found_node = split_RBT_with_heights(other, other_height, root->node_id,
+    &other_half[left], &other_half_height[left], &other_half[right], &other_half_height[right]);
+    if (task->operation == RB_difference)
+    {
+        half[left].tree1 = other_half[left], half[left].height1 = other_half_height[left];
+        half[left].tree2 = left_child, half[left].height2 = left_child_height;
+        half[right].tree1 = other_half[right], half[right].height1 = other_half_height[right];
+        half[right].tree2 = right_child, half[right].height2 = right_child_height;
+    }
+    else
+    {
+        half[left].tree1 = left_child, half[left].height1 = left_child_height;
+        half[left].tree2 = other_half[left], half[left].height2 = other_half_height[left];
+        half[right].tree1 = right_child, half[right].height1 = right_child_height;
+        half[right].tree2 = other_half[right], half[right].height2 = other_half_height[right];
+    }
+    run_two_RB_set_tasks(&half[left], &half[right]);
+    /* the root stays as the middle node for a union, and for an intersection
+    if the other tree had its key */
+    _Bool root_stays = task->operation == RB_union || (task->operation == RB_intersection && found_node);
+    if (found_node) free_an_RB_node(found_node);
+    if (root_stays)
+        task->result = join_RB_trees_with_heights(half[left].result, half[left].result_height, root,
+        half[right].result, half[right].result_height, &task->result_height);
+    else
+    {
+        free_an_RB_node(root);
+        task->result = join_RB_trees_without_a_middle_node(half[left].result, half[left].result_height,
+        half[right].result, half[right].result_height, &task->result_height);
+    }
+    return;
+}
+
+static void run_an_RB_set_operation(struct RB_node **RB_tree, struct RB_node **other_tree,
+enum RB_set_operation operation)
+{
+    struct RB_set_task task = {.operation = operation, .tree1 = *RB_tree, .tree2 = *other_tree};
+    if (task.tree1) task.tree1->color = black;
+    if (task.tree2) task.tree2->color = black;
+    task.height1 = black_height_of_RBT(task.tree1);
+    task.height2 = black_height_of_RBT(task.tree2);
+    run_an_RB_set_task(&task);
+    *RB_tree = task.result, *other_tree = NULL;
+    return;
+}
+
+/* *RB_tree becomes the union of both trees and *other_tree becomes empty.
+The nodes of *other_tree either move into *RB_tree or are freed. */
+void union_RB_trees(struct RB_node **RB_tree, struct RB_node **other_tree)
+{
+    run_an_RB_set_operation(RB_tree, other_tree, RB_union);
+    return;
+}
+
+/* *RB_tree keeps only the keys also in *other_tree, which becomes empty */
+void intersect_RB_trees(struct RB_node **RB_tree, struct RB_node **other_tree)
+{
+    run_an_RB_set_operation(RB_tree, other_tree, RB_intersection);
+    return;
+}
+
+/* *RB_tree loses every key in *other_tree, which becomes empty */
+void subtract_RB_trees(struct RB_node **RB_tree, struct RB_node **other_tree)
+{
+    run_an_RB_set_operation(RB_tree, other_tree, RB_difference);
+    return;
+}
+
+/* move the keys of *RB_tree less than key into *left_tree and those greater
+into *right_tree, and empty *RB_tree. Return 0 if key was in the tree, whose
+node is then freed, or -1 if not. */
+int split_RBT(struct RB_node **RB_tree, int64_t key, struct RB_node **left_tree, struct RB_node **right_tree)
+{
+    int32_t left_height, right_height;
+    if (*RB_tree) (*RB_tree)->color = black;
+    struct RB_node *found_node = split_RBT_with_heights(*RB_tree, black_height_of_RBT(*RB_tree), key,
+    left_tree, &left_height, right_tree, &right_height);
+    *RB_tree = NULL;
+    if (found_node == NULL) return -1;
+    free_an_RB_node(found_node);
+    return 0;
+}
+
+/* link *RB_tree, a new node with middle_key and *right_tree into *RB_tree
+and empty *right_tree. Every key of *RB_tree has to be less than middle_key,
+and every key of *right_tree greater; otherwise return -1 and change nothing. */
+int join_RB_trees(struct RB_node **RB_tree, int64_t middle_key, struct RB_node **right_tree)
+{
+    struct RB_node *cur;
+    for (cur = *RB_tree; cur && cur->next[right]; cur = cur->next[right]);
+    if (cur && cur->node_id >= middle_key)
+    {
+        fprintf(stderr, "join failed. Key %" PRId64" in the left tree is not less than %" PRId64".\n",
+        cur->node_id, middle_key);
+        return -1;
+    }
+    for (cur = *right_tree; cur && cur->next[left]; cur = cur->next[left]);
+    if (cur && cur->node_id <= middle_key)
+    {
+        fprintf(stderr, "join failed. Key %" PRId64" in the right tree is not greater than %" PRId64".\n",
+        cur->node_id, middle_key);
+        return -1;
+    }
+    /* the middle node joins the pool of either tree */
+    struct RB_node *middle = alloc_a_new_RB_node(*RB_tree ? node_pool_of_an_RBT(RB_tree)
+    : node_pool_of_an_RBT(right_tree));
+    middle->node_id = middle_key;
+    if (*RB_tree) (*RB_tree)->color = black;
+    if (*right_tree) (*right_tree)->color = black;
+    int32_t height;
+    *RB_tree = join_RB_trees_with_heights(*RB_tree, black_height_of_RBT(*RB_tree), middle,
+    *right_tree, black_height_of_RBT(*right_tree), &height);
+    *right_tree = NULL;
+    return 0;
+}
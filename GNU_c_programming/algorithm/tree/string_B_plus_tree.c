@@ -0,0 +1,518 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <inttypes.h>
+/* a B plus tree for variable-length byte-string keys. A node is one page of
+STRING_B_PLUS_NODE_SIZE bytes: the entries grow up from the header and the
+key bytes grow down from the end, so how many keys a node holds depends on
+their bytes. With compression on:
+- every node stores the longest common prefix of its keys once, and each
+  entry only the suffix after it (prefix compression);
+- a split pushes up the shortest string which separates the two halves,
+  not the whole first key of the right half (suffix truncation).
+In an internal node, child[i] holds the keys from key[i] up to key[i + 1],
+and key[0] is empty and never compared. */
+#define STRING_B_PLUS_NODE_SIZE 4096
+#define STRING_B_PLUS_KEY_MAX_LEN 512
+#define STRING_B_PLUS_MAX_HEIGHT 16
+
+struct string_B_plus_node;
+struct string_B_plus_entry {
+    union {
+        struct string_B_plus_node *child;
+        uint64_t value;};
+    /* the suffix of the key after the node prefix */
+    uint16_t offset;
+    uint16_t len;};
+
+struct string_B_plus_node {
+    int16_t last_index;
+    _Bool isleaf;
+    uint16_t prefix_offset, prefix_len;
+    /* the key bytes live in [heap_start, STRING_B_PLUS_NODE_SIZE) */
+    uint16_t heap_start;
+    /* the bytes of the prefix and of the suffixes still in use */
+    uint16_t key_bytes;
+    struct string_B_plus_node *sibling;
+    struct string_B_plus_entry entry[];};
+
+#define STRING_B_PLUS_MAX_ENTRIES ((STRING_B_PLUS_NODE_SIZE - sizeof(struct string_B_plus_node)) \
+/ sizeof(struct string_B_plus_entry))
+
+/* an entry with its whole key, while a node is rebuilt or split */
+struct string_B_plus_item {
+    union {
+        struct string_B_plus_node *child;
+        uint64_t value;};
+    uint16_t len;
+    unsigned char key[STRING_B_PLUS_KEY_MAX_LEN];};
+
+struct string_B_plus_tree {
+    struct string_B_plus_node *root;
+    /* 0 stores whole keys, for comparison with the compressed layout */
+    _Bool compress;
+    /* the entries of the node being rebuilt, and one more */
+    struct string_B_plus_item *scratch;};
+
+struct string_B_plus_path {
+    int8_t top;
+    struct string_B_plus_node *node_stack[STRING_B_PLUS_MAX_HEIGHT];
+    int16_t pos_stack[STRING_B_PLUS_MAX_HEIGHT];};
+
+struct string_B_plus_tree *init_string_B_plus_tree(_Bool compress)
+{
+    struct string_B_plus_tree *tree = (struct string_B_plus_tree *)malloc(sizeof(struct string_B_plus_tree));
+    if (tree == NULL)
+        perror("fail to allocate a string B plus tree"), exit(EXIT_FAILURE);
+    tree->scratch = (struct string_B_plus_item *)malloc((STRING_B_PLUS_MAX_ENTRIES + 2)
+    * sizeof(struct string_B_plus_item));
+    if (tree->scratch == NULL)
+        perror("fail to allocate the scratch entries"), exit(EXIT_FAILURE);
+    tree->root = NULL;
+    tree->compress = compress;
+    return tree;
+}
+
+static struct string_B_plus_node *alloc_a_new_string_B_plus_node(_Bool isleaf)
+{
+    struct string_B_plus_node *node = (struct string_B_plus_node *)aligned_alloc(64, STRING_B_PLUS_NODE_SIZE);
+    if (node == NULL)
+        perror("fail to allocate a string B plus node"), exit(EXIT_FAILURE);
+    node->last_index = -1;
+    node->isleaf = isleaf;
+    node->prefix_offset = STRING_B_PLUS_NODE_SIZE, node->prefix_len = 0;
+    node->heap_start = STRING_B_PLUS_NODE_SIZE, node->key_bytes = 0;
+    node->sibling = NULL;
+    return node;
+}
+
+static unsigned char *bytes_in_a_string_B_plus_node(struct string_B_plus_node *node, uint16_t offset)
+{
+    return (unsigned char *)node + offset;
+}
+
+static size_t free_bytes_in_a_string_B_plus_node(struct string_B_plus_node *node)
+{
+    return node->heap_start - offsetof(struct string_B_plus_node, entry)
+    - (node->last_index + 1) * sizeof(struct string_B_plus_entry);
+}
+
+static size_t used_bytes_in_a_string_B_plus_node(struct string_B_plus_node *node)
+{
+    return offsetof(struct string_B_plus_node, entry)
+    + (node->last_index + 1) * sizeof(struct string_B_plus_entry) + node->key_bytes;
+}
+
+/* memcmp() order, and a proper prefix is the smaller one */
+static int compare_two_byte_strings(const unsigned char *a, size_t a_len, const unsigned char *b, size_t b_len)
+{
+    int cmp = memcmp(a, b, a_len < b_len ? a_len : b_len);
+    if (cmp) return cmp;
+    return (a_len > b_len) - (a_len < b_len);
+}
+
+/* the first pos whose key is not less than key, and whether it is equal.
+key[0] of an internal node is skipped. */
+static int16_t look_up_a_key_pos_in_a_string_B_plus_node(struct string_B_plus_node *node,
+const unsigned char *key, size_t len, _Bool *equal)
+{
+    int16_t left = node->isleaf ? 0 : 1, right = node->last_index;
+    *equal = 0;
+    /* the prefix is compared once for the whole node */
+    size_t compared = len < node->prefix_len ? len : node->prefix_len;
+    int cmp = memcmp(key, bytes_in_a_string_B_plus_node(node, node->prefix_offset), compared);
+    if (cmp < 0 || (cmp == 0 && len < node->prefix_len)) return left;
+    if (cmp > 0) return right + 1;
+    key += node->prefix_len, len -= node->prefix_len;
+    while (left <= right)
+    {
+        int16_t middle = left + ((right - left) >> 1);
+        struct string_B_plus_entry *entry = &node->entry[middle];
+        cmp = compare_two_byte_strings(key, len, bytes_in_a_string_B_plus_node(node, entry->offset), entry->len);
+        if (cmp == 0)
+        {
+            *equal = 1;
+            return middle;
+        }
+        else if (cmp < 0)
+            right = middle - 1;
+        else left = middle + 1;
+    }
+    return left;
+}
+
+/* the child whose range holds key */
+static int16_t look_up_a_child_pos_in_a_string_B_plus_node(struct string_B_plus_node *node,
+const unsigned char *key, size_t len)
+{
+    _Bool equal;
+    int16_t pos = look_up_a_key_pos_in_a_string_B_plus_node(node, key, len, &equal);
+    return equal ? pos : pos - 1;
+}
+
+/* return 0 and the value of key through value, or -1 if absent. */
+int look_up_a_key_in_string_B_plus_tree(struct string_B_plus_tree *tree, const void *key, size_t len,
+uint64_t *value)
+{
+    struct string_B_plus_node *cur = tree->root;
+    if (cur == NULL) return -1;
+    while (!cur->isleaf)
+        cur = cur->entry[look_up_a_child_pos_in_a_string_B_plus_node(cur, key, len)].child;
+    _Bool equal;
+    int16_t pos = look_up_a_key_pos_in_a_string_B_plus_node(cur, key, len, &equal);
+    if (!equal) return -1;
+    if (value) *value = cur->entry[pos].value;
+    return 0;
+}
+
+/* copy the whole key of entry pos of node into item */
+static void take_a_key_out_of_a_string_B_plus_node(struct string_B_plus_node *node, int16_t pos,
+struct string_B_plus_item *item)
+{
+    struct string_B_plus_entry *entry = &node->entry[pos];
+    memcpy(item->key, bytes_in_a_string_B_plus_node(node, node->prefix_offset), node->prefix_len);
+    memcpy(item->key + node->prefix_len, bytes_in_a_string_B_plus_node(node, entry->offset), entry->len);
+    item->len = node->prefix_len + entry->len;
+    return;
+}
+
+/* copy the entries of node with their whole keys into item */
+static int16_t take_items_out_of_a_string_B_plus_node(struct string_B_plus_node *node,
+struct string_B_plus_item *item)
+{
+    for (int16_t i = 0; i <= node->last_index; i++)
+    {
+        item[i].value = node->entry[i].value;
+        if (!node->isleaf && i == 0)
+            item[i].len = 0;
+        else take_a_key_out_of_a_string_B_plus_node(node, i, &item[i]);
+    }
+    return node->last_index + 1;
+}
+
+/* the keys are sorted, so the first and the last share the prefix of all */
+static uint16_t common_prefix_of_string_B_plus_items(struct string_B_plus_item *item, int16_t first, int16_t last)
+{
+    if (first > last) return 0;
+    uint16_t len = 0;
+    while (len < item[first].len && len < item[last].len && item[first].key[len] == item[last].key[len])
+        len++;
+    return len;
+}
+
+static size_t bytes_to_build_a_string_B_plus_node(struct string_B_plus_tree *tree,
+struct string_B_plus_item *item, int16_t item_number, _Bool isleaf)
+{
+    int16_t first = isleaf ? 0 : 1;
+    uint16_t prefix_len = tree->compress ? common_prefix_of_string_B_plus_items(item, first, item_number - 1) : 0;
+    size_t bytes = offsetof(struct string_B_plus_node, entry)
+    + item_number * sizeof(struct string_B_plus_entry) + prefix_len;
+    for (int16_t i = first; i < item_number; i++)
+        bytes += item[i].len - prefix_len;
+    return bytes;
+}
+
+/* lay item out in node anew, which drops the bytes of deleted keys. The
+items have to fit, see bytes_to_build_a_string_B_plus_node(). */
+static void build_a_string_B_plus_node(struct string_B_plus_tree *tree, struct string_B_plus_node *node,
+struct string_B_plus_item *item, int16_t item_number)
+{
+    int16_t first = node->isleaf ? 0 : 1;
+    uint16_t prefix_len = tree->compress ? common_prefix_of_string_B_plus_items(item, first, item_number - 1) : 0;
+    node->heap_start = STRING_B_PLUS_NODE_SIZE - prefix_len;
+    node->prefix_offset = node->heap_start, node->prefix_len = prefix_len;
+    if (prefix_len) memcpy(bytes_in_a_string_B_plus_node(node, node->heap_start), item[first].key, prefix_len);
+    for (int16_t i = 0; i < item_number; i++)
+    {
+        uint16_t suffix_len = (i < first) ? 0 : item[i].len - prefix_len;
+        node->heap_start -= suffix_len;
+        memcpy(bytes_in_a_string_B_plus_node(node, node->heap_start), item[i].key + prefix_len, suffix_len);
+        node->entry[i].value = item[i].value;
+        node->entry[i].offset = node->heap_start;
+        node->entry[i].len = suffix_len;
+    }
+    node->last_index = item_number - 1;
+    node->key_bytes = STRING_B_PLUS_NODE_SIZE - node->heap_start;
+    return;
+}
+
+/* put item at pos without rebuilding node. Return -1 if its key does not
+start with the node prefix or there is no room. */
+static int insert_an_item_in_a_string_B_plus_node_in_place(struct string_B_plus_node *node, int16_t pos,
+const struct string_B_plus_item *item)
+{
+    if (item->len < node->prefix_len
+    || memcmp(item->key, bytes_in_a_string_B_plus_node(node, node->prefix_offset), node->prefix_len))
+        return -1;
+    uint16_t suffix_len = item->len - node->prefix_len;
+    if (free_bytes_in_a_string_B_plus_node(node) < sizeof(struct string_B_plus_entry) + suffix_len)
+        return -1;
+    memmove(&node->entry[pos + 1], &node->entry[pos], (node->last_index - pos + 1) * sizeof(struct string_B_plus_entry));
+    node->heap_start -= suffix_len;
+    memcpy(bytes_in_a_string_B_plus_node(node, node->heap_start), item->key + node->prefix_len, suffix_len);
+    node->entry[pos].value = item->value;
+    node->entry[pos].offset = node->heap_start;
+    node->entry[pos].len = suffix_len;
+    node->key_bytes += suffix_len;
+    node->last_index++;
+    return 0;
+}
+
+static void delete_an_entry_in_a_string_B_plus_node(struct string_B_plus_node *node, int16_t pos)
+{
+    node->key_bytes -= node->entry[pos].len;
+    memmove(&node->entry[pos], &node->entry[pos + 1], (node->last_index - pos) * sizeof(struct string_B_plus_entry));
+    node->last_index--;
+    return;
+}
+
+/* the shortest string above left and not above right, where left < right */
+static void shortest_separator_of_two_string_B_plus_items(struct string_B_plus_item *separator,
+const struct string_B_plus_item *left, const struct string_B_plus_item *right)
+{
+    uint16_t len = 0;
+    while (len < left->len && left->key[len] == right->key[len])
+        len++;
+    separator->len = len + 1;
+    memcpy(separator->key, right->key, separator->len);
+    return;
+}
+
+/* split the items of a node in two by their bytes. A leaf then looks around
+the middle for the split whose separator is the shortest. */
+static int16_t choose_a_split_pos_of_string_B_plus_items(struct string_B_plus_tree *tree,
+struct string_B_plus_item *item, int16_t item_number, _Bool isleaf)
+{
+    uint16_t prefix_len = common_prefix_of_string_B_plus_items(item, isleaf ? 0 : 1, item_number - 1);
+    size_t total_bytes = 0, bytes = 0;
+    for (int16_t i = 0; i < item_number; i++)
+        total_bytes += sizeof(struct string_B_plus_entry) + (item[i].len > prefix_len ? item[i].len - prefix_len : 0);
+    int16_t split_pos = 1;
+    while (split_pos < item_number - 1)
+    {
+        bytes += sizeof(struct string_B_plus_entry) + (item[split_pos - 1].len > prefix_len ? item[split_pos - 1].len - prefix_len : 0);
+        if (bytes >= total_bytes >> 1) break;
+        split_pos++;
+    }
+    /* an internal split moves key[split_pos] up, so both halves keep a child */
+    if (!isleaf || !tree->compress) return split_pos;
+    int16_t window = item_number >> 4, best_pos = split_pos;
+    uint16_t best_len = UINT16_MAX;
+    for (int16_t i = split_pos - window; i <= split_pos + window; i++)
+    {
+        if (i < 1 || i > item_number - 1) continue;
+        uint16_t len = 0;
+        while (len < item[i - 1].len && item[i - 1].key[len] == item[i].key[len])
+            len++;
+        if (len < best_len) best_len = len, best_pos = i;
+    }
+    /* both halves still have to fit */
+    if (bytes_to_build_a_string_B_plus_node(tree, item, best_pos, isleaf) > STRING_B_PLUS_NODE_SIZE
+    || bytes_to_build_a_string_B_plus_node(tree, item + best_pos, item_number - best_pos, isleaf) > STRING_B_PLUS_NODE_SIZE)
+        return split_pos;
+    return best_pos;
+}
+
+/* insert item at pos of node, and rebuild or split node when it does not fit.
+Return 1 if node split; separator then holds the key and the new right node
+which the parent has to take in. */
+static int insert_an_item_in_a_string_B_plus_node(struct string_B_plus_tree *tree, struct string_B_plus_node *node,
+int16_t pos, const struct string_B_plus_item *new_item, struct string_B_plus_item *separator)
+{
+    if (insert_an_item_in_a_string_B_plus_node_in_place(node, pos, new_item) == 0)
+        return 0;
+    struct string_B_plus_item *item = tree->scratch;
+    int16_t item_number = take_items_out_of_a_string_B_plus_node(node, item);
+    memmove(&item[pos + 1], &item[pos], (item_number - pos) * sizeof(struct string_B_plus_item));
+    item[pos].value = new_item->value;
+    item[pos].len = new_item->len;
+    memcpy(item[pos].key, new_item->key, new_item->len);
+    item_number++;
+    if (item_number <= (int16_t)STRING_B_PLUS_MAX_ENTRIES
+    && bytes_to_build_a_string_B_plus_node(tree, item, item_number, node->isleaf) <= STRING_B_PLUS_NODE_SIZE)
+    {
+        build_a_string_B_plus_node(tree, node, item, item_number);
+        return 0;
+    }
+    int16_t split_pos = choose_a_split_pos_of_string_B_plus_items(tree, item, item_number, node->isleaf);
+    struct string_B_plus_node *new_node = alloc_a_new_string_B_plus_node(node->isleaf);
+    if (node->isleaf)
+    {
+        if (tree->compress)
+            shortest_separator_of_two_string_B_plus_items(separator, &item[split_pos - 1], &item[split_pos]);
+        else
+        {
+            separator->len = item[split_pos].len;
+            memcpy(separator->key, item[split_pos].key, separator->len);
+        }
+        new_node->sibling = node->sibling;
+        node->sibling = new_node;
+    }
+    else
+    {
+        /* the first key of the right half moves up, and becomes its empty key[0] */
+        separator->len = item[split_pos].len;
+        memcpy(separator->key, item[split_pos].key, separator->len);
+        item[split_pos].len = 0;
+    }
+    separator->child = new_node;
+    build_a_string_B_plus_node(tree, new_node, item + split_pos, item_number - split_pos);
+    build_a_string_B_plus_node(tree, node, item, split_pos);
+    return 1;
+}
+
+/* return 0, or -1 if key is there already or longer than STRING_B_PLUS_KEY_MAX_LEN. */
+int insert_a_key_in_string_B_plus_tree(struct string_B_plus_tree *tree, const void *key, size_t len, uint64_t value)
+{
+    if (len > STRING_B_PLUS_KEY_MAX_LEN)
+    {
+        fprintf(stderr, "insert failed. A key of %zu bytes is longer than %d bytes.\n", len, STRING_B_PLUS_KEY_MAX_LEN);
+        return -1;
+    }
+    struct string_B_plus_item new_item, separator;
+    new_item.value = value, new_item.len = len;
+    memcpy(new_item.key, key, len);
+    if (tree->root == NULL)
+    {
+        tree->root = alloc_a_new_string_B_plus_node(1);
+        build_a_string_B_plus_node(tree, tree->root, &new_item, 1);
+        return 0;
+    }
+    struct string_B_plus_path path;
+    path.top = -1;
+    struct string_B_plus_node *cur = tree->root;
+    while (!cur->isleaf)
+    {
+        if (path.top == STRING_B_PLUS_MAX_HEIGHT - 1)
+            perror("string B plus path overflow"), exit(-1);
+        path.node_stack[++path.top] = cur;
+        path.pos_stack[path.top] = look_up_a_child_pos_in_a_string_B_plus_node(cur, key, len);
+        cur = cur->entry[path.pos_stack[path.top]].child;
+    }
+    _Bool equal;
+    int16_t pos = look_up_a_key_pos_in_a_string_B_plus_node(cur, key, len, &equal);
+    if (equal)
+    {
+        fprintf(stderr, "insert failed. This B plus tree has already the key %.*s.\n", (int)len, (const char *)key);
+        return -1;
+    }
+    /* split up the ancestors while the separator pushed up does not fit */
+    while (insert_an_item_in_a_string_B_plus_node(tree, cur, pos, &new_item, &separator))
+    {
+        new_item = separator;
+        if (path.top < 0)
+        {
+            /* create a new root after spliting the root. */
+            struct string_B_plus_node *new_root = alloc_a_new_string_B_plus_node(0);
+            struct string_B_plus_item *item = tree->scratch;
+            item[0].child = cur, item[0].len = 0;
+            item[1] = new_item;
+            build_a_string_B_plus_node(tree, new_root, item, 2);
+            tree->root = new_root;
+            break;
+        }
+        cur = path.node_stack[path.top];
+        pos = path.pos_stack[path.top--] + 1;
+    }
+    return 0;
+}
+
+/* merge the node at right_pos of parent into its left sibling if both fit
+in one node. Return 0 if they were merged. */
+static int merge_two_string_B_plus_nodes(struct string_B_plus_tree *tree, struct string_B_plus_node *parent,
+int16_t right_pos)
+{
+    struct string_B_plus_node *left = parent->entry[right_pos - 1].child, *right = parent->entry[right_pos].child;
+    struct string_B_plus_item *item = tree->scratch;
+    int16_t item_number = take_items_out_of_a_string_B_plus_node(left, item);
+    if (item_number + right->last_index + 1 > (int16_t)STRING_B_PLUS_MAX_ENTRIES)
+        return -1;
+    int16_t right_first = item_number;
+    item_number += take_items_out_of_a_string_B_plus_node(right, item + item_number);
+    if (!right->isleaf)
+    {
+        /* the empty key[0] of right gets the separator above it back */
+        take_a_key_out_of_a_string_B_plus_node(parent, right_pos, &item[right_first]);
+    }
+    if (bytes_to_build_a_string_B_plus_node(tree, item, item_number, left->isleaf) > STRING_B_PLUS_NODE_SIZE)
+        return -1;
+    build_a_string_B_plus_node(tree, left, item, item_number);
+    left->sibling = right->sibling;
+    delete_an_entry_in_a_string_B_plus_node(parent, right_pos);
+    free(right);
+    return 0;
+}
+
+/* return 0, or -1 if key is absent. A node which falls under a quarter of
+its page is merged with a sibling when both fit in one page. */
+int delete_a_key_in_string_B_plus_tree(struct string_B_plus_tree *tree, const void *key, size_t len)
+{
+    struct string_B_plus_path path;
+    path.top = -1;
+    struct string_B_plus_node *cur = tree->root;
+    if (cur == NULL)
+    {
+        fprintf(stderr, "No key value in B plus tree!\n");
+        return -1;
+    }
+    while (!cur->isleaf)
+    {
+        if (path.top == STRING_B_PLUS_MAX_HEIGHT - 1)
+            perror("string B plus path overflow"), exit(-1);
+        path.node_stack[++path.top] = cur;
+        path.pos_stack[path.top] = look_up_a_child_pos_in_a_string_B_plus_node(cur, key, len);
+        cur = cur->entry[path.pos_stack[path.top]].child;
+    }
+    _Bool equal;
+    int16_t del_pos = look_up_a_key_pos_in_a_string_B_plus_node(cur, key, len, &equal);
+    if (!equal)
+    {
+        fprintf(stderr, "No key value in B plus tree!\n");
+        return -1;
+    }
+    delete_an_entry_in_a_string_B_plus_node(cur, del_pos);
+    while (path.top >= 0 && used_bytes_in_a_string_B_plus_node(cur) < STRING_B_PLUS_NODE_SIZE >> 2)
+    {
+        struct string_B_plus_node *parent = path.node_stack[path.top];
+        int16_t pos = path.pos_stack[path.top--];
+        if (pos > 0)
+            merge_two_string_B_plus_nodes(tree, parent, pos);
+        else if (pos < parent->last_index)
+            merge_two_string_B_plus_nodes(tree, parent, pos + 1);
+        cur = parent;
+    }
+    /* the root keeps one key at least, unless the tree is empty */
+    while (!tree->root->isleaf && tree->root->last_index == 0)
+    {
+        struct string_B_plus_node *root = tree->root;
+        tree->root = root->entry[0].child;
+        free(root);
+    }
+    if (tree->root->last_index < 0)
+    {
+        free(tree->root);
+        tree->root = NULL;
+    }
+    return 0;
+}
+
+static void delete_all_nodes_in_string_B_plus_tree(struct string_B_plus_node *node)
+{
+    if (node == NULL) return;
+    if (!node->isleaf)
+        for (int16_t i = 0; i <= node->last_index; i++)
+            delete_all_nodes_in_string_B_plus_tree(node->entry[i].child);
+    free(node);
+    return;
+}
+
+void destroy_string_B_plus_tree(struct string_B_plus_tree *tree)
+{
+    delete_all_nodes_in_string_B_plus_tree(tree->root);
+    free(tree->scratch);
+    free(tree);
+    return;
+}
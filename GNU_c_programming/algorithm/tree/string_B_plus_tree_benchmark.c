@@ -0,0 +1,106 @@
+#include "string_B_plus_tree.c"
+#include <time.h>
+/* space and lookup latency of string_B_plus_tree.c with whole keys against
+prefix compression and suffix truncation, on URL-like keys which share
+long prefixes. */
+#define KEY_NUMBER 1000000
+#define LOOKUP_NUMBER 2000000
+
+struct string_B_plus_shape {
+    int32_t height;
+    int64_t leaf_number, internal_number;
+    int64_t key_bytes;};
+
+static void measure_a_string_B_plus_subtree(struct string_B_plus_node *node, int32_t depth,
+struct string_B_plus_shape *shape)
+{
+    if (depth > shape->height) shape->height = depth;
+    shape->key_bytes += node->key_bytes;
+    if (node->isleaf)
+    {
+        shape->leaf_number++;
+        return;
+    }
+    shape->internal_number++;
+    for (int16_t i = 0; i <= node->last_index; i++)
+        measure_a_string_B_plus_subtree(node->entry[i].child, depth + 1, shape);
+    return;
+}
+
+static uint64_t xorshift64(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static double elapsed_ns(struct timespec *start, struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
+
+static const char *const site[] = {"https://www.example-shop.com", "https://static.example-cdn.net",
+"https://api.example-payments.io", "https://blog.example-news.org"};
+static const char *const section[] = {"/catalog/electronics/computers/laptops", "/catalog/home/kitchen/appliances",
+"/assets/images/products/thumbnails", "/v2/customers/accounts/transactions", "/articles/2023/technology/reviews"};
+
+/* a URL: a host, a deep section, an item id and sometimes a query */
+static int make_a_URL_like_key(char *key, uint64_t *state)
+{
+    uint64_t random = xorshift64(state);
+    int len = sprintf(key, "%s%s/item-%08" PRIu64, site[random % 4], section[(random >> 8) % 5],
+    (random >> 16) % 100000000);
+    if ((random >> 48) % 3 == 0)
+        len += sprintf(key + len, "?utm_source=newsletter&page=%" PRIu64, (random >> 56) % 10);
+    return len;
+}
+
+int main(void)
+{
+    char (*key)[STRING_B_PLUS_KEY_MAX_LEN] = malloc(KEY_NUMBER * sizeof(*key));
+    int *key_len = (int *)malloc(KEY_NUMBER * sizeof(int));
+    int32_t *probe = (int32_t *)malloc(LOOKUP_NUMBER * sizeof(int32_t));
+    if (key == NULL || key_len == NULL || probe == NULL)
+        perror("fail to allocate the keys"), exit(EXIT_FAILURE);
+    uint64_t state = 0x9E3779B97F4A7C15;
+    int64_t total_key_len = 0;
+    for (int32_t i = 0; i < KEY_NUMBER; i++)
+        total_key_len += key_len[i] = make_a_URL_like_key(key[i], &state);
+    for (int32_t i = 0; i < LOOKUP_NUMBER; i++)
+        probe[i] = xorshift64(&state) % KEY_NUMBER;
+    printf("%d keys, %.1f bytes per key on average\n", KEY_NUMBER, (double)total_key_len / KEY_NUMBER);
+
+    for (int compress = 0; compress <= 1; compress++)
+    {
+        struct string_B_plus_tree *tree = init_string_B_plus_tree(compress);
+        struct timespec start, end;
+        int32_t inserted = 0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int32_t i = 0; i < KEY_NUMBER; i++)
+            /* a generated key may repeat, which is rejected */
+            inserted += insert_a_key_in_string_B_plus_tree(tree, key[i], key_len[i], i) == 0;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double insert_ns = elapsed_ns(&start, &end) / KEY_NUMBER;
+
+        int64_t found = 0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int32_t i = 0; i < LOOKUP_NUMBER; i++)
+            found += look_up_a_key_in_string_B_plus_tree(tree, key[probe[i]], key_len[probe[i]], NULL) == 0;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        struct string_B_plus_shape shape = {0};
+        measure_a_string_B_plus_subtree(tree->root, 1, &shape);
+        int64_t node_bytes = (shape.leaf_number + shape.internal_number) * STRING_B_PLUS_NODE_SIZE;
+        printf("%s: height %" PRId32", %" PRId64" leaves, %" PRId64" internal nodes, "
+        "%.1f node bytes per key (%.1f key bytes), insert %.0f ns, lookup %.0f ns, %" PRId64" found\n",
+        compress ? "prefix/suffix compressed" : "whole keys", shape.height, shape.leaf_number,
+        shape.internal_number, (double)node_bytes / inserted, (double)shape.key_bytes / inserted,
+        insert_ns, elapsed_ns(&start, &end) / LOOKUP_NUMBER, found);
+        destroy_string_B_plus_tree(tree);
+    }
+    free(probe);
+    free(key_len);
+    free(key);
+    return 0;
+}